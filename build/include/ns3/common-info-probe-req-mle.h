@@ -0,0 +1 @@
+#include "/root/repo/src/wifi/model/eht/common-info-probe-req-mle.h"
@@ -0,0 +1 @@
+#include "/root/repo/src/internet-apps/model/dhcp-client.h"
@@ -0,0 +1 @@
+#include "/root/repo/src/mesh/helper/flame/flame-installer.h"
@@ -0,0 +1 @@
+#include "/root/repo/src/flow-monitor/model/ipv4-flow-probe.h"
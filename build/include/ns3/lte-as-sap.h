@@ -0,0 +1 @@
+#include "/root/repo/src/lte/model/lte-as-sap.h"
@@ -0,0 +1 @@
+#include "/root/repo/src/mesh/model/mesh-information-element-vector.h"
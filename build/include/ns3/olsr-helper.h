@@ -0,0 +1 @@
+#include "/root/repo/src/olsr/helper/olsr-helper.h"
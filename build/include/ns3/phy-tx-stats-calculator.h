@@ -0,0 +1 @@
+#include "/root/repo/src/lte/helper/phy-tx-stats-calculator.h"
@@ -0,0 +1 @@
+#include "/root/repo/src/lte/helper/radio-bearer-stats-connector.h"
@@ -0,0 +1 @@
+#include "/root/repo/src/energy/model/simple-device-energy-model.h"
@@ -0,0 +1 @@
+#include "/root/repo/src/tap-bridge/model/tap-encode-decode.h"
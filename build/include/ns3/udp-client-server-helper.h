@@ -0,0 +1 @@
+#include "/root/repo/src/applications/helper/udp-client-server-helper.h"
@@ -27,15 +27,21 @@
 #include "ns3/packet.h"
 #include "ns3/point-to-point-helper.h"
 #include "ns3/qbb-helper.h"
+#include <ns3/flow-trace.h>
+#include <ns3/packet-trace.h>
+#include <ns3/queue-monitor.h>
 #include <ns3/rdma-client-helper.h>
 #include <ns3/rdma-client.h>
 #include <ns3/rdma-driver.h>
+#include <ns3/rdma-workload-generator.h>
 #include <ns3/rdma.h>
+#include <ns3/route-calculator.h>
 #include <ns3/sim-setting.h>
 #include <ns3/switch-node.h>
 
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <time.h>
 #include <unordered_map>
 
@@ -47,6 +53,15 @@ NS_LOG_COMPONENT_DEFINE("GENERIC_SIMULATION");
 uint32_t cc_mode = 1;
 uint64_t cncp_gamma = 1500;
 uint64_t cncp_lambda = 100000000000;
+bool cncp_batched_timers = false;
+uint32_t cncp_report_batch = 1;
+uint64_t cncp_report_interval = 1000, cncp_update_interval = 1000,
+         cncp_flow_expired_interval = 4000;
+double cncp_queue_weight = 1.1, cncp_alpha = 1;
+std::string cncp_utility = "Log";
+uint64_t cncp_utility_ref_rate = 1000000000;
+std::map<uint32_t, double> cncp_pg_weights;
+bool cncp_fixed_point = false;
 uint32_t nic_dequeue_mode = 0;
 bool enable_qcn = true, enable_pfc = true, use_dynamic_pfc_threshold = true;
 uint32_t packet_payload_size = 1000, l2_chunk_size = 0, l2_ack_interval = 0;
@@ -72,21 +87,27 @@ bool sample_feedback = false;
 double pint_log_base = 1.05;
 double pint_prob = 1.0;
 bool use_coding_transport = false;
+bool coding_cc = false; // coding flows follow the CC of cc_mode
 double u_target = 0.95;
 uint32_t int_multi = 1;
 bool rate_bound = true;
+uint64_t rx_qp_idle_timeout = 0; // ns, 0: an rx qp is deleted when its flow completes
 
 uint32_t ack_high_prio = 0;
 uint64_t link_down_time = 0;
 uint32_t link_down_A = 0, link_down_B = 0;
 
 uint32_t enable_trace = 1;
+uint32_t trace_events = PacketTraceWriter::allEvents, trace_sample = 1, trace_flow_sample = 1;
+std::vector<std::pair<double, double>> trace_windows;
+uint32_t trace_trigger_pfc = 0, trace_trigger_drop = 0, trace_trigger_qlen = 0;
+double trace_trigger_before = 0, trace_trigger_after = 0; // us
 
 uint32_t buffer_size = 16;
 
 uint32_t qlen_dump_interval = 100000000, qlen_mon_interval = 100;
 uint64_t qlen_mon_start = 2000000000, qlen_mon_end = 2100000000;
-string qlen_mon_file;
+string qlen_mon_file, qlen_mon_format = "text";
 
 unordered_map<uint64_t, uint32_t> rate2kmax, rate2kmin;
 unordered_map<uint64_t, double> rate2pmax;
@@ -94,7 +115,7 @@ unordered_map<uint64_t, double> rate2pmax;
 /************************************************
  * Runtime varibles
  ***********************************************/
-std::ifstream topof, flowf, tracef;
+std::ifstream topof, tracef;
 
 NodeContainer n;
 
@@ -102,59 +123,52 @@ uint64_t nic_rate;
 
 uint64_t maxRtt, maxBdp;
 
-struct Interface
+// ECMP routes of the topology and the delays between hosts, by node id
+RouteCalculator routes;
+
+// base RTT of a host pair
+uint64_t
+PairRtt(uint32_t src, uint32_t dst)
 {
-    uint32_t idx;
-    bool up;
-    uint64_t delay;
-    uint64_t bw;
-
-    Interface()
-        : idx(0),
-          up(false)
-    {
-    }
-};
+    return routes.GetDelay(src, dst) * 2;
+}
 
-map<Ptr<Node>, map<Ptr<Node>, Interface>> nbr2if;
-// Mapping destination to next hop for each node: <node, <dest, <nexthop0, ...> > >
-map<Ptr<Node>, map<Ptr<Node>, vector<Ptr<Node>>>> nextHop;
-map<Ptr<Node>, map<Ptr<Node>, uint64_t>> pairDelay;
-map<Ptr<Node>, map<Ptr<Node>, uint64_t>> pairTxDelay;
-map<uint32_t, map<uint32_t, uint64_t>> pairBw;
-map<Ptr<Node>, map<Ptr<Node>, uint64_t>> pairBdp;
-map<uint32_t, map<uint32_t, uint64_t>> pairRtt;
+// BDP of a host pair
+uint64_t
+PairBdp(uint32_t src, uint32_t dst)
+{
+    return PairRtt(src, dst) * routes.GetBw(src, dst) / 1000000000 / 8;
+}
 
 std::vector<Ipv4Address> serverAddress;
 
 // maintain port number for each host pair
 std::unordered_map<uint32_t, unordered_map<uint32_t, uint16_t>> portNumder;
 
-struct FlowInput
-{
-    uint32_t src, dst, pg, maxPacketCount, port, dport;
-    double start_time;
-    uint32_t idx;
-};
-
-FlowInput flow_input = {0};
-uint32_t flow_num;
+// the flow trace, text or binary (see FlowTraceReader), streamed while the simulation runs
+FlowTraceReader flowReader;
+FlowTraceRecord flow_input;
+bool flow_pending = false; // flow_input holds the next flow to hand out
+// flows are handed to the RdmaDriver of their source this far ahead of their start, and at
+// most flow_batch at a time, which bounds the flows waiting in the drivers
+double flow_lookahead = 0.001;
+uint32_t flow_batch = 4096;
+// with WORKLOAD_CDF set, the flows are drawn by a RdmaWorkloadGenerator instead of read from
+// FLOW_FILE, see its attributes for the WORKLOAD_* keys
+std::string workload_cdf;
+double workload_load = 0.3;
+std::string workload_pattern = "AllToAll";
+uint32_t workload_fanin = 16;
+double workload_start = 2.0;
+double workload_stop = 2.01;
+Ptr<RdmaWorkloadGenerator> workload;
 
 void
 ReadFlowInput()
 {
-    if (flow_input.idx < flow_num)
+    flow_pending = workload ? workload->Next(flow_input) : flowReader.Read(flow_input);
+    if (flow_pending)
     {
-        flowf >> flow_input.src >> flow_input.dst >> flow_input.pg >> flow_input.dport >>
-            flow_input.maxPacketCount >> flow_input.start_time;
-
-        auto srcNode = n.Get(flow_input.src);
-        auto dstNode = n.Get(flow_input.dst);
-
-        NS_LOG_DEBUG("[Debug] Flow #" << flow_input.idx << " src=" << flow_input.src
-                  << " (type=" << srcNode->GetNodeType() << ")"
-                  << ", dst=" << flow_input.dst << " (type=" << dstNode->GetNodeType() << ")"
-                  << std::endl);
         NS_ASSERT(n.Get(flow_input.src)->GetNodeType() == 0 &&
                   n.Get(flow_input.dst)->GetNodeType() == 0);
     }
@@ -163,38 +177,49 @@ ReadFlowInput()
 void
 ScheduleFlowInputs()
 {
-    while (flow_input.idx < flow_num && Seconds(flow_input.start_time) == Simulator::Now())
+    Time horizon = Simulator::Now() + Seconds(flow_lookahead);
+    Time last = Simulator::Now();
+    uint32_t batch = 0;
+    while (flow_pending && flow_input.start <= horizon && batch < flow_batch)
     {
-        size_t winSize = (global_t == 1 ? maxBdp : pairBdp[n.Get(flow_input.src)][n.Get(flow_input.dst)]);
+        size_t winSize = (global_t == 1 ? maxBdp : PairBdp(flow_input.src, flow_input.dst));
         // has_win is effective in all cases except when use_coding_transport is true and pg != 2.
-        // In other words, when use_coding_transport is true, only pg==2 flows can use has_win.
-        bool isSetWin = has_win && (!use_coding_transport || flow_input.pg == 2);
+        // In other words, when use_coding_transport is true, only pg==2 flows can use has_win,
+        // unless coding flows follow the CC, which may bound their symbols in flight.
+        bool isSetWin = has_win && (!use_coding_transport || flow_input.pg == 2 || coding_cc);
         uint32_t port = portNumder[flow_input.src][flow_input.dst]++; // get a new port number
-        RdmaClientHelper clientHelper(
-            flow_input.pg,
-            serverAddress[flow_input.src],
-            serverAddress[flow_input.dst],
-            port,
-            flow_input.dport,
-            flow_input.maxPacketCount,
-            isSetWin ? winSize : 0,
-            global_t == 1 ? maxRtt : pairRtt[flow_input.src][flow_input.dst]);
-        ApplicationContainer appCon = clientHelper.Install(n.Get(flow_input.src));
-        appCon.Start(Time(0));
+        // hand the flow to the source's RdmaDriver, without a per-flow RdmaClient
+        RdmaDriver::Flow flow;
+        flow.start = Max(flow_input.start, Simulator::Now());
+        flow.size = flow_input.size;
+        flow.pg = flow_input.pg;
+        flow.sip = serverAddress[flow_input.src];
+        flow.dip = serverAddress[flow_input.dst];
+        flow.sport = port;
+        flow.dport = flow_input.dport;
+        flow.win = isSetWin ? winSize : 0;
+        flow.baseRtt = global_t == 1 ? maxRtt : PairRtt(flow_input.src, flow_input.dst);
+        n.Get(flow_input.src)->GetObject<RdmaDriver>()->AddFlow(flow);
+        last = flow.start;
+        batch++;
 
         // get the next flow input
-        flow_input.idx++;
         ReadFlowInput();
     }
 
-    // schedule the next time to run this function
-    if (flow_input.idx < flow_num)
+    // schedule the next batch, after the current one has started if it was full
+    if (flow_pending)
     {
-        Simulator::Schedule(Seconds(flow_input.start_time) - Simulator::Now(), ScheduleFlowInputs);
+        Time next = Max(flow_input.start - Seconds(flow_lookahead), Simulator::Now());
+        if (batch == flow_batch)
+        {
+            next = Max(next, last);
+        }
+        Simulator::Schedule(next - Simulator::Now(), ScheduleFlowInputs);
     }
     else
     { // no more flows, close the file
-        flowf.close();
+        flowReader.Close();
     }
 }
 
@@ -214,7 +239,7 @@ void
 qp_finish(FILE* fout, Ptr<RdmaQueuePair> q)
 {
     uint32_t sid = ip_to_node_id(q->sip), did = ip_to_node_id(q->dip);
-    uint64_t base_rtt = pairRtt[sid][did], b = pairBw[sid][did];
+    uint64_t base_rtt = PairRtt(sid, did), b = routes.GetBw(sid, did);
     uint32_t total_bytes =
         q->m_size + ((q->m_size - 1) / packet_payload_size + 1) *
                         (CustomHeader::GetStaticWholeHeaderSize() -
@@ -255,234 +280,37 @@ get_pfc(FILE* fout, Ptr<QbbNetDevice> dev, uint32_t type)
             type);
 }
 
-struct QlenDistribution
-{
-    vector<uint32_t> cnt; // cnt[i] is the number of times that the queue len is i KB
-
-    void add(uint32_t qlen)
-    {
-        uint32_t kb = qlen / 1000;
-        if (cnt.size() < kb + 1)
-        {
-            cnt.resize(kb + 1);
-        }
-        cnt[kb]++;
-    }
-};
-
-map<uint32_t, map<uint32_t, QlenDistribution>> queue_result;
-
-void
-monitor_buffer(FILE* qlen_output, NodeContainer* n)
-{
-    for (uint32_t i = 0; i < n->GetN(); i++)
-    {
-        if (n->Get(i)->GetNodeType() == 1)
-        { // is switch
-            Ptr<SwitchNode> sw = DynamicCast<SwitchNode>(n->Get(i));
-            if (queue_result.find(i) == queue_result.end())
-            {
-                queue_result[i];
-            }
-            for (uint32_t j = 1; j < sw->GetNDevices(); j++)
-            {
-                uint32_t size = 0;
-                for (uint32_t k = 0; k < SwitchMmu::qCnt; k++)
-                {
-                    size += sw->m_mmu->egress_bytes[j][k];
-                }
-                queue_result[i][j].add(size);
-            }
-        }
-    }
-    if (Simulator::Now().GetTimeStep() % qlen_dump_interval == 0)
-    {
-        fprintf(qlen_output, "time: %lu\n", Simulator::Now().GetTimeStep());
-        for (auto& it0 : queue_result)
-        {
-            for (auto& it1 : it0.second)
-            {
-                fprintf(qlen_output, "%u %u", it0.first, it1.first);
-                auto& dist = it1.second.cnt;
-                for (uint32_t i = 0; i < dist.size(); i++)
-                {
-                    fprintf(qlen_output, " %u", dist[i]);
-                }
-                fprintf(qlen_output, "\n");
-            }
-        }
-        fflush(qlen_output);
-    }
-    if (Simulator::Now().GetTimeStep() < qlen_mon_end)
-    {
-        Simulator::Schedule(NanoSeconds(qlen_mon_interval), &monitor_buffer, qlen_output, n);
-    }
-}
-
-void
-CalculateRoute(Ptr<Node> host)
-{
-    // queue for the BFS.
-    vector<Ptr<Node>> q;
-    // Distance from the host to each node.
-    map<Ptr<Node>, int> dis;
-    map<Ptr<Node>, uint64_t> delay;
-    map<Ptr<Node>, uint64_t> txDelay;
-    map<Ptr<Node>, uint64_t> bw;
-    // init BFS.
-    q.push_back(host);
-    dis[host] = 0;
-    delay[host] = 0;
-    txDelay[host] = 0;
-    bw[host] = 0xfffffffffffffffflu;
-    // BFS.
-    for (int i = 0; i < (int)q.size(); i++)
-    {
-        Ptr<Node> now = q[i];
-        int d = dis[now];
-        for (auto it = nbr2if[now].begin(); it != nbr2if[now].end(); it++)
-        {
-            // skip down link
-            if (!it->second.up)
-            {
-                continue;
-            }
-            Ptr<Node> next = it->first;
-            // If 'next' have not been visited.
-            if (dis.find(next) == dis.end())
-            {
-                dis[next] = d + 1;
-                delay[next] = delay[now] + it->second.delay;
-                txDelay[next] =
-                    txDelay[now] + packet_payload_size * 1000000000lu * 8 / it->second.bw;
-                bw[next] = std::min(bw[now], it->second.bw);
-                // we only enqueue switch, because we do not want packets to go through host as
-                // middle point
-                if (next->GetNodeType() == 1)
-                {
-                    q.push_back(next);
-                }
-            }
-            // if 'now' is on the shortest path from 'next' to 'host'.
-            if (d + 1 == dis[next])
-            {
-                nextHop[next][host].push_back(now);
-            }
-        }
-    }
-    for (auto it : delay)
-    {
-        pairDelay[it.first][host] = it.second;
-    }
-    for (auto it : txDelay)
-    {
-        pairTxDelay[it.first][host] = it.second;
-    }
-    for (auto it : bw)
-    {
-        pairBw[it.first->GetId()][host->GetId()] = it.second;
-    }
-}
-
 void
-CalculateRoutes(NodeContainer& n)
+PrintRoute(uint32_t node, uint32_t dst, uint32_t ifIndex)
 {
-    for (int i = 0; i < (int)n.GetN(); i++)
-    {
-        Ptr<Node> node = n.Get(i);
-        if (node->GetNodeType() == 0)
-        {
-            CalculateRoute(node);
-        }
-    }
-}
-
-void
-SetRoutingEntries()
-{
-    // For each node.
-    for (auto i = nextHop.begin(); i != nextHop.end(); i++)
-    {
-        Ptr<Node> node = i->first;
-        auto& table = i->second;
-        for (auto j = table.begin(); j != table.end(); j++)
-        {
-            // The destination node.
-            Ptr<Node> dst = j->first;
-            // The IP address of the dst.
-            Ipv4Address dstAddr = dst->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal();
-            // The next hops towards the dst.
-            vector<Ptr<Node>> nexts = j->second;
-            for (int k = 0; k < (int)nexts.size(); k++)
-            {
-                Ptr<Node> next = nexts[k];
-                uint32_t interface = nbr2if[node][next].idx;
-                if (node->GetNodeType() == 1)
-                {
-                    DynamicCast<SwitchNode>(node)->AddTableEntry(dstAddr, interface);
-                }
-                else
-                {
-                    node->GetObject<RdmaDriver>()->m_rdma->AddTableEntry(dstAddr, interface);
-                }
-            }
-        }
-    }
+    std::cout << "From node " << node << " (type=" << n.Get(node)->GetNodeType()
+              << ") to destination node " << dst << ": next hop device " << ifIndex << std::endl;
 }
 
 void
 PrintRoutingTable()
 {
-    std::cout << "\n=== Routing Table (nextHop) ===" << std::endl;
-    for (const auto& entry : nextHop)
-    {
-        Ptr<Node> from = entry.first;
-        std::cout << "From node " << from->GetId() << " (type=" << from->GetNodeType()
-                  << "):" << std::endl;
-
-        for (const auto& destEntry : entry.second)
-        {
-            Ptr<Node> dst = destEntry.first;
-            std::cout << "  To destination node " << dst->GetId() << " (type=" << dst->GetNodeType()
-                      << "): next hops = ";
-
-            for (auto next : destEntry.second)
-            {
-                std::cout << next->GetId() << " ";
-            }
-            std::cout << std::endl;
-        }
-    }
+    std::cout << "\n=== Routing Table ===" << std::endl;
+    routes.ComputeRoutes(MakeCallback(&PrintRoute));
 }
 
 // take down the link between a and b, and redo the routing
 void
 TakeDownLink(NodeContainer n, Ptr<Node> a, Ptr<Node> b)
 {
-    if (!nbr2if[a][b].up)
+    // take down link between a and b
+    if (!routes.SetLinkUp(a->GetId(), b->GetId(), false))
     {
         return;
     }
-    // take down link between a and b
-    nbr2if[a][b].up = nbr2if[b][a].up = false;
-    nextHop.clear();
-    CalculateRoutes(n);
     // clear routing tables
-    for (uint32_t i = 0; i < n.GetN(); i++)
-    {
-        if (n.Get(i)->GetNodeType() == 1)
-        {
-            DynamicCast<SwitchNode>(n.Get(i))->ClearTable();
-        }
-        else
-        {
-            n.Get(i)->GetObject<RdmaDriver>()->m_rdma->ClearTable();
-        }
-    }
-    DynamicCast<QbbNetDevice>(a->GetDevice(nbr2if[a][b].idx))->TakeDown();
-    DynamicCast<QbbNetDevice>(b->GetDevice(nbr2if[b][a].idx))->TakeDown();
+    routes.ClearRoutes();
+    DynamicCast<QbbNetDevice>(a->GetDevice(routes.GetInterface(a->GetId(), b->GetId())))
+        ->TakeDown();
+    DynamicCast<QbbNetDevice>(b->GetDevice(routes.GetInterface(b->GetId(), a->GetId())))
+        ->TakeDown();
     // reset routing table
-    SetRoutingEntries();
+    routes.InstallRoutes();
 
     // redistribute qp on each host
     for (uint32_t i = 0; i < n.GetN(); i++)
@@ -781,6 +609,42 @@ main(int argc, char* argv[])
                 flow_file = v;
                 std::cout << "FLOW_FILE\t\t\t" << flow_file << "\n";
             }
+            else if (key.compare("FLOW_LOOKAHEAD") == 0)
+            {
+                conf >> flow_lookahead;
+                std::cout << "FLOW_LOOKAHEAD\t\t\t" << flow_lookahead << "\n";
+            }
+            else if (key.compare("FLOW_BATCH") == 0)
+            {
+                conf >> flow_batch;
+                std::cout << "FLOW_BATCH\t\t\t" << flow_batch << "\n";
+            }
+            else if (key.compare("WORKLOAD_CDF") == 0)
+            {
+                conf >> workload_cdf;
+                std::cout << "WORKLOAD_CDF\t\t\t" << workload_cdf << "\n";
+            }
+            else if (key.compare("WORKLOAD_LOAD") == 0)
+            {
+                conf >> workload_load;
+                std::cout << "WORKLOAD_LOAD\t\t\t" << workload_load << "\n";
+            }
+            else if (key.compare("WORKLOAD_PATTERN") == 0)
+            {
+                conf >> workload_pattern;
+                std::cout << "WORKLOAD_PATTERN\t\t" << workload_pattern << "\n";
+            }
+            else if (key.compare("WORKLOAD_INCAST_FANIN") == 0)
+            {
+                conf >> workload_fanin;
+                std::cout << "WORKLOAD_INCAST_FANIN\t\t" << workload_fanin << "\n";
+            }
+            else if (key.compare("WORKLOAD_TIME") == 0)
+            {
+                conf >> workload_start >> workload_stop;
+                std::cout << "WORKLOAD_TIME\t\t\t" << workload_start << " " << workload_stop
+                          << "\n";
+            }
             else if (key.compare("TRACE_FILE") == 0)
             {
                 std::string v;
@@ -923,6 +787,11 @@ main(int argc, char* argv[])
                 rate_bound = v;
                 std::cout << "RATE_BOUND\t\t" << rate_bound << '\n';
             }
+            else if (key.compare("RX_QP_IDLE_TIMEOUT") == 0)
+            {
+                conf >> rx_qp_idle_timeout;
+                std::cout << "RX_QP_IDLE_TIMEOUT\t\t" << rx_qp_idle_timeout << '\n';
+            }
             else if (key.compare("ACK_HIGH_PRIO") == 0)
             {
                 conf >> ack_high_prio;
@@ -949,6 +818,43 @@ main(int argc, char* argv[])
                 conf >> enable_trace;
                 std::cout << "ENABLE_TRACE\t\t\t\t" << enable_trace << '\n';
             }
+            else if (key.compare("TRACE_EVENTS") == 0)
+            {
+                conf >> trace_events;
+                std::cout << "TRACE_EVENTS\t\t\t\t" << trace_events << '\n';
+            }
+            else if (key.compare("TRACE_SAMPLE") == 0)
+            {
+                conf >> trace_sample;
+                std::cout << "TRACE_SAMPLE\t\t\t\t" << trace_sample << '\n';
+            }
+            else if (key.compare("TRACE_FLOW_SAMPLE") == 0)
+            {
+                conf >> trace_flow_sample;
+                std::cout << "TRACE_FLOW_SAMPLE\t\t\t" << trace_flow_sample << '\n';
+            }
+            else if (key.compare("TRACE_WINDOW") == 0)
+            {
+                int n_w;
+                conf >> n_w;
+                std::cout << "TRACE_WINDOW\t\t\t\t";
+                for (int i = 0; i < n_w; i++)
+                {
+                    double start, stop;
+                    conf >> start >> stop;
+                    trace_windows.emplace_back(start, stop);
+                    std::cout << ' ' << start << ' ' << stop;
+                }
+                std::cout << '\n';
+            }
+            else if (key.compare("TRACE_TRIGGER") == 0)
+            {
+                conf >> trace_trigger_pfc >> trace_trigger_drop >> trace_trigger_qlen >>
+                    trace_trigger_before >> trace_trigger_after;
+                std::cout << "TRACE_TRIGGER\t\t\t\t" << trace_trigger_pfc << ' '
+                          << trace_trigger_drop << ' ' << trace_trigger_qlen << ' '
+                          << trace_trigger_before << ' ' << trace_trigger_after << '\n';
+            }
             else if (key.compare("KMAX_MAP") == 0)
             {
                 int n_k;
@@ -1014,6 +920,11 @@ main(int argc, char* argv[])
                 conf >> qlen_mon_end;
                 std::cout << "QLEN_MON_END\t\t\t\t" << qlen_mon_end << '\n';
             }
+            else if (key.compare("QLEN_MON_FORMAT") == 0)
+            {
+                conf >> qlen_mon_format;
+                std::cout << "QLEN_MON_FORMAT\t\t\t\t" << qlen_mon_format << '\n';
+            }
             else if (key.compare("MULTI_RATE") == 0)
             {
                 int v;
@@ -1043,6 +954,11 @@ main(int argc, char* argv[])
                 conf >> use_coding_transport;
                 std::cout << "USE_CODING_TRANSPORT\t\t\t\t" << use_coding_transport << '\n';
             }
+            else if (key.compare("CODING_CC") == 0)
+            {
+                conf >> coding_cc;
+                std::cout << "CODING_CC\t\t\t\t" << coding_cc << '\n';
+            }
             else if (key.compare("CNCP_GAMMA") == 0)
             {
                 conf >> cncp_gamma;
@@ -1053,6 +969,72 @@ main(int argc, char* argv[])
                 conf >> cncp_lambda;
                 std::cout << "CNCP_LAMBDA\t\t\t\t" << cncp_lambda << '\n';
             }
+            else if (key.compare("CNCP_BATCHED_TIMERS") == 0)
+            {
+                conf >> cncp_batched_timers;
+                std::cout << "CNCP_BATCHED_TIMERS\t\t\t" << cncp_batched_timers << '\n';
+            }
+            else if (key.compare("CNCP_REPORT_BATCH") == 0)
+            {
+                conf >> cncp_report_batch;
+                std::cout << "CNCP_REPORT_BATCH\t\t\t" << cncp_report_batch << '\n';
+            }
+            else if (key.compare("CNCP_REPORT_INTERVAL") == 0)
+            {
+                conf >> cncp_report_interval;
+                std::cout << "CNCP_REPORT_INTERVAL\t\t\t" << cncp_report_interval << '\n';
+            }
+            else if (key.compare("CNCP_UPDATE_INTERVAL") == 0)
+            {
+                conf >> cncp_update_interval;
+                std::cout << "CNCP_UPDATE_INTERVAL\t\t\t" << cncp_update_interval << '\n';
+            }
+            else if (key.compare("CNCP_FLOW_EXPIRED_INTERVAL") == 0)
+            {
+                conf >> cncp_flow_expired_interval;
+                std::cout << "CNCP_FLOW_EXPIRED_INTERVAL\t\t" << cncp_flow_expired_interval
+                          << '\n';
+            }
+            else if (key.compare("CNCP_QUEUE_WEIGHT") == 0)
+            {
+                conf >> cncp_queue_weight;
+                std::cout << "CNCP_QUEUE_WEIGHT\t\t\t" << cncp_queue_weight << '\n';
+            }
+            else if (key.compare("CNCP_UTILITY") == 0)
+            {
+                conf >> cncp_utility;
+                std::cout << "CNCP_UTILITY\t\t\t\t" << cncp_utility << '\n';
+            }
+            else if (key.compare("CNCP_ALPHA") == 0)
+            {
+                conf >> cncp_alpha;
+                std::cout << "CNCP_ALPHA\t\t\t\t" << cncp_alpha << '\n';
+            }
+            else if (key.compare("CNCP_UTILITY_REF_RATE") == 0)
+            {
+                conf >> cncp_utility_ref_rate;
+                std::cout << "CNCP_UTILITY_REF_RATE\t\t\t" << cncp_utility_ref_rate << '\n';
+            }
+            else if (key.compare("CNCP_PG_WEIGHTS") == 0)
+            {
+                uint32_t n_pg;
+                conf >> n_pg;
+                std::cout << "CNCP_PG_WEIGHTS\t\t\t\t";
+                for (uint32_t i = 0; i < n_pg; i++)
+                {
+                    uint32_t pg;
+                    double w;
+                    conf >> pg >> w;
+                    cncp_pg_weights[pg] = w;
+                    std::cout << ' ' << pg << ' ' << w;
+                }
+                std::cout << '\n';
+            }
+            else if (key.compare("CNCP_FIXED_POINT") == 0)
+            {
+                conf >> cncp_fixed_point;
+                std::cout << "CNCP_FIXED_POINT\t\t\t" << cncp_fixed_point << '\n';
+            }
             
             
             fflush(stdout);
@@ -1104,11 +1086,16 @@ main(int argc, char* argv[])
     // SeedManager::SetSeed(time(NULL));
 
     topof.open(topology_file.c_str());
-    flowf.open(flow_file.c_str());
+    if (workload_cdf.empty())
+    {
+        if (!flowReader.Open(flow_file))
+        {
+            NS_FATAL_ERROR("cannot read the flow trace " << flow_file);
+        }
+    }
     tracef.open(trace_file.c_str());
     uint32_t node_num, switch_num, link_num, trace_num;
     topof >> node_num >> switch_num >> link_num;
-    flowf >> flow_num;
     tracef >> trace_num;
 
     // n.Create(node_num);
@@ -1150,6 +1137,9 @@ main(int argc, char* argv[])
             serverAddress[i] = node_id_to_ip(i);
         }
     }
+    routes.SetNodes(n, serverAddress);
+    routes.SetHostAddressing(0x0b000001, 8); // see node_id_to_ip
+    routes.SetPayloadSize(packet_payload_size);
 
     NS_LOG_INFO("Create channels.");
 
@@ -1215,20 +1205,11 @@ main(int argc, char* argv[])
             ipv4->AddAddress(1, Ipv4InterfaceAddress(serverAddress[dst], Ipv4Mask(0xff000000)));
         }
         // used to create a graph of the topology
-        nbr2if[snode][dnode].idx = DynamicCast<QbbNetDevice>(d.Get(0))->GetIfIndex();
-        nbr2if[snode][dnode].up = true;
-        nbr2if[snode][dnode].delay =
-            DynamicCast<QbbChannel>(DynamicCast<QbbNetDevice>(d.Get(0))->GetChannel())
-                ->GetDelay()
-                .GetTimeStep();
-        nbr2if[snode][dnode].bw = DynamicCast<QbbNetDevice>(d.Get(0))->GetDataRate().GetBitRate();
-        nbr2if[dnode][snode].idx = DynamicCast<QbbNetDevice>(d.Get(1))->GetIfIndex();
-        nbr2if[dnode][snode].up = true;
-        nbr2if[dnode][snode].delay =
-            DynamicCast<QbbChannel>(DynamicCast<QbbNetDevice>(d.Get(1))->GetChannel())
-                ->GetDelay()
-                .GetTimeStep();
-        nbr2if[dnode][snode].bw = DynamicCast<QbbNetDevice>(d.Get(1))->GetDataRate().GetBitRate();
+        Ptr<QbbNetDevice> sdev = DynamicCast<QbbNetDevice>(d.Get(0));
+        Ptr<QbbNetDevice> ddev = DynamicCast<QbbNetDevice>(d.Get(1));
+        uint64_t delay = DynamicCast<QbbChannel>(sdev->GetChannel())->GetDelay().GetTimeStep();
+        routes.AddInterface(src, dst, sdev->GetIfIndex(), delay, sdev->GetDataRate().GetBitRate());
+        routes.AddInterface(dst, src, ddev->GetIfIndex(), delay, ddev->GetDataRate().GetBitRate());
 
         // This is just to set up the connectivity between nodes. The IP addresses are useless
         char ipstring[16];
@@ -1294,36 +1275,47 @@ main(int argc, char* argv[])
     //
     // install RDMA driver
     //
+    // parameters of the CC algorithms, each RdmaHw creates the one of cc_mode
+    Config::SetDefault("ns3::RdmaDcqcn::ClampTargetRate", BooleanValue(clamp_target_rate));
+    Config::SetDefault("ns3::RdmaDcqcn::AlphaResumInterval", DoubleValue(alpha_resume_interval));
+    Config::SetDefault("ns3::RdmaDcqcn::RPTimer", DoubleValue(rp_timer));
+    Config::SetDefault("ns3::RdmaDcqcn::FastRecoveryTimes", UintegerValue(fast_recovery_times));
+    Config::SetDefault("ns3::RdmaDcqcn::EwmaGain", DoubleValue(ewma_gain));
+    Config::SetDefault("ns3::RdmaDcqcn::RateAI", DataRateValue(DataRate(rate_ai)));
+    Config::SetDefault("ns3::RdmaDcqcn::RateHAI", DataRateValue(DataRate(rate_hai)));
+    Config::SetDefault("ns3::RdmaDcqcn::RateDecreaseInterval", DoubleValue(rate_decrease_interval));
+    Config::SetDefault("ns3::RdmaHpcc::RateAI", DataRateValue(DataRate(rate_ai)));
+    Config::SetDefault("ns3::RdmaHpcc::MiThresh", UintegerValue(mi_thresh));
+    Config::SetDefault("ns3::RdmaHpcc::FastReact", BooleanValue(fast_react));
+    Config::SetDefault("ns3::RdmaHpcc::MultiRate", BooleanValue(multi_rate));
+    Config::SetDefault("ns3::RdmaHpcc::SampleFeedback", BooleanValue(sample_feedback));
+    Config::SetDefault("ns3::RdmaHpcc::TargetUtil", DoubleValue(u_target));
+    Config::SetDefault("ns3::RdmaTimely::RateAI", DataRateValue(DataRate(rate_ai)));
+    Config::SetDefault("ns3::RdmaTimely::RateHAI", DataRateValue(DataRate(rate_hai)));
+    Config::SetDefault("ns3::RdmaDctcp::EwmaGain", DoubleValue(ewma_gain));
+    Config::SetDefault("ns3::RdmaDctcp::RateAI", DataRateValue(DataRate(dctcp_rate_ai)));
+    Config::SetDefault("ns3::RdmaHpccPint::RateAI", DataRateValue(DataRate(rate_ai)));
+    Config::SetDefault("ns3::RdmaHpccPint::MiThresh", UintegerValue(mi_thresh));
+    Config::SetDefault("ns3::RdmaHpccPint::TargetUtil", DoubleValue(u_target));
+    Config::SetDefault("ns3::RdmaHpccPint::PintSmplThresh",
+                       UintegerValue((uint32_t)(65536 * pint_prob)));
     for (uint32_t i = 0; i < node_num; i++)
     {
         if (n.Get(i)->GetNodeType() == 0)
         { // is server
             // create RdmaHw
             Ptr<RdmaHw> rdmaHw = CreateObject<RdmaHw>();
-            rdmaHw->SetAttribute("ClampTargetRate", BooleanValue(clamp_target_rate));
             rdmaHw->SetAttribute("CodingTransport", BooleanValue(use_coding_transport));
-            rdmaHw->SetAttribute("AlphaResumInterval", DoubleValue(alpha_resume_interval));
-            rdmaHw->SetAttribute("RPTimer", DoubleValue(rp_timer));
-            rdmaHw->SetAttribute("FastRecoveryTimes", UintegerValue(fast_recovery_times));
-            rdmaHw->SetAttribute("EwmaGain", DoubleValue(ewma_gain));
-            rdmaHw->SetAttribute("RateAI", DataRateValue(DataRate(rate_ai)));
-            rdmaHw->SetAttribute("RateHAI", DataRateValue(DataRate(rate_hai)));
+            rdmaHw->SetAttribute("CodingCc", BooleanValue(coding_cc));
             rdmaHw->SetAttribute("L2BackToZero", BooleanValue(l2_back_to_zero));
             rdmaHw->SetAttribute("L2ChunkSize", UintegerValue(l2_chunk_size));
             rdmaHw->SetAttribute("L2AckInterval", UintegerValue(l2_ack_interval));
             rdmaHw->SetAttribute("CcMode", UintegerValue(cc_mode));
-            rdmaHw->SetAttribute("RateDecreaseInterval", DoubleValue(rate_decrease_interval));
             rdmaHw->SetAttribute("MinRate", DataRateValue(DataRate(min_rate)));
             rdmaHw->SetAttribute("Mtu", UintegerValue(packet_payload_size));
-            rdmaHw->SetAttribute("MiThresh", UintegerValue(mi_thresh));
             rdmaHw->SetAttribute("VarWin", BooleanValue(var_win));
-            rdmaHw->SetAttribute("FastReact", BooleanValue(fast_react));
-            rdmaHw->SetAttribute("MultiRate", BooleanValue(multi_rate));
-            rdmaHw->SetAttribute("SampleFeedback", BooleanValue(sample_feedback));
-            rdmaHw->SetAttribute("TargetUtil", DoubleValue(u_target));
             rdmaHw->SetAttribute("RateBound", BooleanValue(rate_bound));
-            rdmaHw->SetAttribute("DctcpRateAI", DataRateValue(DataRate(dctcp_rate_ai)));
-            rdmaHw->SetPintSmplThresh(pint_prob);
+            rdmaHw->SetAttribute("RxQpIdleTimeout", TimeValue(NanoSeconds(rx_qp_idle_timeout)));
             // create and install RdmaDriver
             Ptr<RdmaDriver> rdma = CreateObject<RdmaDriver>();
             Ptr<Node> node = n.Get(i);
@@ -1349,8 +1341,7 @@ main(int argc, char* argv[])
     }
 
     // setup routing
-    CalculateRoutes(n);
-    SetRoutingEntries();
+    routes.InstallRoutes();
 
     //
     // get BDP and delay
@@ -1369,14 +1360,8 @@ main(int argc, char* argv[])
             {
                 continue;
             }
-            uint64_t delay = pairDelay[n.Get(i)][n.Get(j)];
-            uint64_t txDelay = pairTxDelay[n.Get(i)][n.Get(j)];
-            // uint64_t rtt = delay * 2 + txDelay;
-            uint64_t rtt = delay * 2;
-            uint64_t bw = pairBw[i][j];
-            uint64_t bdp = rtt * bw / 1000000000 / 8;
-            pairBdp[n.Get(i)][n.Get(j)] = bdp;
-            pairRtt[i][j] = rtt;
+            uint64_t rtt = PairRtt(i, j);
+            uint64_t bdp = PairBdp(i, j);
             if (bdp > maxBdp)
             {
                 maxBdp = bdp;
@@ -1401,6 +1386,20 @@ main(int argc, char* argv[])
             sw->SetAttribute("MaxRtt", UintegerValue(maxRtt));
             sw->SetAttribute("CNCPGamma", UintegerValue(cncp_gamma));
             sw->SetAttribute("CNCPLambda", UintegerValue(cncp_lambda));
+            sw->SetAttribute("CNCPBatchedTimers", BooleanValue(cncp_batched_timers));
+            sw->SetAttribute("CNCPReportBatchSize", UintegerValue(cncp_report_batch));
+            sw->SetAttribute("CNCPReportInterval", UintegerValue(cncp_report_interval));
+            sw->SetAttribute("CNCPUpdateInterval", UintegerValue(cncp_update_interval));
+            sw->SetAttribute("CNCPFlowExpiredInterval", UintegerValue(cncp_flow_expired_interval));
+            sw->SetAttribute("CNCPQueueWeight", DoubleValue(cncp_queue_weight));
+            sw->SetAttribute("CNCPUtility", StringValue(cncp_utility));
+            sw->SetAttribute("CNCPAlpha", DoubleValue(cncp_alpha));
+            sw->SetAttribute("CNCPUtilityRefRate", UintegerValue(cncp_utility_ref_rate));
+            sw->SetAttribute("CNCPFixedPoint", BooleanValue(cncp_fixed_point));
+            for (auto& pw : cncp_pg_weights)
+            {
+                sw->SetCNCPPriorityWeight(pw.first, pw.second);
+            }
         }
     }
 
@@ -1419,23 +1418,31 @@ main(int argc, char* argv[])
         trace_nodes = NodeContainer(trace_nodes, n.Get(nid));
     }
     FILE* trace_output = fopen(trace_output_file.c_str(), "w");
+    Ptr<PacketTraceWriter> trace_writer = Create<PacketTraceWriter>(trace_output);
+    trace_writer->SetDefaultFilter(trace_events, trace_sample);
+    trace_writer->SetFlowSampling(trace_flow_sample);
+    for (auto& w : trace_windows)
+    {
+        trace_writer->AddWindow(Seconds(w.first), Seconds(w.second));
+    }
+    trace_writer->SetTriggers(trace_trigger_pfc,
+                              trace_trigger_drop,
+                              trace_trigger_qlen,
+                              MicroSeconds(trace_trigger_before),
+                              MicroSeconds(trace_trigger_after));
     if (enable_trace)
     {
-        qbb.EnableTracing(trace_output, trace_nodes);
+        qbb.EnableTracing(trace_writer, trace_nodes);
     }
     // dump link speed to trace file
     {
         SimSetting sim_setting;
-        for (auto i : nbr2if)
+        for (uint32_t i = 0; i < node_num; i++)
         {
-            for (auto j : i.second)
+            auto adj = routes.GetAdjacency(i);
+            for (auto a = adj.first; a != adj.second; a++)
             {
-                uint16_t node = i.first->GetId();
-                uint8_t intf = j.second.idx;
-                uint64_t bps = DynamicCast<QbbNetDevice>(i.first->GetDevice(j.second.idx))
-                                   ->GetDataRate()
-                                   .GetBitRate();
-                sim_setting.port_speed[node][intf] = bps;
+                sim_setting.port_speed[i][a->ifIndex] = a->bw;
             }
         }
         sim_setting.win = maxBdp;
@@ -1465,11 +1472,34 @@ main(int argc, char* argv[])
         }
     }
 
-    flow_input.idx = 0;
-    if (flow_num > 0)
+    if (!workload_cdf.empty())
     {
-        ReadFlowInput();
-        Simulator::Schedule(Seconds(flow_input.start_time) - Simulator::Now(), ScheduleFlowInputs);
+        workload = CreateObject<RdmaWorkloadGenerator>();
+        workload->SetAttribute("Load", DoubleValue(workload_load));
+        workload->SetAttribute("HostRate", DataRateValue(DataRate(nic_rate)));
+        workload->SetAttribute("Pattern", StringValue(workload_pattern));
+        workload->SetAttribute("IncastFanIn", UintegerValue(workload_fanin));
+        workload->SetAttribute("StartTime", TimeValue(Seconds(workload_start)));
+        workload->SetAttribute("StopTime", TimeValue(Seconds(workload_stop)));
+        if (!workload->LoadCdf(workload_cdf))
+        {
+            NS_FATAL_ERROR("cannot load the flow size CDF " << workload_cdf);
+        }
+        std::vector<uint32_t> hosts;
+        for (uint32_t i = 0; i < node_num; i++)
+        {
+            if (n.Get(i)->GetNodeType() == 0)
+            {
+                hosts.push_back(i);
+            }
+        }
+        workload->SetHosts(hosts);
+    }
+    ReadFlowInput();
+    if (flow_pending)
+    {
+        Simulator::Schedule(Max(flow_input.start - Seconds(flow_lookahead), Seconds(0)),
+                            ScheduleFlowInputs);
     }
 
     topof.close();
@@ -1485,9 +1515,28 @@ main(int argc, char* argv[])
                             n.Get(link_down_B));
     }
 
-    // schedule buffer monitor
-    FILE* qlen_output = fopen(qlen_mon_file.c_str(), "w");
-    Simulator::Schedule(NanoSeconds(qlen_mon_start), &monitor_buffer, qlen_output, &n);
+    // monitor the egress queues of the switches
+    QueueMonitor::Format qlen_format = QueueMonitor::Text;
+    if (qlen_mon_format == "csv")
+    {
+        qlen_format = QueueMonitor::Csv;
+    }
+    else if (qlen_mon_format == "binary")
+    {
+        qlen_format = QueueMonitor::Binary;
+    }
+    FILE* qlen_output = fopen(qlen_mon_file.c_str(), "wb");
+    Ptr<QueueMonitor> qlen_monitor = Create<QueueMonitor>(qlen_output, qlen_format);
+    qlen_monitor->SetWindow(NanoSeconds(qlen_mon_start), NanoSeconds(qlen_mon_end));
+    qlen_monitor->SetTextInterval(NanoSeconds(qlen_mon_interval));
+    for (uint32_t i = 0; i < node_num; i++)
+    {
+        if (n.Get(i)->GetNodeType() == 1)
+        {
+            qlen_monitor->MonitorSwitch(DynamicCast<SwitchNode>(n.Get(i)));
+        }
+    }
+    qlen_monitor->ScheduleDumps(NanoSeconds(qlen_dump_interval));
 
     //
     // Now, do the actual simulation.
@@ -1497,9 +1546,43 @@ main(int argc, char* argv[])
     NS_LOG_INFO("Run Simulation.");
     Simulator::Stop(Seconds(simulator_stop_time));
     Simulator::Run();
+    // rx qps left on the receivers, by late retransmissions or flows still running
+    uint32_t rxQps = 0, maxRxQps = 0;
+    uint64_t rxQpsCreated = 0, rxQpsExpired = 0;
+    for (uint32_t i = 0; i < node_num; i++)
+    {
+        if (n.Get(i)->GetNodeType() == 0)
+        {
+            Ptr<RdmaHw> rdmaHw = n.Get(i)->GetObject<RdmaDriver>()->m_rdma;
+            rxQps += rdmaHw->GetRxQpCount();
+            maxRxQps = std::max(maxRxQps, rdmaHw->GetRxQpCount());
+            rxQpsCreated += rdmaHw->m_rxQpCreated;
+            rxQpsExpired += rdmaHw->m_rxQpExpired;
+        }
+    }
+    std::cout << "Rx QPs created: " << rxQpsCreated << ", alive: " << rxQps << " (at most "
+              << maxRxQps << " on a host), deleted idle: " << rxQpsExpired << "\n";
+    if (cc_mode == 11)
+    {
+        uint64_t cncpEvents = 0;
+        for (uint32_t i = 0; i < node_num; i++)
+        {
+            if (n.Get(i)->GetNodeType() == 1)
+            {
+                cncpEvents += DynamicCast<SwitchNode>(n.Get(i))->GetCncpScheduledEvents();
+            }
+        }
+        std::cout << "CNCP timer events scheduled: " << cncpEvents << "\n";
+    }
     Simulator::Destroy();
     NS_LOG_INFO("Done.");
+    trace_writer->Flush();
     fclose(trace_output);
+    fclose(qlen_output);
+    if (enable_trace && (trace_trigger_pfc || trace_trigger_drop || trace_trigger_qlen))
+    {
+        std::cout << "Trace triggers: " << trace_writer->GetNTriggers() << "\n";
+    }
 
     endt = clock();
     std::cout << "Time taken: " << (double)(endt - begint) / CLOCKS_PER_SEC << " seconds\n";
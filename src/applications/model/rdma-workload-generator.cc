@@ -0,0 +1,219 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "rdma-workload-generator.h"
+
+#include "ns3/double.h"
+#include "ns3/enum.h"
+#include "ns3/log.h"
+#include "ns3/uinteger.h"
+
+#include <fstream>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("RdmaWorkloadGenerator");
+NS_OBJECT_ENSURE_REGISTERED(RdmaWorkloadGenerator);
+
+TypeId
+RdmaWorkloadGenerator::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::RdmaWorkloadGenerator")
+            .SetParent<Object>()
+            .AddConstructor<RdmaWorkloadGenerator>()
+            .AddAttribute("Load",
+                          "Average load of each host link, as a fraction of HostRate",
+                          DoubleValue(0.3),
+                          MakeDoubleAccessor(&RdmaWorkloadGenerator::m_load),
+                          MakeDoubleChecker<double>(0.0))
+            .AddAttribute("HostRate",
+                          "Rate of the host links",
+                          DataRateValue(DataRate("100Gb/s")),
+                          MakeDataRateAccessor(&RdmaWorkloadGenerator::m_hostRate),
+                          MakeDataRateChecker())
+            .AddAttribute("Pattern",
+                          "How the hosts of a flow are chosen",
+                          EnumValue(ALL_TO_ALL),
+                          MakeEnumAccessor<Pattern>(&RdmaWorkloadGenerator::m_pattern),
+                          MakeEnumChecker(ALL_TO_ALL, "AllToAll", INCAST, "Incast"))
+            .AddAttribute("IncastFanIn",
+                          "Number of senders of an incast",
+                          UintegerValue(16),
+                          MakeUintegerAccessor(&RdmaWorkloadGenerator::m_fanIn),
+                          MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("StartTime",
+                          "Time of the first arrival is exponentially distributed after this",
+                          TimeValue(Seconds(2)),
+                          MakeTimeAccessor(&RdmaWorkloadGenerator::m_startTime),
+                          MakeTimeChecker())
+            .AddAttribute("StopTime",
+                          "No flow starts after this",
+                          TimeValue(Seconds(3)),
+                          MakeTimeAccessor(&RdmaWorkloadGenerator::m_stopTime),
+                          MakeTimeChecker())
+            .AddAttribute("PriorityGroup",
+                          "The priority group of the flows",
+                          UintegerValue(3),
+                          MakeUintegerAccessor(&RdmaWorkloadGenerator::m_pg),
+                          MakeUintegerChecker<uint16_t>())
+            .AddAttribute("DestPort",
+                          "The destination port of the flows",
+                          UintegerValue(100),
+                          MakeUintegerAccessor(&RdmaWorkloadGenerator::m_dport),
+                          MakeUintegerChecker<uint16_t>());
+    return tid;
+}
+
+RdmaWorkloadGenerator::RdmaWorkloadGenerator()
+    : m_meanSize(0),
+      m_now(-1)
+{
+    NS_LOG_FUNCTION(this);
+    m_size = CreateObject<EmpiricalRandomVariable>();
+    m_size->SetInterpolate(true);
+    m_interArrival = CreateObject<ExponentialRandomVariable>();
+    m_host = CreateObject<UniformRandomVariable>();
+}
+
+RdmaWorkloadGenerator::~RdmaWorkloadGenerator()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+void
+RdmaWorkloadGenerator::DoDispose()
+{
+    m_size = nullptr;
+    m_interArrival = nullptr;
+    m_host = nullptr;
+    Object::DoDispose();
+}
+
+bool
+RdmaWorkloadGenerator::LoadCdf(const std::string& path)
+{
+    NS_LOG_FUNCTION(this << path);
+    NS_ASSERT_MSG(m_meanSize == 0, "the CDF can only be loaded once");
+    std::ifstream f(path);
+    std::vector<std::pair<double, double>> cdf; // (size, cdf)
+    double v;
+    double c;
+    while (f >> v >> c)
+    {
+        if (v < 0 || (!cdf.empty() && (v < cdf.back().first || c < cdf.back().second)))
+        {
+            NS_LOG_ERROR("not a CDF at size " << v);
+            return false;
+        }
+        cdf.emplace_back(v, c);
+    }
+    if (cdf.empty() || cdf.back().second <= 0)
+    {
+        NS_LOG_ERROR("no CDF in " << path);
+        return false;
+    }
+    // interpolated like EmpiricalRandomVariable samples it: the mass up to
+    // the first point is at its size, then uniform between points
+    double last = cdf.back().second;
+    m_meanSize = cdf[0].first * cdf[0].second / last;
+    m_size->CDF(cdf[0].first, cdf[0].second / last);
+    for (size_t i = 1; i < cdf.size(); i++)
+    {
+        m_meanSize += (cdf[i].first + cdf[i - 1].first) / 2 *
+                      (cdf[i].second - cdf[i - 1].second) / last;
+        m_size->CDF(cdf[i].first, cdf[i].second / last);
+    }
+    return m_meanSize > 0;
+}
+
+void
+RdmaWorkloadGenerator::SetHosts(const std::vector<uint32_t>& hosts)
+{
+    NS_ASSERT(hosts.size() >= 2);
+    m_hosts = hosts;
+}
+
+double
+RdmaWorkloadGenerator::GetMeanFlowSize() const
+{
+    return m_meanSize;
+}
+
+uint32_t
+RdmaWorkloadGenerator::PickHost()
+{
+    return m_host->GetInteger(0, m_hosts.size() - 1);
+}
+
+bool
+RdmaWorkloadGenerator::Next(FlowTraceRecord& r)
+{
+    if (!m_burst.empty())
+    {
+        r = m_burst.front();
+        m_burst.pop_front();
+        return true;
+    }
+    if (m_now.IsNegative())
+    {
+        NS_ASSERT_MSG(m_meanSize > 0 && !m_hosts.empty(), "LoadCdf and SetHosts first");
+        NS_ASSERT_MSG(m_pattern != INCAST || m_fanIn < m_hosts.size(),
+                      "more incast senders than hosts");
+        // every host sends, and in the incast pattern receives, Load of its link on average
+        double flowsPerSecond =
+            m_load * m_hostRate.GetBitRate() / 8 * m_hosts.size() / m_meanSize;
+        double arrivalsPerSecond = m_pattern == INCAST ? flowsPerSecond / m_fanIn : flowsPerSecond;
+        m_interArrival->SetAttribute("Mean", DoubleValue(1 / arrivalsPerSecond));
+        m_now = m_startTime;
+    }
+    m_now += Seconds(m_interArrival->GetValue());
+    if (m_now > m_stopTime)
+    {
+        return false;
+    }
+    r.pg = m_pg;
+    r.dport = m_dport;
+    r.start = m_now;
+    uint32_t n = m_hosts.size();
+    if (m_pattern == ALL_TO_ALL)
+    {
+        uint32_t src = PickHost();
+        r.src = m_hosts[src];
+        r.dst = m_hosts[(src + 1 + m_host->GetInteger(0, n - 2)) % n];
+        r.size = std::max<uint64_t>(m_size->GetValue() + 0.5, 1);
+        return true;
+    }
+    // pick the senders among the other hosts by a partial Fisher-Yates shuffle
+    uint32_t dst = PickHost();
+    m_picked.resize(n - 1);
+    for (uint32_t i = 0; i < n - 1; i++)
+    {
+        m_picked[i] = i < dst ? i : i + 1;
+    }
+    for (uint32_t i = 0; i < m_fanIn; i++)
+    {
+        std::swap(m_picked[i], m_picked[m_host->GetInteger(i, n - 2)]);
+        FlowTraceRecord f = r;
+        f.src = m_hosts[m_picked[i]];
+        f.dst = m_hosts[dst];
+        f.size = std::max<uint64_t>(m_size->GetValue() + 0.5, 1);
+        m_burst.push_back(f);
+    }
+    r = m_burst.front();
+    m_burst.pop_front();
+    return true;
+}
+
+int64_t
+RdmaWorkloadGenerator::AssignStreams(int64_t stream)
+{
+    m_size->SetStream(stream);
+    m_interArrival->SetStream(stream + 1);
+    m_host->SetStream(stream + 2);
+    return 3;
+}
+
+} // namespace ns3
@@ -0,0 +1,103 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef RDMA_WORKLOAD_GENERATOR_H
+#define RDMA_WORKLOAD_GENERATOR_H
+
+#include "ns3/data-rate.h"
+#include "ns3/flow-trace.h"
+#include "ns3/nstime.h"
+#include "ns3/object.h"
+#include "ns3/random-variable-stream.h"
+
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \ingroup rdmaclientserver
+ * \brief Synthetic RDMA flows drawn from an empirical flow-size distribution
+ *
+ * Flows arrive as a Poisson process whose rate loads every host link to
+ * Load of HostRate on average, with sizes drawn from a CDF file. The CDF
+ * file has one "size cdf" line per point, sizes in bytes and cdf values
+ * increasing to 100 (or 1), as the WebSearch, Hadoop, Cache and RPC
+ * distributions are usually published. The flows are pulled in start time
+ * order with Next(), like the flows of a FlowTraceReader, so a simulation
+ * hands them to the RdmaDrivers without a trace file.
+ *
+ * In the ALL_TO_ALL pattern each flow goes between two random hosts. In
+ * the INCAST pattern each arrival is IncastFanIn flows started at once from
+ * distinct random hosts to one random receiver.
+ */
+class RdmaWorkloadGenerator : public Object
+{
+  public:
+    enum Pattern
+    {
+        ALL_TO_ALL,
+        INCAST,
+    };
+
+    static TypeId GetTypeId();
+
+    RdmaWorkloadGenerator();
+    ~RdmaWorkloadGenerator() override;
+
+    /**
+     * \param path the CDF file
+     * \return false if it cannot be read or is not a CDF
+     */
+    bool LoadCdf(const std::string& path);
+    /**
+     * \param hosts the node ids the flows are spread over, at least two
+     */
+    void SetHosts(const std::vector<uint32_t>& hosts);
+    /**
+     * \return the mean flow size of the loaded CDF, in bytes
+     */
+    double GetMeanFlowSize() const;
+    /**
+     * \param r filled with the next flow, by start time
+     * \return false once the next flow would start after StopTime
+     */
+    bool Next(FlowTraceRecord& r);
+
+    /**
+     * \param stream first stream index to use
+     * \return the number of stream indices used
+     */
+    int64_t AssignStreams(int64_t stream);
+
+  protected:
+    void DoDispose() override;
+
+  private:
+    uint32_t PickHost(); //!< a random host index
+
+    double m_load;
+    DataRate m_hostRate;
+    Pattern m_pattern;
+    uint32_t m_fanIn;
+    Time m_startTime;
+    Time m_stopTime;
+    uint16_t m_pg;
+    uint16_t m_dport;
+
+    Ptr<EmpiricalRandomVariable> m_size;
+    Ptr<ExponentialRandomVariable> m_interArrival;
+    Ptr<UniformRandomVariable> m_host;
+    double m_meanSize;
+    std::vector<uint32_t> m_hosts;
+    Time m_now;                           //!< arrival time of the last arrival
+    std::deque<FlowTraceRecord> m_burst;  //!< flows of the last incast arrival not handed out yet
+    std::vector<uint32_t> m_picked;       //!< scratch for drawing distinct senders
+};
+
+} // namespace ns3
+
+#endif /* RDMA_WORKLOAD_GENERATOR_H */
@@ -391,7 +391,7 @@ Node::GetNodeType()
 }
 
 void
-Node::SwitchNotifyDequeue(uint32_t ifIndex, uint32_t qIndex, Ptr<Packet> p)
+Node::SwitchNotifyDequeue(uint32_t ifIndex, uint32_t qIndex, Ptr<Packet> p, CustomHeader& ch)
 {
     NS_ASSERT_MSG(
         false,
@@ -223,7 +223,10 @@ class Node : public Object
      */
   public:
     uint32_t GetNodeType();
-    virtual void SwitchNotifyDequeue(uint32_t ifIndex, uint32_t qIndex, Ptr<Packet> p);
+    virtual void SwitchNotifyDequeue(uint32_t ifIndex,
+                                     uint32_t qIndex,
+                                     Ptr<Packet> p,
+                                     CustomHeader& ch);
     virtual bool SwitchReceiveFromDevice(Ptr<NetDevice> device,
                                          Ptr<Packet> packet,
                                          CustomHeader& ch);
@@ -83,10 +83,18 @@ BEgressQueue::~BEgressQueue()
 
 bool
 BEgressQueue::Enqueue(Ptr<Packet> p, uint32_t qIndex)
+{
+    CustomHeader ch(CustomHeader::L2_Header | CustomHeader::L3_Header | CustomHeader::L4_Header);
+    p->PeekHeader(ch);
+    return Enqueue(p, qIndex, ch);
+}
+
+bool
+BEgressQueue::Enqueue(Ptr<Packet> p, uint32_t qIndex, const CustomHeader& ch)
 {
     NS_LOG_FUNCTION(this << p);
 
-    bool retval = DoEnqueue(p, qIndex);
+    bool retval = DoEnqueue(p, qIndex, ch);
     if (retval)
     {
         // m_traceEnqueue(p);
@@ -138,13 +146,21 @@ BEgressQueue::DequeuePF(bool paused[])
 // -------------------------------------------------------------------------
 
 bool
-BEgressQueue::DoEnqueue(Ptr<Packet> p, uint32_t qIndex)
+BEgressQueue::DoEnqueue(Ptr<Packet> p, uint32_t qIndex, const CustomHeader& ch)
 {
     NS_LOG_FUNCTION(this << p << qIndex);
 
     if (m_bytesInQueueTotal + p->GetSize() < m_maxBytes)
     {
-        m_queues[qIndex]->Enqueue(p);
+        // the per-priority queue may still drop the packet, only keep the header of a queued one
+        if (m_queues[qIndex]->Enqueue(p))
+        {
+            if (qIndex >= m_headers.size())
+            {
+                m_headers.resize(qIndex + 1);
+            }
+            m_headers[qIndex].push_back(ch);
+        }
         m_bytesInQueueTotal += p->GetSize();
         m_bytesInQueue[qIndex] += p->GetSize();
         return true;
@@ -189,6 +205,8 @@ BEgressQueue::DoDequeueRR(bool paused[])
     if (found)
     {
         Ptr<Packet> p = m_queues[qIndex]->Dequeue();
+        m_lastHeader = m_headers[qIndex].front();
+        m_headers[qIndex].pop_front();
         m_traceBeqDequeue(p, qIndex);
         m_bytesInQueueTotal -= p->GetSize();
         m_bytesInQueue[qIndex] -= p->GetSize();
@@ -242,6 +260,8 @@ BEgressQueue::DoDequeuePF(bool paused[])
     if (found)
     {
         Ptr<Packet> p = m_queues[qIndex]->Dequeue();
+        m_lastHeader = m_headers[qIndex].front();
+        m_headers[qIndex].pop_front();
         m_traceBeqDequeue(p, qIndex);
         m_bytesInQueueTotal -= p->GetSize();
         m_bytesInQueue[qIndex] -= p->GetSize();
@@ -318,4 +338,10 @@ BEgressQueue::GetLastQueue()
     return m_qlast;
 }
 
+CustomHeader&
+BEgressQueue::GetLastHeader()
+{
+    return m_lastHeader;
+}
+
 } // namespace ns3
\ No newline at end of file
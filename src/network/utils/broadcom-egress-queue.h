@@ -19,7 +19,9 @@
 #ifndef BROADCOM_EGRESS_H
 #define BROADCOM_EGRESS_H
 
+#include <deque>
 #include <vector>
+#include "ns3/custom-header.h"
 #include "ns3/packet.h"
 #include "ns3/queue.h"
 #include "ns3/drop-tail-queue.h"
@@ -51,9 +53,12 @@ public:
   BEgressQueue ();
   virtual ~BEgressQueue ();
 
-  /** Enqueue packet into a specific queue */
+  /** Enqueue packet into a specific queue, parsing its L2/L3/L4 header */
   bool Enqueue (Ptr<Packet> p, uint32_t qIndex);
 
+  /** Enqueue packet into a specific queue along with its already parsed header */
+  bool Enqueue (Ptr<Packet> p, uint32_t qIndex, const CustomHeader &ch);
+
   /** Dequeue one packet using RR scheduling */
   Ptr<Packet> DequeueRR (bool paused[]);
 
@@ -69,6 +74,12 @@ public:
   /** Get last dequeued queue index */
   uint32_t GetLastQueue ();
 
+  /**
+   * Get the header enqueued with the last dequeued packet. It may be
+   * updated in place to follow in-place changes to the packet bytes.
+   */
+  CustomHeader &GetLastHeader ();
+
   /** Trace callback for enqueue to BEgressQueue (packet, queueIndex) */
   TracedCallback<Ptr<const Packet>, uint32_t> m_traceBeqEnqueue;
 
@@ -77,7 +88,7 @@ public:
 
 private:
   /** Internal enqueue used by public Enqueue */
-  bool DoEnqueue (Ptr<Packet> p, uint32_t qIndex);
+  bool DoEnqueue (Ptr<Packet> p, uint32_t qIndex, const CustomHeader &ch);
 
   /** Internal Round-Robin dequeue */
   Ptr<Packet> DoDequeueRR (bool paused[]);
@@ -108,6 +119,8 @@ private:
   uint32_t m_qlast;   //!< Last dequeued queue index
 
   std::vector<Ptr<Queue<Packet>>> m_queues; //!< The actual queues
+  std::vector<std::deque<CustomHeader>> m_headers; //!< Parsed headers of the queued packets, grown on demand
+  CustomHeader m_lastHeader; //!< Header of the last dequeued packet
 };
 
 } // namespace ns3
@@ -71,13 +71,13 @@ uint32_t IntHeader::Deserialize (Buffer::Iterator start){
 	return GetStaticSize();
 }
 
-uint64_t IntHeader::GetTs(void){
+uint64_t IntHeader::GetTs(void) const{
 	if (mode == TS)
 		return ts;
 	return 0;
 }
 
-uint16_t IntHeader::GetPower(void){
+uint16_t IntHeader::GetPower(void) const{
 	if (mode == PINT)
 		return pint_bytes == 1 ? pint.power_lo8 : pint.power;
 	return 0;
@@ -107,8 +107,8 @@ public:
 	void PushHop(uint64_t time, uint64_t bytes, uint32_t qlen, uint64_t rate);
 	void Serialize (Buffer::Iterator start) const;
 	uint32_t Deserialize (Buffer::Iterator start);
-	uint64_t GetTs(void);
-	uint16_t GetPower(void);
+	uint64_t GetTs(void) const;
+	uint16_t GetPower(void) const;
 	void SetPower(uint16_t);
 };
 
@@ -0,0 +1,306 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+#include "flow-trace.h"
+
+#include "ns3/log.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("FlowTrace");
+
+const char FlowTraceReader::magic[8] = {'N', 'S', '3', 'F', 'L', 'O', 'W', '1'};
+
+static const size_t chunkSize = 1 << 20;
+static const size_t maxToken = 64; // longer than any number of the text format
+
+static uint64_t
+GetLe(const uint8_t* b, uint32_t n)
+{
+    uint64_t v = 0;
+    for (uint32_t i = n; i > 0; i--)
+    {
+        v = (v << 8) | b[i - 1];
+    }
+    return v;
+}
+
+static void
+PutLe(uint8_t* b, uint64_t v, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++, v >>= 8)
+    {
+        b[i] = v & 0xff;
+    }
+}
+
+FlowTraceReader::FlowTraceReader()
+    : m_file(nullptr),
+      m_pos(0),
+      m_end(0),
+      m_binary(false),
+      m_n(0),
+      m_read(0)
+{
+}
+
+FlowTraceReader::~FlowTraceReader()
+{
+    Close();
+}
+
+bool
+FlowTraceReader::Open(const std::string& path)
+{
+    Close();
+    m_file = fopen(path.c_str(), "rb");
+    if (m_file == nullptr)
+    {
+        return false;
+    }
+    m_buf.resize(chunkSize + 1); // room for a terminating '\0' after the valid bytes
+    m_pos = m_end = 0;
+    m_buf[0] = '\0';
+    m_read = 0;
+    Fill(sizeof(magic) + 8);
+    m_binary = m_end - m_pos >= sizeof(magic) + 8 && memcmp(&m_buf[m_pos], magic, sizeof(magic)) == 0;
+    if (m_binary)
+    {
+        m_n = GetLe((const uint8_t*)&m_buf[m_pos + sizeof(magic)], 8);
+        m_pos += sizeof(magic) + 8;
+        return true;
+    }
+    return ParseUint(m_n);
+}
+
+void
+FlowTraceReader::Close()
+{
+    if (m_file != nullptr)
+    {
+        fclose(m_file);
+        m_file = nullptr;
+    }
+    m_buf.clear();
+    m_buf.shrink_to_fit();
+    m_pos = m_end = 0;
+}
+
+bool
+FlowTraceReader::IsBinary() const
+{
+    return m_binary;
+}
+
+uint64_t
+FlowTraceReader::GetNFlows() const
+{
+    return m_n;
+}
+
+bool
+FlowTraceReader::Read(FlowTraceRecord& r)
+{
+    if (m_file == nullptr || m_read >= m_n)
+    {
+        return false;
+    }
+    if (m_binary)
+    {
+        if (!Fill(recordSize))
+        {
+            return false;
+        }
+        const uint8_t* b = (const uint8_t*)&m_buf[m_pos];
+        r.src = GetLe(b, 4);
+        r.dst = GetLe(b + 4, 4);
+        r.pg = GetLe(b + 8, 2);
+        r.dport = GetLe(b + 10, 2);
+        r.size = GetLe(b + 12, 8);
+        r.start = NanoSeconds((int64_t)GetLe(b + 20, 8));
+        m_pos += recordSize;
+    }
+    else if (!ReadText(r))
+    {
+        return false;
+    }
+    m_read++;
+    return true;
+}
+
+bool
+FlowTraceReader::Fill(size_t need)
+{
+    if (m_end - m_pos >= need)
+    {
+        return true;
+    }
+    // keep the unread tail, then top the buffer up
+    memmove(&m_buf[0], &m_buf[m_pos], m_end - m_pos);
+    m_end -= m_pos;
+    m_pos = 0;
+    m_end += fread(&m_buf[m_end], 1, chunkSize - m_end, m_file);
+    m_buf[m_end] = '\0'; // the number parsers stop here
+    return m_end - m_pos >= need;
+}
+
+bool
+FlowTraceReader::SkipSpace()
+{
+    while (true)
+    {
+        if (m_pos == m_end && !Fill(1))
+        {
+            return false;
+        }
+        char c = m_buf[m_pos];
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r')
+        {
+            return true;
+        }
+        m_pos++;
+    }
+}
+
+bool
+FlowTraceReader::ParseUint(uint64_t& v)
+{
+    if (!SkipSpace())
+    {
+        return false;
+    }
+    Fill(maxToken);
+    const char* b = &m_buf[m_pos];
+    const char* c = b;
+    v = 0;
+    while (*c >= '0' && *c <= '9')
+    {
+        v = v * 10 + (*c++ - '0');
+    }
+    if (c == b)
+    {
+        return false;
+    }
+    m_pos += c - b;
+    return true;
+}
+
+bool
+FlowTraceReader::ParseDouble(double& v)
+{
+    static const double pow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                   1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                   1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    if (!SkipSpace())
+    {
+        return false;
+    }
+    Fill(maxToken);
+    const char* b = &m_buf[m_pos];
+    // plain decimals with at most 15 significant digits, like "2.000001234", are
+    // exactly a mantissa divided by a power of ten, which is correctly rounded
+    // the same as strtod
+    const char* c = b;
+    uint64_t mant = 0;
+    uint32_t digits = 0;
+    uint32_t frac = 0;
+    for (; *c >= '0' && *c <= '9'; c++, digits++)
+    {
+        mant = mant * 10 + (*c - '0');
+    }
+    if (*c == '.')
+    {
+        for (c++; *c >= '0' && *c <= '9'; c++, digits++, frac++)
+        {
+            mant = mant * 10 + (*c - '0');
+        }
+    }
+    if (digits > 0 && digits <= 15 && *c != 'e' && *c != 'E')
+    {
+        v = mant / pow10[frac];
+        m_pos += c - b;
+        return true;
+    }
+    // anything else goes to strtod, the buffer is '\0'-terminated after m_end
+    char* end;
+    v = strtod(b, &end);
+    if (end == b)
+    {
+        return false;
+    }
+    m_pos += end - b;
+    return true;
+}
+
+bool
+FlowTraceReader::ReadText(FlowTraceRecord& r)
+{
+    uint64_t src;
+    uint64_t dst;
+    uint64_t pg;
+    uint64_t dport;
+    uint64_t size;
+    double start;
+    if (!ParseUint(src) || !ParseUint(dst) || !ParseUint(pg) || !ParseUint(dport) ||
+        !ParseUint(size) || !ParseDouble(start))
+    {
+        NS_LOG_ERROR("malformed flow #" << m_read);
+        return false;
+    }
+    r.src = src;
+    r.dst = dst;
+    r.pg = pg;
+    r.dport = dport;
+    r.size = size;
+    r.start = Seconds(start);
+    return true;
+}
+
+bool
+FlowTraceReader::ConvertToBinary(const std::string& textPath, const std::string& binPath)
+{
+    FlowTraceReader in;
+    if (!in.Open(textPath) || in.IsBinary())
+    {
+        return false;
+    }
+    FILE* out = fopen(binPath.c_str(), "wb");
+    if (out == nullptr)
+    {
+        return false;
+    }
+    uint8_t head[sizeof(magic) + 8];
+    memcpy(head, magic, sizeof(magic));
+    PutLe(head + sizeof(magic), in.GetNFlows(), 8);
+    bool ok = fwrite(head, sizeof(head), 1, out) == 1;
+    std::vector<uint8_t> buf;
+    buf.reserve(chunkSize);
+    FlowTraceRecord r;
+    uint64_t n = 0;
+    while (ok && in.Read(r))
+    {
+        uint8_t b[recordSize];
+        PutLe(b, r.src, 4);
+        PutLe(b + 4, r.dst, 4);
+        PutLe(b + 8, r.pg, 2);
+        PutLe(b + 10, r.dport, 2);
+        PutLe(b + 12, r.size, 8);
+        PutLe(b + 20, r.start.GetNanoSeconds(), 8);
+        buf.insert(buf.end(), b, b + recordSize);
+        if (buf.size() + recordSize > chunkSize)
+        {
+            ok = fwrite(buf.data(), 1, buf.size(), out) == buf.size();
+            buf.clear();
+        }
+        n++;
+    }
+    ok = ok && fwrite(buf.data(), 1, buf.size(), out) == buf.size();
+    fclose(out);
+    return ok && n == in.GetNFlows();
+}
+
+} // namespace ns3
@@ -0,0 +1,89 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+#ifndef FLOW_TRACE_H
+#define FLOW_TRACE_H
+
+#include "ns3/nstime.h"
+
+#include <cstdio>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * One flow of a flow trace: "src dst pg dport size start" in the text format
+ */
+struct FlowTraceRecord
+{
+    uint32_t src;   //!< source node id
+    uint32_t dst;   //!< destination node id
+    uint16_t pg;    //!< priority group
+    uint16_t dport; //!< destination port
+    uint64_t size;  //!< bytes to send
+    Time start;     //!< start time
+};
+
+/**
+ * \brief Sequential reader of flow traces, text or binary
+ *
+ * The text format is the flow count followed by one "src dst pg dport size
+ * start_seconds" line per flow. The binary format, written by
+ * ConvertToBinary, is the 8-byte magic, the flow count as a little-endian
+ * uint64 and fixed-size little-endian records (src u32, dst u32, pg u16,
+ * dport u16, size u64, start in ns i64). Both are read in large chunks, so
+ * a trace of any size is streamed with constant memory; Open tells them
+ * apart by the magic.
+ */
+class FlowTraceReader
+{
+  public:
+    FlowTraceReader();
+    ~FlowTraceReader();
+
+    /**
+     * \param path the trace file
+     * \return false if it cannot be opened
+     */
+    bool Open(const std::string& path);
+    void Close();
+
+    bool IsBinary() const;
+    uint64_t GetNFlows() const; //!< as announced by the trace
+    /**
+     * \param r filled with the next flow
+     * \return false once all flows were read, or on a malformed trace
+     */
+    bool Read(FlowTraceRecord& r);
+
+    /**
+     * Convert a text trace to the binary format
+     * \return false if a file cannot be opened or the text trace is malformed
+     */
+    static bool ConvertToBinary(const std::string& textPath, const std::string& binPath);
+
+    static const char magic[8];   //!< first bytes of a binary trace
+    static const uint32_t recordSize = 28; //!< bytes of a binary record
+
+  private:
+    bool Fill(size_t need);                     //!< have at least need bytes buffered, if the file has them
+    bool ReadText(FlowTraceRecord& r);          //!< parse the next line
+    bool ParseUint(uint64_t& v);                //!< next unsigned integer of the text
+    bool ParseDouble(double& v);                //!< next number of the text
+    bool SkipSpace();                           //!< to the next token, false at the end of the file
+
+    FILE* m_file;
+    std::vector<char> m_buf;
+    size_t m_pos;    //!< next byte of m_buf to read
+    size_t m_end;    //!< end of valid bytes in m_buf
+    bool m_binary;
+    uint64_t m_n;    //!< flows in the trace
+    uint64_t m_read; //!< flows read so far
+};
+
+} // namespace ns3
+
+#endif /* FLOW_TRACE_H */
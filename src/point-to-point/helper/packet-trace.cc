@@ -0,0 +1,301 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+#include "packet-trace.h"
+
+#include "sim-setting.h"
+
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+
+#include <algorithm>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("PacketTrace");
+
+PacketTraceWriter::PacketTraceWriter(FILE* file, uint32_t bufferRecords)
+    : m_file(file),
+      m_buf(bufferRecords),
+      m_n(0),
+      m_written(0),
+      m_default{allEvents, 1, 0},
+      m_flowEvery(1),
+      m_openWindows(0),
+      m_outsideWindows(false),
+      m_pfcTrigger(false),
+      m_dropTrigger(false),
+      m_qlenTrigger(0),
+      m_before(0),
+      m_after(0),
+      m_triggeredUntil(0),
+      m_nTriggers(0),
+      m_historyCap(0),
+      m_keptPrefix(0)
+{
+    NS_ASSERT(bufferRecords > 0);
+}
+
+PacketTraceWriter::~PacketTraceWriter()
+{
+    Flush();
+}
+
+void
+PacketTraceWriter::SetDefaultFilter(uint8_t events, uint32_t every)
+{
+    m_default = Filter{events, std::max(every, 1U), 0};
+}
+
+void
+PacketTraceWriter::SetFilter(uint32_t node, uint8_t events, uint32_t every)
+{
+    GetFilter(node) = Filter{events, std::max(every, 1U), 0};
+}
+
+PacketTraceWriter::Filter&
+PacketTraceWriter::GetFilter(uint32_t node)
+{
+    if (node >= m_filters.size())
+    {
+        m_filters.resize(node + 1, m_default);
+    }
+    return m_filters[node];
+}
+
+bool
+PacketTraceWriter::KeepsEvent(uint32_t node, MyEvent event)
+{
+    return (GetFilter(node).events & (1 << event)) != 0;
+}
+
+void
+PacketTraceWriter::SetFlowSampling(uint32_t every)
+{
+    m_flowEvery = std::max(every, 1U);
+}
+
+void
+PacketTraceWriter::AddWindow(Time start, Time stop)
+{
+    NS_ASSERT(start <= stop);
+    m_outsideWindows = m_openWindows == 0;
+    Simulator::Schedule(start, &PacketTraceWriter::OpenWindow, this);
+    Simulator::Schedule(stop, &PacketTraceWriter::CloseWindow, this);
+}
+
+void
+PacketTraceWriter::OpenWindow()
+{
+    m_openWindows++;
+    m_outsideWindows = false;
+}
+
+void
+PacketTraceWriter::CloseWindow()
+{
+    m_openWindows--;
+    m_outsideWindows = m_openWindows == 0;
+}
+
+void
+PacketTraceWriter::SetTriggers(bool pfc, bool drop, uint32_t qlen, Time before, Time after)
+{
+    m_pfcTrigger = pfc;
+    m_dropTrigger = drop;
+    m_qlenTrigger = qlen;
+    m_before = before.GetTimeStep();
+    m_after = after.GetTimeStep();
+    // bounds the history when the events of the "before" time do not fit
+    m_historyCap = pfc || drop || qlen > 0 ? 16 * m_buf.size() : 0;
+}
+
+bool
+PacketTraceWriter::HasPfcTrigger() const
+{
+    return m_pfcTrigger;
+}
+
+bool
+PacketTraceWriter::HasDropTrigger() const
+{
+    return m_dropTrigger;
+}
+
+void
+PacketTraceWriter::Trigger()
+{
+    uint64_t now = Simulator::Now().GetTimeStep();
+    if (m_nTriggers == 0 || now > m_triggeredUntil)
+    {
+        m_nTriggers++;
+        m_triggeredUntil = now + m_after;
+    }
+    else
+    {
+        m_triggeredUntil = std::max(m_triggeredUntil, now + m_after);
+    }
+    for (size_t i = m_keptPrefix; i < m_history.size(); i++)
+    {
+        m_history[i].keep = true;
+    }
+    m_keptPrefix = m_history.size();
+}
+
+bool
+PacketTraceWriter::IsSampledFlow(const TraceFormat& tr) const
+{
+    uint64_t h;
+    uint64_t ports;
+    switch (tr.l3Prot)
+    {
+    case 0x6:
+    case 0x11:
+        h = ((uint64_t)tr.sip << 32) | tr.dip;
+        ports = ((uint64_t)tr.data.sport << 32) | ((uint64_t)tr.data.dport << 16) |
+                (tr.l3Prot == 0x11 ? tr.data.pg : 0);
+        break;
+    case 0xFC:
+    case 0xFD:
+        // the ACK goes back from the receiver, with the addresses and ports swapped
+        h = ((uint64_t)tr.dip << 32) | tr.sip;
+        ports = ((uint64_t)tr.ack.dport << 32) | ((uint64_t)tr.ack.sport << 16) | tr.ack.pg;
+        break;
+    default:
+        return true;
+    }
+    // the murmur3 finalizer
+    h ^= ports * 0x9e3779b97f4a7c15ULL;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h % m_flowEvery == 0;
+}
+
+void
+PacketTraceWriter::CommitHistory(bool keep)
+{
+    HeldRecord& r = m_history.back();
+    uint64_t now = r.tr.time;
+    r.keep = (keep && (m_flowEvery <= 1 || IsSampledFlow(r.tr))) ||
+             (m_nTriggers > 0 && now <= m_triggeredUntil);
+    if (r.keep && m_keptPrefix + 1 == m_history.size())
+    {
+        m_keptPrefix++;
+    }
+    if (m_qlenTrigger > 0 && r.tr.qlen >= m_qlenTrigger)
+    {
+        Trigger();
+    }
+    while (m_history.front().tr.time + m_before < now || m_history.size() > m_historyCap)
+    {
+        if (m_history.front().keep)
+        {
+            Append() = m_history.front().tr;
+        }
+        m_history.pop_front();
+        if (m_keptPrefix > 0)
+        {
+            m_keptPrefix--;
+        }
+    }
+}
+
+void
+PacketTraceWriter::Flush()
+{
+    for (auto& r : m_history)
+    {
+        if (r.keep)
+        {
+            Append() = r.tr;
+        }
+    }
+    m_history.clear();
+    m_keptPrefix = 0;
+    WriteBuffer();
+}
+
+void
+PacketTraceWriter::WriteBuffer()
+{
+    if (m_n > 0 && fwrite(m_buf.data(), sizeof(TraceFormat), m_n, m_file) != m_n)
+    {
+        NS_LOG_WARN("Failed to write " << m_n << " trace records");
+    }
+    m_n = 0;
+}
+
+uint64_t
+PacketTraceWriter::GetNRecords() const
+{
+    return m_written;
+}
+
+uint64_t
+PacketTraceWriter::GetNTriggers() const
+{
+    return m_nTriggers;
+}
+
+PacketTraceReader::PacketTraceReader()
+    : m_file(nullptr),
+      m_pos(0),
+      m_end(0)
+{
+}
+
+PacketTraceReader::~PacketTraceReader()
+{
+    Close();
+}
+
+bool
+PacketTraceReader::Open(const std::string& path, SimSetting& setting)
+{
+    Close();
+    m_file = fopen(path.c_str(), "rb");
+    if (m_file == nullptr)
+    {
+        return false;
+    }
+    setting.Deserialize(m_file);
+    m_buf.resize(65536);
+    m_pos = m_end = 0;
+    return true;
+}
+
+void
+PacketTraceReader::Close()
+{
+    if (m_file != nullptr)
+    {
+        fclose(m_file);
+        m_file = nullptr;
+    }
+}
+
+bool
+PacketTraceReader::Read(TraceFormat& tr)
+{
+    if (m_pos == m_end)
+    {
+        if (m_file == nullptr)
+        {
+            return false;
+        }
+        m_pos = 0;
+        m_end = fread(m_buf.data(), sizeof(TraceFormat), m_buf.size(), m_file);
+        if (m_end == 0)
+        {
+            return false;
+        }
+    }
+    tr = m_buf[m_pos++];
+    return true;
+}
+
+} // namespace ns3
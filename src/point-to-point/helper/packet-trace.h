@@ -0,0 +1,344 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+#ifndef PACKET_TRACE_H
+#define PACKET_TRACE_H
+
+#include "ns3/assert.h"
+#include "ns3/nstime.h"
+#include "ns3/simple-ref-count.h"
+
+#include <cstdio>
+#include <deque>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class SimSetting;
+
+namespace ns3
+{
+
+enum MyEvent
+{
+    Recv = 0,
+    Enqu = 1,
+    Dequ = 2,
+    Drop = 3,
+    SwitchDrop = 4 // a packet a switch did not admit, only in filters, recorded as Drop
+};
+
+struct TraceFormat
+{
+    uint64_t time;
+    uint16_t node;
+    uint8_t intf, qidx;
+    uint32_t qlen;
+    uint32_t sip, dip;
+    uint16_t size;
+    uint8_t l3Prot;
+    uint8_t event;
+    uint8_t ecn;      // this is the ip ECN bits
+    uint8_t nodeType; // 0: host, 1: switch
+
+    union {
+        struct
+        {
+            uint16_t sport, dport;
+            uint32_t seq;
+            uint64_t ts;
+            uint16_t pg;
+            uint16_t
+                payload; // this does not include SeqTsHeader's size, diff from udp's payload size.
+        } data;
+
+        struct
+        {
+            uint16_t fid;
+            uint8_t qIndex;
+            uint8_t ecnBits; // this is the ECN bits in the CNP
+            uint16_t qfb;
+            uint16_t total;
+        } cnp;
+
+        struct
+        {
+            uint16_t sport, dport;
+            uint16_t flags;
+            uint16_t pg;
+            uint32_t seq;
+            uint64_t ts;
+        } ack;
+
+        struct
+        {
+            uint32_t time;
+            uint32_t qlen;
+            uint8_t qIndex;
+        } pfc;
+
+        struct
+        {
+            uint16_t sport, dport;
+        } qp;
+    };
+
+    void Serialize(FILE* file)
+    {
+        fwrite(this, sizeof(TraceFormat), 1, file);
+    }
+
+    int Deserialize(FILE* file)
+    {
+        int ret = fread(this, sizeof(TraceFormat), 1, file);
+        return ret;
+    }
+};
+
+static inline const char*
+EventToStr(enum MyEvent e)
+{
+    switch (e)
+    {
+    case Recv:
+        return "Recv";
+    case Enqu:
+        return "Enqu";
+    case Dequ:
+        return "Dequ";
+    case Drop:
+        return "Drop";
+    default:
+        return "????";
+    }
+}
+
+/**
+ * \brief Buffered writer of the packet events of QbbHelper tracing
+ *
+ * The records are the fixed-size TraceFormat of the original trace, so the
+ * file layout is unchanged: the SimSetting the scratch programs dump, then
+ * one TraceFormat per event. The events are filled in place in a buffer of
+ * records and written a block at a time with one fwrite, instead of one
+ * fwrite per event.
+ *
+ * Each node has a filter, the events of the node to keep and one in how many
+ * of them; an event type a node does not keep is not even connected by
+ * QbbHelper, so the filters must be set before EnableTracing. The admission
+ * drops of switches are only kept by filters with SwitchDrop, which
+ * allEvents leaves out so that the default trace only has the drops of the
+ * devices. The simulator
+ * runs on one thread, so a writer has a single buffer.
+ *
+ * On top of the filters, the events can be limited to one in N flows, by a
+ * hash of the five-tuple and priority group (an ACK counts for the flow it
+ * acknowledges, PFC and CNP packets are always kept), and to time windows.
+ *
+ * Triggers record every event the node filters have, ignoring the sampling
+ * and the windows, from some time before to some time after a PFC pause, a
+ * drop or a queue length above a threshold on a traced device. For that the
+ * events of the last "before" time are held in a history, which also delays
+ * the sampled events by that much so the trace stays in time order.
+ */
+class PacketTraceWriter : public SimpleRefCount<PacketTraceWriter>
+{
+  public:
+    /**
+     * \param file where to write the records, not closed by the writer
+     * \param bufferRecords records in the buffer
+     */
+    PacketTraceWriter(FILE* file, uint32_t bufferRecords = 65536);
+    ~PacketTraceWriter();
+
+    static const uint8_t allEvents = (1 << Recv) | (1 << Enqu) | (1 << Dequ) | (1 << Drop);
+
+    /// what to do with an event, see Decide
+    enum Decision
+    {
+        Skip,      //!< not recorded
+        Candidate, //!< recorded if a trigger covers it
+        Keep,      //!< recorded
+    };
+
+    /**
+     * \param events mask of 1 << MyEvent to keep
+     * \param every keep one in this many of those events
+     */
+    void SetDefaultFilter(uint8_t events, uint32_t every); //!< of the nodes without their own
+    void SetFilter(uint32_t node, uint8_t events, uint32_t every);
+    bool KeepsEvent(uint32_t node, MyEvent event); //!< whether the filter of node has event
+
+    void SetFlowSampling(uint32_t every); //!< keep the events of one in this many flows
+    /**
+     * Only keep the events between start and stop, may be called several
+     * times before the simulation runs
+     */
+    void AddWindow(Time start, Time stop);
+    /**
+     * \param pfc trigger on a PFC pause received by a traced device
+     * \param drop trigger on a drop by a traced device
+     * \param qlen trigger on an event seeing its queue at this many bytes or more, 0 for none
+     * \param before record the events this long before a trigger
+     * \param after record the events this long after a trigger
+     */
+    void SetTriggers(bool pfc, bool drop, uint32_t qlen, Time before, Time after);
+    bool HasPfcTrigger() const;
+    bool HasDropTrigger() const;
+    void Trigger(); //!< record the events around now
+
+    /**
+     * \return what to do with this event of node, counting it for the sampling
+     */
+    Decision Decide(uint32_t node, MyEvent event)
+    {
+        NS_ASSERT(node < m_filters.size());
+        if (m_dropTrigger && (event == Drop || event == SwitchDrop))
+        {
+            Trigger();
+        }
+        Filter& f = m_filters[node];
+        if ((f.events & (1 << event)) == 0)
+        {
+            return Skip;
+        }
+        bool keep = ++f.count >= f.every;
+        if (keep)
+        {
+            f.count = 0;
+        }
+        keep = keep && !m_outsideWindows;
+        if (m_historyCap == 0)
+        {
+            return keep ? Keep : Skip;
+        }
+        return keep ? Keep : Candidate;
+    }
+
+    /**
+     * \return the record to fill for an event Decide did not skip, then Commit it
+     */
+    TraceFormat& Next()
+    {
+        if (m_historyCap > 0)
+        {
+            m_history.emplace_back();
+            return m_history.back().tr;
+        }
+        if (m_n == m_buf.size())
+        {
+            WriteBuffer();
+        }
+        return m_buf[m_n];
+    }
+
+    /**
+     * \param keep whether Decide said Keep
+     */
+    void Commit(bool keep)
+    {
+        if (m_historyCap > 0)
+        {
+            CommitHistory(keep);
+        }
+        else if (keep && (m_flowEvery <= 1 || IsSampledFlow(m_buf[m_n])))
+        {
+            m_n++;
+            m_written++;
+        }
+    }
+
+    /**
+     * \return the record to fill for the next event, always kept
+     */
+    TraceFormat& Append()
+    {
+        if (m_n == m_buf.size())
+        {
+            WriteBuffer();
+        }
+        m_written++;
+        return m_buf[m_n++];
+    }
+
+    void Flush(); //!< write the held and buffered records
+    uint64_t GetNRecords() const; //!< written so far
+    uint64_t GetNTriggers() const;
+
+  private:
+    struct Filter
+    {
+        uint8_t events;
+        uint32_t every;
+        uint32_t count; //!< events since the last one kept
+    };
+
+    struct HeldRecord
+    {
+        TraceFormat tr;
+        bool keep;
+    };
+
+    Filter& GetFilter(uint32_t node);
+    bool IsSampledFlow(const TraceFormat& tr) const;
+    void CommitHistory(bool keep);
+    void WriteBuffer();
+    void OpenWindow();
+    void CloseWindow();
+
+    FILE* m_file;
+    std::vector<TraceFormat> m_buf;
+    size_t m_n; //!< records in m_buf
+    uint64_t m_written;
+    Filter m_default;
+    std::vector<Filter> m_filters; //!< by node id
+    uint32_t m_flowEvery;
+    uint32_t m_openWindows;
+    bool m_outsideWindows; //!< there are windows and none is open
+
+    bool m_pfcTrigger;
+    bool m_dropTrigger;
+    uint32_t m_qlenTrigger;
+    uint64_t m_before; //!< in time steps
+    uint64_t m_after;
+    uint64_t m_triggeredUntil; //!< time step up to which every event is kept, once m_nTriggers > 0
+    uint64_t m_nTriggers;
+    std::deque<HeldRecord> m_history; //!< the events of the last m_before, oldest first
+    size_t m_historyCap;              //!< 0 without triggers
+    size_t m_keptPrefix;              //!< leading records of m_history that are all kept
+};
+
+/**
+ * \brief Reader of the trace written by PacketTraceWriter
+ *
+ * Reads the SimSetting at the start of the file, then the records in large
+ * blocks.
+ */
+class PacketTraceReader
+{
+  public:
+    PacketTraceReader();
+    ~PacketTraceReader();
+
+    /**
+     * \param path the trace file
+     * \param setting filled with the SimSetting of the trace
+     * \return false if it cannot be opened
+     */
+    bool Open(const std::string& path, SimSetting& setting);
+    void Close();
+    /**
+     * \param tr filled with the next record
+     * \return false at the end of the trace
+     */
+    bool Read(TraceFormat& tr);
+
+  private:
+    FILE* m_file;
+    std::vector<TraceFormat> m_buf;
+    size_t m_pos; //!< next record of m_buf
+    size_t m_end; //!< records in m_buf
+};
+
+} // namespace ns3
+
+#endif /* PACKET_TRACE_H */
@@ -308,9 +308,15 @@ QbbHelper::GetTraceFromPacket(TraceFormat& tr,
                               MyEvent event,
                               bool hasL2)
 {
-    CustomHeader hdr((hasL2 ? CustomHeader::L2_Header : 0) | CustomHeader::L3_Header |
-                     CustomHeader::L4_Header);
-    p->PeekHeader(hdr);
+    // reuse the header the device already parsed for this packet when there is one
+    CustomHeader parsed((hasL2 ? CustomHeader::L2_Header : 0) | CustomHeader::L3_Header |
+                        CustomHeader::L4_Header);
+    const CustomHeader* cached = hasL2 ? dev->GetTracedHeader() : nullptr;
+    if (cached == nullptr)
+    {
+        p->PeekHeader(parsed);
+    }
+    const CustomHeader& hdr = cached != nullptr ? *cached : parsed;
 
     tr.event = event;
     tr.node = dev->GetNode()->GetId();
@@ -366,81 +372,139 @@ QbbHelper::GetTraceFromPacket(TraceFormat& tr,
 }
 
 void
-QbbHelper::PacketEventCallback(FILE* file,
+QbbHelper::PacketEventCallback(Ptr<PacketTraceWriter> writer,
                                Ptr<QbbNetDevice> dev,
                                Ptr<const Packet> p,
                                uint32_t qidx,
                                MyEvent event,
                                bool hasL2)
 {
-    TraceFormat tr;
-    GetTraceFromPacket(tr, dev, p, qidx, event, hasL2);
-    tr.Serialize(file);
+    PacketTraceWriter::Decision d = writer->Decide(dev->GetNode()->GetId(), event);
+    if (d != PacketTraceWriter::Skip)
+    {
+        GetTraceFromPacket(writer->Next(), dev, p, qidx, event, hasL2);
+        writer->Commit(d == PacketTraceWriter::Keep);
+    }
 }
 
 void
-QbbHelper::MacRxDetailCallback(FILE* file, Ptr<QbbNetDevice> dev, Ptr<const Packet> p)
+QbbHelper::MacRxDetailCallback(Ptr<PacketTraceWriter> writer,
+                               Ptr<QbbNetDevice> dev,
+                               Ptr<const Packet> p)
 {
-    PacketEventCallback(file, dev, p, 0, Recv, true);
+    PacketEventCallback(writer, dev, p, 0, Recv, true);
 }
 
 void
-QbbHelper::EnqueueDetailCallback(FILE* file,
+QbbHelper::EnqueueDetailCallback(Ptr<PacketTraceWriter> writer,
                                  Ptr<QbbNetDevice> dev,
                                  Ptr<const Packet> p,
                                  uint32_t qidx)
 {
-    PacketEventCallback(file, dev, p, qidx, Enqu, true);
+    PacketEventCallback(writer, dev, p, qidx, Enqu, true);
 }
 
 void
-QbbHelper::DequeueDetailCallback(FILE* file,
+QbbHelper::DequeueDetailCallback(Ptr<PacketTraceWriter> writer,
                                  Ptr<QbbNetDevice> dev,
                                  Ptr<const Packet> p,
                                  uint32_t qidx)
 {
-    PacketEventCallback(file, dev, p, qidx, Dequ, true);
+    PacketEventCallback(writer, dev, p, qidx, Dequ, true);
+}
+
+void
+QbbHelper::DropDetailCallback(Ptr<PacketTraceWriter> writer,
+                              Ptr<QbbNetDevice> dev,
+                              Ptr<const Packet> p,
+                              uint32_t qidx)
+{
+    PacketEventCallback(writer, dev, p, qidx, Drop, true);
 }
 
 void
-QbbHelper::DropDetailCallback(FILE* file, Ptr<QbbNetDevice> dev, Ptr<const Packet> p, uint32_t qidx)
+QbbHelper::SwitchDropDetailCallback(Ptr<PacketTraceWriter> writer,
+                                    Ptr<QbbNetDevice> dev,
+                                    Ptr<const Packet> p,
+                                    uint32_t qidx)
 {
-    PacketEventCallback(file, dev, p, qidx, Drop, true);
+    PacketTraceWriter::Decision d = writer->Decide(dev->GetNode()->GetId(), SwitchDrop);
+    if (d != PacketTraceWriter::Skip)
+    {
+        GetTraceFromPacket(writer->Next(), dev, p, qidx, Drop, true);
+        writer->Commit(d == PacketTraceWriter::Keep);
+    }
 }
 
 void
-QbbHelper::QpDequeueCallback(FILE* file,
+QbbHelper::QpDequeueCallback(Ptr<PacketTraceWriter> writer,
                              Ptr<QbbNetDevice> dev,
                              Ptr<const Packet> p,
                              Ptr<RdmaQueuePair> qp)
 {
-    TraceFormat tr;
-    GetTraceFromPacket(tr, dev, p, qp->m_pg, Dequ, true);
-    tr.Serialize(file);
+    PacketEventCallback(writer, dev, p, qp->m_pg, Dequ, true);
 }
 
 void
-QbbHelper::EnableTracingDevice(FILE* file, Ptr<QbbNetDevice> nd)
+QbbHelper::PfcTriggerCallback(Ptr<PacketTraceWriter> writer, uint32_t type)
+{
+    if (type == 1)
+    {
+        writer->Trigger();
+    }
+}
+
+void
+QbbHelper::EnableTracingDevice(Ptr<PacketTraceWriter> writer, Ptr<QbbNetDevice> nd)
 {
     uint32_t nodeid = nd->GetNode()->GetId();
     uint32_t deviceid = nd->GetIfIndex();
     std::ostringstream oss;
 
 #if 1
-    nd->TraceConnectWithoutContext("MacRx",
-                                   MakeBoundCallback(&QbbHelper::MacRxDetailCallback, file, nd));
+    if (writer->KeepsEvent(nodeid, Recv))
+    {
+        nd->TraceConnectWithoutContext(
+            "MacRx",
+            MakeBoundCallback(&QbbHelper::MacRxDetailCallback, writer, nd));
+    }
     // oss << "/NodeList/" << nd->GetNode ()->GetId () << "/DeviceList/" << deviceid <<
     // "/$ns3::QbbNetDevice/MacRx"; Config::ConnectWithoutContext (oss.str (), MakeBoundCallback
     // (&QbbHelper::MacRxDetailCallback, file, nd));
 
-    nd->TraceConnectWithoutContext("QbbEnqueue",
-                                   MakeBoundCallback(&QbbHelper::EnqueueDetailCallback, file, nd));
-    nd->TraceConnectWithoutContext("QbbDequeue",
-                                   MakeBoundCallback(&QbbHelper::DequeueDetailCallback, file, nd));
-    nd->TraceConnectWithoutContext("QbbDrop",
-                                   MakeBoundCallback(&QbbHelper::DropDetailCallback, file, nd));
-    nd->TraceConnectWithoutContext("RdmaQpDequeue",
-                                   MakeBoundCallback(&QbbHelper::QpDequeueCallback, file, nd));
+    if (writer->KeepsEvent(nodeid, Enqu))
+    {
+        nd->TraceConnectWithoutContext(
+            "QbbEnqueue",
+            MakeBoundCallback(&QbbHelper::EnqueueDetailCallback, writer, nd));
+    }
+    if (writer->KeepsEvent(nodeid, Dequ))
+    {
+        nd->TraceConnectWithoutContext(
+            "QbbDequeue",
+            MakeBoundCallback(&QbbHelper::DequeueDetailCallback, writer, nd));
+        nd->TraceConnectWithoutContext(
+            "RdmaQpDequeue",
+            MakeBoundCallback(&QbbHelper::QpDequeueCallback, writer, nd));
+    }
+    if (writer->KeepsEvent(nodeid, Drop) || writer->HasDropTrigger())
+    {
+        nd->TraceConnectWithoutContext(
+            "QbbDrop",
+            MakeBoundCallback(&QbbHelper::DropDetailCallback, writer, nd));
+    }
+    if (writer->KeepsEvent(nodeid, SwitchDrop) || writer->HasDropTrigger())
+    {
+        nd->TraceConnectWithoutContext(
+            "QbbSwitchDrop",
+            MakeBoundCallback(&QbbHelper::SwitchDropDetailCallback, writer, nd));
+    }
+    if (writer->HasPfcTrigger())
+    {
+        nd->TraceConnectWithoutContext(
+            "QbbPfc",
+            MakeBoundCallback(&QbbHelper::PfcTriggerCallback, writer));
+    }
 #endif
     // nd->GetQueue()->TraceConnectWithoutContext("BeqEnqueue", MakeBoundCallback
     // (&QbbHelper::EnqueueDetailCallback, file, nd)); oss.str (""); oss << "/NodeList/" << nodeid
@@ -468,7 +532,7 @@ QbbHelper::EnableTracingDevice(FILE* file, Ptr<QbbNetDevice> nd)
 }
 
 void
-QbbHelper::EnableTracing(FILE* file, NodeContainer node_container)
+QbbHelper::EnableTracing(Ptr<PacketTraceWriter> writer, NodeContainer node_container)
 {
     NetDeviceContainer devs;
     for (NodeContainer::Iterator i = node_container.Begin(); i != node_container.End(); ++i)
@@ -478,7 +542,7 @@ QbbHelper::EnableTracing(FILE* file, NodeContainer node_container)
         {
             if (node->GetDevice(j)->IsQbb())
             {
-                EnableTracingDevice(file, DynamicCast<QbbNetDevice>(node->GetDevice(j)));
+                EnableTracingDevice(writer, DynamicCast<QbbNetDevice>(node->GetDevice(j)));
             }
         }
     }
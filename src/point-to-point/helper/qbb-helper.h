@@ -24,6 +24,7 @@
 #include "ns3/net-device-container.h"
 #include "ns3/node-container.h"
 #include "ns3/object-factory.h"
+#include "ns3/packet-trace.h"
 #include "ns3/qbb-net-device.h"
 #include "ns3/queue.h"
 #include "ns3/trace-helper.h"
@@ -33,107 +34,6 @@
 namespace ns3
 {
 
-enum MyEvent
-{
-    Recv = 0,
-    Enqu = 1,
-    Dequ = 2,
-    Drop = 3
-};
-
-struct TraceFormat
-{
-    uint64_t time;
-    uint16_t node;
-    uint8_t intf, qidx;
-    uint32_t qlen;
-    uint32_t sip, dip;
-    uint16_t size;
-    uint8_t l3Prot;
-    uint8_t event;
-    uint8_t ecn;      // this is the ip ECN bits
-    uint8_t nodeType; // 0: host, 1: switch
-
-    union {
-        struct
-        {
-            uint16_t sport, dport;
-            uint32_t seq;
-            uint64_t ts;
-            uint16_t pg;
-            uint16_t
-                payload; // this does not include SeqTsHeader's size, diff from udp's payload size.
-        } data;
-
-        struct
-        {
-            uint16_t fid;
-            uint8_t qIndex;
-            uint8_t ecnBits; // this is the ECN bits in the CNP
-
-            union {
-                struct
-                {
-                    uint16_t qfb;
-                    uint16_t total;
-                };
-
-                uint32_t seq;
-            };
-        } cnp;
-
-        struct
-        {
-            uint16_t sport, dport;
-            uint16_t flags;
-            uint16_t pg;
-            uint32_t seq;
-            uint64_t ts;
-        } ack;
-
-        struct
-        {
-            uint32_t time;
-            uint32_t qlen;
-            uint8_t qIndex;
-        } pfc;
-
-        struct
-        {
-            uint16_t sport, dport;
-        } qp;
-    };
-
-    void Serialize(FILE* file)
-    {
-        fwrite(this, sizeof(TraceFormat), 1, file);
-    }
-
-    int Deserialize(FILE* file)
-    {
-        int ret = fread(this, sizeof(TraceFormat), 1, file);
-        return ret;
-    }
-};
-
-static inline const char*
-EventToStr(enum MyEvent e)
-{
-    switch (e)
-    {
-    case Recv:
-        return "Recv";
-    case Enqu:
-        return "Enqu";
-    case Dequ:
-        return "Dequ";
-    case Drop:
-        return "Drop";
-    default:
-        return "????";
-    }
-}
-
 // class Queue;
 class NetDevice;
 class Node;
@@ -262,33 +162,43 @@ class QbbHelper : public PcapHelperForDevice, public AsciiTraceHelperForDevice
                                    uint32_t qidx,
                                    MyEvent event,
                                    bool hasL2);
-    static void PacketEventCallback(FILE* file,
+    static void PacketEventCallback(Ptr<PacketTraceWriter> writer,
                                     Ptr<QbbNetDevice>,
                                     Ptr<const Packet>,
                                     uint32_t qidx,
                                     MyEvent event,
                                     bool hasL2);
-    static void MacRxDetailCallback(FILE* file, Ptr<QbbNetDevice>, Ptr<const Packet> p);
-    static void EnqueueDetailCallback(FILE* file,
+    static void MacRxDetailCallback(Ptr<PacketTraceWriter> writer,
+                                    Ptr<QbbNetDevice>,
+                                    Ptr<const Packet> p);
+    static void EnqueueDetailCallback(Ptr<PacketTraceWriter> writer,
                                       Ptr<QbbNetDevice>,
                                       Ptr<const Packet> p,
                                       uint32_t qidx);
-    static void DequeueDetailCallback(FILE* file,
+    static void DequeueDetailCallback(Ptr<PacketTraceWriter> writer,
                                       Ptr<QbbNetDevice>,
                                       Ptr<const Packet> p,
                                       uint32_t qidx);
-    static void DropDetailCallback(FILE* file,
+    static void DropDetailCallback(Ptr<PacketTraceWriter> writer,
                                    Ptr<QbbNetDevice>,
                                    Ptr<const Packet> p,
                                    uint32_t qidx);
-    static void QpDequeueCallback(FILE* file,
+    static void SwitchDropDetailCallback(Ptr<PacketTraceWriter> writer,
+                                         Ptr<QbbNetDevice>,
+                                         Ptr<const Packet> p,
+                                         uint32_t qidx);
+    static void QpDequeueCallback(Ptr<PacketTraceWriter> writer,
                                   Ptr<QbbNetDevice>,
                                   Ptr<const Packet>,
                                   Ptr<RdmaQueuePair>);
+    static void PfcTriggerCallback(Ptr<PacketTraceWriter> writer, uint32_t type);
 
-    void EnableTracingDevice(FILE* file, Ptr<QbbNetDevice>);
+    /**
+     * Trace the events of a device that the filter of its node keeps
+     */
+    void EnableTracingDevice(Ptr<PacketTraceWriter> writer, Ptr<QbbNetDevice>);
 
-    void EnableTracing(FILE* file, NodeContainer node_container);
+    void EnableTracing(Ptr<PacketTraceWriter> writer, NodeContainer node_container);
 
   private:
     /**
@@ -0,0 +1,422 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+#include "route-calculator.h"
+
+#include "ns3/log.h"
+#include "ns3/rdma-driver.h"
+#include "ns3/rdma-hw.h"
+#include "ns3/switch-node.h"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <thread>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("RouteCalculator");
+
+static const uint32_t batchPerThread = 32; // BFS per thread between two hand-outs of routes
+
+RouteCalculator::RouteCalculator()
+    : m_hostLayout(false),
+      m_hostBase(0),
+      m_hostShift(0),
+      m_csrValid(false),
+      m_threads(0),
+      m_payloadSize(1000)
+{
+}
+
+void
+RouteCalculator::SetNodes(const NodeContainer& nodes, const std::vector<Ipv4Address>& addresses)
+{
+    m_nodes = nodes;
+    m_addresses = addresses;
+    uint32_t n = nodes.GetN();
+    m_isSwitch.assign(n, false);
+    m_switches.assign(n, nullptr);
+    m_rdma.assign(n, nullptr);
+    m_hosts.clear();
+    m_hostIdx.assign(n, -1);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        Ptr<Node> node = nodes.Get(i);
+        if (node->GetNodeType() == 1)
+        {
+            m_isSwitch[i] = true;
+            m_switches[i] = DynamicCast<SwitchNode>(node);
+        }
+        else
+        {
+            NS_ASSERT_MSG(i < addresses.size(), "host " << i << " has no address");
+            m_hostIdx[i] = m_hosts.size();
+            m_hosts.push_back(i);
+        }
+    }
+    m_links.clear();
+    m_csrValid = false;
+}
+
+void
+RouteCalculator::AddInterface(uint32_t node,
+                              uint32_t nbr,
+                              uint32_t ifIndex,
+                              uint64_t delay,
+                              uint64_t bw)
+{
+    NS_ASSERT(node < m_nodes.GetN() && nbr < m_nodes.GetN());
+    Adjacency a;
+    a.nbr = nbr;
+    a.ifIndex = ifIndex;
+    a.nbrIf = 0;
+    a.up = true;
+    a.delay = delay;
+    a.bw = bw;
+    m_links.emplace_back((uint64_t)node << 32 | nbr, a);
+    m_csrValid = false;
+}
+
+void
+RouteCalculator::SetThreads(uint32_t threads)
+{
+    m_threads = threads;
+}
+
+void
+RouteCalculator::SetPayloadSize(uint32_t payloadSize)
+{
+    m_payloadSize = payloadSize;
+}
+
+void
+RouteCalculator::BuildCsr()
+{
+    if (m_csrValid)
+    {
+        return;
+    }
+    // by (node, nbr), the last one added of a pair wins
+    std::stable_sort(m_links.begin(), m_links.end(), [](const auto& a, const auto& b) {
+        return a.first < b.first;
+    });
+    std::vector<std::pair<uint64_t, Adjacency>> links;
+    for (auto& l : m_links)
+    {
+        if (!links.empty() && links.back().first == l.first)
+        {
+            links.back() = l;
+        }
+        else
+        {
+            links.push_back(l);
+        }
+    }
+    m_links.swap(links);
+
+    uint32_t n = m_nodes.GetN();
+    m_adjStart.assign(n + 1, 0);
+    m_adj.clear();
+    m_adj.reserve(m_links.size());
+    for (auto& l : m_links)
+    {
+        m_adjStart[(l.first >> 32) + 1]++;
+        m_adj.push_back(l.second);
+    }
+    for (uint32_t i = 0; i < n; i++)
+    {
+        m_adjStart[i + 1] += m_adjStart[i];
+    }
+    // the device of the other end, for the routes of the neighbors
+    for (uint32_t i = 0; i < n; i++)
+    {
+        for (uint32_t k = m_adjStart[i]; k < m_adjStart[i + 1]; k++)
+        {
+            const Adjacency* rev = Find(m_adj[k].nbr, i);
+            NS_ASSERT_MSG(rev, "link " << i << "-" << m_adj[k].nbr << " has one direction");
+            m_adj[k].nbrIf = rev->ifIndex;
+        }
+    }
+
+    m_rates.assign(1, 0);
+    for (auto& a : m_adj)
+    {
+        m_rates.push_back(a.bw);
+    }
+    std::sort(m_rates.begin(), m_rates.end());
+    m_rates.erase(std::unique(m_rates.begin(), m_rates.end()), m_rates.end());
+    m_rates.push_back(std::numeric_limits<uint64_t>::max());
+    NS_ABORT_MSG_IF(m_rates.size() > 256, "more than 254 distinct link rates");
+    m_csrValid = true;
+}
+
+RouteCalculator::Adjacency*
+RouteCalculator::Find(uint32_t a, uint32_t b)
+{
+    Adjacency* begin = m_adj.data() + m_adjStart[a];
+    Adjacency* end = m_adj.data() + m_adjStart[a + 1];
+    Adjacency* it = std::lower_bound(begin, end, b, [](const Adjacency& x, uint32_t nbr) {
+        return x.nbr < nbr;
+    });
+    return it != end && it->nbr == b ? it : nullptr;
+}
+
+int32_t
+RouteCalculator::GetInterface(uint32_t a, uint32_t b)
+{
+    BuildCsr();
+    const Adjacency* adj = Find(a, b);
+    return adj ? (int32_t)adj->ifIndex : -1;
+}
+
+std::pair<const RouteCalculator::Adjacency*, const RouteCalculator::Adjacency*>
+RouteCalculator::GetAdjacency(uint32_t node)
+{
+    BuildCsr();
+    return {m_adj.data() + m_adjStart[node], m_adj.data() + m_adjStart[node + 1]};
+}
+
+bool
+RouteCalculator::SetLinkUp(uint32_t a, uint32_t b, bool up)
+{
+    BuildCsr();
+    Adjacency* ab = Find(a, b);
+    Adjacency* ba = Find(b, a);
+    if (!ab || !ba || (ab->up == up && ba->up == up))
+    {
+        return false;
+    }
+    ab->up = ba->up = up;
+    return true;
+}
+
+void
+RouteCalculator::Bfs(uint32_t hostIdx, Scratch& s, HostRoutes& out)
+{
+    uint32_t host = m_hosts[hostIdx];
+    out.routes.clear();
+    s.queue.clear();
+    s.queue.push_back(host);
+    s.dis[host] = 0;
+    s.delay[host] = 0;
+    s.txDelay[host] = 0;
+    s.bw[host] = std::numeric_limits<uint64_t>::max();
+    // the reset below only touches the visited nodes
+    s.visited.clear();
+    s.visited.push_back(host);
+    for (size_t i = 0; i < s.queue.size(); i++)
+    {
+        uint32_t now = s.queue[i];
+        int32_t d = s.dis[now];
+        for (uint32_t k = m_adjStart[now]; k < m_adjStart[now + 1]; k++)
+        {
+            const Adjacency& a = m_adj[k];
+            if (!a.up)
+            {
+                continue;
+            }
+            uint32_t next = a.nbr;
+            if (s.dis[next] < 0)
+            {
+                s.dis[next] = d + 1;
+                s.delay[next] = s.delay[now] + a.delay;
+                s.txDelay[next] = s.txDelay[now] + m_payloadSize * 1000000000LU * 8 / a.bw;
+                s.bw[next] = std::min(s.bw[now], a.bw);
+                s.visited.push_back(next);
+                // only switches are expanded, packets do not go through a host
+                if (m_isSwitch[next])
+                {
+                    s.queue.push_back(next);
+                }
+            }
+            // 'now' is on a shortest path from 'next' to the host
+            if (s.dis[next] == d + 1)
+            {
+                out.routes.emplace_back(next, a.nbrIf);
+            }
+        }
+    }
+
+    uint32_t nHosts = m_hosts.size();
+    uint32_t* delay = &m_pairDelay[(size_t)hostIdx * nHosts];
+    uint32_t* txDelay = &m_pairTxDelay[(size_t)hostIdx * nHosts];
+    uint8_t* rate = &m_pairRate[(size_t)hostIdx * nHosts];
+    std::fill(delay, delay + nHosts, 0);
+    std::fill(txDelay, txDelay + nHosts, 0);
+    std::fill(rate, rate + nHosts, 0);
+    for (uint32_t v : s.visited)
+    {
+        if (m_hostIdx[v] >= 0)
+        {
+            // the dense pair tables keep 32-bit ns, about 4.29 s
+            NS_ABORT_MSG_IF(s.delay[v] > std::numeric_limits<uint32_t>::max() ||
+                                s.txDelay[v] > std::numeric_limits<uint32_t>::max(),
+                            "delay from node " << v << " to host " << m_hosts[hostIdx]
+                                               << " does not fit 32 bits of ns");
+            delay[m_hostIdx[v]] = s.delay[v];
+            txDelay[m_hostIdx[v]] = s.txDelay[v];
+            rate[m_hostIdx[v]] = RateIndex(s.bw[v]);
+        }
+        s.dis[v] = -1;
+    }
+}
+
+uint8_t
+RouteCalculator::RateIndex(uint64_t bw) const
+{
+    return std::lower_bound(m_rates.begin(), m_rates.end(), bw) - m_rates.begin();
+}
+
+void
+RouteCalculator::ComputeRoutes(RouteCallback cb)
+{
+    BuildCsr();
+    uint32_t n = m_nodes.GetN();
+    size_t nHosts = m_hosts.size();
+    m_pairDelay.resize(nHosts * nHosts);
+    m_pairTxDelay.resize(nHosts * nHosts);
+    m_pairRate.resize(nHosts * nHosts);
+
+    uint32_t threads = m_threads ? m_threads : std::max(1U, std::thread::hardware_concurrency());
+    threads = std::min<uint32_t>(threads, std::max<size_t>(nHosts, 1));
+    std::vector<Scratch> scratch(threads);
+    for (auto& s : scratch)
+    {
+        s.dis.assign(n, -1);
+        s.delay.resize(n);
+        s.txDelay.resize(n);
+        s.bw.resize(n);
+        s.queue.reserve(n);
+        s.visited.reserve(n);
+    }
+    uint32_t batch = threads * batchPerThread;
+    std::vector<HostRoutes> out(std::min<size_t>(batch, nHosts));
+    for (size_t first = 0; first < nHosts; first += batch)
+    {
+        uint32_t count = std::min<size_t>(batch, nHosts - first);
+        std::atomic<uint32_t> next(0);
+        auto work = [&](Scratch& s) {
+            for (uint32_t i; (i = next++) < count;)
+            {
+                Bfs(first + i, s, out[i]);
+            }
+        };
+        std::vector<std::thread> pool;
+        for (uint32_t t = 1; t < threads && t < count; t++)
+        {
+            pool.emplace_back(work, std::ref(scratch[t]));
+        }
+        work(scratch[0]);
+        for (auto& t : pool)
+        {
+            t.join();
+        }
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint32_t dst = m_hosts[first + i];
+            for (auto& r : out[i].routes)
+            {
+                cb(r.first, dst, r.second);
+            }
+        }
+    }
+}
+
+void
+RouteCalculator::AddTableEntry(uint32_t node, uint32_t dst, uint32_t ifIndex)
+{
+    if (m_isSwitch[node])
+    {
+        m_switches[node]->AddTableEntry(m_addresses[dst], ifIndex);
+    }
+    else
+    {
+        m_rdma[node]->AddTableEntry(m_addresses[dst], ifIndex);
+    }
+}
+
+void
+RouteCalculator::FindTables()
+{
+    // the RdmaDrivers are usually installed after the links, look for them late
+    for (uint32_t i : m_hosts)
+    {
+        if (!m_rdma[i])
+        {
+            Ptr<RdmaDriver> driver = m_nodes.Get(i)->GetObject<RdmaDriver>();
+            NS_ABORT_MSG_IF(!driver, "host " << i << " has no RdmaDriver");
+            m_rdma[i] = driver->m_rdma;
+        }
+    }
+}
+
+void
+RouteCalculator::SetHostAddressing(uint32_t base, uint32_t shift)
+{
+    m_hostLayout = true;
+    m_hostBase = base;
+    m_hostShift = shift;
+}
+
+void
+RouteCalculator::InstallRoutes()
+{
+    FindTables();
+    // the groups of the former tables go with them
+    Ptr<EcmpGroupPool> groups = Create<EcmpGroupPool>();
+    EcmpTable empty = m_hostLayout ? EcmpTable(groups, m_hostBase, m_hostShift) : EcmpTable(groups);
+    for (uint32_t i = 0; i < m_nodes.GetN(); i++)
+    {
+        if (m_isSwitch[i])
+        {
+            m_switches[i]->SetTable(empty);
+        }
+        else
+        {
+            m_rdma[i]->SetTable(empty);
+        }
+    }
+    ComputeRoutes(MakeCallback(&RouteCalculator::AddTableEntry, this));
+}
+
+void
+RouteCalculator::ClearRoutes()
+{
+    FindTables();
+    for (uint32_t i = 0; i < m_nodes.GetN(); i++)
+    {
+        if (m_isSwitch[i])
+        {
+            m_switches[i]->ClearTable();
+        }
+        else
+        {
+            m_rdma[i]->ClearTable();
+        }
+    }
+}
+
+uint64_t
+RouteCalculator::GetDelay(uint32_t src, uint32_t dst) const
+{
+    NS_ASSERT(m_hostIdx[src] >= 0 && m_hostIdx[dst] >= 0);
+    return m_pairDelay[(size_t)m_hostIdx[dst] * m_hosts.size() + m_hostIdx[src]];
+}
+
+uint64_t
+RouteCalculator::GetTxDelay(uint32_t src, uint32_t dst) const
+{
+    NS_ASSERT(m_hostIdx[src] >= 0 && m_hostIdx[dst] >= 0);
+    return m_pairTxDelay[(size_t)m_hostIdx[dst] * m_hosts.size() + m_hostIdx[src]];
+}
+
+uint64_t
+RouteCalculator::GetBw(uint32_t src, uint32_t dst) const
+{
+    NS_ASSERT(m_hostIdx[src] >= 0 && m_hostIdx[dst] >= 0);
+    return m_rates[m_pairRate[(size_t)m_hostIdx[dst] * m_hosts.size() + m_hostIdx[src]]];
+}
+
+} // namespace ns3
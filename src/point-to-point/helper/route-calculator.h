@@ -0,0 +1,160 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+#ifndef ROUTE_CALCULATOR_H
+#define ROUTE_CALCULATOR_H
+
+#include "ns3/callback.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/node-container.h"
+#include "ns3/rdma-hw.h"
+#include "ns3/switch-node.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief Shortest-path ECMP routes and host pair delays of a qbb topology
+ *
+ * Nodes are the indices of the NodeContainer given to SetNodes, hosts are
+ * the nodes of type 0. The links are kept as a CSR adjacency, neighbors in
+ * index order, and the routes towards each host come from a BFS from that
+ * host which, like the original per-host BFS of the scratch programs, only
+ * goes through switches. The BFS of different hosts run on several threads
+ * in batches; the routes of a batch are handed out in host order from the
+ * calling thread, so the tables and their ECMP order do not depend on the
+ * number of threads.
+ *
+ * The one-way delay, transmission delay of a packet and bottleneck rate of
+ * every host pair, along the first path the BFS found, are kept in dense
+ * host-by-host arrays.
+ */
+class RouteCalculator
+{
+  public:
+    /// a route: node reaches the host dst through its device ifIndex
+    typedef Callback<void, uint32_t, uint32_t, uint32_t> RouteCallback;
+
+    /// one direction of a link
+    struct Adjacency
+    {
+        uint32_t nbr;     //!< the node at the other end
+        uint32_t ifIndex; //!< the device of this node
+        uint32_t nbrIf;   //!< the device of the neighbor
+        bool up;
+        uint64_t delay;   //!< propagation delay, in time steps
+        uint64_t bw;      //!< bit/s of the device
+    };
+
+    RouteCalculator();
+
+    /**
+     * \param nodes the nodes; SwitchNodes and hosts, which must have their
+     *        RdmaDriver by the time routes are installed
+     * \param addresses the address of each host, by node index
+     */
+    void SetNodes(const NodeContainer& nodes, const std::vector<Ipv4Address>& addresses);
+    /**
+     * Add one direction of a link, a later call for the same pair replaces it
+     */
+    void AddInterface(uint32_t node, uint32_t nbr, uint32_t ifIndex, uint64_t delay, uint64_t bw);
+    /**
+     * The host of node index i has address base + (i << shift), which lets
+     * the tables keep the routes to hosts as runs of node indices, see
+     * EcmpTable. Without it all destinations are hashed.
+     */
+    void SetHostAddressing(uint32_t base, uint32_t shift);
+    void SetThreads(uint32_t threads);         //!< 0 for the number of hardware threads
+    void SetPayloadSize(uint32_t payloadSize); //!< of the packets in GetTxDelay
+
+    /**
+     * Take a link down or up again, both directions
+     * \return false if the link does not exist or already was in that state
+     */
+    bool SetLinkUp(uint32_t a, uint32_t b, bool up);
+    /**
+     * \return the device of a towards b, or -1 if they are not linked
+     */
+    int32_t GetInterface(uint32_t a, uint32_t b);
+    /**
+     * \return [begin, end) of the adjacency of node, neighbors in index order
+     */
+    std::pair<const Adjacency*, const Adjacency*> GetAdjacency(uint32_t node);
+
+    /**
+     * Run the BFS from every host, hand every route to cb and update the
+     * host pair delays
+     */
+    void ComputeRoutes(RouteCallback cb);
+    /**
+     * Give all switches and hosts a new empty table, sharing one new
+     * EcmpGroupPool, and ComputeRoutes into them
+     */
+    void InstallRoutes();
+    /**
+     * Clear the tables of all switches and hosts
+     */
+    void ClearRoutes();
+
+    // from host src to host dst, 0 if unreachable, by node index
+    uint64_t GetDelay(uint32_t src, uint32_t dst) const;
+    uint64_t GetTxDelay(uint32_t src, uint32_t dst) const;
+    uint64_t GetBw(uint32_t src, uint32_t dst) const;
+
+  private:
+    /// what the BFS from one host found
+    struct HostRoutes
+    {
+        std::vector<std::pair<uint32_t, uint32_t>> routes; //!< (node, ifIndex) in BFS order
+    };
+
+    /// per-thread BFS state, indexed by node
+    struct Scratch
+    {
+        std::vector<int32_t> dis;
+        std::vector<uint64_t> delay;
+        std::vector<uint64_t> txDelay;
+        std::vector<uint64_t> bw;
+        std::vector<uint32_t> queue;
+        std::vector<uint32_t> visited;
+    };
+
+    void BuildCsr();                                         //!< from m_links when changed
+    Adjacency* Find(uint32_t a, uint32_t b);                 //!< a towards b in the CSR, or null
+    void Bfs(uint32_t hostIdx, Scratch& s, HostRoutes& out); //!< from the host m_hosts[hostIdx]
+    uint8_t RateIndex(uint64_t bw) const;
+    void FindTables(); //!< the RdmaHw of each host
+    void AddTableEntry(uint32_t node, uint32_t dst, uint32_t ifIndex);
+
+    NodeContainer m_nodes;
+    std::vector<Ipv4Address> m_addresses;
+    std::vector<bool> m_isSwitch;
+    std::vector<Ptr<SwitchNode>> m_switches; //!< by node, null for hosts
+    std::vector<Ptr<RdmaHw>> m_rdma;         //!< by node, null for switches
+    std::vector<uint32_t> m_hosts;           //!< node of each host
+    std::vector<int32_t> m_hostIdx;          //!< host index of each node, -1 for switches
+    bool m_hostLayout;                       //!< SetHostAddressing was called
+    uint32_t m_hostBase;
+    uint32_t m_hostShift;
+
+    std::vector<std::pair<uint64_t, Adjacency>> m_links; //!< (node << 32 | nbr, link) as added
+    bool m_csrValid;
+    std::vector<uint32_t> m_adjStart; //!< adjacency of node i is [m_adjStart[i], m_adjStart[i + 1])
+    std::vector<Adjacency> m_adj;
+
+    uint32_t m_threads;
+    uint32_t m_payloadSize;
+
+    // host pairs, [dst * hosts + src], the rate as an index into m_rates
+    std::vector<uint32_t> m_pairDelay;
+    std::vector<uint32_t> m_pairTxDelay;
+    std::vector<uint8_t> m_pairRate;
+    std::vector<uint64_t> m_rates; //!< 0 for unreachable, then every link rate, then ~0 for src == dst
+};
+
+} // namespace ns3
+
+#endif /* ROUTE_CALCULATOR_H */
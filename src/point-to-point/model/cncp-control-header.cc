@@ -181,4 +181,124 @@ CncpControlHeader::Deserialize (Buffer::Iterator start)
   return GetSerializedSize ();
 }
 
+NS_OBJECT_ENSURE_REGISTERED (CncpBatchReportHeader);
+
+CncpBatchReportHeader::CncpBatchReportHeader ()
+{
+}
+
+CncpBatchReportHeader::~CncpBatchReportHeader ()
+{
+}
+
+void
+CncpBatchReportHeader::AddReport (const FlowKey &key, uint64_t flowInfo)
+{
+  NS_ASSERT (m_keys.size () < maxReports);
+  m_keys.push_back (key);
+  m_flow_info.push_back (flowInfo);
+}
+
+void
+CncpBatchReportHeader::Clear (void)
+{
+  m_keys.clear ();
+  m_flow_info.clear ();
+}
+
+uint32_t
+CncpBatchReportHeader::GetNReports (void) const
+{
+  return m_keys.size ();
+}
+
+bool
+CncpBatchReportHeader::IsFull (void) const
+{
+  return m_keys.size () >= maxReports;
+}
+
+const FlowKey &
+CncpBatchReportHeader::GetFlowKey (uint32_t i) const
+{
+  return m_keys[i];
+}
+
+uint64_t
+CncpBatchReportHeader::GetFlowInfo (uint32_t i) const
+{
+  return m_flow_info[i];
+}
+
+TypeId
+CncpBatchReportHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::CncpBatchReportHeader")
+    .SetParent<Header> ()
+    .AddConstructor<CncpBatchReportHeader> ()
+    ;
+  return tid;
+}
+
+TypeId
+CncpBatchReportHeader::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+void
+CncpBatchReportHeader::Print (std::ostream &os) const
+{
+  os << "reports=" << m_keys.size ();
+  for (uint32_t i = 0; i < m_keys.size (); i++)
+    {
+      os << " (sip=" << m_keys[i].sip
+         << ", dip=" << m_keys[i].dip
+         << ", sport=" << m_keys[i].sport
+         << ", dport=" << m_keys[i].dport
+         << ", flow_info=" << m_flow_info[i] << ")";
+    }
+}
+
+uint32_t
+CncpBatchReportHeader::GetSerializedSize (void) const
+{
+  return 2 + entrySize * m_keys.size (); // 2 bytes for the count, then the entries as in CncpControlHeader
+}
+
+void
+CncpBatchReportHeader::Serialize (Buffer::Iterator start) const
+{
+  start.WriteU16 (m_keys.size ());
+  for (uint32_t i = 0; i < m_keys.size (); i++)
+    {
+      start.WriteU32 (m_keys[i].sip);
+      start.WriteU32 (m_keys[i].dip);
+      start.WriteU16 (m_keys[i].sport);
+      start.WriteU16 (m_keys[i].dport);
+      start.WriteU8 (m_keys[i].protocol);
+      start.WriteU8 (m_keys[i].priority_group);
+      start.WriteU64 (m_flow_info[i]);
+    }
+}
+
+uint32_t
+CncpBatchReportHeader::Deserialize (Buffer::Iterator start)
+{
+  uint16_t n = start.ReadU16 ();
+  m_keys.resize (n);
+  m_flow_info.resize (n);
+  for (uint32_t i = 0; i < n; i++)
+    {
+      m_keys[i].sip = start.ReadU32 ();
+      m_keys[i].dip = start.ReadU32 ();
+      m_keys[i].sport = start.ReadU16 ();
+      m_keys[i].dport = start.ReadU16 ();
+      m_keys[i].protocol = start.ReadU8 ();
+      m_keys[i].priority_group = start.ReadU8 ();
+      m_flow_info[i] = start.ReadU64 ();
+    }
+  return GetSerializedSize ();
+}
+
 } // namespace ns3
@@ -22,9 +22,11 @@
 #define CNCP_CONTROL_HEADER_H
 
 #include "ns3/buffer.h"
+#include "ns3/cncp-flowkey.h"
 #include "ns3/header.h"
 
 #include <stdint.h>
+#include <vector>
 
 namespace ns3
 {
@@ -78,6 +80,46 @@ class CncpControlHeader : public Header
     uint64_t m_flow_info;
 };
 
+/**
+ * \ingroup Cncp
+ * \brief Header for a batched CNCP report (protocol 0xFA)
+ *
+ * Carries a count followed by (flow id, flow information) entries, each laid
+ * out as in CncpControlHeader, so one control packet reports the flows a
+ * switch shares with the same upstream port. An IPv4 packet of at most mtu
+ * bytes holds up to maxReports entries.
+ */
+
+class CncpBatchReportHeader : public Header
+{
+  public:
+    CncpBatchReportHeader();
+    virtual ~CncpBatchReportHeader();
+
+    void AddReport(const FlowKey& key, uint64_t flowInfo);
+    void Clear(void);
+
+    uint32_t GetNReports(void) const;
+    bool IsFull(void) const; //!< the next entry would exceed maxReports
+    const FlowKey& GetFlowKey(uint32_t i) const;
+    uint64_t GetFlowInfo(uint32_t i) const;
+
+    static TypeId GetTypeId(void);
+    virtual TypeId GetInstanceTypeId(void) const;
+    virtual void Print(std::ostream& os) const;
+    virtual uint32_t GetSerializedSize(void) const;
+    virtual void Serialize(Buffer::Iterator start) const;
+    virtual uint32_t Deserialize(Buffer::Iterator start);
+
+    static const uint32_t entrySize = 22;  //!< bytes of an entry
+    static const uint32_t mtu = 1500;      //!< bytes of the IPv4 packet, headers included
+    static const uint32_t maxReports = (mtu - 20 - 2) / entrySize; //!< less the IPv4 header and count
+
+  private:
+    std::vector<FlowKey> m_keys;
+    std::vector<uint64_t> m_flow_info;
+};
+
 }; // namespace ns3
 
 #endif /* CNCP_CONTROL_HEADER */
@@ -0,0 +1,221 @@
+#include "cncp-flow-table.h"
+
+#include "ns3/assert.h"
+
+namespace ns3
+{
+
+CncpFlowTable::CncpFlowTable(uint32_t capacity)
+    : m_size(0)
+{
+    uint32_t n = 16;
+    while (n < capacity)
+    {
+        n <<= 1;
+    }
+    m_slots.assign(n, CncpFlowEntry());
+    m_mask = n - 1;
+}
+
+uint64_t
+CncpFlowTable::Hash(const FlowKey& key)
+{
+    // fold the five-tuple and pg into 64 bits, then apply the murmur3 finalizer
+    uint64_t h = ((uint64_t)key.sip << 32) | key.dip;
+    h ^= (((uint64_t)key.sport << 32) | ((uint64_t)key.dport << 16) |
+          ((uint64_t)key.protocol << 8) | key.priority_group) *
+         0x9e3779b97f4a7c15ULL;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+uint32_t
+CncpFlowTable::FindSlot(const FlowKey& key) const
+{
+    uint32_t i = Hash(key) & m_mask;
+    while (m_slots[i].used && !(m_slots[i].key == key))
+    {
+        i = (i + 1) & m_mask;
+    }
+    return i;
+}
+
+CncpFlowEntry*
+CncpFlowTable::Find(const FlowKey& key)
+{
+    uint32_t i = FindSlot(key);
+    return m_slots[i].used ? &m_slots[i] : nullptr;
+}
+
+CncpFlowEntry*
+CncpFlowTable::Insert(const FlowKey& key, bool& inserted)
+{
+    uint32_t i = FindSlot(key);
+    if (m_slots[i].used)
+    {
+        inserted = false;
+        return &m_slots[i];
+    }
+    // keep the load factor at most 1/2 so probe sequences stay short
+    if ((m_size + 1) * 2 > m_slots.size())
+    {
+        Grow();
+        i = FindSlot(key);
+    }
+    CncpFlowEntry& e = m_slots[i];
+    e = CncpFlowEntry();
+    e.key = key;
+    e.used = 1;
+    m_size++;
+    inserted = true;
+    return &e;
+}
+
+bool
+CncpFlowTable::Erase(const FlowKey& key)
+{
+    uint32_t i = FindSlot(key);
+    if (!m_slots[i].used)
+    {
+        return false;
+    }
+    // backward-shift deletion: pull up every following entry whose home slot
+    // is not in (i, j], so no probe sequence is broken by the hole at i
+    uint32_t j = i;
+    while (true)
+    {
+        j = (j + 1) & m_mask;
+        if (!m_slots[j].used)
+        {
+            break;
+        }
+        uint32_t k = Hash(m_slots[j].key) & m_mask;
+        bool stays = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);
+        if (!stays)
+        {
+            m_slots[i] = m_slots[j];
+            i = j;
+        }
+    }
+    m_slots[i].used = 0;
+    m_size--;
+    return true;
+}
+
+void
+CncpFlowTable::Clear()
+{
+    for (auto& e : m_slots)
+    {
+        e.used = 0;
+    }
+    m_size = 0;
+}
+
+uint32_t
+CncpFlowTable::GetN() const
+{
+    return m_size;
+}
+
+uint32_t
+CncpFlowTable::GetCapacity() const
+{
+    return m_slots.size();
+}
+
+CncpFlowEntry&
+CncpFlowTable::GetSlot(uint32_t i)
+{
+    NS_ASSERT(i < m_slots.size());
+    return m_slots[i];
+}
+
+void
+CncpFlowTable::Grow()
+{
+    std::vector<CncpFlowEntry> old;
+    old.swap(m_slots);
+    m_slots.assign(old.size() * 2, CncpFlowEntry());
+    m_mask = m_slots.size() - 1;
+    for (auto& e : old)
+    {
+        if (e.used)
+        {
+            m_slots[FindSlot(e.key)] = e;
+        }
+    }
+}
+
+CncpPortShare::CncpPortShare()
+    : m_nFlows(0),
+      m_epoch(0),
+      m_fairShare(0),
+      m_bonus(0)
+{
+}
+
+void
+CncpPortShare::Sync(CncpFlowEntry& flow) const
+{
+    if (flow.epoch != m_epoch)
+    {
+        Resync(flow);
+    }
+}
+
+bool
+CncpPortShare::Join(CncpFlowEntry& flow, uint64_t rate)
+{
+    m_nFlows++;
+    m_epoch++;
+    m_fairShare = rate / m_nFlows;
+    m_bonus = 0;
+    Resync(flow);
+    return m_epoch == 0;
+}
+
+void
+CncpPortShare::Resync(CncpFlowEntry& flow) const
+{
+    flow.epoch = m_epoch;
+    flow.rateBase = m_fairShare;
+}
+
+void
+CncpPortShare::Leave(CncpFlowEntry& flow)
+{
+    NS_ASSERT(m_nFlows > 0);
+    uint64_t rate = GetRate(flow);
+    m_nFlows--;
+    if (m_nFlows > 0)
+    {
+        m_bonus += rate / m_nFlows;
+    }
+}
+
+uint64_t
+CncpPortShare::GetRate(CncpFlowEntry& flow) const
+{
+    Sync(flow);
+    return flow.rateBase + m_bonus;
+}
+
+void
+CncpPortShare::SetRate(CncpFlowEntry& flow, uint64_t rate) const
+{
+    Sync(flow);
+    flow.rateBase = rate - m_bonus;
+}
+
+uint32_t
+CncpPortShare::GetN() const
+{
+    return m_nFlows;
+}
+
+} // namespace ns3
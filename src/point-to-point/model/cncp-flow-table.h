@@ -0,0 +1,114 @@
+#ifndef CNCP_FLOW_TABLE_H
+#define CNCP_FLOW_TABLE_H
+
+#include "ns3/cncp-flowkey.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief Per-flow CNCP state kept by a SwitchNode.
+ *
+ * All state touched on the per-packet path lives in one 64-byte record so that
+ * CNCPNotifyIngress/CNCPAdmitIngress cost one cache line per packet.
+ */
+struct alignas(64) CncpFlowEntry
+{
+    FlowKey key;
+    uint16_t egressDevIdx;  // used for initializing flow rate
+    uint16_t prevHopDevIdx; // used for sending CNCP report to previous hop device
+    uint32_t qv;            // Q_v reported by the next hop, used for CNCP update
+    int32_t bytesOnNode;    // Q_u, bytes of this flow buffered on the node
+    uint8_t used;           // slot is occupied
+    uint16_t epoch;         // CncpPortShare epoch rateBase belongs to
+    uint64_t rateBase;      // flow rate in bits per second, read it through CncpPortShare
+    uint64_t ingressWindow; // bytes allowed to enter before the next refill
+    uint64_t lastIngressPktTs;
+    uint64_t lastArrivalPktTs;
+};
+
+static_assert(sizeof(CncpFlowEntry) == 64, "CncpFlowEntry should fit in one cache line");
+
+/**
+ * \brief Fair share of the CNCP flows leaving one egress port.
+ *
+ * A new flow resets every flow on the port to rate / nFlows, and an expiring
+ * flow's rate is split among the remaining flows of its port. Both are done
+ * lazily: Join bumps the epoch and Leave adds to a per-port bonus, and a flow
+ * picks them up the next time GetRate or SetRate touches it. rateBase is kept
+ * relative to the bonus (modulo 2^64), so the bonus costs no per-flow field.
+ * The 16-bit epoch wraps every 65536 joins, after which a flow that was not
+ * read since would take its stale rate for current, so the owner of the port
+ * Resyncs every flow on it when Join reports a wrap.
+ */
+class CncpPortShare
+{
+  public:
+    CncpPortShare();
+
+    /**
+     * add flow to the port and reset every flow on it to rate / GetN()
+     * \return true if the epoch wrapped, then Resync every other flow on the port
+     */
+    bool Join(CncpFlowEntry& flow, uint64_t rate);
+    /// bring flow to the current epoch, whatever epoch it holds
+    void Resync(CncpFlowEntry& flow) const;
+    /// remove flow from the port and split its rate among the remaining flows
+    void Leave(CncpFlowEntry& flow);
+
+    uint64_t GetRate(CncpFlowEntry& flow) const;
+    void SetRate(CncpFlowEntry& flow, uint64_t rate) const;
+    uint32_t GetN() const;
+
+  private:
+    void Sync(CncpFlowEntry& flow) const;
+
+    uint32_t m_nFlows;
+    uint16_t m_epoch;
+    uint64_t m_fairShare; // rate of every flow at the start of the epoch
+    uint64_t m_bonus;     // rate added to every flow since the start of the epoch
+};
+
+/**
+ * \brief Open-addressing hash table of CncpFlowEntry keyed by FlowKey.
+ *
+ * Linear probing over a power-of-two array with backward-shift deletion, so
+ * there are no tombstones. Entry pointers stay valid until the next Insert or
+ * Erase on the table.
+ */
+class CncpFlowTable
+{
+  public:
+    CncpFlowTable(uint32_t capacity = 64);
+
+    /// \return the entry of key, or nullptr if the flow is not in the table
+    CncpFlowEntry* Find(const FlowKey& key);
+    /// \return the entry of key, zero-initialized and marked inserted if it was absent
+    CncpFlowEntry* Insert(const FlowKey& key, bool& inserted);
+    /// remove the entry of key, \return false if it was not in the table
+    bool Erase(const FlowKey& key);
+    void Clear();
+
+    uint32_t GetN() const;
+
+    // raw slot access for walking all flows, skip slots with used == 0
+    uint32_t GetCapacity() const;
+    CncpFlowEntry& GetSlot(uint32_t i);
+
+    static uint64_t Hash(const FlowKey& key);
+
+  private:
+    uint32_t FindSlot(const FlowKey& key) const;
+    void Grow();
+
+    std::vector<CncpFlowEntry> m_slots;
+    uint32_t m_mask;
+    uint32_t m_size;
+};
+
+} // namespace ns3
+
+#endif /* CNCP_FLOW_TABLE_H */
@@ -0,0 +1,105 @@
+#include "cncp-timer-wheel.h"
+
+namespace ns3
+{
+
+CncpTimerWheel::CncpTimerWheel()
+    : m_now(0),
+      m_size(0)
+{
+}
+
+void
+CncpTimerWheel::File(const Timer& t)
+{
+    uint64_t delta = t.deadline > m_now ? t.deadline - m_now : 1;
+    uint32_t level = 0;
+    while (level + 1 < kLevels && delta >= (1ULL << (kSlotBits * (level + 1))))
+    {
+        level++;
+    }
+    uint64_t deadline = t.deadline > m_now ? t.deadline : m_now + 1;
+    if (level + 1 == kLevels && delta >= (1ULL << (kSlotBits * kLevels)))
+    {
+        // beyond the top level, park it in the farthest slot and re-file on cascade
+        deadline = m_now + (1ULL << (kSlotBits * kLevels)) - 1;
+    }
+    uint32_t slot = (deadline >> (kSlotBits * level)) & (kSlots - 1);
+    m_slots[level][slot].push_back(t);
+}
+
+void
+CncpTimerWheel::Schedule(const FlowKey& key, uint64_t deadline)
+{
+    Timer t;
+    t.key = key;
+    t.deadline = deadline;
+    File(t);
+    m_size++;
+}
+
+void
+CncpTimerWheel::Advance(uint64_t now, std::vector<FlowKey>& expired)
+{
+    while (m_now < now)
+    {
+        m_now++;
+        // cascade the higher level slots that the wheel just entered
+        for (uint32_t level = 1; level < kLevels; level++)
+        {
+            if ((m_now & ((1ULL << (kSlotBits * level)) - 1)) != 0)
+            {
+                break;
+            }
+            uint32_t slot = (m_now >> (kSlotBits * level)) & (kSlots - 1);
+            std::vector<Timer> pending;
+            pending.swap(m_slots[level][slot]);
+            for (const Timer& t : pending)
+            {
+                if (t.deadline <= m_now)
+                {
+                    expired.push_back(t.key);
+                    m_size--;
+                }
+                else
+                {
+                    File(t);
+                }
+            }
+        }
+        std::vector<Timer>& due = m_slots[0][m_now & (kSlots - 1)];
+        for (const Timer& t : due)
+        {
+            expired.push_back(t.key);
+        }
+        m_size -= due.size();
+        due.clear();
+    }
+}
+
+void
+CncpTimerWheel::Clear()
+{
+    for (uint32_t level = 0; level < kLevels; level++)
+    {
+        for (uint32_t slot = 0; slot < kSlots; slot++)
+        {
+            m_slots[level][slot].clear();
+        }
+    }
+    m_size = 0;
+}
+
+uint64_t
+CncpTimerWheel::GetNow() const
+{
+    return m_now;
+}
+
+uint32_t
+CncpTimerWheel::GetN() const
+{
+    return m_size;
+}
+
+} // namespace ns3
@@ -0,0 +1,55 @@
+#ifndef CNCP_TIMER_WHEEL_H
+#define CNCP_TIMER_WHEEL_H
+
+#include "ns3/cncp-flowkey.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief Hierarchical timing wheel of FlowKey timers, in units of ticks.
+ *
+ * Level l has 64 slots of 64^l ticks each. A timer is filed in the lowest
+ * level whose span covers its distance from the current tick and cascades
+ * down as the wheel turns, so Schedule and Advance are O(1) per timer.
+ * Timers further out than the top level are clamped to it and re-filed
+ * when they cascade.
+ */
+class CncpTimerWheel
+{
+  public:
+    CncpTimerWheel();
+
+    /// file a timer for key that fires at tick deadline (fires on the next tick if already due)
+    void Schedule(const FlowKey& key, uint64_t deadline);
+    /// turn the wheel up to tick now, appending the keys of every timer that fired to expired
+    void Advance(uint64_t now, std::vector<FlowKey>& expired);
+    void Clear();
+
+    uint64_t GetNow() const;
+    uint32_t GetN() const;
+
+  private:
+    static const uint32_t kLevels = 4;
+    static const uint32_t kSlotBits = 6;
+    static const uint32_t kSlots = 1 << kSlotBits;
+
+    struct Timer
+    {
+        FlowKey key;
+        uint64_t deadline;
+    };
+
+    void File(const Timer& t);
+
+    std::vector<Timer> m_slots[kLevels][kSlots];
+    uint64_t m_now;
+    uint32_t m_size;
+};
+
+} // namespace ns3
+
+#endif /* CNCP_TIMER_WHEEL_H */
@@ -0,0 +1,164 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+#include "cncp-update.h"
+
+#include "ns3/assert.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ns3
+{
+
+static const uint32_t tableBits = 10;
+
+/// log2(1 + x) and 2^x in Q16, at the middle of each 1/1024 of [0, 1)
+struct CncpUpdateTables
+{
+    CncpUpdateTables()
+    {
+        for (uint32_t i = 0; i < (1U << tableBits); i++)
+        {
+            double x = (i + 0.5) / (1 << tableBits);
+            log2[i] = std::llround(std::log2(1 + x) * 65536);
+            exp2[i] = std::llround(std::exp2(x) * 65536);
+        }
+    }
+
+    int64_t log2[1 << tableBits];
+    int64_t exp2[1 << tableBits];
+};
+
+static const CncpUpdateTables tables;
+
+/// log2 x in Q16, x > 0
+static inline int64_t
+Log2Q16(uint64_t x)
+{
+    int e = 63 - __builtin_clzll(x);
+    uint64_t mantissa = (x << (63 - e)) >> (63 - tableBits) & ((1U << tableBits) - 1);
+    return ((int64_t)e << 16) + tables.log2[mantissa];
+}
+
+CncpUpdateKernel::CncpUpdateKernel()
+{
+    std::array<double, pgCnt> ones;
+    ones.fill(1);
+    Configure(1500, 100000000000, 1000, 1.1, Log, 1, 1000000000, ones);
+}
+
+void
+CncpUpdateKernel::Configure(uint64_t gamma,
+                            uint64_t lambda,
+                            uint64_t reportInterval,
+                            double queueWeight,
+                            Utility utility,
+                            double alpha,
+                            uint64_t refRate,
+                            const std::array<double, pgCnt>& pgWeights)
+{
+    NS_ASSERT(reportInterval > 0 && refRate > 0 && alpha > 0 && queueWeight >= 0);
+    m_utility = utility;
+    m_gamma = gamma;
+    m_tg = 8 * gamma / reportInterval;
+    m_queueWeight = queueWeight;
+    m_alpha = alpha;
+    m_refRate = refRate;
+    m_gammaInt = gamma;
+    m_linear = gamma * (8 * gamma / reportInterval);
+    m_queue = std::llround(m_linear * queueWeight * 65536);
+    for (uint32_t i = 0; i < pgCnt; i++)
+    {
+        NS_ASSERT(pgWeights[i] >= 0);
+        m_lambda[i] = std::llround(lambda * pgWeights[i]);
+        double scale = gamma * (double)m_lambda[i] / refRate * 65536;
+        // (r / f)^alpha is at most 2^31, times the Q16 of 2^x below 2^17
+        NS_ASSERT_MSG(utility != AlphaFair || scale < std::exp2(46),
+                      "CNCP gamma * lambda / r is too large");
+        m_utilityScale[i] = std::min(std::llround(scale), 1LL << 46);
+    }
+    m_alpha16 = std::llround(alpha * 65536);
+    m_log2Ref = Log2Q16(refRate);
+}
+
+uint64_t
+CncpUpdateKernel::NextRateDouble(uint64_t f,
+                                 uint64_t qv,
+                                 uint64_t pe,
+                                 uint64_t qu,
+                                 uint32_t pg) const
+{
+    uint64_t x = f > 0 ? f : 1; // avoid division by zero
+    double uPrime;
+    if (m_utility == Log)
+    {
+        uPrime = m_lambda[pg] / x;
+    }
+    else
+    {
+        uPrime = m_lambda[pg] / m_refRate * std::pow(m_refRate / x, m_alpha);
+    }
+    double result = f + m_gamma * (qv * m_tg + uPrime - m_queueWeight * pe * m_tg - qu * m_tg);
+    return result > 0 ? static_cast<uint64_t>(result) : 0;
+}
+
+inline int64_t
+CncpUpdateKernel::Linear(uint64_t f, uint64_t qv, uint64_t pe, uint64_t qu) const
+{
+    return (int64_t)f + m_linear * ((int64_t)qv - (int64_t)qu) - ((m_queue * (int64_t)pe) >> 16);
+}
+
+inline int64_t
+CncpUpdateKernel::LogUtility(uint64_t f, uint32_t pg) const
+{
+    return m_gammaInt * (int64_t)(m_lambda[pg] / (f | (f == 0))); // f of 0 counts as 1
+}
+
+inline int64_t
+CncpUpdateKernel::AlphaUtility(uint64_t f, uint32_t pg) const
+{
+    // 2^d = (r / f)^alpha, d in Q16 is split into whole and fractional bits
+    int64_t d = (m_alpha16 * (m_log2Ref - Log2Q16(f | (f == 0)))) >> 16;
+    int64_t whole = std::clamp<int64_t>(d >> 16, -31, 31);
+    uint64_t exp2 = tables.exp2[(d & 0xffff) >> (16 - tableBits)];
+    return (m_utilityScale[pg] * exp2) >> (32 - whole);
+}
+
+uint64_t
+CncpUpdateKernel::NextRate(uint64_t f, uint64_t qv, uint64_t pe, uint64_t qu, uint32_t pg) const
+{
+    NS_ASSERT(pg < pgCnt);
+    int64_t u = m_utility == Log ? LogUtility(f, pg) : AlphaUtility(f, pg);
+    return std::max<int64_t>(Linear(f, qv, pe, qu) + u, 0);
+}
+
+void
+CncpUpdateKernel::NextRates(uint32_t n,
+                            uint64_t* rate,
+                            const uint32_t* qv,
+                            const uint32_t* pe,
+                            const uint32_t* qu,
+                            const uint8_t* pg,
+                            const uint64_t* cap) const
+{
+    // one loop per utility, so that neither branches on it per flow
+    if (m_utility == Log)
+    {
+        for (uint32_t i = 0; i < n; i++)
+        {
+            int64_t next = Linear(rate[i], qv[i], pe[i], qu[i]) + LogUtility(rate[i], pg[i]);
+            rate[i] = std::min<uint64_t>(std::max<int64_t>(next, 0), cap[i]);
+        }
+    }
+    else
+    {
+        for (uint32_t i = 0; i < n; i++)
+        {
+            int64_t next = Linear(rate[i], qv[i], pe[i], qu[i]) + AlphaUtility(rate[i], pg[i]);
+            rate[i] = std::min<uint64_t>(std::max<int64_t>(next, 0), cap[i]);
+        }
+    }
+}
+
+} // namespace ns3
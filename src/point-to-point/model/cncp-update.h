@@ -0,0 +1,113 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+#ifndef CNCP_UPDATE_H
+#define CNCP_UPDATE_H
+
+#include <array>
+#include <cstdint>
+
+namespace ns3
+{
+
+/**
+ * \brief The iterative CNCP rate update of a SwitchNode.
+ *
+ * One iteration moves the rate f of a flow, in bits per second, to
+ *
+ *   f + gamma * (tg * q_v + U'(f) - w * tg * p_e - tg * q_u)
+ *
+ * clamped to [0, egress rate], where q_v is the Q_u reported by the next hop,
+ * q_u the bytes of the flow buffered on this switch, p_e the queue of its
+ * priority group at its egress port, w the queue weight and
+ * tg = 8 * gamma / report interval, an integer as it has always been.
+ * The derivative U' of the utility of the flow is one of
+ * - Log, lambda_pg / f, in integer division as it has always been: the
+ *   rates converge to a proportionally fair share;
+ * - AlphaFair, lambda_pg / r * (r / f)^alpha for the reference rate r, which
+ *   is Log at alpha 1, max-min fairness as alpha grows;
+ * where lambda_pg is lambda times the weight of the priority group of the
+ * flow, so groups of a larger weight get a larger share.
+ *
+ * NextRateDouble is the reference, computed in double as SwitchNode always
+ * did. NextRate and NextRates compute it in 64-bit integers: w * gamma * tg
+ * and lambda_pg * gamma / r are scaled by 2^16 once in Configure, and
+ * (r / f)^alpha is evaluated as 2^(alpha * (log2 r - log2 f)) with a
+ * 1024-entry table for log2 and one for 2^x. The Log update is exact when
+ * gamma * tg * w is a whole number, as with the default parameters, and off
+ * by less than p_e / 65536 bits per second otherwise; gamma * U' of AlphaFair
+ * is within about alpha / 1000 of its value in double. NextRates updates the
+ * rates of a whole batch of flows held in arrays, a loop without calls or
+ * data-dependent branches.
+ */
+class CncpUpdateKernel
+{
+  public:
+    enum Utility
+    {
+        Log,
+        AlphaFair,
+    };
+
+    static const uint32_t pgCnt = 8; //!< priority groups, as SwitchMmu::qCnt
+
+    CncpUpdateKernel();
+
+    /**
+     * \param gamma the step size
+     * \param lambda the weight of the utility
+     * \param reportInterval between two reports of a flow, in ns
+     * \param queueWeight w, the weight of the egress queue
+     * \param utility U
+     * \param alpha of AlphaFair
+     * \param refRate r of AlphaFair, in bits per second
+     * \param pgWeights the weight of lambda for each priority group
+     */
+    void Configure(uint64_t gamma,
+                   uint64_t lambda,
+                   uint64_t reportInterval,
+                   double queueWeight,
+                   Utility utility,
+                   double alpha,
+                   uint64_t refRate,
+                   const std::array<double, pgCnt>& pgWeights);
+
+    /// the reference update, in double
+    uint64_t NextRateDouble(uint64_t f, uint64_t qv, uint64_t pe, uint64_t qu, uint32_t pg) const;
+    /// the update in fixed point, not clamped to the egress rate
+    uint64_t NextRate(uint64_t f, uint64_t qv, uint64_t pe, uint64_t qu, uint32_t pg) const;
+    /**
+     * Update rate[i] of n flows in fixed point, each clamped to cap[i]
+     */
+    void NextRates(uint32_t n,
+                   uint64_t* rate,
+                   const uint32_t* qv,
+                   const uint32_t* pe,
+                   const uint32_t* qu,
+                   const uint8_t* pg,
+                   const uint64_t* cap) const;
+
+  private:
+    /// gamma * U'(f) of Log and AlphaFair, in fixed point
+    int64_t LogUtility(uint64_t f, uint32_t pg) const;
+    int64_t AlphaUtility(uint64_t f, uint32_t pg) const;
+    int64_t Linear(uint64_t f, uint64_t qv, uint64_t pe, uint64_t qu) const;
+
+    Utility m_utility;
+    double m_gamma;
+    double m_tg;
+    double m_queueWeight;
+    double m_alpha;
+    double m_refRate;
+    std::array<uint64_t, pgCnt> m_lambda;       //!< lambda_pg
+    int64_t m_gammaInt;                         //!< gamma
+    int64_t m_linear;                           //!< gamma * tg
+    int64_t m_queue;                            //!< gamma * tg * w, Q16
+    std::array<uint64_t, pgCnt> m_utilityScale; //!< gamma * lambda_pg / r, Q16
+    int64_t m_alpha16;                          //!< alpha, Q16
+    int64_t m_log2Ref;                          //!< log2 r, Q16
+};
+
+} // namespace ns3
+
+#endif /* CNCP_UPDATE_H */
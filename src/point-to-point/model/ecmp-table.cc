@@ -0,0 +1,226 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+#include "ecmp-table.h"
+
+#include "ns3/assert.h"
+
+#include <algorithm>
+
+namespace ns3
+{
+
+EcmpGroupPool::EcmpGroupPool()
+    : m_start{0, 0},
+      m_ids{{{}, 0}}
+{
+}
+
+uint32_t
+EcmpGroupPool::Extend(uint32_t group, uint32_t port)
+{
+    uint64_t key = (uint64_t)group << 32 | port;
+    auto it = m_extend.find(key);
+    if (it != m_extend.end())
+    {
+        return it->second;
+    }
+    std::vector<uint32_t> ports(m_ports.begin() + m_start[group],
+                                m_ports.begin() + m_start[group + 1]);
+    ports.push_back(port);
+    auto ins = m_ids.emplace(ports, m_start.size() - 1);
+    if (ins.second)
+    {
+        m_ports.insert(m_ports.end(), ports.begin(), ports.end());
+        m_start.push_back(m_ports.size());
+    }
+    m_extend[key] = ins.first->second;
+    return ins.first->second;
+}
+
+const uint32_t*
+EcmpGroupPool::GetPorts(uint32_t group, uint32_t& n) const
+{
+    n = m_start[group + 1] - m_start[group];
+    return m_ports.data() + m_start[group];
+}
+
+uint32_t
+EcmpGroupPool::GetNGroups() const
+{
+    return m_start.size() - 1;
+}
+
+EcmpTable::EcmpTable()
+    : EcmpTable(Create<EcmpGroupPool>())
+{
+}
+
+EcmpTable::EcmpTable(Ptr<EcmpGroupPool> groups)
+    : m_groups(groups),
+      m_hostLayout(false),
+      m_hostBase(0),
+      m_hostShift(0),
+      m_runEnd(0),
+      m_pending(false),
+      m_pendingId(0),
+      m_pendingGroup(0),
+      m_sparseOnly(false)
+{
+}
+
+EcmpTable::EcmpTable(Ptr<EcmpGroupPool> groups, uint32_t hostBase, uint32_t hostShift)
+    : EcmpTable(groups)
+{
+    NS_ASSERT(hostShift < 32);
+    m_hostLayout = true;
+    m_hostBase = hostBase;
+    m_hostShift = hostShift;
+}
+
+uint32_t
+EcmpTable::GetNGroups() const
+{
+    return m_groups->GetNGroups();
+}
+
+bool
+EcmpTable::GetHostId(uint32_t dip, uint32_t& id) const
+{
+    if (!m_hostLayout || m_sparseOnly)
+    {
+        return false;
+    }
+    uint32_t off = dip - m_hostBase;
+    if ((off & ((1u << m_hostShift) - 1)) != 0)
+    {
+        return false;
+    }
+    id = off >> m_hostShift;
+    return true;
+}
+
+void
+EcmpTable::Flush()
+{
+    if (!m_pending)
+    {
+        return;
+    }
+    m_pending = false;
+    if (m_pendingId > m_runEnd && (m_runGroup.empty() || m_runGroup.back() != 0))
+    {
+        // no route to the host ids in between
+        m_runStart.push_back(m_runEnd);
+        m_runGroup.push_back(0);
+    }
+    if (m_runGroup.empty() || m_runGroup.back() != m_pendingGroup)
+    {
+        m_runStart.push_back(m_pendingId);
+        m_runGroup.push_back(m_pendingGroup);
+    }
+    m_runEnd = m_pendingId + 1;
+}
+
+void
+EcmpTable::ToSparse()
+{
+    Flush();
+    for (size_t i = 0; i < m_runStart.size(); i++)
+    {
+        uint32_t end = i + 1 < m_runStart.size() ? m_runStart[i + 1] : m_runEnd;
+        if (m_runGroup[i] == 0)
+        {
+            continue;
+        }
+        for (uint32_t id = m_runStart[i]; id < end; id++)
+        {
+            m_sparse[m_hostBase + (id << m_hostShift)] = m_runGroup[i];
+        }
+    }
+    m_runStart.clear();
+    m_runGroup.clear();
+    m_runEnd = 0;
+    m_sparseOnly = true;
+}
+
+void
+EcmpTable::Add(uint32_t dip, uint32_t port)
+{
+    uint32_t id;
+    if (!GetHostId(dip, id))
+    {
+        uint32_t& g = m_sparse[dip];
+        g = m_groups->Extend(g, port);
+        return;
+    }
+    if (m_pending && id == m_pendingId)
+    {
+        m_pendingGroup = m_groups->Extend(m_pendingGroup, port);
+        return;
+    }
+    if ((m_pending && id < m_pendingId) || (!m_pending && id < m_runEnd))
+    {
+        ToSparse();
+        Add(dip, port);
+        return;
+    }
+    Flush();
+    m_pending = true;
+    m_pendingId = id;
+    m_pendingGroup = m_groups->Extend(0, port);
+}
+
+void
+EcmpTable::Clear()
+{
+    m_runStart.clear();
+    m_runGroup.clear();
+    m_runEnd = 0;
+    m_pending = false;
+    m_sparseOnly = false;
+    m_sparse.clear();
+}
+
+uint32_t
+EcmpTable::GetGroup(uint32_t dip) const
+{
+    uint32_t id;
+    if (!GetHostId(dip, id))
+    {
+        auto it = m_sparse.find(dip);
+        return it == m_sparse.end() ? 0 : it->second;
+    }
+    if (m_pending && id == m_pendingId)
+    {
+        return m_pendingGroup;
+    }
+    if (id >= m_runEnd)
+    {
+        return 0;
+    }
+    // the last run starting at or before id
+    auto it = std::upper_bound(m_runStart.begin(), m_runStart.end(), id);
+    return m_runGroup[it - m_runStart.begin() - 1];
+}
+
+const uint32_t*
+EcmpTable::Lookup(uint32_t dip, uint32_t& n) const
+{
+    return m_groups->GetPorts(GetGroup(dip), n);
+}
+
+uint32_t
+EcmpTable::GetNRuns() const
+{
+    uint32_t n = m_runStart.size();
+    if (m_pending)
+    {
+        // the runs Flush would add
+        bool gap = m_pendingId > m_runEnd && (m_runGroup.empty() || m_runGroup.back() != 0);
+        n += gap ? 2 : (m_runGroup.empty() || m_runGroup.back() != m_pendingGroup ? 1 : 0);
+    }
+    return n;
+}
+
+} // namespace ns3
@@ -0,0 +1,112 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+#ifndef ECMP_TABLE_H
+#define ECMP_TABLE_H
+
+#include "ns3/ptr.h"
+#include "ns3/simple-ref-count.h"
+
+#include <map>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief The next hop lists of the EcmpTables sharing it
+ *
+ * A group id names one contiguous list of ports, group 0 the empty one, and
+ * equal lists are the same group. The pool lives as long as the last table
+ * holding it.
+ */
+class EcmpGroupPool : public SimpleRefCount<EcmpGroupPool>
+{
+  public:
+    EcmpGroupPool();
+
+    uint32_t Extend(uint32_t group, uint32_t port); //!< the group of group + port
+    const uint32_t* GetPorts(uint32_t group, uint32_t& n) const;
+    uint32_t GetNGroups() const;
+
+  private:
+    std::vector<uint32_t> m_start; //!< ports of group g are [m_start[g], m_start[g + 1])
+    std::vector<uint32_t> m_ports;
+    std::map<std::vector<uint32_t>, uint32_t> m_ids;
+    std::unordered_map<uint64_t, uint32_t> m_extend; //!< group << 32 | port to the longer group
+};
+
+/**
+ * \brief Destination IP to ECMP next hops, for SwitchNode and RdmaHw
+ *
+ * The next hop lists are groups of an EcmpGroupPool, which tables built
+ * together share, so a table only stores group ids.
+ *
+ * A table may be given the address layout of the hosts, host id i having
+ * address hostBase + (i << hostShift), like node_id_to_ip of the scratch
+ * programs. Host ids are dense, and neighboring hosts usually share their
+ * next hops (a rack behind the same port, a pod behind the same uplinks), so
+ * these destinations are kept as runs of consecutive host ids with the same
+ * group. When the entries come in host id order, as RouteCalculator adds
+ * them, a fat-tree switch has a handful of runs and a host a couple,
+ * whatever the number of hosts. Other addresses, every address once entries
+ * came out of order, and all of them without a layout, are kept in a hash
+ * map.
+ */
+class EcmpTable
+{
+  public:
+    EcmpTable(); //!< no host layout, with a pool of its own
+    EcmpTable(Ptr<EcmpGroupPool> groups); //!< no host layout
+    /**
+     * \param groups the pool of the next hop lists
+     * \param hostBase the address of host id 0
+     * \param hostShift host id i has address hostBase + (i << hostShift)
+     */
+    EcmpTable(Ptr<EcmpGroupPool> groups, uint32_t hostBase, uint32_t hostShift);
+
+    /**
+     * Add a next hop towards dip, after the ones it already has
+     */
+    void Add(uint32_t dip, uint32_t port);
+    void Clear();
+    /**
+     * \param dip the destination
+     * \param n set to the number of next hops, 0 if there is no route
+     * \return the next hops
+     */
+    const uint32_t* Lookup(uint32_t dip, uint32_t& n) const;
+
+    uint32_t GetNRuns() const;   //!< runs of host destinations, for statistics
+    uint32_t GetNGroups() const; //!< groups in the pool of the table
+
+  private:
+    bool GetHostId(uint32_t dip, uint32_t& id) const; //!< false if dip is not a host address
+
+    uint32_t GetGroup(uint32_t dip) const;
+    void Flush(); //!< close the pending destination into the runs
+    void ToSparse(); //!< move the runs to m_sparse, for out of order entries
+
+    Ptr<EcmpGroupPool> m_groups;
+    bool m_hostLayout; //!< host addresses follow m_hostBase and m_hostShift
+    uint32_t m_hostBase;
+    uint32_t m_hostShift;
+
+    // runs [m_runStart[i], m_runStart[i + 1]) of host ids have group m_runGroup[i], the
+    // last run ends at m_runEnd
+    std::vector<uint32_t> m_runStart;
+    std::vector<uint32_t> m_runGroup;
+    uint32_t m_runEnd;
+    // the last destination added, which may get more next hops
+    bool m_pending;
+    uint32_t m_pendingId;
+    uint32_t m_pendingGroup;
+    bool m_sparseOnly; //!< entries came out of host id order
+    std::unordered_map<uint32_t, uint32_t> m_sparse; //!< dip to group
+};
+
+} // namespace ns3
+
+#endif /* ECMP_TABLE_H */
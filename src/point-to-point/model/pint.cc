@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <array>
 #include <cmath>
 #include <cstdlib>
 #include <cstdio>
@@ -6,12 +8,64 @@
 
 namespace ns3{
 
+/*
+ * log2(1 + i / 1024) and 2^(i / 1024) in Q30 for i in [0, 1024], built at
+ * compile time from the series of ln and exp, which std::log2 and std::exp2
+ * are not constexpr for
+ */
+static const int table_bits = 10;
+
+static constexpr double ln_1_2(double y){ // ln y for y in [1, 2]
+	double z = (y - 1) / (y + 1), z2 = z * z, term = z, sum = 0;
+	for (int k = 1; k < 60; k += 2){
+		sum += term / k;
+		term *= z2;
+	}
+	return 2 * sum;
+}
+
+static constexpr double exp_0_1(double x){ // e^x for x in [0, 1]
+	double term = 1, sum = 1;
+	for (int k = 1; k < 30; k++){
+		term *= x / k;
+		sum += term;
+	}
+	return sum;
+}
+
+static constexpr double ln2 = 0.693147180559945309417232121458176568;
+
+static constexpr std::array<uint32_t, (1 << table_bits) + 1> log2_table = []{
+	std::array<uint32_t, (1 << table_bits) + 1> t{};
+	for (int i = 0; i <= (1 << table_bits); i++)
+		t[i] = (uint32_t)(ln_1_2(1 + (double)i / (1 << table_bits)) / ln2 * (1 << 30) + 0.5);
+	return t;
+}();
+
+static constexpr std::array<uint32_t, (1 << table_bits) + 1> exp2_table = []{
+	std::array<uint32_t, (1 << table_bits) + 1> t{};
+	for (int i = 0; i <= (1 << table_bits); i++)
+		t[i] = (uint32_t)(exp_0_1((double)i / (1 << table_bits) * ln2) * (1 << 30) + 0.5);
+	return t;
+}();
+
+static std::vector<double> make_pow_table(double base){
+	std::vector<double> t(1, 1.0);
+	while (t.back() <= 4294967296.0)
+		t.push_back(pow(base, t.size()));
+	return t;
+}
+
 double Pint::log_base = 1.05;
 double Pint::log_factor = 1 / log(log_base);
+double Pint::log2_factor = 1 / log2(log_base);
+std::vector<double> Pint::pow_table = make_pow_table(log_base);
 
 void Pint::set_log_base(double base){
 	log_base = base;
 	log_factor = 1 / log(log_base);
+	log2_factor = 1 / log2(log_base);
+	pow_table = make_pow_table(log_base);
 }
 
 int Pint::get_n_bits(){
@@ -25,20 +79,96 @@ int Pint::get_n_bytes(){
 	return (n_bits - 1) / 8 + 1;
 }
 
-uint16_t Pint::encode_u(double u){
+uint16_t Pint::encode_u(double u, uint16_t rnd){
 	uint32_t u_toInt = ceil(u * max_concurrent); // convert u to int so that the minimum possible u value is mapped to 1
 	if (u_toInt == 0) u_toInt = 1;
-	double power = log(u_toInt) * log_factor;
-	uint16_t p_upper = ceil(power), p_lower = floor(power);
-	double upper = pow(log_base, p_upper), lower = pow(log_base, p_lower);
-	if (p_upper == p_lower)
-		upper *= log_base;
-	uint16_t p = (rand() % 65536 < (u_toInt - lower) / (upper - lower) * 65536) ? p_upper : p_lower;
-	return p;
+	// the largest p with log_base^p <= u_toInt, from an estimate of log2(u_toInt) / log2(log_base)
+	uint32_t p = log2_fixed(u_toInt, 16) * log2_factor / 65536;
+	if (p > pow_table.size() - 2)
+		p = pow_table.size() - 2;
+	while (p > 0 && pow_table[p] > u_toInt)
+		p--;
+	while (pow_table[p + 1] <= u_toInt)
+		p++;
+	double upper = pow_table[p + 1], lower = pow_table[p];
+	return (rnd < (u_toInt - lower) / (upper - lower) * 65536) ? p + 1 : p;
 }
 
 double Pint::decode_u(uint16_t p){
+	if (p < pow_table.size())
+		return pow_table[p] / max_concurrent;
 	return pow(log_base, p) / max_concurrent;
 }
 
+int Pint::log2_fixed(uint32_t x, int shift){
+	int e = 31 - __builtin_clz(x);
+	uint32_t n = x << (31 - e); // 1.xxx with the leading 1 at bit 31
+	uint32_t i = (n >> (31 - table_bits)) & ((1 << table_bits) - 1);
+	uint64_t rem = n & ((1U << (31 - table_bits)) - 1);
+	uint32_t frac = log2_table[i] + (((log2_table[i + 1] - log2_table[i]) * rem) >> (31 - table_bits));
+	return (e << shift) + (frac >> (30 - shift));
+}
+
+double Pint::exp2_fixed(int64_t y, int shift){
+	int64_t whole = y >> shift;
+	uint32_t frac = (uint64_t)(y & ((1LL << shift) - 1)) << (30 - shift); // Q30
+	uint32_t i = frac >> (30 - table_bits);
+	uint64_t rem = frac & ((1U << (30 - table_bits)) - 1);
+	uint32_t r = exp2_table[i] + (((exp2_table[i + 1] - exp2_table[i]) * rem) >> (30 - table_bits));
+	return ldexp((double)r, std::min<int64_t>(std::max<int64_t>(whole - 30, -2000), 2000));
+}
+
+PintRng::PintRng(uint64_t seed){
+	Seed(seed);
+}
+
+void PintRng::Seed(uint64_t seed){
+	// splitmix64, so that close seeds give unrelated streams, never 0
+	uint64_t z = seed + 0x9E3779B97F4A7C15ULL;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	s = (z ^ (z >> 31)) | 1;
+}
+
+PintEstimator::PintEstimator(){
+	Configure(9000, 12500000000);
+}
+
+void PintEstimator::Configure(uint64_t maxRtt, uint64_t bytesPerSecond){
+	double fct = 1 << shift;
+	m_maxRtt = maxRtt;
+	m_logT = llround(log2(maxRtt) * fct);
+	int64_t logB = llround(log2(bytesPerSecond) * fct);
+	int64_t log1e9 = llround(log2(1e9) * fct);
+	m_qConst = log1e9 - logB - 2 * m_logT + (8 << shift);
+	m_byteConst = log1e9 - logB - m_logT;
+	m_uConst = -m_logT - (13 << shift);
+}
+
+int64_t PintEstimator::Log2Apprx(int64_t x, PintRng &rng) const{
+	if (x <= 0)
+		return INT32_MIN; // as int(log2(0) * fct) was, 2^ of which is 0
+	uint32_t x0 = x;
+	int msb = 32 - __builtin_clz(x0);
+	uint32_t v = x0;
+	if (msb > m){
+		v = x0 >> (msb - m) << (msb - m);
+		uint32_t mask = (1U << (msb - m)) - 1;
+		if ((x0 & mask) > (rng.Next() & mask))
+			v += 1U << (msb - m);
+	}
+	return Pint::log2_fixed(v, shift);
+}
+
+double PintEstimator::Estimate(uint64_t dt, uint64_t qlen, uint32_t lastPktSize, double u, PintRng &rng) const{
+	double qterm = 0, byteTerm = 0, uTerm = 0;
+	if ((qlen >> 8) > 0) // ~dt * qlen * 1e9 / (B * T^2)
+		qterm = Pint::exp2_fixed(Log2Apprx(dt, rng) + Log2Apprx(qlen >> 8, rng) + m_qConst, shift);
+	if (lastPktSize > 0) // ~byte * 1e9 / (B * T)
+		byteTerm = Pint::exp2_fixed(Log2Apprx(lastPktSize, rng) + m_byteConst, shift);
+	if (m_maxRtt > dt && u > 0) // ~(T - dt) * u / T
+		uTerm = Pint::exp2_fixed(Log2Apprx(m_maxRtt - dt, rng) + Log2Apprx(llround(u * 8192), rng) + m_uConst, shift);
+	return qterm + byteTerm + uTerm;
+}
+
 } /* namespace ns3 */
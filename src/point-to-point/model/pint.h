@@ -2,6 +2,7 @@
 #define PINT_H
 
 #include <stdint.h>
+#include <vector>
 
 namespace ns3{
 class Pint{
@@ -11,8 +12,61 @@ public:
 	static void set_log_base(double base);
 	static int get_n_bits();
 	static int get_n_bytes();
-	static uint16_t encode_u(double u);
+	static uint16_t encode_u(double u, uint16_t rnd); // rnd is uniform in [0, 65536), for the stochastic rounding
 	static double decode_u(uint16_t p);
+
+	// from tables built at compile time, interpolated
+	static int log2_fixed(uint32_t x, int shift); // ~log2(x) * 2^shift rounded down, x > 0
+	static double exp2_fixed(int64_t y, int shift); // ~2^(y / 2^shift)
+
+private:
+	static std::vector<double> pow_table; // log_base^p up to 2^32, the bounds of encode_u
+	static double log2_factor; // 1 / log2(log_base)
+};
+
+/**
+ * xorshift64* random stream of a switch, for the stochastic rounding of PINT
+ */
+class PintRng{
+public:
+	PintRng(uint64_t seed = 1);
+	void Seed(uint64_t seed);
+	uint32_t Next(){
+		s ^= s >> 12;
+		s ^= s << 25;
+		s ^= s >> 27;
+		return (s * 0x2545F4914F6CDD1DULL) >> 32;
+	}
+private:
+	uint64_t s;
+};
+
+/**
+ * The utilization of a switch port that HPCC-PINT carries, estimated at each
+ * dequeue from the time dt since the previous one, the queue length qlen,
+ * the size of the previous packet and the previous estimate u as
+ *   dt * qlen / (B * T^2) + byte / (B * T) + (T - dt) * u / T
+ * for the rate B and the max RTT T. Each term is 2 to the power of a sum of
+ * log2 in Q15, the constant part of which is computed once per port by
+ * Configure. Log2Apprx rounds x to its 16 most significant bits, up or down
+ * at random in proportion to the bits dropped.
+ */
+class PintEstimator{
+public:
+	static const int b = 20, m = 16, l = 20; // x of at most b bits, use most significant m bits, result in l bits
+	static const int shift = l - 5; // log2 in Q(shift), 5 for the log2 of b bits
+
+	PintEstimator();
+	void Configure(uint64_t maxRtt, uint64_t bytesPerSecond);
+	double Estimate(uint64_t dt, uint64_t qlen, uint32_t lastPktSize, double u, PintRng &rng) const;
+	int64_t Log2Apprx(int64_t x, PintRng &rng) const; // ~log2(x) * 2^shift
+
+private:
+	uint64_t m_maxRtt;
+	int64_t m_logT; // log2(T) in Q(shift)
+	int64_t m_qConst; // of dt * qlen / (B * T^2), with qlen counted in units of 256 bytes
+	int64_t m_byteConst; // of byte / (B * T)
+	int64_t m_uConst; // of (T - dt) * u / T, with u counted in units of 1/8192
 };
 } /* namespace ns3 */
 
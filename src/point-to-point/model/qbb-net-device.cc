@@ -36,6 +36,7 @@
 #include "ns3/simulator.h"
 #include "ns3/uinteger.h"
 
+#include <cstring>
 #include <stdint.h>
 #include <stdio.h>
 // #include "ns3/random-variable.h"
@@ -86,6 +87,9 @@ RdmaEgressQueue::RdmaEgressQueue()
         "MaxSize",
         QueueSizeValue(QueueSize(QueueSizeUnit::PACKETS,
                                  0xffffffff))); // queue limit is on a higher level, not here
+    m_schedGrp = nullptr;
+    m_schedGen = 0;
+    m_nFinished = 0;
 }
 
 Ptr<Packet>
@@ -119,63 +123,286 @@ RdmaEgressQueue::GetNextQindex(bool paused[])
         return -1;
     }
 
-    // 2. Round-robin polling for all normal queues (QPs).
-    // Only select a QP that is not PAUSED, has data left, is not window-bounded, and is available
-    // now.
-    int res = -1024; // Default: no packet to send
-    uint32_t fcount = m_qpGrp->GetN();
-    uint32_t min_finish_id = 0xffffffff; // For tracking the smallest finished QP index
-    for (uint32_t qIndex = 1; qIndex <= fcount; qIndex++)
-    {
-        uint32_t idx = (qIndex + m_rrlast) % fcount;
-        Ptr<RdmaQueuePair> qp = m_qpGrp->Get(idx);
-        // The QP is eligible if:
-        // 1. Its priority group is not PAUSED
-        // 2. It has data left to send
-        // 3. It is not window-bounded
-        // 4. Its next available time has arrived
-        if (!paused[qp->m_pg] && qp->GetBytesLeft() > 0 && !qp->IsWinBound())
+    // 2. Round-robin over the ready QPs, i.e. not PAUSED, data left, not window-bounded and
+    // available now. Slots are never reordered, so the first ready slot after m_rrlast among
+    // the unpaused priority groups is the QP a scan from m_rrlast would stop at.
+    SyncQps();
+    if (m_nFinished > 0 && m_nFinished * 2 >= m_state.size())
+    {
+        CompactFinished();
+    }
+    uint32_t fcount = m_state.size();
+    if (fcount == 0)
+    {
+        return -1024;
+    }
+    int64_t now = Simulator::Now().GetTimeStep();
+    PromoteWaiting(now);
+    uint32_t last = m_rrlast % fcount;
+    while (true)
+    {
+        uint32_t best = 0xffffffff;
+        uint32_t bestDist = 0xffffffff;
+        for (uint32_t pg = 0; pg < qCnt; pg++)
         {
-            if (m_qpGrp->Get(idx)->m_nextAvail.GetTimeStep() >
-                Simulator::Now().GetTimeStep()) // Not available yet
+            if (paused[pg] || m_ready[pg].Empty())
             {
                 continue;
             }
-            res = idx;
-            break;
+            uint32_t idx = m_ready[pg].FindFrom(last + 1);
+            if (idx == 0xffffffff)
+            {
+                idx = m_ready[pg].FindFrom(0);
+            }
+            uint32_t dist = (idx + fcount - last - 1) % fcount;
+            if (dist < bestDist)
+            {
+                best = idx;
+                bestDist = dist;
+            }
+        }
+        if (best == 0xffffffff)
+        {
+            // Return value:
+            //   -1: send ACK
+            //   >=0: send the corresponding QP
+            //   -1024: nothing to send
+            return -1024;
         }
-        // Track the smallest finished QP index for later cleanup
-        else if (qp->IsFinished())
+        // the ready sets are only refreshed through UpdateQp, re-check before sending
+        Ptr<RdmaQueuePair> qp = m_qpGrp->m_qps[best];
+        if (qp->GetBytesLeft() > 0 && !qp->IsWinBound() && qp->m_nextAvail.GetTimeStep() <= now)
         {
-            min_finish_id = idx < min_finish_id ? idx : min_finish_id;
+            return best;
         }
+        Classify(best, now);
     }
+}
 
-    // 3. Clean up finished QPs to keep the queue group tidy
-    if (min_finish_id < 0xffffffff)
+void
+RdmaEgressQueue::UpdateQp(Ptr<RdmaQueuePair> qp)
+{
+    if (m_qpGrp == nullptr)
+    {
+        return;
+    }
+    SyncQps();
+    uint32_t idx = qp->m_egressIdx;
+    if (idx < m_state.size() && m_qpGrp->m_qps[idx] == qp)
     {
-        int nxt = min_finish_id;
-        auto& qps = m_qpGrp->m_qps;
-        for (int i = min_finish_id + 1; i < fcount; i++)
+        Classify(idx, Simulator::Now().GetTimeStep());
+    }
+}
+
+Time
+RdmaEgressQueue::GetNextAvail()
+{
+    if (m_qpGrp == nullptr)
+    {
+        return Simulator::GetMaximumSimulationTime();
+    }
+    SyncQps();
+    while (!m_wait.empty())
+    {
+        const WaitEntry& e = m_wait.top();
+        if (m_state[e.idx] == QP_WAITING && m_waitTs[e.idx] == e.ts)
         {
-            if (!qps[i]->IsFinished())
-            {
-                // If the selected QP is after the removed QPs, update its index
-                if (i == res)
-                {
-                    res = nxt;
-                }
-                qps[nxt] = qps[i];
-                nxt++;
-            }
+            return TimeStep(e.ts);
+        }
+        m_wait.pop(); // superseded by a later UpdateQp
+    }
+    return Simulator::GetMaximumSimulationTime();
+}
+
+void
+RdmaEgressQueue::SyncQps()
+{
+    if (m_schedGrp != PeekPointer(m_qpGrp) || m_schedGen != m_qpGrp->m_generation)
+    {
+        ResetSchedule();
+    }
+    // RdmaHw appends new qps to the group, file them here
+    auto& qps = m_qpGrp->m_qps;
+    int64_t now = Simulator::Now().GetTimeStep();
+    for (uint32_t i = m_state.size(); i < qps.size(); i++)
+    {
+        qps[i]->m_egressIdx = i;
+        m_state.push_back(QP_BLOCKED);
+        m_waitTs.push_back(0);
+        Classify(i, now);
+    }
+}
+
+void
+RdmaEgressQueue::ResetSchedule()
+{
+    m_schedGrp = PeekPointer(m_qpGrp);
+    m_schedGen = m_qpGrp->m_generation;
+    m_state.clear();
+    m_waitTs.clear();
+    for (uint32_t pg = 0; pg < qCnt; pg++)
+    {
+        m_ready[pg].Clear();
+    }
+    m_wait = decltype(m_wait)();
+    m_nFinished = 0;
+}
+
+void
+RdmaEgressQueue::Classify(uint32_t idx, int64_t now)
+{
+    Ptr<RdmaQueuePair> qp = m_qpGrp->m_qps[idx];
+    uint8_t old = m_state[idx];
+    if (old == QP_FINISHED)
+    {
+        return;
+    }
+    if (old == QP_READY)
+    {
+        m_ready[qp->m_pg].Erase(idx);
+    }
+    if (qp->IsFinished())
+    {
+        m_state[idx] = QP_FINISHED;
+        m_nFinished++;
+        return;
+    }
+    if (qp->GetBytesLeft() == 0 || qp->IsWinBound())
+    {
+        m_state[idx] = QP_BLOCKED;
+        return;
+    }
+    int64_t ts = qp->m_nextAvail.GetTimeStep();
+    if (ts <= now)
+    {
+        m_state[idx] = QP_READY;
+        m_ready[qp->m_pg].Insert(idx);
+        return;
+    }
+    if (old != QP_WAITING || m_waitTs[idx] != ts)
+    {
+        m_wait.push(WaitEntry{ts, idx});
+        m_waitTs[idx] = ts;
+    }
+    m_state[idx] = QP_WAITING;
+}
+
+void
+RdmaEgressQueue::PromoteWaiting(int64_t now)
+{
+    while (!m_wait.empty() && m_wait.top().ts <= now)
+    {
+        WaitEntry e = m_wait.top();
+        m_wait.pop();
+        if (m_state[e.idx] == QP_WAITING && m_waitTs[e.idx] == e.ts)
+        {
+            Classify(e.idx, now);
         }
-        qps.resize(nxt);
     }
-    // Return value:
-    //   -1: send ACK
-    //   >=0: send the corresponding QP
-    //   -1024: nothing to send
-    return res;
+}
+
+RdmaEgressQueue::SlotSet::SlotSet()
+    : m_n(0)
+{
+}
+
+void
+RdmaEgressQueue::SlotSet::Insert(uint32_t i)
+{
+    uint32_t w = i >> 6;
+    if (w >= m_bits.size())
+    {
+        m_bits.resize(w + 1, 0);
+        m_summary.resize((m_bits.size() + 63) >> 6, 0);
+    }
+    if (!(m_bits[w] & (1ULL << (i & 63))))
+    {
+        m_bits[w] |= 1ULL << (i & 63);
+        m_summary[w >> 6] |= 1ULL << (w & 63);
+        m_n++;
+    }
+}
+
+void
+RdmaEgressQueue::SlotSet::Erase(uint32_t i)
+{
+    uint32_t w = i >> 6;
+    if (w < m_bits.size() && (m_bits[w] & (1ULL << (i & 63))))
+    {
+        m_bits[w] &= ~(1ULL << (i & 63));
+        if (m_bits[w] == 0)
+        {
+            m_summary[w >> 6] &= ~(1ULL << (w & 63));
+        }
+        m_n--;
+    }
+}
+
+uint32_t
+RdmaEgressQueue::SlotSet::FindFrom(uint32_t i) const
+{
+    uint32_t w = i >> 6;
+    if (w >= m_bits.size())
+    {
+        return 0xffffffff;
+    }
+    uint64_t m = m_bits[w] & (~0ULL << (i & 63));
+    if (m)
+    {
+        return (w << 6) + __builtin_ctzll(m);
+    }
+    // first non-empty word after w
+    w++;
+    for (uint32_t s = w >> 6; s < m_summary.size(); s++)
+    {
+        m = m_summary[s];
+        if (s == (w >> 6))
+        {
+            m &= ~0ULL << (w & 63);
+        }
+        if (m)
+        {
+            uint32_t word = (s << 6) + __builtin_ctzll(m);
+            return (word << 6) + __builtin_ctzll(m_bits[word]);
+        }
+    }
+    return 0xffffffff;
+}
+
+bool
+RdmaEgressQueue::SlotSet::Empty() const
+{
+    return m_n == 0;
+}
+
+void
+RdmaEgressQueue::SlotSet::Clear()
+{
+    m_bits.clear();
+    m_summary.clear();
+    m_n = 0;
+}
+
+void
+RdmaEgressQueue::CompactFinished()
+{
+    // keep the order of the remaining qps and keep m_rrlast pointing between the same two qps
+    auto& qps = m_qpGrp->m_qps;
+    uint32_t last = m_rrlast % qps.size();
+    uint32_t nxt = 0;
+    uint32_t upToLast = 0;
+    for (uint32_t i = 0; i < qps.size(); i++)
+    {
+        if (m_state[i] != QP_FINISHED)
+        {
+            qps[nxt++] = qps[i];
+            upToLast += i <= last;
+        }
+    }
+    qps.resize(nxt);
+    m_rrlast = upToLast > 0 ? upToLast - 1 : (nxt > 0 ? nxt - 1 : 0);
+    ResetSchedule();
+    SyncQps();
 }
 
 int
@@ -209,6 +436,7 @@ RdmaEgressQueue::RecoverQueue(uint32_t i)
 {
     NS_ASSERT_MSG(i < m_qpGrp->GetN(), "RdmaEgressQueue::RecoverQueue: qIndex >= m_qpGrp->GetN()");
     m_qpGrp->Get(i)->snd_nxt = m_qpGrp->Get(i)->snd_una;
+    UpdateQp(m_qpGrp->Get(i));
 }
 
 void
@@ -282,6 +510,10 @@ QbbNetDevice::GetTypeId(void)
                             "Drop a packet in the QbbNetDevice.",
                             MakeTraceSourceAccessor(&QbbNetDevice::m_traceDrop),
                             "ns3::Queue::QbbDropTracedCallback")
+            .AddTraceSource("QbbSwitchDrop",
+                            "The switch did not admit a packet to a queue of the QbbNetDevice.",
+                            MakeTraceSourceAccessor(&QbbNetDevice::m_traceSwitchDrop),
+                            "ns3::Queue::QbbDropTracedCallback")
             .AddTraceSource("RdmaQpDequeue",
                             "A qp dequeue a packet.",
                             MakeTraceSourceAccessor(&QbbNetDevice::m_traceQpDequeue),
@@ -294,12 +526,19 @@ QbbNetDevice::GetTypeId(void)
                           "Dequeue mode of NIC: 0: round robin, 1: priority first",
                           UintegerValue(0),
                           MakeUintegerAccessor(&QbbNetDevice::m_nicDequeueMode),
-                          MakeUintegerChecker<uint32_t>());
+                          MakeUintegerChecker<uint32_t>())
+            .AddAttribute("ValidateHeaderCache",
+                          "Check that the header cached with each switched packet matches "
+                          "the packet bytes when it is dequeued (slow, for debugging).",
+                          BooleanValue(false),
+                          MakeBooleanAccessor(&QbbNetDevice::m_validateHeaderCache),
+                          MakeBooleanChecker());
 
     return tid;
 }
 
 QbbNetDevice::QbbNetDevice()
+    : m_tracedHeader(nullptr)
 {
     NS_LOG_FUNCTION(this);
     m_ecn_source = new std::vector<ECNAccount>;
@@ -384,20 +623,12 @@ QbbNetDevice::DequeueAndTransmit(void)
             // has just sent a packet" and update the next available sending time of the QP (next
             // avail time)
             m_rdmaPktSent(lastQp, p, m_tInterframeGap);
+            m_rdmaEQ->UpdateQp(lastQp);
         }
         else
         { // no packet to send
             NS_LOG_INFO("PAUSE prohibits send at node " << GetNode()->GetId());
-            Time t = Simulator::GetMaximumSimulationTime();
-            for (uint32_t i = 0; i < m_rdmaEQ->GetFlowCount(); i++)
-            {
-                Ptr<RdmaQueuePair> qp = m_rdmaEQ->GetQp(i);
-                if (qp->GetBytesLeft() == 0)
-                {
-                    continue;
-                }
-                t = Min(qp->m_nextAvail, t);
-            }
+            Time t = m_rdmaEQ->GetNextAvail();
             if (m_nextSend.IsExpired() && t < Simulator::GetMaximumSimulationTime() &&
                 t > Simulator::Now())
             {
@@ -425,24 +656,20 @@ QbbNetDevice::DequeueAndTransmit(void)
         {
             m_snifferTrace(p);
             m_promiscSnifferTrace(p);
-            Ipv4Header h;
-            Ptr<Packet> packet = p->Copy();
-            uint16_t protocol = 0;
-            ProcessHeader(packet, protocol);
-            packet->RemoveHeader(h);
+            // SwitchNotifyDequeue reads and updates the headers in place, no copy needed,
+            // and keeps the header parsed on receive in sync with the bytes
             FlowIdTag t;
             uint32_t qIndex = m_queue->GetLastQueue();
-            if (qIndex == 0)
-            { // this is a pause or cnp, send it immediately!
-                GetNode()->SwitchNotifyDequeue(m_ifIndex, qIndex, p);
-                p->RemovePacketTag(t);
-            }
-            else
+            CustomHeader& ch = m_queue->GetLastHeader();
+            GetNode()->SwitchNotifyDequeue(m_ifIndex, qIndex, p, ch);
+            p->RemovePacketTag(t);
+            if (m_validateHeaderCache)
             {
-                GetNode()->SwitchNotifyDequeue(m_ifIndex, qIndex, p);
-                p->RemovePacketTag(t);
+                CheckHeaderCache(p, ch);
             }
+            m_tracedHeader = &ch;
             m_traceDequeue(p, qIndex);
+            m_tracedHeader = nullptr;
             TransmitStart(p);
             return;
         }
@@ -451,16 +678,7 @@ QbbNetDevice::DequeueAndTransmit(void)
             NS_LOG_INFO("PAUSE prohibits send at node " << GetNode()->GetId());
             if (GetNode()->GetNodeType() == 0 && m_qcnEnabled)
             { // nothing to send, possibly due to qcn flow control, if so reschedule sending
-                Time t = Simulator::GetMaximumSimulationTime();
-                for (uint32_t i = 0; i < m_rdmaEQ->GetFlowCount(); i++)
-                {
-                    Ptr<RdmaQueuePair> qp = m_rdmaEQ->GetQp(i);
-                    if (qp->GetBytesLeft() == 0)
-                    {
-                        continue;
-                    }
-                    t = Min(qp->m_nextAvail, t);
-                }
+                Time t = m_rdmaEQ->GetNextAvail();
                 if (m_nextSend.IsExpired() && t < Simulator::GetMaximumSimulationTime() &&
                     t > Simulator::Now())
                 {
@@ -505,10 +723,13 @@ QbbNetDevice::Receive(Ptr<Packet> packet)
         return;
     }
 
-    m_macRxTrace(packet);
+    // this is the only place a switched packet is parsed, the header then travels with it
     CustomHeader ch(CustomHeader::L2_Header | CustomHeader::L3_Header | CustomHeader::L4_Header);
     ch.getInt = 1; // parse INT header
     packet->PeekHeader(ch);
+    m_tracedHeader = &ch;
+    m_macRxTrace(packet);
+    m_tracedHeader = nullptr;
     if (ch.l3Prot == 0xFE)
     { // PFC
         if (!m_qbbEnabled)
@@ -554,13 +775,49 @@ QbbNetDevice::Send(Ptr<Packet> packet, const Address& dest, uint16_t protocolNum
 bool
 QbbNetDevice::SwitchSend(uint32_t qIndex, Ptr<Packet> packet, CustomHeader& ch)
 {
+    m_tracedHeader = &ch;
     m_macTxTrace(packet);
     m_traceEnqueue(packet, qIndex);
-    m_queue->Enqueue(packet, qIndex);
+    m_tracedHeader = nullptr;
+    m_queue->Enqueue(packet, qIndex, ch);
     DequeueAndTransmit();
     return true;
 }
 
+void
+QbbNetDevice::SwitchDrop(uint32_t qIndex, Ptr<Packet> packet, CustomHeader& ch)
+{
+    m_tracedHeader = &ch;
+    m_traceSwitchDrop(packet, qIndex);
+    m_tracedHeader = nullptr;
+}
+
+const CustomHeader*
+QbbNetDevice::GetTracedHeader() const
+{
+    return m_tracedHeader;
+}
+
+void
+QbbNetDevice::CheckHeaderCache(Ptr<const Packet> p, const CustomHeader& ch)
+{
+    // compare through Serialize so that fields the parser skips are ignored on both sides
+    CustomHeader parsed(ch.headerType);
+    parsed.getInt = ch.getInt;
+    p->PeekHeader(parsed);
+    Buffer cached;
+    cached.AddAtStart(ch.GetSerializedSize());
+    ch.Serialize(cached.Begin());
+    Buffer bytes;
+    bytes.AddAtStart(parsed.GetSerializedSize());
+    parsed.Serialize(bytes.Begin());
+    NS_ABORT_MSG_UNLESS(cached.GetSize() == bytes.GetSize() &&
+                            memcmp(cached.PeekData(), bytes.PeekData(), cached.GetSize()) == 0,
+                        "Cached header of packet " << p->GetUid() << " at node "
+                                                   << GetNode()->GetId() << " dev " << m_ifIndex
+                                                   << " does not match the packet bytes");
+}
+
 void
 QbbNetDevice::SendPfc(uint32_t qIndex, uint32_t type)
 {
@@ -716,6 +973,12 @@ QbbNetDevice::TakeDown()
     m_linkUp = false;
 }
 
+void
+QbbNetDevice::UpdateQp(Ptr<RdmaQueuePair> qp)
+{
+    m_rdmaEQ->UpdateQp(qp);
+}
+
 void
 QbbNetDevice::UpdateNextAvail(Time t)
 {
@@ -753,4 +1016,24 @@ QbbNetDevice::SendCNCPReport(FlowKey key, uint64_t flowInfo)
     p->PeekHeader(ch);
     SwitchSend(0, p, ch);
 }
+
+void
+QbbNetDevice::SendCNCPBatchReport(const CncpBatchReportHeader& reports)
+{
+    Ptr<Packet> p = Create<Packet>(0);
+    p->AddHeader(reports);
+    Ipv4Header ipv4h; // Prepare IPv4 header
+    ipv4h.SetProtocol(0xFA);
+    ipv4h.SetSource(GetNode()->GetObject<Ipv4>()->GetAddress(m_ifIndex, 0).GetLocal());
+    ipv4h.SetDestination(Ipv4Address("255.255.255.255"));
+    ipv4h.SetPayloadSize(p->GetSize());
+    ipv4h.SetTtl(1);
+    ipv4h.SetIdentification(m_uv->GetInteger(0, 65535));
+    p->AddHeader(ipv4h);
+    AddHeader(p, 0x800);
+    // the entries are not part of CustomHeader, they stay in the payload
+    CustomHeader ch(CustomHeader::L2_Header | CustomHeader::L3_Header | CustomHeader::L4_Header);
+    p->PeekHeader(ch);
+    SwitchSend(0, p, ch);
+}
 } // namespace ns3
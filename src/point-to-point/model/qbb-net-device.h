@@ -34,6 +34,7 @@
 #include "ns3/cncp-flowkey.h"
 #include "ns3/cncp-control-header.h"
 #include <map>
+#include <queue>
 #include <vector>
 
 namespace ns3
@@ -65,8 +66,76 @@ class RdmaEgressQueue : public Object
     void EnqueueHighPrioQ(Ptr<Packet> p);
     void CleanHighPrio(TracedCallback<Ptr<const Packet>, uint32_t> dropCb);
 
+    /**
+     * Re-file qp after its send state changed (packet sent, ACK/NACK, rate or
+     * window change). A qp that became sendable is only seen once this is called.
+     */
+    void UpdateQp(Ptr<RdmaQueuePair> qp);
+    /// earliest m_nextAvail of a qp that only waits for its rate limiter, max time if none
+    Time GetNextAvail();
+
     TracedCallback<Ptr<const Packet>, uint32_t> m_traceRdmaEnqueue;
     TracedCallback<Ptr<const Packet>, uint32_t> m_traceRdmaDequeue;
+
+  private:
+    /*
+     * QP scheduler. Every qp in m_qpGrp is in one state, indexed by its slot:
+     * ready (sendable now, in m_ready of its pg), waiting (only m_nextAvail is in
+     * the future, in m_wait), blocked (no bytes left or window bound) or finished.
+     * GetNextQindex promotes due waiting qps, then takes the ready qp that follows
+     * m_rrlast in slot order among the unpaused pgs, which is the qp the former
+     * round-robin scan picked. Finished qps are compacted away in batches.
+     */
+    enum QpState : uint8_t
+    {
+        QP_BLOCKED,
+        QP_WAITING,
+        QP_READY,
+        QP_FINISHED
+    };
+
+    /// set of qp slots: a bitmap plus a summary bit per non-empty bitmap word
+    class SlotSet
+    {
+      public:
+        SlotSet();
+        void Insert(uint32_t i);
+        void Erase(uint32_t i);
+        /// smallest slot >= i in the set, 0xffffffff if none
+        uint32_t FindFrom(uint32_t i) const;
+        bool Empty() const;
+        void Clear();
+
+      private:
+        std::vector<uint64_t> m_bits;
+        std::vector<uint64_t> m_summary;
+        uint32_t m_n;
+    };
+
+    struct WaitEntry
+    {
+        int64_t ts; //< m_nextAvail of the qp when filed
+        uint32_t idx;
+
+        bool operator>(const WaitEntry& o) const
+        {
+            return ts > o.ts || (ts == o.ts && idx > o.idx);
+        }
+    };
+
+    void SyncQps();
+    void ResetSchedule();
+    void Classify(uint32_t idx, int64_t now);
+    void PromoteWaiting(int64_t now);
+    void CompactFinished();
+
+    RdmaQueuePairGroup* m_schedGrp; //< group the scheduler state was built for
+    uint32_t m_schedGen;            //< its generation, bumped by RdmaQueuePairGroup::Clear
+    std::vector<uint8_t> m_state;   //< QpState by slot
+    std::vector<int64_t> m_waitTs;  //< ts of the live m_wait entry of a waiting slot
+    SlotSet m_ready[qCnt];
+    std::priority_queue<WaitEntry, std::vector<WaitEntry>, std::greater<WaitEntry>> m_wait;
+    uint32_t m_nFinished;
 };
 
 /**
@@ -105,6 +174,10 @@ class QbbNetDevice : public PointToPointNetDevice
      */
     virtual bool Send(Ptr<Packet> packet, const Address& dest, uint16_t protocolNumber);
     virtual bool SwitchSend(uint32_t qIndex, Ptr<Packet> packet, CustomHeader& ch);
+    /**
+     * Report to the QbbSwitchDrop trace sinks a packet the switch did not admit to queue qIndex
+     */
+    void SwitchDrop(uint32_t qIndex, Ptr<Packet> packet, CustomHeader& ch);
 
     /**
      * Get the size of Tx buffer available in the device
@@ -133,10 +206,19 @@ class QbbNetDevice : public PointToPointNetDevice
     void SendPfc(uint32_t qIndex, uint32_t type); // type: 0 = pause, 1 = resume
 
     void SendCNCPReport(FlowKey key, uint64_t flowInfo);
+    void SendCNCPBatchReport(const CncpBatchReportHeader& reports); // protocol 0xFA
+
+    /**
+     * Header of the packet passed to the MacRx, MacTx, QbbEnqueue, QbbDequeue, QbbDrop
+     * and QbbSwitchDrop trace sinks on a switch, already parsed by the device. Only valid while
+     * such a sink runs, nullptr otherwise (the sink has to parse the packet).
+     */
+    const CustomHeader* GetTracedHeader() const;
 
     TracedCallback<Ptr<const Packet>, uint32_t> m_traceEnqueue;
     TracedCallback<Ptr<const Packet>, uint32_t> m_traceDequeue;
     TracedCallback<Ptr<const Packet>, uint32_t> m_traceDrop;
+    TracedCallback<Ptr<const Packet>, uint32_t> m_traceSwitchDrop;
     TracedCallback<uint32_t> m_tracePfc; // 0: resume, 1: pause
 
     // Uniform random variable
@@ -202,6 +284,11 @@ class QbbNetDevice : public PointToPointNetDevice
     // whether dequeue using priority first scheduling or round robin scheduling
     uint32_t m_nicDequeueMode;
 
+    // the header parsed on receive travels with the packet through m_queue
+    bool m_validateHeaderCache; //< check the cached header against the bytes on dequeue
+    const CustomHeader* m_tracedHeader;
+    void CheckHeaderCache(Ptr<const Packet> p, const CustomHeader& ch);
+
     struct ECNAccount
     {
         Ipv4Address source;
@@ -231,6 +318,7 @@ class QbbNetDevice : public PointToPointNetDevice
     Ptr<RdmaEgressQueue> GetRdmaQueue();
     void TakeDown(); // take down this device
     void UpdateNextAvail(Time t);
+    void UpdateQp(Ptr<RdmaQueuePair> qp); // qp send state changed, see RdmaEgressQueue::UpdateQp
 
     TracedCallback<Ptr<const Packet>, Ptr<RdmaQueuePair>>
         m_traceQpDequeue; // the trace for printing dequeue
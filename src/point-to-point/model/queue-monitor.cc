@@ -0,0 +1,222 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+#include "queue-monitor.h"
+
+#include "switch-mmu.h"
+#include "switch-node.h"
+
+#include "ns3/log.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("QueueMonitor");
+
+static const char magic[8] = {'N', 'S', '3', 'Q', 'L', 'E', 'N', '1'};
+
+void
+QueueMonitor::Port::Account(uint64_t now)
+{
+    uint64_t from = std::max(m_last, m_monitor->m_start);
+    uint64_t to = std::min(now, m_monitor->m_stop);
+    m_last = now;
+    if (to <= from)
+    {
+        return;
+    }
+    uint64_t bin = m_bytes / m_monitor->m_binWidth;
+    if (bin >= m_bins.size())
+    {
+        m_bins.resize(bin + 1);
+    }
+    m_bins[bin] += to - from;
+    m_ns += to - from;
+    m_byteNs += (double)m_bytes * (to - from);
+    m_max = std::max(m_max, m_bytes);
+}
+
+QueueMonitor::QueueMonitor(FILE* file, Format format)
+    : m_file(file),
+      m_format(format),
+      m_headerDone(false),
+      m_binWidth(1000),
+      m_start(0),
+      m_stop(UINT64_MAX),
+      m_textInterval(100)
+{
+}
+
+QueueMonitor::~QueueMonitor()
+{
+    for (auto& p : m_ports)
+    {
+        p->m_mmu->egress_monitor[p->m_port] = nullptr;
+    }
+}
+
+void
+QueueMonitor::SetBinWidth(uint32_t bytes)
+{
+    NS_ASSERT(bytes > 0 && m_ports.empty());
+    m_binWidth = bytes;
+}
+
+void
+QueueMonitor::SetWindow(Time start, Time stop)
+{
+    NS_ASSERT(start <= stop);
+    m_start = start.GetTimeStep();
+    m_stop = stop.GetTimeStep();
+}
+
+void
+QueueMonitor::SetTextInterval(Time interval)
+{
+    NS_ASSERT(interval.IsStrictlyPositive());
+    m_textInterval = interval.GetTimeStep();
+}
+
+void
+QueueMonitor::MonitorPort(Ptr<SwitchNode> sw, uint32_t port)
+{
+    Ptr<SwitchMmu> mmu = sw->m_mmu;
+    NS_ASSERT(port < mmu->egress_bytes.size());
+    auto p = std::make_unique<Port>();
+    p->m_node = sw->GetId();
+    p->m_port = port;
+    p->m_bytes = 0;
+    for (uint32_t q = 0; q < SwitchMmu::qCnt; q++)
+    {
+        p->m_bytes += mmu->egress_bytes[port][q];
+    }
+    p->m_last = Simulator::Now().GetTimeStep();
+    p->m_max = 0;
+    p->m_ns = 0;
+    p->m_byteNs = 0;
+    p->m_monitor = this;
+    p->m_mmu = mmu;
+    if (mmu->egress_monitor.size() < mmu->egress_bytes.size())
+    {
+        mmu->egress_monitor.resize(mmu->egress_bytes.size(), nullptr);
+    }
+    mmu->egress_monitor[port] = p.get();
+    m_ports.push_back(std::move(p));
+}
+
+void
+QueueMonitor::MonitorSwitch(Ptr<SwitchNode> sw)
+{
+    for (uint32_t j = 1; j < sw->GetNDevices(); j++)
+    {
+        MonitorPort(sw, j);
+    }
+}
+
+void
+QueueMonitor::ScheduleDumps(Time interval)
+{
+    uint64_t step = interval.GetTimeStep();
+    NS_ASSERT(step > 0 && m_stop != UINT64_MAX);
+    uint64_t now = Simulator::Now().GetTimeStep();
+    for (uint64_t t = (m_start + step - 1) / step * step; t < m_stop; t += step)
+    {
+        Simulator::Schedule(TimeStep(t - now), &QueueMonitor::Dump, this);
+    }
+    Simulator::Schedule(TimeStep(m_stop - now), &QueueMonitor::Dump, this);
+}
+
+void
+QueueMonitor::WriteHeader()
+{
+    m_headerDone = true;
+    if (m_format == Csv)
+    {
+        fprintf(m_file, "time,node,port,ns,mean,p50,p90,p99,max\n");
+    }
+    else if (m_format == Binary)
+    {
+        fwrite(magic, sizeof(magic), 1, m_file);
+        fwrite(&m_binWidth, sizeof(m_binWidth), 1, m_file);
+    }
+}
+
+void
+QueueMonitor::Dump()
+{
+    if (!m_headerDone)
+    {
+        WriteHeader();
+    }
+    uint64_t now = Simulator::Now().GetTimeStep();
+    if (m_format == Text)
+    {
+        fprintf(m_file, "time: %lu\n", now);
+    }
+    else if (m_format == Binary)
+    {
+        uint32_t n = m_ports.size();
+        fwrite(&now, sizeof(now), 1, m_file);
+        fwrite(&n, sizeof(n), 1, m_file);
+    }
+    for (auto& p : m_ports)
+    {
+        p->Account(now);
+        switch (m_format)
+        {
+        case Text:
+            fprintf(m_file, "%u %u", p->m_node, p->m_port);
+            for (uint64_t ns : p->m_bins)
+            {
+                fprintf(m_file, " %lu", (ns + m_textInterval / 2) / m_textInterval);
+            }
+            fprintf(m_file, "\n");
+            break;
+        case Csv: {
+            // the lower edges of the bins the percentiles fall in
+            const double q[3] = {0.5, 0.9, 0.99};
+            uint64_t pct[3] = {0, 0, 0};
+            uint64_t acc = 0;
+            uint32_t k = 0;
+            for (uint32_t i = 0; i < p->m_bins.size() && k < 3; i++)
+            {
+                acc += p->m_bins[i];
+                while (k < 3 && acc >= std::ceil(q[k] * p->m_ns) && p->m_ns > 0)
+                {
+                    pct[k++] = (uint64_t)i * m_binWidth;
+                }
+            }
+            fprintf(m_file,
+                    "%lu,%u,%u,%lu,%.1f,%lu,%lu,%lu,%lu\n",
+                    now,
+                    p->m_node,
+                    p->m_port,
+                    p->m_ns,
+                    p->m_ns > 0 ? p->m_byteNs / p->m_ns : 0.0,
+                    pct[0],
+                    pct[1],
+                    pct[2],
+                    p->m_max);
+            break;
+        }
+        case Binary: {
+            uint32_t head[4] = {p->m_node,
+                                p->m_port,
+                                (uint32_t)p->m_max,
+                                (uint32_t)p->m_bins.size()};
+            double mean = p->m_ns > 0 ? p->m_byteNs / p->m_ns : 0.0;
+            fwrite(head, sizeof(head), 1, m_file);
+            fwrite(&p->m_ns, sizeof(p->m_ns), 1, m_file);
+            fwrite(&mean, sizeof(mean), 1, m_file);
+            fwrite(p->m_bins.data(), sizeof(uint64_t), p->m_bins.size(), m_file);
+            break;
+        }
+        }
+    }
+    fflush(m_file);
+}
+
+} // namespace ns3
@@ -0,0 +1,124 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+#ifndef QUEUE_MONITOR_H
+#define QUEUE_MONITOR_H
+
+#include "ns3/nstime.h"
+#include "ns3/ptr.h"
+#include "ns3/simple-ref-count.h"
+#include "ns3/simulator.h"
+
+#include <cstdio>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+namespace ns3
+{
+
+class SwitchMmu;
+class SwitchNode;
+
+/**
+ * \brief Time-weighted egress occupancy statistics of switch ports
+ *
+ * SwitchMmu reports every change of the egress bytes of a monitored port, the
+ * sum over its queues, to that port's Port, which adds the time the port
+ * spent at its previous occupancy to a histogram of bins of the bin width.
+ * Only the time inside the window counts. A port that is not monitored costs
+ * SwitchMmu one test of an empty vector.
+ *
+ * Dump writes the statistics of every monitored port since the window
+ * started, in one of:
+ * - Text, the histogram layout of the former monitor_buffer of the scratch
+ *   programs, "time: t" then "node port n0 n1 ..." lines where ni is the
+ *   time in bin i in units of the text interval, which is the number of
+ *   samples that monitor, polling at that interval, would have counted;
+ * - Csv, a "time,node,port,ns,mean,p50,p90,p99,max" header then one line per
+ *   port, in bytes, a percentile being the lower edge of its bin;
+ * - Binary, the 8-byte magic and the bin width as uint32, then per dump the
+ *   time as uint64 and the number of ports as uint32, then per port node,
+ *   port, max bytes and bins as uint32, the time in the window as uint64,
+ *   the mean bytes as double and the time in each bin as uint64, all in host
+ *   byte order.
+ */
+class QueueMonitor : public SimpleRefCount<QueueMonitor>
+{
+  public:
+    enum Format
+    {
+        Text,
+        Csv,
+        Binary,
+    };
+
+    /// the statistics of one port
+    class Port
+    {
+      public:
+        /**
+         * Called by SwitchMmu when the egress bytes of the port change by delta
+         */
+        void Change(int64_t delta)
+        {
+            Account(Simulator::Now().GetTimeStep());
+            m_bytes += delta;
+        }
+
+      private:
+        friend class QueueMonitor;
+
+        void Account(uint64_t now); //!< add the time since the last change
+
+        uint32_t m_node;
+        uint32_t m_port;
+        uint64_t m_bytes;     //!< now
+        uint64_t m_last;      //!< time step of the last change
+        uint64_t m_max;       //!< in the window
+        uint64_t m_ns;        //!< in the window
+        double m_byteNs;      //!< bytes times time steps, in the window
+        std::vector<uint64_t> m_bins; //!< time steps in each bin
+        const QueueMonitor* m_monitor;
+        Ptr<SwitchMmu> m_mmu;
+    };
+
+    /**
+     * \param file where to dump, not closed by the monitor
+     * \param format how to dump
+     */
+    QueueMonitor(FILE* file, Format format);
+    ~QueueMonitor();
+
+    void SetBinWidth(uint32_t bytes); //!< 1000 by default
+    void SetWindow(Time start, Time stop);
+    void SetTextInterval(Time interval); //!< the unit of the Text format, 100 ns by default
+
+    /**
+     * Monitor the egress occupancy of a port of sw, from now on
+     */
+    void MonitorPort(Ptr<SwitchNode> sw, uint32_t port);
+    void MonitorSwitch(Ptr<SwitchNode> sw); //!< every port of sw
+
+    void Dump(); //!< the statistics up to now
+    /**
+     * Dump at every multiple of interval in the window, and at its end
+     */
+    void ScheduleDumps(Time interval);
+
+  private:
+    void WriteHeader();
+
+    FILE* m_file;
+    Format m_format;
+    bool m_headerDone;
+    uint32_t m_binWidth;
+    uint64_t m_start; //!< of the window, in time steps
+    uint64_t m_stop;
+    uint64_t m_textInterval;
+    std::vector<std::unique_ptr<Port>> m_ports; //!< in the order they were added
+};
+
+} // namespace ns3
+
+#endif /* QUEUE_MONITOR_H */
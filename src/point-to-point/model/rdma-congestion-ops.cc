@@ -0,0 +1,877 @@
+#include <ns3/simulator.h>
+#include "ns3/boolean.h"
+#include "ns3/uinteger.h"
+#include "ns3/double.h"
+#include "ns3/data-rate.h"
+#include "ns3/log.h"
+#include "ns3/rng-seed-manager.h"
+#include "ns3/node.h"
+#include "rdma-congestion-ops.h"
+#include "rdma-hw.h"
+#include "qbb-net-device.h"
+#include "pint.h"
+
+NS_LOG_COMPONENT_DEFINE("RdmaCongestionOps");
+
+namespace ns3{
+
+NS_OBJECT_ENSURE_REGISTERED (RdmaCongestionOps);
+NS_OBJECT_ENSURE_REGISTERED (RdmaDcqcn);
+NS_OBJECT_ENSURE_REGISTERED (RdmaHpcc);
+NS_OBJECT_ENSURE_REGISTERED (RdmaTimely);
+NS_OBJECT_ENSURE_REGISTERED (RdmaDctcp);
+NS_OBJECT_ENSURE_REGISTERED (RdmaHpccPint);
+
+/******************************
+ * RdmaCongestionOps
+ *****************************/
+TypeId RdmaCongestionOps::GetTypeId (void)
+{
+	static TypeId tid = TypeId ("ns3::RdmaCongestionOps")
+		.SetParent<Object> ()
+		.AddConstructor<RdmaCongestionOps> ()
+		;
+	return tid;
+}
+
+TypeId RdmaCongestionOps::GetTypeIdOfCcMode(uint32_t ccMode){
+	switch (ccMode){
+		case 1: return RdmaDcqcn::GetTypeId();
+		case 3: return RdmaHpcc::GetTypeId();
+		case 7: return RdmaTimely::GetTypeId();
+		case 8: return RdmaDctcp::GetTypeId();
+		case 10: return RdmaHpccPint::GetTypeId();
+		default: return RdmaCongestionOps::GetTypeId();
+	}
+}
+
+RdmaCongestionOps::RdmaCongestionOps(){
+	m_hw = NULL;
+}
+
+void RdmaCongestionOps::SetRdmaHw(RdmaHw *hw){
+	m_hw = hw;
+}
+
+Ptr<RdmaCcSlab> RdmaCongestionOps::GetSlab(){
+	return m_slab;
+}
+
+void RdmaCongestionOps::InitQp(Ptr<RdmaQueuePair> qp){
+}
+
+void RdmaCongestionOps::OnAck(Ptr<RdmaQueuePair> qp, RdmaAckFeedback &fb){
+}
+
+void RdmaCongestionOps::OnCnp(Ptr<RdmaQueuePair> qp){
+}
+
+void RdmaCongestionOps::OnSent(Ptr<RdmaQueuePair> qp, uint32_t pktSize){
+}
+
+void RdmaCongestionOps::OnTimer(Ptr<RdmaQueuePair> qp, uint32_t timer){
+}
+
+void RdmaCongestionOps::OnComplete(Ptr<RdmaQueuePair> qp){
+}
+
+EventId RdmaCongestionOps::ScheduleTimer(Time delay, Ptr<RdmaQueuePair> qp, uint32_t timer){
+	return Simulator::Schedule(delay, &RdmaCongestionOps::OnTimer, this, qp, timer);
+}
+
+Ptr<QbbNetDevice> RdmaCongestionOps::GetNic(Ptr<RdmaQueuePair> qp){
+	return m_hw->m_nic[m_hw->GetNicIdxOfQp(qp)].dev;
+}
+
+#define PRINT_LOG 0
+/******************************
+ * Mellanox's version of DCQCN
+ *****************************/
+TypeId RdmaDcqcn::GetTypeId (void)
+{
+	static TypeId tid = TypeId ("ns3::RdmaDcqcn")
+		.SetParent<RdmaCongestionOps> ()
+		.AddConstructor<RdmaDcqcn> ()
+		.AddAttribute("EwmaGain",
+				"Control gain parameter which determines the level of rate decrease",
+				DoubleValue(1.0 / 16),
+				MakeDoubleAccessor(&RdmaDcqcn::m_g),
+				MakeDoubleChecker<double>())
+		.AddAttribute("RateOnFirstCnp",
+				"the fraction of rate on first CNP",
+				DoubleValue(1.0),
+				MakeDoubleAccessor(&RdmaDcqcn::m_rateOnFirstCNP),
+				MakeDoubleChecker<double>())
+		.AddAttribute("ClampTargetRate",
+				"Clamp target rate.",
+				BooleanValue(false),
+				MakeBooleanAccessor(&RdmaDcqcn::m_EcnClampTgtRate),
+				MakeBooleanChecker())
+		.AddAttribute("RPTimer",
+				"The rate increase timer at RP in microseconds",
+				DoubleValue(1500.0),
+				MakeDoubleAccessor(&RdmaDcqcn::m_rpgTimeReset),
+				MakeDoubleChecker<double>())
+		.AddAttribute("RateDecreaseInterval",
+				"The interval of rate decrease check",
+				DoubleValue(4.0),
+				MakeDoubleAccessor(&RdmaDcqcn::m_rateDecreaseInterval),
+				MakeDoubleChecker<double>())
+		.AddAttribute("FastRecoveryTimes",
+				"The rate increase timer at RP",
+				UintegerValue(5),
+				MakeUintegerAccessor(&RdmaDcqcn::m_rpgThreshold),
+				MakeUintegerChecker<uint32_t>())
+		.AddAttribute("AlphaResumInterval",
+				"The interval of resuming alpha",
+				DoubleValue(55.0),
+				MakeDoubleAccessor(&RdmaDcqcn::m_alpha_resume_interval),
+				MakeDoubleChecker<double>())
+		.AddAttribute("RateAI",
+				"Rate increment unit in AI period",
+				DataRateValue(DataRate("5Mb/s")),
+				MakeDataRateAccessor(&RdmaDcqcn::m_rai),
+				MakeDataRateChecker())
+		.AddAttribute("RateHAI",
+				"Rate increment unit in hyperactive AI period",
+				DataRateValue(DataRate("50Mb/s")),
+				MakeDataRateAccessor(&RdmaDcqcn::m_rhai),
+				MakeDataRateChecker())
+		;
+	return tid;
+}
+
+RdmaDcqcn::RdmaDcqcn(){
+}
+
+void RdmaDcqcn::InitQp(Ptr<RdmaQueuePair> qp){
+	RdmaQpMlx *mlx = InitState<RdmaQpMlx>(qp);
+	mlx->m_targetRate = qp->m_rate;
+}
+
+void RdmaDcqcn::OnTimer(Ptr<RdmaQueuePair> qp, uint32_t timer){
+	switch (timer){
+		case TIMER_ALPHA: UpdateAlphaMlx(qp); break;
+		case TIMER_DECREASE: CheckRateDecreaseMlx(qp); break;
+		case TIMER_RATE_INC: RateIncEventTimerMlx(qp); break;
+		default: break;
+	}
+}
+
+void RdmaDcqcn::OnComplete(Ptr<RdmaQueuePair> qp){
+	RdmaQpMlx *mlx = qp->GetCcState<RdmaQpMlx>();
+	Simulator::Cancel(mlx->m_eventUpdateAlpha);
+	Simulator::Cancel(mlx->m_eventDecreaseRate);
+	Simulator::Cancel(mlx->m_rpTimer);
+}
+
+RdmaQpMlx::RdmaQpMlx(){
+	m_alpha = 1;
+	m_alpha_cnp_arrived = false;
+	m_first_cnp = true;
+	m_decrease_cnp_arrived = false;
+	m_rpTimeStage = 0;
+}
+
+void RdmaDcqcn::UpdateAlphaMlx(Ptr<RdmaQueuePair> q){
+	RdmaQpMlx *mlx = q->GetCcState<RdmaQpMlx>();
+	#if PRINT_LOG
+	//std::cout << Simulator::Now() << " alpha update:" << m_hw->m_node->GetId() << ' ' << mlx->m_alpha << ' ' << (int)mlx->m_alpha_cnp_arrived << '\n';
+	//printf("%lu alpha update: %08x %08x %u %u %.6lf->", Simulator::Now().GetTimeStep(), q->sip.Get(), q->dip.Get(), q->sport, q->dport, mlx->m_alpha);
+	#endif
+	if (mlx->m_alpha_cnp_arrived){
+		mlx->m_alpha = (1 - m_g)*mlx->m_alpha + m_g; 	//binary feedback
+	}else {
+		mlx->m_alpha = (1 - m_g)*mlx->m_alpha; 	//binary feedback
+	}
+	#if PRINT_LOG
+	//printf("%.6lf\n", mlx->m_alpha);
+	#endif
+	mlx->m_alpha_cnp_arrived = false; // clear the CNP_arrived bit
+	ScheduleUpdateAlphaMlx(q);
+}
+void RdmaDcqcn::ScheduleUpdateAlphaMlx(Ptr<RdmaQueuePair> q){
+	RdmaQpMlx *mlx = q->GetCcState<RdmaQpMlx>();
+	mlx->m_eventUpdateAlpha = ScheduleTimer(MicroSeconds(m_alpha_resume_interval), q, TIMER_ALPHA);
+}
+
+void RdmaDcqcn::OnCnp(Ptr<RdmaQueuePair> q){
+	RdmaQpMlx *mlx = q->GetCcState<RdmaQpMlx>();
+	mlx->m_alpha_cnp_arrived = true; // set CNP_arrived bit for alpha update
+	mlx->m_decrease_cnp_arrived = true; // set CNP_arrived bit for rate decrease
+	if (mlx->m_first_cnp){
+		// init alpha
+		mlx->m_alpha = 1;
+		mlx->m_alpha_cnp_arrived = false;
+		// schedule alpha update
+		ScheduleUpdateAlphaMlx(q);
+		// schedule rate decrease
+		ScheduleDecreaseRateMlx(q, 1); // add 1 ns to make sure rate decrease is after alpha update
+		// set rate on first CNP
+		mlx->m_targetRate = q->m_rate = q->m_rate * m_rateOnFirstCNP;
+		mlx->m_first_cnp = false;
+	}
+}
+
+void RdmaDcqcn::CheckRateDecreaseMlx(Ptr<RdmaQueuePair> q){
+	RdmaQpMlx *mlx = q->GetCcState<RdmaQpMlx>();
+	ScheduleDecreaseRateMlx(q, 0);
+	if (mlx->m_decrease_cnp_arrived){
+		#if PRINT_LOG
+		printf("%lu rate dec: %08x %08x %u %u (%0.3lf %.3lf)->", Simulator::Now().GetTimeStep(), q->sip.Get(), q->dip.Get(), q->sport, q->dport, mlx->m_targetRate.GetBitRate() * 1e-9, q->m_rate.GetBitRate() * 1e-9);
+		#endif
+		bool clamp = true;
+		if (!m_EcnClampTgtRate){
+			if (mlx->m_rpTimeStage == 0)
+				clamp = false;
+		}
+		if (clamp)
+			mlx->m_targetRate = q->m_rate;
+		q->m_rate = std::max(m_hw->m_minRate, q->m_rate * (1 - mlx->m_alpha / 2));
+		// reset rate increase related things
+		mlx->m_rpTimeStage = 0;
+		mlx->m_decrease_cnp_arrived = false;
+		Simulator::Cancel(mlx->m_rpTimer);
+		mlx->m_rpTimer = ScheduleTimer(MicroSeconds(m_rpgTimeReset), q, TIMER_RATE_INC);
+		#if PRINT_LOG
+		printf("(%.3lf %.3lf)\n", mlx->m_targetRate.GetBitRate() * 1e-9, q->m_rate.GetBitRate() * 1e-9);
+		#endif
+	}
+}
+void RdmaDcqcn::ScheduleDecreaseRateMlx(Ptr<RdmaQueuePair> q, uint32_t delta){
+	RdmaQpMlx *mlx = q->GetCcState<RdmaQpMlx>();
+	mlx->m_eventDecreaseRate = ScheduleTimer(MicroSeconds(m_rateDecreaseInterval) + NanoSeconds(delta), q, TIMER_DECREASE);
+}
+
+void RdmaDcqcn::RateIncEventTimerMlx(Ptr<RdmaQueuePair> q){
+	RdmaQpMlx *mlx = q->GetCcState<RdmaQpMlx>();
+	mlx->m_rpTimer = ScheduleTimer(MicroSeconds(m_rpgTimeReset), q, TIMER_RATE_INC);
+	RateIncEventMlx(q);
+	mlx->m_rpTimeStage++;
+}
+void RdmaDcqcn::RateIncEventMlx(Ptr<RdmaQueuePair> q){
+	RdmaQpMlx *mlx = q->GetCcState<RdmaQpMlx>();
+	// check which increase phase: fast recovery, active increase, hyper increase
+	if (mlx->m_rpTimeStage < m_rpgThreshold){ // fast recovery
+		FastRecoveryMlx(q);
+	}else if (mlx->m_rpTimeStage == m_rpgThreshold){ // active increase
+		ActiveIncreaseMlx(q);
+	}else { // hyper increase
+		HyperIncreaseMlx(q);
+	}
+	// a higher rate may open a variable window
+	GetNic(q)->UpdateQp(q);
+}
+
+void RdmaDcqcn::FastRecoveryMlx(Ptr<RdmaQueuePair> q){
+	RdmaQpMlx *mlx = q->GetCcState<RdmaQpMlx>();
+	#if PRINT_LOG
+	printf("%lu fast recovery: %08x %08x %u %u (%0.3lf %.3lf)->", Simulator::Now().GetTimeStep(), q->sip.Get(), q->dip.Get(), q->sport, q->dport, mlx->m_targetRate.GetBitRate() * 1e-9, q->m_rate.GetBitRate() * 1e-9);
+	#endif
+	q->m_rate = (q->m_rate / 2) + (mlx->m_targetRate / 2);
+	#if PRINT_LOG
+	printf("(%.3lf %.3lf)\n", mlx->m_targetRate.GetBitRate() * 1e-9, q->m_rate.GetBitRate() * 1e-9);
+	#endif
+}
+void RdmaDcqcn::ActiveIncreaseMlx(Ptr<RdmaQueuePair> q){
+	RdmaQpMlx *mlx = q->GetCcState<RdmaQpMlx>();
+	#if PRINT_LOG
+	printf("%lu active inc: %08x %08x %u %u (%0.3lf %.3lf)->", Simulator::Now().GetTimeStep(), q->sip.Get(), q->dip.Get(), q->sport, q->dport, mlx->m_targetRate.GetBitRate() * 1e-9, q->m_rate.GetBitRate() * 1e-9);
+	#endif
+	// get NIC
+	Ptr<QbbNetDevice> dev = GetNic(q);
+	// increate rate
+	mlx->m_targetRate += m_rai;
+	if (mlx->m_targetRate > dev->GetDataRate())
+		mlx->m_targetRate = dev->GetDataRate();
+	q->m_rate = (q->m_rate / 2) + (mlx->m_targetRate / 2);
+	#if PRINT_LOG
+	printf("(%.3lf %.3lf)\n", mlx->m_targetRate.GetBitRate() * 1e-9, q->m_rate.GetBitRate() * 1e-9);
+	#endif
+}
+void RdmaDcqcn::HyperIncreaseMlx(Ptr<RdmaQueuePair> q){
+	RdmaQpMlx *mlx = q->GetCcState<RdmaQpMlx>();
+	#if PRINT_LOG
+	printf("%lu hyper inc: %08x %08x %u %u (%0.3lf %.3lf)->", Simulator::Now().GetTimeStep(), q->sip.Get(), q->dip.Get(), q->sport, q->dport, mlx->m_targetRate.GetBitRate() * 1e-9, q->m_rate.GetBitRate() * 1e-9);
+	#endif
+	// get NIC
+	Ptr<QbbNetDevice> dev = GetNic(q);
+	// increate rate
+	mlx->m_targetRate += m_rhai;
+	if (mlx->m_targetRate > dev->GetDataRate())
+		mlx->m_targetRate = dev->GetDataRate();
+	q->m_rate = (q->m_rate / 2) + (mlx->m_targetRate / 2);
+	#if PRINT_LOG
+	printf("(%.3lf %.3lf)\n", mlx->m_targetRate.GetBitRate() * 1e-9, q->m_rate.GetBitRate() * 1e-9);
+	#endif
+}
+
+/***********************
+ * High Precision CC
+ ***********************/
+TypeId RdmaHpcc::GetTypeId (void)
+{
+	static TypeId tid = TypeId ("ns3::RdmaHpcc")
+		.SetParent<RdmaCongestionOps> ()
+		.AddConstructor<RdmaHpcc> ()
+		.AddAttribute("RateAI",
+				"Rate increment unit in AI period",
+				DataRateValue(DataRate("5Mb/s")),
+				MakeDataRateAccessor(&RdmaHpcc::m_rai),
+				MakeDataRateChecker())
+		.AddAttribute("FastReact",
+				"Fast React to congestion feedback",
+				BooleanValue(true),
+				MakeBooleanAccessor(&RdmaHpcc::m_fast_react),
+				MakeBooleanChecker())
+		.AddAttribute("MiThresh",
+				"Threshold of number of consecutive AI before MI",
+				UintegerValue(5),
+				MakeUintegerAccessor(&RdmaHpcc::m_miThresh),
+				MakeUintegerChecker<uint32_t>())
+		.AddAttribute("TargetUtil",
+				"The Target Utilization of the bottleneck bandwidth, by default 95%",
+				DoubleValue(0.95),
+				MakeDoubleAccessor(&RdmaHpcc::m_targetUtil),
+				MakeDoubleChecker<double>())
+		.AddAttribute("UtilHigh",
+				"The upper bound of Target Utilization of the bottleneck bandwidth, by default 98%",
+				DoubleValue(0.98),
+				MakeDoubleAccessor(&RdmaHpcc::m_utilHigh),
+				MakeDoubleChecker<double>())
+		.AddAttribute("MultiRate",
+				"Maintain multiple rates in HPCC",
+				BooleanValue(true),
+				MakeBooleanAccessor(&RdmaHpcc::m_multipleRate),
+				MakeBooleanChecker())
+		.AddAttribute("SampleFeedback",
+				"Whether sample feedback or not",
+				BooleanValue(false),
+				MakeBooleanAccessor(&RdmaHpcc::m_sampleFeedback),
+				MakeBooleanChecker())
+		;
+	return tid;
+}
+
+RdmaHpcc::RdmaHpcc(){
+}
+
+void RdmaHpcc::InitQp(Ptr<RdmaQueuePair> qp){
+	RdmaQpHp *hp = InitState<RdmaQpHp>(qp);
+	hp->m_curRate = qp->m_rate;
+	if (m_multipleRate){
+		for (uint32_t i = 0; i < IntHeader::maxHop; i++)
+			hp->hopState[i].Rc = qp->m_rate;
+	}
+}
+
+RdmaQpHp::RdmaQpHp(){
+	m_lastUpdateSeq = 0;
+	for (uint32_t i = 0; i < sizeof(keep) / sizeof(keep[0]); i++)
+		keep[i] = 0;
+	m_incStage = 0;
+	m_lastGap = 0;
+	u = 1;
+	for (uint32_t i = 0; i < IntHeader::maxHop; i++){
+		hopState[i].u = 1;
+		hopState[i].incStage = 0;
+	}
+}
+
+void RdmaHpcc::OnAck(Ptr<RdmaQueuePair> qp, RdmaAckFeedback &fb){
+	RdmaQpHp *hp = qp->GetCcState<RdmaQpHp>();
+	uint32_t ack_seq = fb.ack;
+	// update rate
+	if (ack_seq > hp->m_lastUpdateSeq){ // if full RTT feedback is ready, do full update
+		UpdateRateHp(qp, fb, false);
+	}else{ // do fast react
+		FastReactHp(qp, fb);
+	}
+}
+
+void RdmaHpcc::UpdateRateHp(Ptr<RdmaQueuePair> qp, RdmaAckFeedback &fb, bool fast_react){
+	RdmaQpHp *hp = qp->GetCcState<RdmaQpHp>();
+	uint32_t next_seq = fb.next;
+	if (hp->m_lastUpdateSeq == 0){ // first RTT
+		hp->m_lastUpdateSeq = next_seq;
+		// store INT
+		IntHeader &ih = *fb.ih;
+		NS_ASSERT(ih.nhop <= IntHeader::maxHop);
+		for (uint32_t i = 0; i < ih.nhop; i++)
+			hp->hop[i] = ih.hop[i];
+		#if PRINT_LOG
+		printf("%lu %s %08x %08x %u %u [%u,%u,%u]", Simulator::Now().GetTimeStep(), fast_react? "fast" : "update", qp->sip.Get(), qp->dip.Get(), qp->sport, qp->dport, hp->m_lastUpdateSeq, fb.ack, next_seq);
+		for (uint32_t i = 0; i < ih.nhop; i++)
+			printf(" %u %lu %lu", ih.hop[i].GetQlen(), ih.hop[i].GetBytes(), ih.hop[i].GetTime());
+		printf("\n");
+		#endif
+	}else {
+		// check packet INT
+		IntHeader &ih = *fb.ih;
+		if (ih.nhop <= IntHeader::maxHop){
+			double max_c = 0;
+			#if PRINT_LOG
+			printf("%lu %s %08x %08x %u %u [%u,%u,%u]", Simulator::Now().GetTimeStep(), fast_react? "fast" : "update", qp->sip.Get(), qp->dip.Get(), qp->sport, qp->dport, hp->m_lastUpdateSeq, fb.ack, next_seq);
+			#endif
+			// check each hop
+			double U = 0;
+			uint64_t dt = 0;
+			bool updated[IntHeader::maxHop] = {false}, updated_any = false;
+			NS_ASSERT(ih.nhop <= IntHeader::maxHop);
+			for (uint32_t i = 0; i < ih.nhop; i++){
+				if (m_sampleFeedback){
+					if (ih.hop[i].GetQlen() == 0 && fast_react)
+						continue;
+				}
+				updated[i] = updated_any = true;
+				#if PRINT_LOG
+				printf(" %u(%u) %lu(%lu) %lu(%lu)", ih.hop[i].GetQlen(), hp->hop[i].GetQlen(), ih.hop[i].GetBytes(), hp->hop[i].GetBytes(), ih.hop[i].GetTime(), hp->hop[i].GetTime());
+				#endif
+				uint64_t tau = ih.hop[i].GetTimeDelta(hp->hop[i]);;
+				double duration = tau * 1e-9;
+				double txRate = (ih.hop[i].GetBytesDelta(hp->hop[i])) * 8 / duration;
+				double u = txRate / ih.hop[i].GetLineRate() + (double)std::min(ih.hop[i].GetQlen(), hp->hop[i].GetQlen()) * qp->m_max_rate.GetBitRate() / ih.hop[i].GetLineRate() /qp->m_win;
+				#if PRINT_LOG
+				printf(" %.3lf %.3lf", txRate, u);
+				#endif
+				if (!m_multipleRate){
+					// for aggregate (single R)
+					if (u > U){
+						U = u;
+						dt = tau;
+					}
+				}else {
+					// for per hop (per hop R)
+					if (tau > qp->m_baseRtt)
+						tau = qp->m_baseRtt;
+					hp->hopState[i].u = (hp->hopState[i].u * (qp->m_baseRtt - tau) + u * tau) / double(qp->m_baseRtt);
+				}
+				hp->hop[i] = ih.hop[i];
+			}
+
+			DataRate new_rate;
+			int32_t new_incStage;
+			DataRate new_rate_per_hop[IntHeader::maxHop];
+			int32_t new_incStage_per_hop[IntHeader::maxHop];
+			if (!m_multipleRate){
+				// for aggregate (single R)
+				if (updated_any){
+					if (dt > qp->m_baseRtt)
+						dt = qp->m_baseRtt;
+					hp->u = (hp->u * (qp->m_baseRtt - dt) + U * dt) / double(qp->m_baseRtt);
+					max_c = hp->u / m_targetUtil;
+
+					if (max_c >= 1 || hp->m_incStage >= m_miThresh){
+						new_rate = hp->m_curRate / max_c + m_rai;
+						new_incStage = 0;
+					}else{
+						new_rate = hp->m_curRate + m_rai;
+						new_incStage = hp->m_incStage+1;
+					}
+					if (new_rate < m_hw->m_minRate)
+						new_rate = m_hw->m_minRate;
+					if (new_rate > qp->m_max_rate)
+						new_rate = qp->m_max_rate;
+					#if PRINT_LOG
+					printf(" u=%.6lf U=%.3lf dt=%u max_c=%.3lf", hp->u, U, dt, max_c);
+					#endif
+					#if PRINT_LOG
+					printf(" rate:%.3lf->%.3lf\n", hp->m_curRate.GetBitRate()*1e-9, new_rate.GetBitRate()*1e-9);
+					#endif
+				}
+			}else{
+				// for per hop (per hop R)
+				new_rate = qp->m_max_rate;
+				for (uint32_t i = 0; i < ih.nhop; i++){
+					if (updated[i]){
+						double c = hp->hopState[i].u / m_targetUtil;
+						if (c >= 1 || hp->hopState[i].incStage >= m_miThresh){
+							new_rate_per_hop[i] = hp->hopState[i].Rc / c + m_rai;
+							new_incStage_per_hop[i] = 0;
+						}else{
+							new_rate_per_hop[i] = hp->hopState[i].Rc + m_rai;
+							new_incStage_per_hop[i] = hp->hopState[i].incStage+1;
+						}
+						// bound rate
+						if (new_rate_per_hop[i] < m_hw->m_minRate)
+							new_rate_per_hop[i] = m_hw->m_minRate;
+						if (new_rate_per_hop[i] > qp->m_max_rate)
+							new_rate_per_hop[i] = qp->m_max_rate;
+						// find min new_rate
+						if (new_rate_per_hop[i] < new_rate)
+							new_rate = new_rate_per_hop[i];
+						#if PRINT_LOG
+						printf(" [%u]u=%.6lf c=%.3lf", i, hp->hopState[i].u, c);
+						#endif
+						#if PRINT_LOG
+						printf(" %.3lf->%.3lf", hp->hopState[i].Rc.GetBitRate()*1e-9, new_rate.GetBitRate()*1e-9);
+						#endif
+					}else{
+						if (hp->hopState[i].Rc < new_rate)
+							new_rate = hp->hopState[i].Rc;
+					}
+				}
+				#if PRINT_LOG
+				printf("\n");
+				#endif
+			}
+			if (updated_any)
+				m_hw->ChangeRate(qp, new_rate);
+			if (!fast_react){
+				if (updated_any){
+					hp->m_curRate = new_rate;
+					hp->m_incStage = new_incStage;
+				}
+				if (m_multipleRate){
+					// for per hop (per hop R)
+					for (uint32_t i = 0; i < ih.nhop; i++){
+						if (updated[i]){
+							hp->hopState[i].Rc = new_rate_per_hop[i];
+							hp->hopState[i].incStage = new_incStage_per_hop[i];
+						}
+					}
+				}
+			}
+		}
+		if (!fast_react){
+			if (next_seq > hp->m_lastUpdateSeq)
+				hp->m_lastUpdateSeq = next_seq; //+ rand() % 2 * m_mtu;
+		}
+	}
+}
+
+void RdmaHpcc::FastReactHp(Ptr<RdmaQueuePair> qp, RdmaAckFeedback &fb){
+	if (m_fast_react)
+		UpdateRateHp(qp, fb, true);
+}
+
+/**********************
+ * TIMELY
+ *********************/
+TypeId RdmaTimely::GetTypeId (void)
+{
+	static TypeId tid = TypeId ("ns3::RdmaTimely")
+		.SetParent<RdmaCongestionOps> ()
+		.AddConstructor<RdmaTimely> ()
+		.AddAttribute("RateAI",
+				"Rate increment unit in AI period",
+				DataRateValue(DataRate("5Mb/s")),
+				MakeDataRateAccessor(&RdmaTimely::m_rai),
+				MakeDataRateChecker())
+		.AddAttribute("RateHAI",
+				"Rate increment unit in hyperactive AI period",
+				DataRateValue(DataRate("50Mb/s")),
+				MakeDataRateAccessor(&RdmaTimely::m_rhai),
+				MakeDataRateChecker())
+		.AddAttribute("Alpha",
+				"Alpha of TIMELY",
+				DoubleValue(0.875),
+				MakeDoubleAccessor(&RdmaTimely::m_tmly_alpha),
+				MakeDoubleChecker<double>())
+		.AddAttribute("Beta",
+				"Beta of TIMELY",
+				DoubleValue(0.8),
+				MakeDoubleAccessor(&RdmaTimely::m_tmly_beta),
+				MakeDoubleChecker<double>())
+		.AddAttribute("TLow",
+				"TLow of TIMELY (ns)",
+				UintegerValue(50000),
+				MakeUintegerAccessor(&RdmaTimely::m_tmly_TLow),
+				MakeUintegerChecker<uint64_t>())
+		.AddAttribute("THigh",
+				"THigh of TIMELY (ns)",
+				UintegerValue(500000),
+				MakeUintegerAccessor(&RdmaTimely::m_tmly_THigh),
+				MakeUintegerChecker<uint64_t>())
+		.AddAttribute("MinRtt",
+				"MinRtt of TIMELY (ns)",
+				UintegerValue(20000),
+				MakeUintegerAccessor(&RdmaTimely::m_tmly_minRtt),
+				MakeUintegerChecker<uint64_t>())
+		;
+	return tid;
+}
+
+RdmaTimely::RdmaTimely(){
+}
+
+void RdmaTimely::InitQp(Ptr<RdmaQueuePair> qp){
+	RdmaQpTimely *tmly = InitState<RdmaQpTimely>(qp);
+	tmly->m_curRate = qp->m_rate;
+}
+
+RdmaQpTimely::RdmaQpTimely(){
+	m_lastUpdateSeq = 0;
+	m_incStage = 0;
+	lastRtt = 0;
+	rttDiff = 0;
+}
+
+void RdmaTimely::OnAck(Ptr<RdmaQueuePair> qp, RdmaAckFeedback &fb){
+	RdmaQpTimely *tmly = qp->GetCcState<RdmaQpTimely>();
+	uint32_t ack_seq = fb.ack;
+	// update rate
+	if (ack_seq > tmly->m_lastUpdateSeq){ // if full RTT feedback is ready, do full update
+		UpdateRateTimely(qp, fb, false);
+	}else{ // do fast react
+		FastReactTimely(qp, fb);
+	}
+}
+void RdmaTimely::UpdateRateTimely(Ptr<RdmaQueuePair> qp, RdmaAckFeedback &fb, bool us){
+	RdmaQpTimely *tmly = qp->GetCcState<RdmaQpTimely>();
+	uint32_t next_seq = fb.next;
+	uint64_t rtt = Simulator::Now().GetTimeStep() - fb.ih->ts;
+	if (tmly->m_lastUpdateSeq != 0){ // not first RTT
+		int64_t new_rtt_diff = (int64_t)rtt - (int64_t)tmly->lastRtt;
+		double rtt_diff = (1 - m_tmly_alpha) * tmly->rttDiff + m_tmly_alpha * new_rtt_diff;
+		double gradient = rtt_diff / m_tmly_minRtt;
+		bool inc = false;
+		double c = 0;
+		#if PRINT_LOG
+		if (!us)
+			printf("%lu node:%u rtt:%lu rttDiff:%.0lf gradient:%.3lf rate:%.3lf", Simulator::Now().GetTimeStep(), m_hw->m_node->GetId(), rtt, rtt_diff, gradient, tmly->m_curRate.GetBitRate() * 1e-9);
+		#endif
+		if (rtt < m_tmly_TLow){
+			inc = true;
+		}else if (rtt > m_tmly_THigh){
+			c = 1 - m_tmly_beta * (1 - (double)m_tmly_THigh / rtt);
+			inc = false;
+		}else if (gradient <= 0){
+			inc = true;
+		}else{
+			c = 1 - m_tmly_beta * gradient;
+			if (c < 0)
+				c = 0;
+			inc = false;
+		}
+		if (inc){
+			if (tmly->m_incStage < 5){
+				qp->m_rate = tmly->m_curRate + m_rai;
+			}else{
+				qp->m_rate = tmly->m_curRate + m_rhai;
+			}
+			if (qp->m_rate > qp->m_max_rate)
+				qp->m_rate = qp->m_max_rate;
+			if (!us){
+				tmly->m_curRate = qp->m_rate;
+				tmly->m_incStage++;
+				tmly->rttDiff = rtt_diff;
+			}
+		}else{
+			qp->m_rate = std::max(m_hw->m_minRate, tmly->m_curRate * c); 
+			if (!us){
+				tmly->m_curRate = qp->m_rate;
+				tmly->m_incStage = 0;
+				tmly->rttDiff = rtt_diff;
+			}
+		}
+		#if PRINT_LOG
+		if (!us){
+			printf(" %c %.3lf\n", inc? '^':'v', qp->m_rate.GetBitRate() * 1e-9);
+		}
+		#endif
+	}
+	if (!us && next_seq > tmly->m_lastUpdateSeq){
+		tmly->m_lastUpdateSeq = next_seq;
+		// update
+		tmly->lastRtt = rtt;
+	}
+}
+void RdmaTimely::FastReactTimely(Ptr<RdmaQueuePair> qp, RdmaAckFeedback &fb){
+}
+
+/**********************
+ * DCTCP
+ *********************/
+TypeId RdmaDctcp::GetTypeId (void)
+{
+	static TypeId tid = TypeId ("ns3::RdmaDctcp")
+		.SetParent<RdmaCongestionOps> ()
+		.AddConstructor<RdmaDctcp> ()
+		.AddAttribute("EwmaGain",
+				"Control gain parameter which determines the level of rate decrease",
+				DoubleValue(1.0 / 16),
+				MakeDoubleAccessor(&RdmaDctcp::m_g),
+				MakeDoubleChecker<double>())
+		.AddAttribute("RateAI",
+				"DCTCP's Rate increment unit in AI period",
+				DataRateValue(DataRate("1000Mb/s")),
+				MakeDataRateAccessor(&RdmaDctcp::m_dctcp_rai),
+				MakeDataRateChecker())
+		;
+	return tid;
+}
+
+RdmaDctcp::RdmaDctcp(){
+}
+
+void RdmaDctcp::InitQp(Ptr<RdmaQueuePair> qp){
+	InitState<RdmaQpDctcp>(qp);
+}
+
+RdmaQpDctcp::RdmaQpDctcp(){
+	m_lastUpdateSeq = 0;
+	m_caState = 0;
+	m_highSeq = 0;
+	m_alpha = 1;
+	m_ecnCnt = 0;
+	m_batchSizeOfAlpha = 0;
+}
+
+void RdmaDctcp::OnAck(Ptr<RdmaQueuePair> qp, RdmaAckFeedback &fb){
+	RdmaQpDctcp *dctcp = qp->GetCcState<RdmaQpDctcp>();
+	uint32_t ack_seq = fb.ack;
+	uint8_t cnp = fb.cnp;
+	bool new_batch = false;
+
+	// update alpha
+	dctcp->m_ecnCnt += (cnp > 0);
+	if (ack_seq > dctcp->m_lastUpdateSeq){ // if full RTT feedback is ready, do alpha update
+		#if PRINT_LOG
+		printf("%lu %s %08x %08x %u %u [%u,%u,%u] %.3lf->", Simulator::Now().GetTimeStep(), "alpha", qp->sip.Get(), qp->dip.Get(), qp->sport, qp->dport, dctcp->m_lastUpdateSeq, fb.ack, fb.next, dctcp->m_alpha);
+		#endif
+		new_batch = true;
+		if (dctcp->m_lastUpdateSeq == 0){ // first RTT
+			dctcp->m_lastUpdateSeq = fb.next;
+			dctcp->m_batchSizeOfAlpha = fb.next / m_hw->m_mtu + 1;
+		}else {
+			double frac = std::min(1.0, double(dctcp->m_ecnCnt) / dctcp->m_batchSizeOfAlpha);
+			dctcp->m_alpha = (1 - m_g) * dctcp->m_alpha + m_g * frac;
+			dctcp->m_lastUpdateSeq = fb.next;
+			dctcp->m_ecnCnt = 0;
+			dctcp->m_batchSizeOfAlpha = (fb.next - ack_seq) / m_hw->m_mtu + 1;
+			#if PRINT_LOG
+			printf("%.3lf F:%.3lf", dctcp->m_alpha, frac);
+			#endif
+		}
+		#if PRINT_LOG
+		printf("\n");
+		#endif
+	}
+
+	// check cwr exit
+	if (dctcp->m_caState == 1){
+		if (ack_seq > dctcp->m_highSeq)
+			dctcp->m_caState = 0;
+	}
+
+	// check if need to reduce rate: ECN and not in CWR
+	if (cnp && dctcp->m_caState == 0){
+		#if PRINT_LOG
+		printf("%lu %s %08x %08x %u %u %.3lf->", Simulator::Now().GetTimeStep(), "rate", qp->sip.Get(), qp->dip.Get(), qp->sport, qp->dport, qp->m_rate.GetBitRate()*1e-9);
+		#endif
+		qp->m_rate = std::max(m_hw->m_minRate, qp->m_rate * (1 - dctcp->m_alpha / 2));
+		#if PRINT_LOG
+		printf("%.3lf\n", qp->m_rate.GetBitRate() * 1e-9);
+		#endif
+		dctcp->m_caState = 1;
+		dctcp->m_highSeq = fb.next;
+	}
+
+	// additive inc
+	if (dctcp->m_caState == 0 && new_batch)
+		qp->m_rate = std::min(qp->m_max_rate, qp->m_rate + m_dctcp_rai);
+}
+
+/*********************
+ * HPCC-PINT
+ ********************/
+TypeId RdmaHpccPint::GetTypeId (void)
+{
+	static TypeId tid = TypeId ("ns3::RdmaHpccPint")
+		.SetParent<RdmaCongestionOps> ()
+		.AddConstructor<RdmaHpccPint> ()
+		.AddAttribute("RateAI",
+				"Rate increment unit in AI period",
+				DataRateValue(DataRate("5Mb/s")),
+				MakeDataRateAccessor(&RdmaHpccPint::m_rai),
+				MakeDataRateChecker())
+		.AddAttribute("MiThresh",
+				"Threshold of number of consecutive AI before MI",
+				UintegerValue(5),
+				MakeUintegerAccessor(&RdmaHpccPint::m_miThresh),
+				MakeUintegerChecker<uint32_t>())
+		.AddAttribute("TargetUtil",
+				"The Target Utilization of the bottleneck bandwidth, by default 95%",
+				DoubleValue(0.95),
+				MakeDoubleAccessor(&RdmaHpccPint::m_targetUtil),
+				MakeDoubleChecker<double>())
+		.AddAttribute("PintSmplThresh",
+				"PINT's sampling threshold, out of 65536",
+				UintegerValue(65536),
+				MakeUintegerAccessor(&RdmaHpccPint::pint_smpl_thresh),
+				MakeUintegerChecker<uint32_t>())
+		;
+	return tid;
+}
+
+RdmaHpccPint::RdmaHpccPint(){
+}
+
+void RdmaHpccPint::SetRdmaHw(RdmaHw *hw){
+	RdmaCongestionOps::SetRdmaHw(hw);
+	uint32_t id = hw->m_node != nullptr ? hw->m_node->GetId() : 0;
+	m_rng.Seed((RngSeedManager::GetSeed() * 1000003ULL + RngSeedManager::GetRun()) << 20 | id);
+}
+
+void RdmaHpccPint::InitQp(Ptr<RdmaQueuePair> qp){
+	RdmaQpHpPint *pint = InitState<RdmaQpHpPint>(qp);
+	pint->m_curRate = qp->m_rate;
+}
+
+RdmaQpHpPint::RdmaQpHpPint(){
+	m_lastUpdateSeq = 0;
+	m_incStage = 0;
+}
+
+void RdmaHpccPint::OnAck(Ptr<RdmaQueuePair> qp, RdmaAckFeedback &fb){
+	RdmaQpHpPint *pint = qp->GetCcState<RdmaQpHpPint>();
+	uint32_t ack_seq = fb.ack;
+	if ((m_rng.Next() & 0xffff) >= pint_smpl_thresh)
+		return;
+	// update rate
+	if (ack_seq > pint->m_lastUpdateSeq){ // if full RTT feedback is ready, do full update
+		UpdateRateHpPint(qp, fb, false);
+	}else{ // do fast react
+		UpdateRateHpPint(qp, fb, true);
+	}
+}
+
+void RdmaHpccPint::UpdateRateHpPint(Ptr<RdmaQueuePair> qp, RdmaAckFeedback &fb, bool fast_react){
+	RdmaQpHpPint *pint = qp->GetCcState<RdmaQpHpPint>();
+	uint32_t next_seq = fb.next;
+	if (pint->m_lastUpdateSeq == 0){ // first RTT
+		pint->m_lastUpdateSeq = next_seq;
+	}else {
+		// check packet INT
+		IntHeader &ih = *fb.ih;
+		double U = Pint::decode_u(ih.GetPower());
+
+		DataRate new_rate;
+		int32_t new_incStage;
+		double max_c = U / m_targetUtil;
+
+		if (max_c >= 1 || pint->m_incStage >= m_miThresh){
+			new_rate = pint->m_curRate / max_c + m_rai;
+			new_incStage = 0;
+		}else{
+			new_rate = pint->m_curRate + m_rai;
+			new_incStage = pint->m_incStage+1;
+		}
+		if (new_rate < m_hw->m_minRate)
+			new_rate = m_hw->m_minRate;
+		if (new_rate > qp->m_max_rate)
+			new_rate = qp->m_max_rate;
+		m_hw->ChangeRate(qp, new_rate);
+		if (!fast_react){
+			pint->m_curRate = new_rate;
+			pint->m_incStage = new_incStage;
+		}
+		if (!fast_react){
+			if (next_seq > pint->m_lastUpdateSeq)
+				pint->m_lastUpdateSeq = next_seq; //+ rand() % 2 * m_mtu;
+		}
+	}
+}
+
+} /* namespace ns3 */
@@ -0,0 +1,264 @@
+#ifndef RDMA_CONGESTION_OPS_H
+#define RDMA_CONGESTION_OPS_H
+
+#include <ns3/object.h>
+#include <ns3/data-rate.h>
+#include <ns3/event-id.h>
+#include <ns3/nstime.h>
+#include <ns3/int-header.h>
+#include <ns3/rdma-queue-pair.h>
+#include <ns3/pint.h>
+
+namespace ns3 {
+
+class RdmaHw;
+class QbbNetDevice;
+
+/**
+ * What an ACK tells the CC engines, in the sequence space of the transport
+ * that carried it: go-back-N acks up to seq of the bytes up to snd_nxt, the
+ * coding transport counts the bytes of the symbols sent and received.
+ */
+struct RdmaAckFeedback{
+	uint32_t ack; // bytes the receiver got
+	uint64_t next; // bytes sent
+	bool cnp; // the acked packet was ECN marked
+	IntHeader *ih; // INT it collected, echoed by the ACK
+};
+
+/**
+ * The congestion control of the qps of an RdmaHw, which creates one from the
+ * TypeId of its CongestionOps attribute, or of its CcMode. Each algorithm
+ * keeps its parameters as attributes, set with Config::SetDefault, and the
+ * state of a qp in a block of its slab. The base class leaves the rates at
+ * line rate, as for cc_mode 0 and CNCP, where the switches set the rates.
+ *
+ * RdmaHw calls InitQp once a qp was added at line rate, OnCnp then OnAck for
+ * each ACK of an ECN marked packet and only OnAck for the others, OnSent for
+ * each data packet the NIC sent and OnComplete once all the bytes of the qp
+ * are acked. OnTimer runs the timers an algorithm scheduled with
+ * ScheduleTimer.
+ */
+class RdmaCongestionOps : public Object {
+public:
+	static TypeId GetTypeId (void);
+	static TypeId GetTypeIdOfCcMode(uint32_t ccMode); // the algorithm of a cc_mode
+	RdmaCongestionOps();
+
+	virtual void SetRdmaHw(RdmaHw *hw); // once the node of hw is set
+	Ptr<RdmaCcSlab> GetSlab(); // of the states of the qps, NULL until the first one
+
+	virtual void InitQp(Ptr<RdmaQueuePair> qp); // qp sends at qp->m_rate, its line rate
+	virtual void OnAck(Ptr<RdmaQueuePair> qp, RdmaAckFeedback &fb);
+	virtual void OnCnp(Ptr<RdmaQueuePair> qp);
+	virtual void OnSent(Ptr<RdmaQueuePair> qp, uint32_t pktSize);
+	virtual void OnTimer(Ptr<RdmaQueuePair> qp, uint32_t timer);
+	virtual void OnComplete(Ptr<RdmaQueuePair> qp);
+
+protected:
+	// the state of qp, created on the first call
+	template <typename T>
+	T *InitState(Ptr<RdmaQueuePair> qp){
+		if (qp->m_cc != NULL)
+			return qp->GetCcState<T>();
+		if (m_slab == nullptr)
+			m_slab = Create<RdmaCcSlab>(sizeof(T));
+		return qp->NewCcState<T>(m_slab);
+	}
+	EventId ScheduleTimer(Time delay, Ptr<RdmaQueuePair> qp, uint32_t timer); // OnTimer(qp, timer) after delay
+	Ptr<QbbNetDevice> GetNic(Ptr<RdmaQueuePair> qp); // the NIC sending qp
+
+	RdmaHw *m_hw; // owns this
+	Ptr<RdmaCcSlab> m_slab;
+};
+
+/******************************
+ * Mellanox's version of DCQCN
+ *****************************/
+struct RdmaQpMlx {
+	DataRate m_targetRate;	//< Target rate
+	EventId m_eventUpdateAlpha;
+	double m_alpha;
+	bool m_alpha_cnp_arrived; // indicate if CNP arrived in the last slot
+	bool m_first_cnp; // indicate if the current CNP is the first CNP
+	EventId m_eventDecreaseRate;
+	bool m_decrease_cnp_arrived; // indicate if CNP arrived in the last slot
+	uint32_t m_rpTimeStage;
+	EventId m_rpTimer;
+
+	RdmaQpMlx();
+};
+
+class RdmaDcqcn : public RdmaCongestionOps {
+public:
+	static TypeId GetTypeId (void);
+	RdmaDcqcn();
+
+	void InitQp(Ptr<RdmaQueuePair> qp) override;
+	void OnCnp(Ptr<RdmaQueuePair> qp) override;
+	void OnTimer(Ptr<RdmaQueuePair> qp, uint32_t timer) override;
+	void OnComplete(Ptr<RdmaQueuePair> qp) override;
+
+	double m_g; //feedback weight
+	double m_rateOnFirstCNP; // the fraction of line rate to set on first CNP
+	bool m_EcnClampTgtRate;
+	double m_rpgTimeReset;
+	double m_rateDecreaseInterval;
+	uint32_t m_rpgThreshold;
+	double m_alpha_resume_interval;
+	DataRate m_rai;		//< Rate of additive increase
+	DataRate m_rhai;		//< Rate of hyper-additive increase
+
+private:
+	enum { TIMER_ALPHA, TIMER_DECREASE, TIMER_RATE_INC };
+
+	// the Mellanox's version of alpha update:
+	// every fixed time slot, update alpha.
+	void UpdateAlphaMlx(Ptr<RdmaQueuePair> q);
+	void ScheduleUpdateAlphaMlx(Ptr<RdmaQueuePair> q);
+
+	// Mellanox's version of rate decrease
+	// It checks every m_rateDecreaseInterval if CNP arrived (m_decrease_cnp_arrived).
+	// If so, decrease rate, and reset all rate increase related things
+	void CheckRateDecreaseMlx(Ptr<RdmaQueuePair> q);
+	void ScheduleDecreaseRateMlx(Ptr<RdmaQueuePair> q, uint32_t delta);
+
+	// Mellanox's version of rate increase
+	void RateIncEventTimerMlx(Ptr<RdmaQueuePair> q);
+	void RateIncEventMlx(Ptr<RdmaQueuePair> q);
+	void FastRecoveryMlx(Ptr<RdmaQueuePair> q);
+	void ActiveIncreaseMlx(Ptr<RdmaQueuePair> q);
+	void HyperIncreaseMlx(Ptr<RdmaQueuePair> q);
+};
+
+/***********************
+ * High Precision CC
+ ***********************/
+struct RdmaQpHp {
+	uint32_t m_lastUpdateSeq;
+	DataRate m_curRate;
+	IntHop hop[IntHeader::maxHop];
+	uint32_t keep[IntHeader::maxHop];
+	uint32_t m_incStage;
+	double m_lastGap;
+	double u;
+	struct {
+		double u;
+		DataRate Rc;
+		uint32_t incStage;
+	}hopState[IntHeader::maxHop];
+
+	RdmaQpHp();
+};
+
+class RdmaHpcc : public RdmaCongestionOps {
+public:
+	static TypeId GetTypeId (void);
+	RdmaHpcc();
+
+	void InitQp(Ptr<RdmaQueuePair> qp) override;
+	void OnAck(Ptr<RdmaQueuePair> qp, RdmaAckFeedback &fb) override;
+
+	DataRate m_rai;		//< Rate of additive increase
+	double m_targetUtil;
+	double m_utilHigh;
+	uint32_t m_miThresh;
+	bool m_fast_react;
+	bool m_multipleRate;
+	bool m_sampleFeedback; // only react to feedback every RTT, or qlen > 0
+
+private:
+	void UpdateRateHp(Ptr<RdmaQueuePair> qp, RdmaAckFeedback &fb, bool fast_react);
+	void FastReactHp(Ptr<RdmaQueuePair> qp, RdmaAckFeedback &fb);
+};
+
+/**********************
+ * TIMELY
+ *********************/
+struct RdmaQpTimely {
+	uint32_t m_lastUpdateSeq;
+	DataRate m_curRate;
+	uint32_t m_incStage;
+	uint64_t lastRtt;
+	double rttDiff;
+
+	RdmaQpTimely();
+};
+
+class RdmaTimely : public RdmaCongestionOps {
+public:
+	static TypeId GetTypeId (void);
+	RdmaTimely();
+
+	void InitQp(Ptr<RdmaQueuePair> qp) override;
+	void OnAck(Ptr<RdmaQueuePair> qp, RdmaAckFeedback &fb) override;
+
+	DataRate m_rai;		//< Rate of additive increase
+	DataRate m_rhai;		//< Rate of hyper-additive increase
+	double m_tmly_alpha, m_tmly_beta;
+	uint64_t m_tmly_TLow, m_tmly_THigh, m_tmly_minRtt;
+
+private:
+	void UpdateRateTimely(Ptr<RdmaQueuePair> qp, RdmaAckFeedback &fb, bool us);
+	void FastReactTimely(Ptr<RdmaQueuePair> qp, RdmaAckFeedback &fb);
+};
+
+/**********************
+ * DCTCP
+ *********************/
+struct RdmaQpDctcp {
+	uint32_t m_lastUpdateSeq;
+	uint32_t m_caState;
+	uint32_t m_highSeq; // when to exit cwr
+	double m_alpha;
+	uint32_t m_ecnCnt;
+	uint32_t m_batchSizeOfAlpha;
+
+	RdmaQpDctcp();
+};
+
+class RdmaDctcp : public RdmaCongestionOps {
+public:
+	static TypeId GetTypeId (void);
+	RdmaDctcp();
+
+	void InitQp(Ptr<RdmaQueuePair> qp) override;
+	void OnAck(Ptr<RdmaQueuePair> qp, RdmaAckFeedback &fb) override;
+
+	double m_g; //feedback weight
+	DataRate m_dctcp_rai;
+};
+
+/*********************
+ * HPCC-PINT
+ ********************/
+struct RdmaQpHpPint {
+	uint32_t m_lastUpdateSeq;
+	DataRate m_curRate;
+	uint32_t m_incStage;
+
+	RdmaQpHpPint();
+};
+
+class RdmaHpccPint : public RdmaCongestionOps {
+public:
+	static TypeId GetTypeId (void);
+	RdmaHpccPint();
+
+	void SetRdmaHw(RdmaHw *hw) override;
+	void InitQp(Ptr<RdmaQueuePair> qp) override;
+	void OnAck(Ptr<RdmaQueuePair> qp, RdmaAckFeedback &fb) override;
+
+	DataRate m_rai;		//< Rate of additive increase
+	double m_targetUtil;
+	uint32_t m_miThresh;
+	uint32_t pint_smpl_thresh; // react to an ACK if a random number of 16 bits is below
+
+private:
+	PintRng m_rng; // of the sampling, seeded from the run and the node
+	void UpdateRateHpPint(Ptr<RdmaQueuePair> qp, RdmaAckFeedback &fb, bool fast_react);
+};
+
+} /* namespace ns3 */
+
+#endif /* RDMA_CONGESTION_OPS_H */
@@ -1,4 +1,5 @@
 #include "rdma-driver.h"
+#include "ns3/simulator.h"
 
 namespace ns3 {
 
@@ -17,6 +18,7 @@ TypeId RdmaDriver::GetTypeId (void)
 }
 
 RdmaDriver::RdmaDriver(){
+	m_flowSeq = 0;
 }
 
 void RdmaDriver::Init(void){
@@ -65,6 +67,26 @@ void RdmaDriver::AddQueuePair(uint64_t size, uint16_t pg, Ipv4Address sip, Ipv4A
 	m_rdma->AddQueuePair(size, pg, sip, dip, sport, dport, win, baseRtt, notifyAppFinish);
 }
 
+void RdmaDriver::AddFlow(const Flow &f){
+	Flow flow = f;
+	flow.seq = m_flowSeq++;
+	m_flows.push(flow);
+	if (m_flowEvent.IsPending() && m_flows.top().start < f.start)
+		return; // the earliest flow is already waited for
+	m_flowEvent.Cancel();
+	m_flowEvent = Simulator::Schedule(Max(m_flows.top().start - Simulator::Now(), Time(0)), &RdmaDriver::StartFlows, this);
+}
+
+void RdmaDriver::StartFlows(void){
+	while (!m_flows.empty() && m_flows.top().start <= Simulator::Now()){
+		const Flow &f = m_flows.top();
+		m_rdma->AddQueuePair(f.size, f.pg, f.sip, f.dip, f.sport, f.dport, f.win, f.baseRtt, Callback<void>());
+		m_flows.pop();
+	}
+	if (!m_flows.empty())
+		m_flowEvent = Simulator::Schedule(m_flows.top().start - Simulator::Now(), &RdmaDriver::StartFlows, this);
+}
+
 void RdmaDriver::QpComplete(Ptr<RdmaQueuePair> q){
 	m_traceQpComplete(q);
 }
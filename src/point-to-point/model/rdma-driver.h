@@ -7,12 +7,26 @@
 #include <ns3/rdma-queue-pair.h>
 #include <ns3/rdma-hw.h>
 #include <vector>
+#include <queue>
 #include <unordered_map>
 
 namespace ns3 {
 
 class RdmaDriver : public Object {
 public:
+	// a flow to start on this host, see AddFlow
+	struct Flow {
+		Time start;
+		uint64_t size;
+		uint16_t pg;
+		Ipv4Address sip, dip;
+		uint16_t sport, dport;
+		uint32_t win;
+		uint64_t baseRtt;
+		uint64_t seq; // set by AddFlow, flows of the same start time start in the order they were added
+		bool operator>(const Flow &b) const { return start > b.start || (start == b.start && seq > b.seq); }
+	};
+
 	Ptr<Node> m_node;
 	Ptr<RdmaHw> m_rdma;
 
@@ -35,8 +49,20 @@ public:
 	// add a queue pair
 	void AddQueuePair(uint64_t size, uint16_t pg, Ipv4Address _sip, Ipv4Address _dip, uint16_t _sport, uint16_t _dport, uint32_t win, uint64_t baseRtt, Callback<void> notifyAppFinish);
 
+	// queue a flow, which becomes a queue pair at its start time. Unlike
+	// RdmaClient, no Application or other per-flow object is kept around, so
+	// memory follows the number of queued and active flows
+	void AddFlow(const Flow &f);
+
 	// callback when qp completes
 	void QpComplete(Ptr<RdmaQueuePair> q);
+
+private:
+	void StartFlows(void); // start the flows that are due, and wait for the next one
+
+	std::priority_queue<Flow, std::vector<Flow>, std::greater<Flow> > m_flows; // by start time, then seq
+	uint64_t m_flowSeq; // of the next flow added
+	EventId m_flowEvent;
 };
 
 } // namespace ns3
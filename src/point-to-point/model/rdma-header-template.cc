@@ -0,0 +1,206 @@
+#include <stdint.h>
+#include <string.h>
+#include <iostream>
+#include "rdma-header-template.h"
+#include "ppp-header.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/udp-header.h"
+#include "ns3/rdma-seq-ts-header.h"
+#include "qbb-header.h"
+#include "ns3/int-header.h"
+#include "ns3/packet.h"
+#include "ns3/simulator.h"
+#include "ns3/log.h"
+
+NS_LOG_COMPONENT_DEFINE("RdmaHeaderTemplate");
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED(RdmaHeaderTemplate);
+
+RdmaHeaderTemplate::RdmaHeaderTemplate ()
+  : m_size(0), m_ipOff(0), m_l4Off(0), m_seqOff(0), m_ack(false)
+{
+}
+
+bool RdmaHeaderTemplate::IsBuilt () const
+{
+	return m_size > 0;
+}
+
+void RdmaHeaderTemplate::Build (Ipv4Address sip, Ipv4Address dip, uint16_t sport, uint16_t dport, uint16_t pg)
+{
+	// serialize the headers the same way RdmaHw::GetNxtPacket did, on an empty packet
+	Ptr<Packet> p = Create<Packet> (0);
+	RDMASeqTsHeader seqTs;
+	seqTs.SetSeq (0);
+	seqTs.SetPG (pg);
+	p->AddHeader (seqTs);
+	UdpHeader udpHeader;
+	udpHeader.SetDestinationPort (dport);
+	udpHeader.SetSourcePort (sport);
+	p->AddHeader (udpHeader);
+	Ipv4Header ipHeader;
+	ipHeader.SetSource (sip);
+	ipHeader.SetDestination (dip);
+	ipHeader.SetProtocol (0x11);
+	ipHeader.SetPayloadSize (p->GetSize());
+	ipHeader.SetTtl (64);
+	ipHeader.SetTos (0);
+	ipHeader.SetIdentification (0);
+	p->AddHeader (ipHeader);
+	m_ack = false;
+	uint32_t l4Off = PppHeader::GetStaticSize() + ipHeader.GetSerializedSize();
+	Finish(p, l4Off, l4Off + udpHeader.GetSerializedSize());
+}
+
+void RdmaHeaderTemplate::BuildAck (Ipv4Address sip, Ipv4Address dip, uint16_t sport, uint16_t dport, uint16_t pg)
+{
+	// the same way RdmaHw::ReceiveUdp built ACKs, the INT is written per packet
+	Ptr<Packet> p = Create<Packet> (0);
+	qbbHeader seqh;
+	seqh.SetSeq(0);
+	seqh.SetPG(pg);
+	seqh.SetSport(sport);
+	seqh.SetDport(dport);
+	p->AddHeader(seqh);
+	Ipv4Header head;
+	head.SetDestination(dip);
+	head.SetSource(sip);
+	head.SetProtocol(0xFC); //ack=0xFC nack=0xFD
+	head.SetTtl(64);
+	head.SetPayloadSize(p->GetSize());
+	head.SetIdentification(0);
+	p->AddHeader(head);
+	m_ack = true;
+	uint32_t l4Off = PppHeader::GetStaticSize() + head.GetSerializedSize();
+	Finish(p, l4Off, l4Off + 8);
+}
+
+void RdmaHeaderTemplate::Finish (Ptr<Packet> p, uint32_t l4Off, uint32_t seqOff)
+{
+	PppHeader ppp;
+	ppp.SetProtocol (0x0021); // EtherToPpp(0x800), see point-to-point-net-device.cc
+	p->AddHeader (ppp);
+
+	NS_ASSERT(p->GetSize() <= maxSize);
+	m_size = p->GetSize();
+	m_ipOff = PppHeader::GetStaticSize();
+	m_l4Off = l4Off;
+	m_seqOff = seqOff;
+	p->CopyData(m_buf, m_size);
+	// PppHeader only writes its protocol, clear the rest rather than keep stale buffer bytes
+	memset(&m_buf[2], 0, m_ipOff - 2);
+}
+
+void RdmaHeaderTemplate::SetDataFlow (Ipv4Address sip, Ipv4Address dip, uint16_t sport, uint16_t dport, uint16_t pg)
+{
+	NS_ASSERT(!m_ack);
+	WriteHtonU32(m_ipOff + 12, sip.Get());
+	WriteHtonU32(m_ipOff + 16, dip.Get());
+	WriteHtonU16(m_l4Off, sport);
+	WriteHtonU16(m_l4Off + 2, dport);
+	WriteHtonU16(m_seqOff + 4, pg);
+}
+
+void RdmaHeaderTemplate::SetData (uint32_t seq, uint16_t ipid, uint32_t payloadSize)
+{
+	uint32_t udpLen = m_size - m_l4Off + payloadSize;
+	WriteHtonU16(m_ipOff + 2, udpLen + 20); // total length
+	WriteHtonU16(m_ipOff + 4, ipid);
+	WriteHtonU16(m_l4Off + 4, udpLen);
+	WriteHtonU32(m_seqOff, seq);
+	if (IntHeader::mode == IntHeader::TS){
+		// RDMASeqTsHeader stamps the time it is created, IntHeader writes it with WriteU64
+		uint64_t ts = Simulator::Now().GetTimeStep();
+		uint8_t *b = &m_buf[m_seqOff + 6];
+		for (uint32_t i = 0; i < 8; i++, ts >>= 8)
+			b[i] = ts & 0xff;
+	}
+}
+
+void RdmaHeaderTemplate::SetAck (uint32_t seq, uint16_t ipid, bool nack, bool cnp, const IntHeader &ih, uint32_t payloadSize)
+{
+	WriteHtonU16(m_ipOff + 2, m_size - m_l4Off + payloadSize + 20); // total length
+	WriteHtonU16(m_ipOff + 4, ipid);
+	m_buf[m_ipOff + 9] = nack ? 0xFD : 0xFC;
+	// qbbHeader writes its fields in host order
+	uint16_t flags = cnp ? 1 << qbbHeader::FLAG_CNP : 0;
+	m_buf[m_l4Off + 4] = flags & 0xff;
+	m_buf[m_l4Off + 5] = flags >> 8;
+	for (uint32_t i = 0; i < 4; i++, seq >>= 8)
+		m_buf[m_seqOff + i] = seq & 0xff;
+	m_ih = ih;
+}
+
+void RdmaHeaderTemplate::SetAckFlow (Ipv4Address sip, Ipv4Address dip, uint16_t sport, uint16_t dport, uint16_t pg)
+{
+	NS_ASSERT(m_ack);
+	WriteHtonU32(m_ipOff + 12, sip.Get());
+	WriteHtonU32(m_ipOff + 16, dip.Get());
+	// qbbHeader writes its fields in host order
+	uint16_t f[2] = {sport, dport};
+	for (uint32_t i = 0; i < 2; i++){
+		m_buf[m_l4Off + 2 * i] = f[i] & 0xff;
+		m_buf[m_l4Off + 2 * i + 1] = f[i] >> 8;
+	}
+	m_buf[m_l4Off + 6] = pg & 0xff;
+	m_buf[m_l4Off + 7] = pg >> 8;
+}
+
+void RdmaHeaderTemplate::WriteHtonU16 (uint32_t off, uint16_t v)
+{
+	m_buf[off] = v >> 8;
+	m_buf[off + 1] = v & 0xff;
+}
+
+void RdmaHeaderTemplate::WriteHtonU32 (uint32_t off, uint32_t v)
+{
+	m_buf[off] = v >> 24;
+	m_buf[off + 1] = (v >> 16) & 0xff;
+	m_buf[off + 2] = (v >> 8) & 0xff;
+	m_buf[off + 3] = v & 0xff;
+}
+
+TypeId RdmaHeaderTemplate::GetTypeId (void)
+{
+	static TypeId tid = TypeId ("ns3::RdmaHeaderTemplate")
+		.SetParent<Header> ()
+		.AddConstructor<RdmaHeaderTemplate> ()
+		;
+	return tid;
+}
+
+TypeId RdmaHeaderTemplate::GetInstanceTypeId (void) const
+{
+	return GetTypeId ();
+}
+
+void RdmaHeaderTemplate::Print (std::ostream &os) const
+{
+	os << (m_ack ? "rdma ack headers, " : "rdma data headers, ") << m_size << " bytes";
+}
+
+uint32_t RdmaHeaderTemplate::GetSerializedSize (void) const
+{
+	return m_size;
+}
+
+void RdmaHeaderTemplate::Serialize (Buffer::Iterator start) const
+{
+	if (m_ack){
+		uint32_t intOff = m_seqOff + 4;
+		start.Write (m_buf, intOff);
+		m_ih.Serialize(start);
+	}else
+		start.Write (m_buf, m_size);
+}
+
+uint32_t RdmaHeaderTemplate::Deserialize (Buffer::Iterator start)
+{
+	// the receivers parse the individual headers, this is only for completeness
+	start.Read (m_buf, m_size);
+	return m_size;
+}
+
+} // namespace ns3
@@ -0,0 +1,70 @@
+#ifndef RDMA_HEADER_TEMPLATE_H
+#define RDMA_HEADER_TEMPLATE_H
+
+#include <stdint.h>
+#include "ns3/header.h"
+#include "ns3/buffer.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/int-header.h"
+#include "ns3/ptr.h"
+
+namespace ns3 {
+
+class Packet;
+
+/**
+ * \brief Pre-serialized headers of the data packets or of the ACK/NACKs of
+ * an RdmaHw
+ *
+ * A data template holds ppp+ipv4+udp+RDMASeqTs, an ACK template ppp+ipv4+
+ * qbbHeader. The bytes are produced once by serializing the real headers,
+ * exactly as RdmaHw used to build every packet. One template of each kind
+ * serves every qp: per packet it is retargeted to the flow (addresses, ports,
+ * pg), the fields that change are patched (IPv4 length, identification and
+ * protocol, UDP length, sequence number, ACK flags, INT) and the whole header
+ * is added to the packet with a single AddHeader.
+ *
+ * Checksums are not computed for RDMA packets, so none is patched here.
+ */
+class RdmaHeaderTemplate : public Header
+{
+public:
+  RdmaHeaderTemplate ();
+
+  bool IsBuilt () const;
+  void Build (Ipv4Address sip, Ipv4Address dip, uint16_t sport, uint16_t dport, uint16_t pg);
+  // retarget a built data template to another flow, so that one template serves every qp
+  void SetDataFlow (Ipv4Address sip, Ipv4Address dip, uint16_t sport, uint16_t dport, uint16_t pg);
+  // set the fields of the next data packet, with payloadSize bytes after the headers
+  void SetData (uint32_t seq, uint16_t ipid, uint32_t payloadSize);
+  void BuildAck (Ipv4Address sip, Ipv4Address dip, uint16_t sport, uint16_t dport, uint16_t pg);
+  // retarget a built ACK template to another flow, so that one template serves every rx qp
+  void SetAckFlow (Ipv4Address sip, Ipv4Address dip, uint16_t sport, uint16_t dport, uint16_t pg);
+  // set the fields of the next ACK (or NACK), which echoes the INT of the data packet
+  void SetAck (uint32_t seq, uint16_t ipid, bool nack, bool cnp, const IntHeader &ih, uint32_t payloadSize);
+
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual void Print (std::ostream &os) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (Buffer::Iterator start) const;
+  virtual uint32_t Deserialize (Buffer::Iterator start);
+
+  static const uint32_t maxSize = 96; // ppp(14) + ipv4(20) + udp(8) + seqTs(6) + INT(42 at most), ACKs are smaller
+
+private:
+  void WriteHtonU16 (uint32_t off, uint16_t v);
+  void WriteHtonU32 (uint32_t off, uint32_t v);
+
+  void Finish (Ptr<Packet> p, uint32_t l4Off, uint32_t seqOff);
+
+  uint32_t m_size; // 0 until Build
+  uint32_t m_ipOff, m_l4Off, m_seqOff;
+  bool m_ack;
+  IntHeader m_ih; // written after the qbbHeader fields of an ACK
+  uint8_t m_buf[maxSize];
+};
+
+} // namespace ns3
+
+#endif /* RDMA_HEADER_TEMPLATE_H */
@@ -8,6 +8,7 @@
 #include "ns3/double.h"
 #include "ns3/data-rate.h"
 #include "ns3/pointer.h"
+#include "ns3/object-factory.h"
 #include "rdma-hw.h"
 #include "ppp-header.h"
 #include "qbb-header.h"
@@ -36,6 +37,11 @@ TypeId RdmaHw::GetTypeId (void)
 				UintegerValue(0),
 				MakeUintegerAccessor(&RdmaHw::m_cc_mode),
 				MakeUintegerChecker<uint32_t>())
+		.AddAttribute("CongestionOps",
+				"The CC of the qps, a subclass of ns3::RdmaCongestionOps; by default the one of CcMode",
+				TypeIdValue(RdmaCongestionOps::GetTypeId()),
+				MakeTypeIdAccessor(&RdmaHw::m_ccTypeId),
+				MakeTypeIdChecker())
 		.AddAttribute("NACKGenerationInterval",
 				"The NACK Generation interval",
 				DoubleValue(500.0),
@@ -56,136 +62,78 @@ TypeId RdmaHw::GetTypeId (void)
 				BooleanValue(false),
 				MakeBooleanAccessor(&RdmaHw::m_backto0),
 				MakeBooleanChecker())
-		.AddAttribute("EwmaGain",
-				"Control gain parameter which determines the level of rate decrease",
-				DoubleValue(1.0 / 16),
-				MakeDoubleAccessor(&RdmaHw::m_g),
-				MakeDoubleChecker<double>())
-		.AddAttribute ("RateOnFirstCnp",
-				"the fraction of rate on first CNP",
-				DoubleValue(1.0),
-				MakeDoubleAccessor(&RdmaHw::m_rateOnFirstCNP),
-				MakeDoubleChecker<double> ())
-		.AddAttribute("ClampTargetRate",
-				"Clamp target rate.",
-				BooleanValue(false),
-				MakeBooleanAccessor(&RdmaHw::m_EcnClampTgtRate),
-				MakeBooleanChecker())
-		.AddAttribute("RPTimer",
-				"The rate increase timer at RP in microseconds",
-				DoubleValue(1500.0),
-				MakeDoubleAccessor(&RdmaHw::m_rpgTimeReset),
-				MakeDoubleChecker<double>())
-		.AddAttribute("RateDecreaseInterval",
-				"The interval of rate decrease check",
-				DoubleValue(4.0),
-				MakeDoubleAccessor(&RdmaHw::m_rateDecreaseInterval),
-				MakeDoubleChecker<double>())
-		.AddAttribute("FastRecoveryTimes",
-				"The rate increase timer at RP",
-				UintegerValue(5),
-				MakeUintegerAccessor(&RdmaHw::m_rpgThreshold),
-				MakeUintegerChecker<uint32_t>())
-		.AddAttribute("AlphaResumInterval",
-				"The interval of resuming alpha",
-				DoubleValue(55.0),
-				MakeDoubleAccessor(&RdmaHw::m_alpha_resume_interval),
-				MakeDoubleChecker<double>())
-		.AddAttribute("RateAI",
-				"Rate increment unit in AI period",
-				DataRateValue(DataRate("5Mb/s")),
-				MakeDataRateAccessor(&RdmaHw::m_rai),
-				MakeDataRateChecker())
-		.AddAttribute("RateHAI",
-				"Rate increment unit in hyperactive AI period",
-				DataRateValue(DataRate("50Mb/s")),
-				MakeDataRateAccessor(&RdmaHw::m_rhai),
-				MakeDataRateChecker())
 		.AddAttribute("VarWin",
 				"Use variable window size or not",
 				BooleanValue(false),
 				MakeBooleanAccessor(&RdmaHw::m_var_win),
 				MakeBooleanChecker())
-		.AddAttribute("FastReact",
-				"Fast React to congestion feedback",
-				BooleanValue(true),
-				MakeBooleanAccessor(&RdmaHw::m_fast_react),
-				MakeBooleanChecker())
-		.AddAttribute("MiThresh",
-				"Threshold of number of consecutive AI before MI",
-				UintegerValue(5),
-				MakeUintegerAccessor(&RdmaHw::m_miThresh),
-				MakeUintegerChecker<uint32_t>())
-		.AddAttribute("TargetUtil",
-				"The Target Utilization of the bottleneck bandwidth, by default 95%",
-				DoubleValue(0.95),
-				MakeDoubleAccessor(&RdmaHw::m_targetUtil),
-				MakeDoubleChecker<double>())
-		.AddAttribute("UtilHigh",
-				"The upper bound of Target Utilization of the bottleneck bandwidth, by default 98%",
-				DoubleValue(0.98),
-				MakeDoubleAccessor(&RdmaHw::m_utilHigh),
-				MakeDoubleChecker<double>())
 		.AddAttribute("RateBound",
 				"Bound packet sending by rate, for test only",
 				BooleanValue(true),
 				MakeBooleanAccessor(&RdmaHw::m_rateBound),
 				MakeBooleanChecker())
-		.AddAttribute("MultiRate",
-				"Maintain multiple rates in HPCC",
-				BooleanValue(true),
-				MakeBooleanAccessor(&RdmaHw::m_multipleRate),
-				MakeBooleanChecker())
-		.AddAttribute("SampleFeedback",
-				"Whether sample feedback or not",
-				BooleanValue(false),
-				MakeBooleanAccessor(&RdmaHw::m_sampleFeedback),
-				MakeBooleanChecker())
-		.AddAttribute("TimelyAlpha",
-				"Alpha of TIMELY",
-				DoubleValue(0.875),
-				MakeDoubleAccessor(&RdmaHw::m_tmly_alpha),
-				MakeDoubleChecker<double>())
-		.AddAttribute("TimelyBeta",
-				"Beta of TIMELY",
-				DoubleValue(0.8),
-				MakeDoubleAccessor(&RdmaHw::m_tmly_beta),
-				MakeDoubleChecker<double>())
-		.AddAttribute("TimelyTLow",
-				"TLow of TIMELY (ns)",
-				UintegerValue(50000),
-				MakeUintegerAccessor(&RdmaHw::m_tmly_TLow),
-				MakeUintegerChecker<uint64_t>())
-		.AddAttribute("TimelyTHigh",
-				"THigh of TIMELY (ns)",
-				UintegerValue(500000),
-				MakeUintegerAccessor(&RdmaHw::m_tmly_THigh),
-				MakeUintegerChecker<uint64_t>())
-		.AddAttribute("TimelyMinRtt",
-				"MinRtt of TIMELY (ns)",
-				UintegerValue(20000),
-				MakeUintegerAccessor(&RdmaHw::m_tmly_minRtt),
-				MakeUintegerChecker<uint64_t>())
-		.AddAttribute("DctcpRateAI",
-				"DCTCP's Rate increment unit in AI period",
-				DataRateValue(DataRate("1000Mb/s")),
-				MakeDataRateAccessor(&RdmaHw::m_dctcp_rai),
-				MakeDataRateChecker())
-		.AddAttribute("PintSmplThresh",
-				"PINT's sampling threshold in rand()%65536",
-				UintegerValue(65536),
-				MakeUintegerAccessor(&RdmaHw::pint_smpl_thresh),
-				MakeUintegerChecker<uint32_t>())
 		.AddAttribute("CodingTransport",
 				"Enable coding-based transport or not",
 				BooleanValue(false),
 				MakeBooleanAccessor(&RdmaHw::m_is_use_coding_transport),
 				MakeBooleanChecker())
+		.AddAttribute("CodingCc",
+				"Coding transport: coding qps follow the CongestionOps, otherwise they send at line rate, within their window if any",
+				BooleanValue(false),
+				MakeBooleanAccessor(&RdmaHw::m_codingCc),
+				MakeBooleanChecker())
+		.AddAttribute("CodingAckInterval",
+				"Coding transport: the receiver acks once per this many symbols (1: every symbol)",
+				UintegerValue(1),
+				MakeUintegerAccessor(&RdmaHw::m_codingAckInterval),
+				MakeUintegerChecker<uint32_t>(1))
+		.AddAttribute("CodingAckDelay",
+				"Coding transport: the longest a received symbol waits for a coalesced ack",
+				TimeValue(MicroSeconds(1)),
+				MakeTimeAccessor(&RdmaHw::m_codingAckDelay),
+				MakeTimeChecker())
+		.AddAttribute("CodingGenerationSize",
+				"Coding transport: source symbols per generation, at most 4096; 0 streams symbols that are all useful",
+				UintegerValue(0),
+				MakeUintegerAccessor(&RdmaHw::m_codingGenSize),
+				MakeUintegerChecker<uint32_t>(0, RdmaCoding::maxK))
+		.AddAttribute("CodingGenerationWindow",
+				"Coding transport: generations a qp has open at a time",
+				UintegerValue(4),
+				MakeUintegerAccessor(&RdmaHw::m_codingWindow),
+				MakeUintegerChecker<uint32_t>(1))
+		.AddAttribute("CodingOverhead",
+				"Coding transport: a generation of k symbols decodes from any ceil(k * (1 + overhead)) of them",
+				DoubleValue(0),
+				MakeDoubleAccessor(&RdmaHw::m_codingOverhead),
+				MakeDoubleChecker<double>(0))
+		.AddAttribute("CodingDecodeTime",
+				"Coding transport: decoding time per source symbol, before a generation is acked decoded",
+				TimeValue(Time(0)),
+				MakeTimeAccessor(&RdmaHw::m_codingDecodeTime),
+				MakeTimeChecker())
+		.AddAttribute("RxQpIdleTimeout",
+				"Delete an rx qp that received no data for this long, 0 to keep it until DeleteRxQp",
+				TimeValue(Time(0)),
+				MakeTimeAccessor(&RdmaHw::m_rxQpIdleTimeout),
+				MakeTimeChecker())
+		.AddTraceSource("RxQpCount",
+				"The number of rx qps alive",
+				MakeTraceSourceAccessor(&RdmaHw::m_nRxQps),
+				"ns3::TracedValueCallback::Uint32")
 		;
 	return tid;
 }
 
 RdmaHw::RdmaHw(){
+	m_nRxQps = 0;
+	m_rxQpCreated = 0;
+	m_rxQpExpired = 0;
+	m_codingSent = 0;
+	m_codingRepairs = 0;
+	m_codingReceived = 0;
+	m_codingRedundant = 0;
+	m_codingDecoded = 0;
 }
 
 void RdmaHw::SetNode(Ptr<Node> node){
@@ -207,15 +155,21 @@ void RdmaHw::Setup(QpCompleteCallback cb){
 	}
 	// setup qp complete callback
 	m_qpCompleteCallback = cb;
+	// create the CC
+	ObjectFactory factory;
+	if (m_ccTypeId == RdmaCongestionOps::GetTypeId())
+		factory.SetTypeId(RdmaCongestionOps::GetTypeIdOfCcMode(m_cc_mode));
+	else
+		factory.SetTypeId(m_ccTypeId);
+	m_ccOps = factory.Create<RdmaCongestionOps>();
+	m_ccOps->SetRdmaHw(this);
 }
 
 uint32_t RdmaHw::GetNicIdxOfQp(Ptr<RdmaQueuePair> qp){
-	auto &v = m_rtTable[qp->dip.Get()];
-	if (v.size() > 0){
-		return v[qp->GetHash() % v.size()];
-	}else{
-		NS_ASSERT_MSG(false, "We assume at least one NIC is alive");
-	}
+	uint32_t n;
+	const uint32_t *v = m_rtTable.Lookup(qp->dip.Get(), n);
+	NS_ASSERT_MSG(n > 0, "We assume at least one NIC is alive");
+	return v[qp->GetHash() % n];
 }
 uint64_t RdmaHw::GetQpKey(uint32_t dip, uint16_t sport, uint16_t pg){
 	return ((uint64_t)dip << 32) | ((uint64_t)sport << 16) | (uint64_t)pg;
@@ -229,7 +183,7 @@ Ptr<RdmaQueuePair> RdmaHw::GetQp(uint32_t dip, uint16_t sport, uint16_t pg){
 }
 void RdmaHw::AddQueuePair(uint64_t size, uint16_t pg, Ipv4Address sip, Ipv4Address dip, uint16_t sport, uint16_t dport, uint32_t win, uint64_t baseRtt, Callback<void> notifyAppFinish){
 	// create qp
-	Ptr<RdmaQueuePair> qp = CreateObject<RdmaQueuePair>(pg, sip, dip, sport, dport);
+	Ptr<RdmaQueuePair> qp = Create<RdmaQueuePair>(pg, sip, dip, sport, dport);
 	qp->SetSize(size);
 	qp->SetWin(win);
 	qp->SetBaseRtt(baseRtt);
@@ -246,19 +200,9 @@ void RdmaHw::AddQueuePair(uint64_t size, uint16_t pg, Ipv4Address sip, Ipv4Addre
 	DataRate m_bps = m_nic[nic_idx].dev->GetDataRate();
 	qp->m_rate = m_bps;
 	qp->m_max_rate = m_bps;
-	if (m_cc_mode == 1){
-		qp->mlx.m_targetRate = m_bps;
-	}else if (m_cc_mode == 3){
-		qp->hp.m_curRate = m_bps;
-		if (m_multipleRate){
-			for (uint32_t i = 0; i < IntHeader::maxHop; i++)
-				qp->hp.hopState[i].Rc = m_bps;
-		}
-	}else if (m_cc_mode == 7){
-		qp->tmly.m_curRate = m_bps;
-	}else if (m_cc_mode == 10){
-		qp->hpccPint.m_curRate = m_bps;
-	}
+	m_ccOps->InitQp(qp);
+	if (m_is_use_coding_transport && m_codingGenSize > 0 && pg != 2)
+		qp->m_codingTx = std::make_unique<RdmaCodingTx>(size, m_mtu, m_codingGenSize, m_codingWindow, m_codingOverhead);
 
 	// Notify Nic
 	m_nic[nic_idx].dev->NewQp(qp);
@@ -270,37 +214,80 @@ void RdmaHw::DeleteQueuePair(Ptr<RdmaQueuePair> qp){
 	m_qpMap.erase(key);
 }
 
-Ptr<RdmaRxQueuePair> RdmaHw::GetRxQp(uint32_t sip, uint32_t dip, uint16_t sport, uint16_t dport, uint16_t pg, bool create){
-	uint64_t key = ((uint64_t)dip << 32) | ((uint64_t)pg << 16) | (uint64_t)dport;
-	auto it = m_rxQpMap.find(key);
-	if (it != m_rxQpMap.end())
-		return it->second;
-	if (create){
-		// create new rx qp
-		Ptr<RdmaRxQueuePair> q = CreateObject<RdmaRxQueuePair>();
+RdmaRxQueuePair *RdmaHw::GetRxQp(uint32_t sip, uint32_t dip, uint16_t sport, uint16_t dport, uint16_t pg, bool create){
+	uint64_t key = RdmaRxQpTable::GetKey(dip, pg, dport);
+	if (!create)
+		return m_rxQps.Find(key);
+	bool inserted;
+	RdmaRxQueuePair *q = m_rxQps.Insert(key, inserted);
+	if (inserted){
 		// init the qp
 		q->sip = sip;
 		q->dip = dip;
 		q->sport = sport;
 		q->dport = dport;
 		q->m_ecn_source.qIndex = pg;
-		// store in map
-		m_rxQpMap[key] = q;
-		return q;
+		m_rxQpCreated++;
+		m_nRxQps = m_rxQps.GetN();
+		if (!m_rxQpIdleTimeout.IsZero() && !m_rxQpSweep.IsPending())
+			m_rxQpSweep = Simulator::Schedule(m_rxQpIdleTimeout, &RdmaHw::SweepRxQps, this);
 	}
-	return NULL;
+	return q;
 }
-uint32_t RdmaHw::GetNicIdxOfRxQp(Ptr<RdmaRxQueuePair> q){
-	auto &v = m_rtTable[q->dip];
-	if (v.size() > 0){
-		return v[q->GetHash() % v.size()];
-	}else{
-		NS_ASSERT_MSG(false, "We assume at least one NIC is alive");
-	}
+uint32_t RdmaHw::GetNicIdxOfRxQp(RdmaRxQueuePair *q){
+	uint32_t n;
+	const uint32_t *v = m_rtTable.Lookup(q->dip, n);
+	NS_ASSERT_MSG(n > 0, "We assume at least one NIC is alive");
+	return v[q->GetHash() % n];
 }
 void RdmaHw::DeleteRxQp(uint32_t dip, uint16_t pg, uint16_t dport){
-	uint64_t key = ((uint64_t)dip << 32) | ((uint64_t)pg << 16) | (uint64_t)dport;
-	m_rxQpMap.erase(key);
+	EraseRxQp(RdmaRxQpTable::GetKey(dip, pg, dport));
+}
+void RdmaHw::EraseRxQp(uint64_t key){
+	if (!m_rxQps.Erase(key))
+		return;
+	auto it = m_codingRx.find(key);
+	if (it != m_codingRx.end()){
+		it->second.event.Cancel();
+		for (EventId &e : it->second.decodes)
+			e.Cancel();
+		m_codingRx.erase(it);
+	}
+	m_nRxQps = m_rxQps.GetN();
+}
+void RdmaHw::SweepRxQps(){
+	// an rx qp is deleted between one and two timeouts after its last packet
+	Time idleSince = Simulator::Now() - m_rxQpIdleTimeout;
+	std::vector<uint64_t> idle;
+	for (uint32_t i = 0; i < m_rxQps.GetCapacity(); i++){
+		RdmaRxQueuePair &q = m_rxQps.GetSlot(i);
+		if (q.used && q.m_lastActive <= idleSince)
+			idle.push_back(q.key);
+	}
+	for (uint64_t key : idle)
+		EraseRxQp(key);
+	m_rxQpExpired += idle.size();
+	if (m_rxQps.GetN() > 0)
+		m_rxQpSweep = Simulator::Schedule(m_rxQpIdleTimeout, &RdmaHw::SweepRxQps, this);
+}
+uint32_t RdmaHw::GetRxQpCount(){
+	return m_rxQps.GetN();
+}
+
+void RdmaHw::SendAck(RdmaRxQueuePair *rxQp, uint32_t seq, uint16_t pg, bool nack, bool cnp, const IntHeader &ih){
+	// ppp, ipv4 and qbb headers from the template, padded to the minimum frame
+	static const uint32_t padSize = std::max(60-14-20-(int)(qbbHeader::GetBaseSize() + IntHeader::GetStaticSize()), 0);
+	if (!m_ackHdr.IsBuilt())
+		m_ackHdr.BuildAck(Ipv4Address(rxQp->sip), Ipv4Address(rxQp->dip), rxQp->sport, rxQp->dport, pg);
+	else
+		m_ackHdr.SetAckFlow(Ipv4Address(rxQp->sip), Ipv4Address(rxQp->dip), rxQp->sport, rxQp->dport, pg);
+	m_ackHdr.SetAck(seq, rxQp->m_ipid++, nack, cnp, ih, padSize);
+	Ptr<Packet> newp = Create<Packet>(padSize);
+	newp->AddHeader(m_ackHdr);
+	// send
+	uint32_t nic_idx = GetNicIdxOfRxQp(rxQp);
+	m_nic[nic_idx].dev->RdmaEnqueueHighPrioQ(newp);
+	m_nic[nic_idx].dev->TriggerTransmit();
 }
 
 int RdmaHw::ReceiveUdp(Ptr<Packet> p, CustomHeader &ch){
@@ -309,42 +296,18 @@ int RdmaHw::ReceiveUdp(Ptr<Packet> p, CustomHeader &ch){
 	uint32_t payload_size = p->GetSize() - ch.GetSerializedSize();
 
 	// TODO find corresponding rx queue pair
-	Ptr<RdmaRxQueuePair> rxQp = GetRxQp(ch.dip, ch.sip, ch.udp.dport, ch.udp.sport, ch.udp.pg, true);
+	RdmaRxQueuePair *rxQp = GetRxQp(ch.dip, ch.sip, ch.udp.dport, ch.udp.sport, ch.udp.pg, true);
 	if (ecnbits != 0){
 		rxQp->m_ecn_source.ecnbits |= ecnbits;
 		rxQp->m_ecn_source.qfb++;
 	}
 	rxQp->m_ecn_source.total++;
 	rxQp->m_milestone_rx = m_ack_interval;
+	rxQp->m_lastActive = Simulator::Now();
 
 	int x = ReceiverCheckSeq(ch.udp.seq, rxQp, payload_size);
 	if (x == 1 || x == 2){ //generate ACK or NACK
-		qbbHeader seqh;
-		seqh.SetSeq(rxQp->ReceiverNextExpectedSeq);
-		seqh.SetPG(ch.udp.pg);
-		seqh.SetSport(ch.udp.dport);
-		seqh.SetDport(ch.udp.sport);
-		seqh.SetIntHeader(ch.udp.ih);
-		if (ecnbits)
-			seqh.SetCnp();
-
-		Ptr<Packet> newp = Create<Packet>(std::max(60-14-20-(int)seqh.GetSerializedSize(), 0));
-		newp->AddHeader(seqh);
-
-		Ipv4Header head;	// Prepare IPv4 header
-		head.SetDestination(Ipv4Address(ch.sip));
-		head.SetSource(Ipv4Address(ch.dip));
-		head.SetProtocol(x == 1 ? 0xFC : 0xFD); //ack=0xFC nack=0xFD
-		head.SetTtl(64);
-		head.SetPayloadSize(newp->GetSize());
-		head.SetIdentification(rxQp->m_ipid++);
-
-		newp->AddHeader(head);
-		AddHeader(newp, 0x800);	// Attach PPP header
-		// send
-		uint32_t nic_idx = GetNicIdxOfRxQp(rxQp);
-		m_nic[nic_idx].dev->RdmaEnqueueHighPrioQ(newp);
-		m_nic[nic_idx].dev->TriggerTransmit();
+		SendAck(rxQp, rxQp->ReceiverNextExpectedSeq, ch.udp.pg, x == 2, ecnbits != 0, ch.udp.ih);
 	}
 	return 0;
 }
@@ -376,19 +339,8 @@ int RdmaHw::ReceiveCnp(Ptr<Packet> p, CustomHeader &ch){
 	if (qp->m_rate == 0)			//lazy initialization	
 	{
 		qp->m_rate = dev->GetDataRate();
-		if (m_cc_mode == 1){
-			qp->mlx.m_targetRate = dev->GetDataRate();
-		}else if (m_cc_mode == 3){
-			qp->hp.m_curRate = dev->GetDataRate();
-			if (m_multipleRate){
-				for (uint32_t i = 0; i < IntHeader::maxHop; i++)
-					qp->hp.hopState[i].Rc = dev->GetDataRate();
-			}
-		}else if (m_cc_mode == 7){
-			qp->tmly.m_curRate = dev->GetDataRate();
-		}else if (m_cc_mode == 10){
-			qp->hpccPint.m_curRate = dev->GetDataRate();
-		}
+		m_ccOps->InitQp(qp);
+		dev->UpdateQp(qp);
 	}
 	return 0;
 }
@@ -423,23 +375,10 @@ int RdmaHw::ReceiveAck(Ptr<Packet> p, CustomHeader &ch){
 	if (ch.l3Prot == 0xFD) // NACK
 		RecoverQueue(qp);
 
-	// handle cnp
-	if (cnp){
-		if (m_cc_mode == 1){ // mlx version
-			cnp_received_mlx(qp);
-		} 
-	}
-
-	if (m_cc_mode == 3){
-		HandleAckHp(qp, p, ch);
-	}else if (m_cc_mode == 7){
-		HandleAckTimely(qp, p, ch);
-	}else if (m_cc_mode == 8){
-		HandleAckDctcp(qp, p, ch);
-	}else if (m_cc_mode == 10){
-		HandleAckHpPint(qp, p, ch);
-	}
+	RdmaAckFeedback fb = {seq, qp->snd_nxt, cnp != 0, &ch.ack.ih};
+	HandleAck(qp, fb);
 	// ACK may advance the on-the-fly window, allowing more packets to send
+	dev->UpdateQp(qp);
 	dev->TriggerTransmit();
 	return 0;
 }
@@ -468,33 +407,32 @@ int RdmaHw::Receive(Ptr<Packet> p, CustomHeader &ch){
 	return 0;
 }
 
+void RdmaHw::AddDataHeaders(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, uint32_t seq){
+	// ppp, ipv4, udp and SeqTs headers in one go, only the per-packet fields change
+	if (!m_dataHdr.IsBuilt())
+		m_dataHdr.Build(qp->sip, qp->dip, qp->sport, qp->dport, qp->m_pg);
+	else
+		m_dataHdr.SetDataFlow(qp->sip, qp->dip, qp->sport, qp->dport, qp->m_pg);
+	m_dataHdr.SetData(seq, qp->m_ipid, p->GetSize());
+	p->AddHeader(m_dataHdr);
+}
+
+void RdmaHw::HandleAck(Ptr<RdmaQueuePair> qp, RdmaAckFeedback &fb){
+	// handle cnp
+	if (fb.cnp)
+		m_ccOps->OnCnp(qp);
+	m_ccOps->OnAck(qp, fb);
+}
+
 Ptr<Packet> RdmaHw::GetNxtCodingPacket(Ptr<RdmaQueuePair> qp){
 	uint32_t payload_size = m_mtu; // send a encoding symbol
 	Ptr<Packet> p = Create<Packet> (payload_size);
-	// add SeqTsHeader
-	RDMASeqTsHeader seqTs;
-	seqTs.SetSeq (qp->coding_snd_nxt);
-	seqTs.SetPG (qp->m_pg);
-	p->AddHeader (seqTs);
-	// add udp header
-	UdpHeader udpHeader;
-	udpHeader.SetDestinationPort (qp->dport);
-	udpHeader.SetSourcePort (qp->sport);
-	p->AddHeader (udpHeader);
-	// add ipv4 header
-	Ipv4Header ipHeader;
-	ipHeader.SetSource (qp->sip);
-	ipHeader.SetDestination (qp->dip);
-	ipHeader.SetProtocol (0x11);
-	ipHeader.SetPayloadSize (p->GetSize());
-	ipHeader.SetTtl (64);
-	ipHeader.SetTos (0);
-	ipHeader.SetIdentification (qp->m_ipid);
-	p->AddHeader(ipHeader);
-	// add ppp header
-	PppHeader ppp;
-	ppp.SetProtocol (0x0021); // EtherToPpp(0x800), see point-to-point-net-device.cc
-	p->AddHeader (ppp);
+	if (qp->m_codingTx != nullptr){
+		// a symbol of the generation that needs one most
+		AddDataHeaders(qp, p, qp->m_codingTx->NextSymbol());
+		m_codingSent++;
+	}else
+		AddDataHeaders(qp, p, qp->coding_snd_nxt);
 
 	// update state
 	qp->coding_snd_nxt += payload_size;
@@ -510,48 +448,91 @@ int RdmaHw::ReceiveCodingUdp(Ptr<Packet> p, CustomHeader &ch){
 	uint32_t payload_size = p->GetSize() - ch.GetSerializedSize();
 
 	// find corresponding rx queue pair
-	Ptr<RdmaRxQueuePair> rxQp = GetRxQp(ch.dip, ch.sip, ch.udp.dport, ch.udp.sport, ch.udp.pg, true);
+	RdmaRxQueuePair *rxQp = GetRxQp(ch.dip, ch.sip, ch.udp.dport, ch.udp.sport, ch.udp.pg, true);
 	if (ecnbits != 0){
 		rxQp->m_ecn_source.ecnbits |= ecnbits;
 		rxQp->m_ecn_source.qfb++;
 	}
 	rxQp->m_ecn_source.total++;
 	rxQp->m_milestone_rx = m_ack_interval;
+	rxQp->m_lastActive = Simulator::Now();
+
+	uint32_t seq;
+	CodingRx *c; // in stream mode, only while a coalesced ack waits
+	if (m_codingGenSize == 0){
+		// recoding received bytes, every bytes is useful to decode
+		uint32_t expected = rxQp->ReceiverNextExpectedSeq;
+		rxQp->ReceiverNextExpectedSeq = expected + payload_size;
+		seq = rxQp->ReceiverNextExpectedSeq;
+		auto it = m_codingRx.find(rxQp->key);
+		c = it != m_codingRx.end() ? &it->second : NULL;
+	}else{
+		// a symbol only adds to the rank of its generation, up to what decoding it needs
+		c = &m_codingRx[rxQp->key];
+		uint32_t g = RdmaCoding::GetGeneration(ch.udp.seq);
+		m_codingReceived++;
+		RdmaCodingRx::Result r = c->gens.OnSymbol(ch.udp.seq, m_codingOverhead);
+		if (r == RdmaCodingRx::RX_DECODABLE){
+			Time t = m_codingDecodeTime * RdmaCoding::GetK(ch.udp.seq);
+			if (t.IsZero())
+				c->gens.SetDecoded(g);
+			else{
+				c->decodes.erase(std::remove_if(c->decodes.begin(), c->decodes.end(), [](const EventId &e){ return !e.IsPending(); }), c->decodes.end());
+				c->decodes.push_back(Simulator::Schedule(t, &RdmaHw::CodingDecoded, this, rxQp->key, ch.udp.pg, g));
+			}
+		}else if (r == RdmaCodingRx::RX_REDUNDANT)
+			m_codingRedundant++;
+		seq = c->gens.GetAckSeq(g);
+		// the sender keeps sending a generation until it learns it is decoded, tell it right away
+		if (c->gens.IsDecoded(g) && r != RdmaCodingRx::RX_RANK){
+			if (r == RdmaCodingRx::RX_DECODABLE)
+				m_codingDecoded++;
+			SendAck(rxQp, seq, ch.udp.pg, false, ecnbits != 0, ch.udp.ih);
+			return 0;
+		}
+	}
 
-	// recoding received bytes, every bytes is useful to decode
-	uint32_t expected = rxQp->ReceiverNextExpectedSeq;
-	rxQp->ReceiverNextExpectedSeq = expected + payload_size;
-	// TODO: Enable ack interval check
-
-	// sending feedback
-	qbbHeader seqh;
-	seqh.SetSeq(rxQp->ReceiverNextExpectedSeq);
-	seqh.SetPG(ch.udp.pg);
-	seqh.SetSport(ch.udp.dport);
-	seqh.SetDport(ch.udp.sport);
-	seqh.SetIntHeader(ch.udp.ih);
-	if (ecnbits)
-		seqh.SetCnp();
-
-	Ptr<Packet> newp = Create<Packet>(std::max(60-14-20-(int)seqh.GetSerializedSize(), 0));
-	newp->AddHeader(seqh);
+	// sending feedback, possibly for several symbols at once
+	uint32_t pending = (c != NULL ? c->pending : 0) + 1;
+	if (ecnbits || pending >= m_codingAckInterval){
+		if (c != NULL){
+			c->event.Cancel();
+			c->pending = 0;
+			if (m_codingGenSize == 0)
+				m_codingRx.erase(rxQp->key);
+		}
+		SendAck(rxQp, seq, ch.udp.pg, false, ecnbits != 0, ch.udp.ih);
+	}else{
+		if (c == NULL)
+			c = &m_codingRx[rxQp->key];
+		if (!c->event.IsPending())
+			c->event = Simulator::Schedule(m_codingAckDelay, &RdmaHw::SendCodingAck, this, rxQp->key, ch.udp.pg, false);
+		c->pending = pending;
+		c->seq = seq;
+		c->ih = ch.udp.ih;
+	}
 
-	Ipv4Header head;	// Prepare IPv4 header
-	head.SetDestination(Ipv4Address(ch.sip));
-	head.SetSource(Ipv4Address(ch.dip));
-	head.SetProtocol(0xFC); //ack=0xFC nack=0xFD
-	head.SetTtl(64);
-	head.SetPayloadSize(newp->GetSize());
-	head.SetIdentification(rxQp->m_ipid++);
+	return 0;
+}
 
-	newp->AddHeader(head);
-	AddHeader(newp, 0x800);	// Attach PPP header
-	// send
-	uint32_t nic_idx = GetNicIdxOfRxQp(rxQp);
-	m_nic[nic_idx].dev->RdmaEnqueueHighPrioQ(newp);
-	m_nic[nic_idx].dev->TriggerTransmit();
+void RdmaHw::SendCodingAck(uint64_t key, uint16_t pg, bool cnp){
+	auto it = m_codingRx.find(key);
+	NS_ASSERT(it != m_codingRx.end());
+	it->second.pending = 0;
+	RdmaRxQueuePair *rxQp = m_rxQps.Find(key);
+	NS_ASSERT_MSG(rxQp != NULL, "EraseRxQp cancels the pending coding ack");
+	SendAck(rxQp, it->second.seq, pg, false, cnp, it->second.ih);
+	if (m_codingGenSize == 0)
+		m_codingRx.erase(it);
+}
 
-	return 0;
+void RdmaHw::CodingDecoded(uint64_t key, uint16_t pg, uint32_t g){
+	auto it = m_codingRx.find(key);
+	RdmaRxQueuePair *rxQp = m_rxQps.Find(key);
+	NS_ASSERT_MSG(it != m_codingRx.end() && rxQp != NULL, "EraseRxQp cancels the decoding");
+	it->second.gens.SetDecoded(g);
+	m_codingDecoded++;
+	SendAck(rxQp, it->second.gens.GetAckSeq(g), pg, false, false, it->second.ih);
 }
 
 int RdmaHw::ReceiveCodingAck(Ptr<Packet> p, CustomHeader &ch){
@@ -569,34 +550,38 @@ int RdmaHw::ReceiveCodingAck(Ptr<Packet> p, CustomHeader &ch){
 	uint32_t nic_idx = GetNicIdxOfQp(qp);
 	Ptr<QbbNetDevice> dev = m_nic[nic_idx].dev;
 	NS_LOG_DEBUG("Qp size: " << qp->m_size << " snd_una: " << qp->snd_una << " snd_nxt: " << qp->snd_nxt);
-	qp->Acknowledge(qp->snd_una + m_mtu); // coding-based transport always push forward receiver's expected sequence number when receiving an ack
+	if (qp->m_codingTx != nullptr){
+		// snd_una covers the generations decoded in order, the flow is done once all are
+		qp->m_codingTx->OnAck(seq);
+		qp->Acknowledge(qp->m_codingTx->GetDecodedBytes());
+		qp->coding_snd_una = std::min(qp->m_codingTx->m_acked * m_mtu, qp->coding_snd_nxt);
+	}else{
+		// coding-based transport always push forward receiver's expected sequence number when receiving an ack,
+		// by one symbol, or by all the symbols a coalesced ack covers
+		int32_t acked = seq - (uint32_t)qp->snd_una;
+		qp->Acknowledge(qp->snd_una + std::max(acked, (int32_t)m_mtu));
+		qp->coding_snd_una = std::min(qp->snd_una, qp->coding_snd_nxt);
+	}
+	// nothing is in flight in go-back-N terms, the window bounds coding_snd_nxt - coding_snd_una
+	qp->snd_nxt = qp->snd_una;
 	if (qp->IsFinished()){
+		if (qp->m_codingTx != nullptr)
+			m_codingRepairs += qp->m_codingTx->m_repairs;
 		qp->snd_nxt = qp->m_size; // only for coding-based transport, qp->snd_nxt = qp->m_size will let GetBytesLeft() return 0, and stop sending more coding packets
 		QpComplete(qp);
 	}
 
-	// handle cnp
-	// if (cnp){
-	// 	if (m_cc_mode == 1){ // mlx version
-	// 		cnp_received_mlx(qp);
-	// 	} 
-	// }
-
-	// if (m_cc_mode == 3){
-	// 	HandleAckHp(qp, p, ch);
-	// }else if (m_cc_mode == 7){
-	// 	HandleAckTimely(qp, p, ch);
-	// }else if (m_cc_mode == 8){
-	// 	HandleAckDctcp(qp, p, ch);
-	// }else if (m_cc_mode == 10){
-	// 	HandleAckHpPint(qp, p, ch);
-	// }
+	if (m_codingCc){
+		RdmaAckFeedback fb = {(uint32_t)qp->coding_snd_una, qp->coding_snd_nxt, cnp != 0, &ch.ack.ih};
+		HandleAck(qp, fb);
+	}
 	// ACK may advance the on-the-fly window, allowing more packets to send
+	dev->UpdateQp(qp);
 	dev->TriggerTransmit();
 	return 0;
 }
 
-int RdmaHw::ReceiverCheckSeq(uint32_t seq, Ptr<RdmaRxQueuePair> q, uint32_t size){
+int RdmaHw::ReceiverCheckSeq(uint32_t seq, RdmaRxQueuePair *q, uint32_t size){
 	uint32_t expected = q->ReceiverNextExpectedSeq;
 	if (seq == expected){
 		q->ReceiverNextExpectedSeq = expected + size;
@@ -644,17 +629,15 @@ void RdmaHw::RecoverQueue(Ptr<RdmaQueuePair> qp){
 
 void RdmaHw::QpComplete(Ptr<RdmaQueuePair> qp){
 	NS_ASSERT(!m_qpCompleteCallback.IsNull());
-	if (m_cc_mode == 1){
-		Simulator::Cancel(qp->mlx.m_eventUpdateAlpha);
-		Simulator::Cancel(qp->mlx.m_eventDecreaseRate);
-		Simulator::Cancel(qp->mlx.m_rpTimer);
-	}
+	m_ccOps->OnComplete(qp);
 
 	// This callback will log info
 	// It may also delete the rxQp on the receiver
 	m_qpCompleteCallback(qp);
 
-	qp->m_notifyAppFinish();
+	// flows started by RdmaDriver::AddFlow have no application to notify
+	if (!qp->m_notifyAppFinish.IsNull())
+		qp->m_notifyAppFinish();
 
 	// delete the qp
 	DeleteQueuePair(qp);
@@ -665,12 +648,15 @@ void RdmaHw::SetLinkDown(Ptr<QbbNetDevice> dev){
 }
 
 void RdmaHw::AddTableEntry(Ipv4Address &dstAddr, uint32_t intf_idx){
-	uint32_t dip = dstAddr.Get();
-	m_rtTable[dip].push_back(intf_idx);
+	m_rtTable.Add(dstAddr.Get(), intf_idx);
 }
 
 void RdmaHw::ClearTable(){
-	m_rtTable.clear();
+	m_rtTable.Clear();
+}
+
+void RdmaHw::SetTable(const EcmpTable &table){
+	m_rtTable = table;
 }
 
 void RdmaHw::RedistributeQp(){
@@ -702,30 +688,7 @@ Ptr<Packet> RdmaHw::GetNxtPacket(Ptr<RdmaQueuePair> qp){
 	if (m_mtu < payload_size)
 		payload_size = m_mtu;
 	Ptr<Packet> p = Create<Packet> (payload_size);
-	// add SeqTsHeader
-	RDMASeqTsHeader seqTs;
-	seqTs.SetSeq (qp->snd_nxt);
-	seqTs.SetPG (qp->m_pg);
-	p->AddHeader (seqTs);
-	// add udp header
-	UdpHeader udpHeader;
-	udpHeader.SetDestinationPort (qp->dport);
-	udpHeader.SetSourcePort (qp->sport);
-	p->AddHeader (udpHeader);
-	// add ipv4 header
-	Ipv4Header ipHeader;
-	ipHeader.SetSource (qp->sip);
-	ipHeader.SetDestination (qp->dip);
-	ipHeader.SetProtocol (0x11);
-	ipHeader.SetPayloadSize (p->GetSize());
-	ipHeader.SetTtl (64);
-	ipHeader.SetTos (0);
-	ipHeader.SetIdentification (qp->m_ipid);
-	p->AddHeader(ipHeader);
-	// add ppp header
-	PppHeader ppp;
-	ppp.SetProtocol (0x0021); // EtherToPpp(0x800), see point-to-point-net-device.cc
-	p->AddHeader (ppp);
+	AddDataHeaders(qp, p, qp->snd_nxt);
 
 	// update state
 	qp->snd_nxt += payload_size;
@@ -738,6 +701,7 @@ Ptr<Packet> RdmaHw::GetNxtPacket(Ptr<RdmaQueuePair> qp){
 void RdmaHw::PktSent(Ptr<RdmaQueuePair> qp, Ptr<Packet> pkt, Time interframeGap){
 	qp->lastPktSize = pkt->GetSize();
 	UpdateNextAvail(qp, interframeGap, pkt->GetSize());
+	m_ccOps->OnSent(qp, pkt->GetSize());
 }
 
 void RdmaHw::UpdateNextAvail(Ptr<RdmaQueuePair> qp, Time interframeGap, uint32_t pkt_size){
@@ -750,509 +714,18 @@ void RdmaHw::UpdateNextAvail(Ptr<RdmaQueuePair> qp, Time interframeGap, uint32_t
 }
 
 void RdmaHw::ChangeRate(Ptr<RdmaQueuePair> qp, DataRate new_rate){
+	uint32_t nic_idx = GetNicIdxOfQp(qp);
 	#if 1
 	Time sendingTime = qp->m_rate.CalculateBytesTxTime(qp->lastPktSize);
 	Time new_sendintTime = new_rate.CalculateBytesTxTime(qp->lastPktSize);
 	qp->m_nextAvail = qp->m_nextAvail + new_sendintTime - sendingTime;
 	// update nic's next avail event
-	uint32_t nic_idx = GetNicIdxOfQp(qp);
 	m_nic[nic_idx].dev->UpdateNextAvail(qp->m_nextAvail);
 	#endif
 
 	// change to new rate
 	qp->m_rate = new_rate;
-}
-
-#define PRINT_LOG 0
-/******************************
- * Mellanox's version of DCQCN
- *****************************/
-void RdmaHw::UpdateAlphaMlx(Ptr<RdmaQueuePair> q){
-	#if PRINT_LOG
-	//std::cout << Simulator::Now() << " alpha update:" << m_node->GetId() << ' ' << q->mlx.m_alpha << ' ' << (int)q->mlx.m_alpha_cnp_arrived << '\n';
-	//printf("%lu alpha update: %08x %08x %u %u %.6lf->", Simulator::Now().GetTimeStep(), q->sip.Get(), q->dip.Get(), q->sport, q->dport, q->mlx.m_alpha);
-	#endif
-	if (q->mlx.m_alpha_cnp_arrived){
-		q->mlx.m_alpha = (1 - m_g)*q->mlx.m_alpha + m_g; 	//binary feedback
-	}else {
-		q->mlx.m_alpha = (1 - m_g)*q->mlx.m_alpha; 	//binary feedback
-	}
-	#if PRINT_LOG
-	//printf("%.6lf\n", q->mlx.m_alpha);
-	#endif
-	q->mlx.m_alpha_cnp_arrived = false; // clear the CNP_arrived bit
-	ScheduleUpdateAlphaMlx(q);
-}
-void RdmaHw::ScheduleUpdateAlphaMlx(Ptr<RdmaQueuePair> q){
-	q->mlx.m_eventUpdateAlpha = Simulator::Schedule(MicroSeconds(m_alpha_resume_interval), &RdmaHw::UpdateAlphaMlx, this, q);
-}
-
-void RdmaHw::cnp_received_mlx(Ptr<RdmaQueuePair> q){
-	q->mlx.m_alpha_cnp_arrived = true; // set CNP_arrived bit for alpha update
-	q->mlx.m_decrease_cnp_arrived = true; // set CNP_arrived bit for rate decrease
-	if (q->mlx.m_first_cnp){
-		// init alpha
-		q->mlx.m_alpha = 1;
-		q->mlx.m_alpha_cnp_arrived = false;
-		// schedule alpha update
-		ScheduleUpdateAlphaMlx(q);
-		// schedule rate decrease
-		ScheduleDecreaseRateMlx(q, 1); // add 1 ns to make sure rate decrease is after alpha update
-		// set rate on first CNP
-		q->mlx.m_targetRate = q->m_rate = q->m_rate * m_rateOnFirstCNP;
-		q->mlx.m_first_cnp = false;
-	}
-}
-
-void RdmaHw::CheckRateDecreaseMlx(Ptr<RdmaQueuePair> q){
-	ScheduleDecreaseRateMlx(q, 0);
-	if (q->mlx.m_decrease_cnp_arrived){
-		#if PRINT_LOG
-		printf("%lu rate dec: %08x %08x %u %u (%0.3lf %.3lf)->", Simulator::Now().GetTimeStep(), q->sip.Get(), q->dip.Get(), q->sport, q->dport, q->mlx.m_targetRate.GetBitRate() * 1e-9, q->m_rate.GetBitRate() * 1e-9);
-		#endif
-		bool clamp = true;
-		if (!m_EcnClampTgtRate){
-			if (q->mlx.m_rpTimeStage == 0)
-				clamp = false;
-		}
-		if (clamp)
-			q->mlx.m_targetRate = q->m_rate;
-		q->m_rate = std::max(m_minRate, q->m_rate * (1 - q->mlx.m_alpha / 2));
-		// reset rate increase related things
-		q->mlx.m_rpTimeStage = 0;
-		q->mlx.m_decrease_cnp_arrived = false;
-		Simulator::Cancel(q->mlx.m_rpTimer);
-		q->mlx.m_rpTimer = Simulator::Schedule(MicroSeconds(m_rpgTimeReset), &RdmaHw::RateIncEventTimerMlx, this, q);
-		#if PRINT_LOG
-		printf("(%.3lf %.3lf)\n", q->mlx.m_targetRate.GetBitRate() * 1e-9, q->m_rate.GetBitRate() * 1e-9);
-		#endif
-	}
-}
-void RdmaHw::ScheduleDecreaseRateMlx(Ptr<RdmaQueuePair> q, uint32_t delta){
-	q->mlx.m_eventDecreaseRate = Simulator::Schedule(MicroSeconds(m_rateDecreaseInterval) + NanoSeconds(delta), &RdmaHw::CheckRateDecreaseMlx, this, q);
-}
-
-void RdmaHw::RateIncEventTimerMlx(Ptr<RdmaQueuePair> q){
-	q->mlx.m_rpTimer = Simulator::Schedule(MicroSeconds(m_rpgTimeReset), &RdmaHw::RateIncEventTimerMlx, this, q);
-	RateIncEventMlx(q);
-	q->mlx.m_rpTimeStage++;
-}
-void RdmaHw::RateIncEventMlx(Ptr<RdmaQueuePair> q){
-	// check which increase phase: fast recovery, active increase, hyper increase
-	if (q->mlx.m_rpTimeStage < m_rpgThreshold){ // fast recovery
-		FastRecoveryMlx(q);
-	}else if (q->mlx.m_rpTimeStage == m_rpgThreshold){ // active increase
-		ActiveIncreaseMlx(q);
-	}else { // hyper increase
-		HyperIncreaseMlx(q);
-	}
-}
-
-void RdmaHw::FastRecoveryMlx(Ptr<RdmaQueuePair> q){
-	#if PRINT_LOG
-	printf("%lu fast recovery: %08x %08x %u %u (%0.3lf %.3lf)->", Simulator::Now().GetTimeStep(), q->sip.Get(), q->dip.Get(), q->sport, q->dport, q->mlx.m_targetRate.GetBitRate() * 1e-9, q->m_rate.GetBitRate() * 1e-9);
-	#endif
-	q->m_rate = (q->m_rate / 2) + (q->mlx.m_targetRate / 2);
-	#if PRINT_LOG
-	printf("(%.3lf %.3lf)\n", q->mlx.m_targetRate.GetBitRate() * 1e-9, q->m_rate.GetBitRate() * 1e-9);
-	#endif
-}
-void RdmaHw::ActiveIncreaseMlx(Ptr<RdmaQueuePair> q){
-	#if PRINT_LOG
-	printf("%lu active inc: %08x %08x %u %u (%0.3lf %.3lf)->", Simulator::Now().GetTimeStep(), q->sip.Get(), q->dip.Get(), q->sport, q->dport, q->mlx.m_targetRate.GetBitRate() * 1e-9, q->m_rate.GetBitRate() * 1e-9);
-	#endif
-	// get NIC
-	uint32_t nic_idx = GetNicIdxOfQp(q);
-	Ptr<QbbNetDevice> dev = m_nic[nic_idx].dev;
-	// increate rate
-	q->mlx.m_targetRate += m_rai;
-	if (q->mlx.m_targetRate > dev->GetDataRate())
-		q->mlx.m_targetRate = dev->GetDataRate();
-	q->m_rate = (q->m_rate / 2) + (q->mlx.m_targetRate / 2);
-	#if PRINT_LOG
-	printf("(%.3lf %.3lf)\n", q->mlx.m_targetRate.GetBitRate() * 1e-9, q->m_rate.GetBitRate() * 1e-9);
-	#endif
-}
-void RdmaHw::HyperIncreaseMlx(Ptr<RdmaQueuePair> q){
-	#if PRINT_LOG
-	printf("%lu hyper inc: %08x %08x %u %u (%0.3lf %.3lf)->", Simulator::Now().GetTimeStep(), q->sip.Get(), q->dip.Get(), q->sport, q->dport, q->mlx.m_targetRate.GetBitRate() * 1e-9, q->m_rate.GetBitRate() * 1e-9);
-	#endif
-	// get NIC
-	uint32_t nic_idx = GetNicIdxOfQp(q);
-	Ptr<QbbNetDevice> dev = m_nic[nic_idx].dev;
-	// increate rate
-	q->mlx.m_targetRate += m_rhai;
-	if (q->mlx.m_targetRate > dev->GetDataRate())
-		q->mlx.m_targetRate = dev->GetDataRate();
-	q->m_rate = (q->m_rate / 2) + (q->mlx.m_targetRate / 2);
-	#if PRINT_LOG
-	printf("(%.3lf %.3lf)\n", q->mlx.m_targetRate.GetBitRate() * 1e-9, q->m_rate.GetBitRate() * 1e-9);
-	#endif
-}
-
-/***********************
- * High Precision CC
- ***********************/
-void RdmaHw::HandleAckHp(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch){
-	uint32_t ack_seq = ch.ack.seq;
-	// update rate
-	if (ack_seq > qp->hp.m_lastUpdateSeq){ // if full RTT feedback is ready, do full update
-		UpdateRateHp(qp, p, ch, false);
-	}else{ // do fast react
-		FastReactHp(qp, p, ch);
-	}
-}
-
-void RdmaHw::UpdateRateHp(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch, bool fast_react){
-	uint32_t next_seq = qp->snd_nxt;
-	bool print = !fast_react || true;
-	if (qp->hp.m_lastUpdateSeq == 0){ // first RTT
-		qp->hp.m_lastUpdateSeq = next_seq;
-		// store INT
-		IntHeader &ih = ch.ack.ih;
-		NS_ASSERT(ih.nhop <= IntHeader::maxHop);
-		for (uint32_t i = 0; i < ih.nhop; i++)
-			qp->hp.hop[i] = ih.hop[i];
-		#if PRINT_LOG
-		if (print){
-			printf("%lu %s %08x %08x %u %u [%u,%u,%u]", Simulator::Now().GetTimeStep(), fast_react? "fast" : "update", qp->sip.Get(), qp->dip.Get(), qp->sport, qp->dport, qp->hp.m_lastUpdateSeq, ch.ack.seq, next_seq);
-			for (uint32_t i = 0; i < ih.nhop; i++)
-				printf(" %u %lu %lu", ih.hop[i].GetQlen(), ih.hop[i].GetBytes(), ih.hop[i].GetTime());
-			printf("\n");
-		}
-		#endif
-	}else {
-		// check packet INT
-		IntHeader &ih = ch.ack.ih;
-		if (ih.nhop <= IntHeader::maxHop){
-			double max_c = 0;
-			bool inStable = false;
-			#if PRINT_LOG
-			if (print)
-				printf("%lu %s %08x %08x %u %u [%u,%u,%u]", Simulator::Now().GetTimeStep(), fast_react? "fast" : "update", qp->sip.Get(), qp->dip.Get(), qp->sport, qp->dport, qp->hp.m_lastUpdateSeq, ch.ack.seq, next_seq);
-			#endif
-			// check each hop
-			double U = 0;
-			uint64_t dt = 0;
-			bool updated[IntHeader::maxHop] = {false}, updated_any = false;
-			NS_ASSERT(ih.nhop <= IntHeader::maxHop);
-			for (uint32_t i = 0; i < ih.nhop; i++){
-				if (m_sampleFeedback){
-					if (ih.hop[i].GetQlen() == 0 && fast_react)
-						continue;
-				}
-				updated[i] = updated_any = true;
-				#if PRINT_LOG
-				if (print)
-					printf(" %u(%u) %lu(%lu) %lu(%lu)", ih.hop[i].GetQlen(), qp->hp.hop[i].GetQlen(), ih.hop[i].GetBytes(), qp->hp.hop[i].GetBytes(), ih.hop[i].GetTime(), qp->hp.hop[i].GetTime());
-				#endif
-				uint64_t tau = ih.hop[i].GetTimeDelta(qp->hp.hop[i]);;
-				double duration = tau * 1e-9;
-				double txRate = (ih.hop[i].GetBytesDelta(qp->hp.hop[i])) * 8 / duration;
-				double u = txRate / ih.hop[i].GetLineRate() + (double)std::min(ih.hop[i].GetQlen(), qp->hp.hop[i].GetQlen()) * qp->m_max_rate.GetBitRate() / ih.hop[i].GetLineRate() /qp->m_win;
-				#if PRINT_LOG
-				if (print)
-					printf(" %.3lf %.3lf", txRate, u);
-				#endif
-				if (!m_multipleRate){
-					// for aggregate (single R)
-					if (u > U){
-						U = u;
-						dt = tau;
-					}
-				}else {
-					// for per hop (per hop R)
-					if (tau > qp->m_baseRtt)
-						tau = qp->m_baseRtt;
-					qp->hp.hopState[i].u = (qp->hp.hopState[i].u * (qp->m_baseRtt - tau) + u * tau) / double(qp->m_baseRtt);
-				}
-				qp->hp.hop[i] = ih.hop[i];
-			}
-
-			DataRate new_rate;
-			int32_t new_incStage;
-			DataRate new_rate_per_hop[IntHeader::maxHop];
-			int32_t new_incStage_per_hop[IntHeader::maxHop];
-			if (!m_multipleRate){
-				// for aggregate (single R)
-				if (updated_any){
-					if (dt > qp->m_baseRtt)
-						dt = qp->m_baseRtt;
-					qp->hp.u = (qp->hp.u * (qp->m_baseRtt - dt) + U * dt) / double(qp->m_baseRtt);
-					max_c = qp->hp.u / m_targetUtil;
-
-					if (max_c >= 1 || qp->hp.m_incStage >= m_miThresh){
-						new_rate = qp->hp.m_curRate / max_c + m_rai;
-						new_incStage = 0;
-					}else{
-						new_rate = qp->hp.m_curRate + m_rai;
-						new_incStage = qp->hp.m_incStage+1;
-					}
-					if (new_rate < m_minRate)
-						new_rate = m_minRate;
-					if (new_rate > qp->m_max_rate)
-						new_rate = qp->m_max_rate;
-					#if PRINT_LOG
-					if (print)
-						printf(" u=%.6lf U=%.3lf dt=%u max_c=%.3lf", qp->hp.u, U, dt, max_c);
-					#endif
-					#if PRINT_LOG
-					if (print)
-						printf(" rate:%.3lf->%.3lf\n", qp->hp.m_curRate.GetBitRate()*1e-9, new_rate.GetBitRate()*1e-9);
-					#endif
-				}
-			}else{
-				// for per hop (per hop R)
-				new_rate = qp->m_max_rate;
-				for (uint32_t i = 0; i < ih.nhop; i++){
-					if (updated[i]){
-						double c = qp->hp.hopState[i].u / m_targetUtil;
-						if (c >= 1 || qp->hp.hopState[i].incStage >= m_miThresh){
-							new_rate_per_hop[i] = qp->hp.hopState[i].Rc / c + m_rai;
-							new_incStage_per_hop[i] = 0;
-						}else{
-							new_rate_per_hop[i] = qp->hp.hopState[i].Rc + m_rai;
-							new_incStage_per_hop[i] = qp->hp.hopState[i].incStage+1;
-						}
-						// bound rate
-						if (new_rate_per_hop[i] < m_minRate)
-							new_rate_per_hop[i] = m_minRate;
-						if (new_rate_per_hop[i] > qp->m_max_rate)
-							new_rate_per_hop[i] = qp->m_max_rate;
-						// find min new_rate
-						if (new_rate_per_hop[i] < new_rate)
-							new_rate = new_rate_per_hop[i];
-						#if PRINT_LOG
-						if (print)
-							printf(" [%u]u=%.6lf c=%.3lf", i, qp->hp.hopState[i].u, c);
-						#endif
-						#if PRINT_LOG
-						if (print)
-							printf(" %.3lf->%.3lf", qp->hp.hopState[i].Rc.GetBitRate()*1e-9, new_rate.GetBitRate()*1e-9);
-						#endif
-					}else{
-						if (qp->hp.hopState[i].Rc < new_rate)
-							new_rate = qp->hp.hopState[i].Rc;
-					}
-				}
-				#if PRINT_LOG
-				printf("\n");
-				#endif
-			}
-			if (updated_any)
-				ChangeRate(qp, new_rate);
-			if (!fast_react){
-				if (updated_any){
-					qp->hp.m_curRate = new_rate;
-					qp->hp.m_incStage = new_incStage;
-				}
-				if (m_multipleRate){
-					// for per hop (per hop R)
-					for (uint32_t i = 0; i < ih.nhop; i++){
-						if (updated[i]){
-							qp->hp.hopState[i].Rc = new_rate_per_hop[i];
-							qp->hp.hopState[i].incStage = new_incStage_per_hop[i];
-						}
-					}
-				}
-			}
-		}
-		if (!fast_react){
-			if (next_seq > qp->hp.m_lastUpdateSeq)
-				qp->hp.m_lastUpdateSeq = next_seq; //+ rand() % 2 * m_mtu;
-		}
-	}
-}
-
-void RdmaHw::FastReactHp(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch){
-	if (m_fast_react)
-		UpdateRateHp(qp, p, ch, true);
-}
-
-/**********************
- * TIMELY
- *********************/
-void RdmaHw::HandleAckTimely(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch){
-	uint32_t ack_seq = ch.ack.seq;
-	// update rate
-	if (ack_seq > qp->tmly.m_lastUpdateSeq){ // if full RTT feedback is ready, do full update
-		UpdateRateTimely(qp, p, ch, false);
-	}else{ // do fast react
-		FastReactTimely(qp, p, ch);
-	}
-}
-void RdmaHw::UpdateRateTimely(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch, bool us){
-	uint32_t next_seq = qp->snd_nxt;
-	uint64_t rtt = Simulator::Now().GetTimeStep() - ch.ack.ih.ts;
-	bool print = !us;
-	if (qp->tmly.m_lastUpdateSeq != 0){ // not first RTT
-		int64_t new_rtt_diff = (int64_t)rtt - (int64_t)qp->tmly.lastRtt;
-		double rtt_diff = (1 - m_tmly_alpha) * qp->tmly.rttDiff + m_tmly_alpha * new_rtt_diff;
-		double gradient = rtt_diff / m_tmly_minRtt;
-		bool inc = false;
-		double c = 0;
-		#if PRINT_LOG
-		if (print)
-			printf("%lu node:%u rtt:%lu rttDiff:%.0lf gradient:%.3lf rate:%.3lf", Simulator::Now().GetTimeStep(), m_node->GetId(), rtt, rtt_diff, gradient, qp->tmly.m_curRate.GetBitRate() * 1e-9);
-		#endif
-		if (rtt < m_tmly_TLow){
-			inc = true;
-		}else if (rtt > m_tmly_THigh){
-			c = 1 - m_tmly_beta * (1 - (double)m_tmly_THigh / rtt);
-			inc = false;
-		}else if (gradient <= 0){
-			inc = true;
-		}else{
-			c = 1 - m_tmly_beta * gradient;
-			if (c < 0)
-				c = 0;
-			inc = false;
-		}
-		if (inc){
-			if (qp->tmly.m_incStage < 5){
-				qp->m_rate = qp->tmly.m_curRate + m_rai;
-			}else{
-				qp->m_rate = qp->tmly.m_curRate + m_rhai;
-			}
-			if (qp->m_rate > qp->m_max_rate)
-				qp->m_rate = qp->m_max_rate;
-			if (!us){
-				qp->tmly.m_curRate = qp->m_rate;
-				qp->tmly.m_incStage++;
-				qp->tmly.rttDiff = rtt_diff;
-			}
-		}else{
-			qp->m_rate = std::max(m_minRate, qp->tmly.m_curRate * c); 
-			if (!us){
-				qp->tmly.m_curRate = qp->m_rate;
-				qp->tmly.m_incStage = 0;
-				qp->tmly.rttDiff = rtt_diff;
-			}
-		}
-		#if PRINT_LOG
-		if (print){
-			printf(" %c %.3lf\n", inc? '^':'v', qp->m_rate.GetBitRate() * 1e-9);
-		}
-		#endif
-	}
-	if (!us && next_seq > qp->tmly.m_lastUpdateSeq){
-		qp->tmly.m_lastUpdateSeq = next_seq;
-		// update
-		qp->tmly.lastRtt = rtt;
-	}
-}
-void RdmaHw::FastReactTimely(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch){
-}
-
-/**********************
- * DCTCP
- *********************/
-void RdmaHw::HandleAckDctcp(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch){
-	uint32_t ack_seq = ch.ack.seq;
-	uint8_t cnp = (ch.ack.flags >> qbbHeader::FLAG_CNP) & 1;
-	bool new_batch = false;
-
-	// update alpha
-	qp->dctcp.m_ecnCnt += (cnp > 0);
-	if (ack_seq > qp->dctcp.m_lastUpdateSeq){ // if full RTT feedback is ready, do alpha update
-		#if PRINT_LOG
-		printf("%lu %s %08x %08x %u %u [%u,%u,%u] %.3lf->", Simulator::Now().GetTimeStep(), "alpha", qp->sip.Get(), qp->dip.Get(), qp->sport, qp->dport, qp->dctcp.m_lastUpdateSeq, ch.ack.seq, qp->snd_nxt, qp->dctcp.m_alpha);
-		#endif
-		new_batch = true;
-		if (qp->dctcp.m_lastUpdateSeq == 0){ // first RTT
-			qp->dctcp.m_lastUpdateSeq = qp->snd_nxt;
-			qp->dctcp.m_batchSizeOfAlpha = qp->snd_nxt / m_mtu + 1;
-		}else {
-			double frac = std::min(1.0, double(qp->dctcp.m_ecnCnt) / qp->dctcp.m_batchSizeOfAlpha);
-			qp->dctcp.m_alpha = (1 - m_g) * qp->dctcp.m_alpha + m_g * frac;
-			qp->dctcp.m_lastUpdateSeq = qp->snd_nxt;
-			qp->dctcp.m_ecnCnt = 0;
-			qp->dctcp.m_batchSizeOfAlpha = (qp->snd_nxt - ack_seq) / m_mtu + 1;
-			#if PRINT_LOG
-			printf("%.3lf F:%.3lf", qp->dctcp.m_alpha, frac);
-			#endif
-		}
-		#if PRINT_LOG
-		printf("\n");
-		#endif
-	}
-
-	// check cwr exit
-	if (qp->dctcp.m_caState == 1){
-		if (ack_seq > qp->dctcp.m_highSeq)
-			qp->dctcp.m_caState = 0;
-	}
-
-	// check if need to reduce rate: ECN and not in CWR
-	if (cnp && qp->dctcp.m_caState == 0){
-		#if PRINT_LOG
-		printf("%lu %s %08x %08x %u %u %.3lf->", Simulator::Now().GetTimeStep(), "rate", qp->sip.Get(), qp->dip.Get(), qp->sport, qp->dport, qp->m_rate.GetBitRate()*1e-9);
-		#endif
-		qp->m_rate = std::max(m_minRate, qp->m_rate * (1 - qp->dctcp.m_alpha / 2));
-		#if PRINT_LOG
-		printf("%.3lf\n", qp->m_rate.GetBitRate() * 1e-9);
-		#endif
-		qp->dctcp.m_caState = 1;
-		qp->dctcp.m_highSeq = qp->snd_nxt;
-	}
-
-	// additive inc
-	if (qp->dctcp.m_caState == 0 && new_batch)
-		qp->m_rate = std::min(qp->m_max_rate, qp->m_rate + m_dctcp_rai);
-}
-
-/*********************
- * HPCC-PINT
- ********************/
-void RdmaHw::SetPintSmplThresh(double p){
-       pint_smpl_thresh = (uint32_t)(65536 * p);
-}
-void RdmaHw::HandleAckHpPint(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch){
-       uint32_t ack_seq = ch.ack.seq;
-       if (rand() % 65536 >= pint_smpl_thresh)
-               return;
-       // update rate
-       if (ack_seq > qp->hpccPint.m_lastUpdateSeq){ // if full RTT feedback is ready, do full update
-               UpdateRateHpPint(qp, p, ch, false);
-       }else{ // do fast react
-               UpdateRateHpPint(qp, p, ch, true);
-       }
-}
-
-void RdmaHw::UpdateRateHpPint(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch, bool fast_react){
-       uint32_t next_seq = qp->snd_nxt;
-       if (qp->hpccPint.m_lastUpdateSeq == 0){ // first RTT
-               qp->hpccPint.m_lastUpdateSeq = next_seq;
-       }else {
-               // check packet INT
-               IntHeader &ih = ch.ack.ih;
-               double U = Pint::decode_u(ih.GetPower());
-
-               DataRate new_rate;
-               int32_t new_incStage;
-               double max_c = U / m_targetUtil;
-
-               if (max_c >= 1 || qp->hpccPint.m_incStage >= m_miThresh){
-                       new_rate = qp->hpccPint.m_curRate / max_c + m_rai;
-                       new_incStage = 0;
-               }else{
-                       new_rate = qp->hpccPint.m_curRate + m_rai;
-                       new_incStage = qp->hpccPint.m_incStage+1;
-               }
-               if (new_rate < m_minRate)
-                       new_rate = m_minRate;
-               if (new_rate > qp->m_max_rate)
-                       new_rate = qp->m_max_rate;
-               ChangeRate(qp, new_rate);
-               if (!fast_react){
-                       qp->hpccPint.m_curRate = new_rate;
-                       qp->hpccPint.m_incStage = new_incStage;
-               }
-               if (!fast_react){
-                       if (next_seq > qp->hpccPint.m_lastUpdateSeq)
-                               qp->hpccPint.m_lastUpdateSeq = next_seq; //+ rand() % 2 * m_mtu;
-               }
-       }
+	m_nic[nic_idx].dev->UpdateQp(qp);
 }
 
 }
@@ -3,11 +3,14 @@
 
 #include <ns3/rdma.h>
 #include <ns3/rdma-queue-pair.h>
+#include <ns3/rdma-congestion-ops.h>
 #include <ns3/node.h>
 #include <ns3/custom-header.h>
+#include <ns3/traced-value.h>
 #include "qbb-net-device.h"
+#include "rdma-header-template.h"
+#include "ecmp-table.h"
 #include <unordered_map>
-#include "pint.h"
 
 namespace ns3 {
 
@@ -31,16 +34,18 @@ public:
 	DataRate m_minRate;		//< Min sending rate
 	uint32_t m_mtu;
 	uint32_t m_cc_mode;
+	TypeId m_ccTypeId; // of the CC, overrides m_cc_mode if set
+	Ptr<RdmaCongestionOps> m_ccOps; // the CC of the qps, created by Setup
 	double m_nack_interval;
 	uint32_t m_chunk;
 	uint32_t m_ack_interval;
 	bool m_backto0;
-	bool m_var_win, m_fast_react;
+	bool m_var_win;
 	bool m_rateBound;
 	std::vector<RdmaInterfaceMgr> m_nic; // list of running nic controlled by this RdmaHw
 	std::unordered_map<uint64_t, Ptr<RdmaQueuePair> > m_qpMap; // mapping from uint64_t to qp
-	std::unordered_map<uint64_t, Ptr<RdmaRxQueuePair> > m_rxQpMap; // mapping from uint64_t to rx qp
-	std::unordered_map<uint32_t, std::vector<int> > m_rtTable; // map from ip address (u32) to possible ECMP port (index of dev)
+	RdmaRxQpTable m_rxQps; // rx qps, by RdmaRxQpTable::GetKey
+	EcmpTable m_rtTable; // map from ip address (u32) to possible ECMP port (index of dev)
 
 	// qp complete callback
 	typedef Callback<void, Ptr<RdmaQueuePair> > QpCompleteCallback;
@@ -54,18 +59,57 @@ public:
 	void AddQueuePair(uint64_t size, uint16_t pg, Ipv4Address _sip, Ipv4Address _dip, uint16_t _sport, uint16_t _dport, uint32_t win, uint64_t baseRtt, Callback<void> notifyAppFinish); // add a new qp (new send)
 	void DeleteQueuePair(Ptr<RdmaQueuePair> qp);
 
-	Ptr<RdmaRxQueuePair> GetRxQp(uint32_t sip, uint32_t dip, uint16_t sport, uint16_t dport, uint16_t pg, bool create); // get a rxQp
-	uint32_t GetNicIdxOfRxQp(Ptr<RdmaRxQueuePair> q); // get the NIC index of the rxQp
-	void DeleteRxQp(uint32_t dip, uint16_t pg, uint16_t dport);
+	RdmaRxQueuePair *GetRxQp(uint32_t sip, uint32_t dip, uint16_t sport, uint16_t dport, uint16_t pg, bool create); // get a rxQp, valid until the next one is created or deleted
+	uint32_t GetNicIdxOfRxQp(RdmaRxQueuePair *q); // get the NIC index of the rxQp
+	void DeleteRxQp(uint32_t dip, uint16_t pg, uint16_t dport); // the flow completed
+	void EraseRxQp(uint64_t key);
+	void SweepRxQps(); // delete the rx qps idle for m_rxQpIdleTimeout
+
+	/**********************
+	* Rx qp stats
+	*********************/
+	Time m_rxQpIdleTimeout; // 0: rx qps are only deleted by DeleteRxQp
+	EventId m_rxQpSweep;
+	TracedValue<uint32_t> m_nRxQps; // rx qps alive
+	uint64_t m_rxQpCreated; // rx qps created
+	uint64_t m_rxQpExpired; // of which deleted by SweepRxQps
+	uint32_t GetRxQpCount();
 
 
 	/**********************
 	* Coding-based transport
 	*********************/
     bool m_is_use_coding_transport;
+	bool m_codingCc; // coding qps follow m_ccOps, otherwise they send at line rate
+	uint32_t m_codingAckInterval; // ack once per this many symbols
+	Time m_codingAckDelay; // or once the oldest unacked symbol waited this long
+	uint32_t m_codingGenSize; // source symbols per generation, 0: stream mode, every symbol is useful
+	uint32_t m_codingWindow; // generations open at a time on a qp
+	double m_codingOverhead; // a generation of k symbols decodes from k * (1 + overhead)
+	Time m_codingDecodeTime; // per source symbol, before the receiver acks a generation decoded
 	Ptr<Packet> GetNxtCodingPacket(Ptr<RdmaQueuePair> qp); // get next packet to send, inc snd_nxt
 	int ReceiveCodingUdp(Ptr<Packet> p, CustomHeader &ch);
 	int ReceiveCodingAck(Ptr<Packet> p, CustomHeader &ch);
+	void SendCodingAck(uint64_t key, uint16_t pg, bool cnp); // ack all the symbols the rx qp of key received since the last ack
+	void CodingDecoded(uint64_t key, uint16_t pg, uint32_t g); // the rx qp of key decoded generation g
+	struct CodingRx{
+		uint32_t pending; // symbols received since the last ack
+		uint32_t seq; // what the coalesced ack carries
+		IntHeader ih; // INT of the latest of them, echoed by the coalesced ack
+		EventId event; // sends the coalesced ack when it waited long enough
+		RdmaCodingRx gens; // generation mode only
+		std::vector<EventId> decodes; // generations being decoded
+
+		CodingRx() : pending(0), seq(0) {}
+	};
+	std::unordered_map<uint64_t, CodingRx> m_codingRx; // by rx qp key, until EraseRxQp in generation mode, while the coalesced ack waits in stream mode
+
+	// generation mode stats
+	uint64_t m_codingSent; // symbols sent
+	uint64_t m_codingRepairs; // of which beyond what their generation needed
+	uint64_t m_codingReceived; // symbols received
+	uint64_t m_codingRedundant; // of which for a generation decodable already
+	uint64_t m_codingDecoded; // generations decoded
 
 	/**********************
 	* GBN-based transport
@@ -75,8 +119,11 @@ public:
 	int ReceiveAck(Ptr<Packet> p, CustomHeader &ch); // handle both ACK and NACK
 	int Receive(Ptr<Packet> p, CustomHeader &ch); // callback function that the QbbNetDevice should use when receive packets. Only NIC can call this function. And do not call this upon PFC
 
-	void CheckandSendQCN(Ptr<RdmaRxQueuePair> q);
-	int ReceiverCheckSeq(uint32_t seq, Ptr<RdmaRxQueuePair> q, uint32_t size);
+	void CheckandSendQCN(RdmaRxQueuePair *q);
+	int ReceiverCheckSeq(uint32_t seq, RdmaRxQueuePair *q, uint32_t size);
+	void SendAck(RdmaRxQueuePair *rxQp, uint32_t seq, uint16_t pg, bool nack, bool cnp, const IntHeader &ih); // ACK or NACK of seq, ReceiverNextExpectedSeq but in generation mode
+	RdmaHeaderTemplate m_dataHdr; // headers of the data packets, built on the first one and retargeted to each qp
+	RdmaHeaderTemplate m_ackHdr; // headers of the ACK/NACKs, built on the first one and retargeted to each rx qp
 	void AddHeader (Ptr<Packet> p, uint16_t protocolNumber);
 	static uint16_t EtherToPpp (uint16_t protocol);
 
@@ -87,81 +134,15 @@ public:
 	// call this function after the NIC is setup
 	void AddTableEntry(Ipv4Address &dstAddr, uint32_t intf_idx);
 	void ClearTable();
+	void SetTable(const EcmpTable &table); // replace the table, e.g. by an empty one of RouteCalculator
 	void RedistributeQp();
 
 	Ptr<Packet> GetNxtPacket(Ptr<RdmaQueuePair> qp); // get next packet to send, inc snd_nxt
+	void AddDataHeaders(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, uint32_t seq); // ppp/ip/udp/SeqTs headers of a data packet, from the qp's template
 	void PktSent(Ptr<RdmaQueuePair> qp, Ptr<Packet> pkt, Time interframeGap);
 	void UpdateNextAvail(Ptr<RdmaQueuePair> qp, Time interframeGap, uint32_t pkt_size);
 	void ChangeRate(Ptr<RdmaQueuePair> qp, DataRate new_rate);
-	/******************************
-	 * Mellanox's version of DCQCN
-	 *****************************/
-	double m_g; //feedback weight
-	double m_rateOnFirstCNP; // the fraction of line rate to set on first CNP
-	bool m_EcnClampTgtRate;
-	double m_rpgTimeReset;
-	double m_rateDecreaseInterval;
-	uint32_t m_rpgThreshold;
-	double m_alpha_resume_interval;
-	DataRate m_rai;		//< Rate of additive increase
-	DataRate m_rhai;		//< Rate of hyper-additive increase
-
-	// the Mellanox's version of alpha update:
-	// every fixed time slot, update alpha.
-	void UpdateAlphaMlx(Ptr<RdmaQueuePair> q);
-	void ScheduleUpdateAlphaMlx(Ptr<RdmaQueuePair> q);
-
-	// Mellanox's version of CNP receive
-	void cnp_received_mlx(Ptr<RdmaQueuePair> q);
-
-	// Mellanox's version of rate decrease
-	// It checks every m_rateDecreaseInterval if CNP arrived (m_decrease_cnp_arrived).
-	// If so, decrease rate, and reset all rate increase related things
-	void CheckRateDecreaseMlx(Ptr<RdmaQueuePair> q);
-	void ScheduleDecreaseRateMlx(Ptr<RdmaQueuePair> q, uint32_t delta);
-
-	// Mellanox's version of rate increase
-	void RateIncEventTimerMlx(Ptr<RdmaQueuePair> q);
-	void RateIncEventMlx(Ptr<RdmaQueuePair> q);
-	void FastRecoveryMlx(Ptr<RdmaQueuePair> q);
-	void ActiveIncreaseMlx(Ptr<RdmaQueuePair> q);
-	void HyperIncreaseMlx(Ptr<RdmaQueuePair> q);
-
-	/***********************
-	 * High Precision CC
-	 ***********************/
-	double m_targetUtil;
-	double m_utilHigh;
-	uint32_t m_miThresh;
-	bool m_multipleRate;
-	bool m_sampleFeedback; // only react to feedback every RTT, or qlen > 0
-	void HandleAckHp(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch);
-	void UpdateRateHp(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch, bool fast_react);
-	void UpdateRateHpTest(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch, bool fast_react);
-	void FastReactHp(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch);
-
-	/**********************
-	 * TIMELY
-	 *********************/
-	double m_tmly_alpha, m_tmly_beta;
-	uint64_t m_tmly_TLow, m_tmly_THigh, m_tmly_minRtt;
-	void HandleAckTimely(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch);
-	void UpdateRateTimely(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch, bool us);
-	void FastReactTimely(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch);
-
-	/**********************
-	 * DCTCP
-	 *********************/
-	DataRate m_dctcp_rai;
-	void HandleAckDctcp(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch);
-
-	/*********************
-	 * HPCC-PINT
-	 ********************/
-	uint32_t pint_smpl_thresh;
-	void SetPintSmplThresh(double p);
-	void HandleAckHpPint(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch);
-	void UpdateRateHpPint(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch, bool fast_react);
+	void HandleAck(Ptr<RdmaQueuePair> qp, RdmaAckFeedback &fb); // m_ccOps reacts to an ACK, of either transport
 };
 
 } /* namespace ns3 */
@@ -1,4 +1,6 @@
 #include <ns3/hash.h>
+#include <ns3/assert.h>
+#include <ns3/abort.h>
 #include <ns3/uinteger.h>
 #include <ns3/seq-ts-header.h>
 #include <ns3/udp-header.h>
@@ -6,20 +8,190 @@
 #include <ns3/simulator.h>
 #include "ns3/ppp-header.h"
 #include "rdma-queue-pair.h"
+#include <algorithm>
+#include <cstddef>
+#include <new>
 
 namespace ns3 {
 
 /**************************
- * RdmaQueuePair
+ * RdmaCcSlab
  *************************/
-TypeId RdmaQueuePair::GetTypeId (void)
-{
-	static TypeId tid = TypeId ("ns3::RdmaQueuePair")
-		.SetParent<Object> ()
-		;
-	return tid;
+RdmaCcSlab::RdmaCcSlab(uint32_t blockSize){
+	// room for the free list link, aligned for any of the CC states
+	m_blockSize = std::max<uint32_t>(blockSize, sizeof(void*));
+	m_blockSize = (m_blockSize + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+	m_nextInChunk = blocksPerChunk;
+	m_free = NULL;
+	m_destroy = NULL;
+}
+
+RdmaCcSlab::~RdmaCcSlab(){
+	for (char *c : m_chunks)
+		::operator delete(c);
 }
 
+void *RdmaCcSlab::Alloc(){
+	if (m_free != NULL){
+		void *p = m_free;
+		m_free = *(void**)p;
+		return p;
+	}
+	if (m_nextInChunk == blocksPerChunk){
+		m_chunks.push_back((char*)::operator new((size_t)m_blockSize * blocksPerChunk));
+		m_nextInChunk = 0;
+	}
+	return m_chunks.back() + (size_t)m_blockSize * m_nextInChunk++;
+}
+
+void RdmaCcSlab::Free(void *p){
+	*(void**)p = m_free;
+	m_free = p;
+}
+
+void RdmaCcSlab::Delete(void *p){
+	m_destroy(p);
+	Free(p);
+}
+
+uint32_t RdmaCcSlab::GetBlockSize(){
+	return m_blockSize;
+}
+
+uint64_t RdmaCcSlab::GetBytes(){
+	return (uint64_t)m_chunks.size() * m_blockSize * blocksPerChunk;
+}
+
+/**************************
+ * RdmaCodingTx
+ *************************/
+RdmaCodingTx::RdmaCodingTx(uint64_t size, uint32_t mtu, uint32_t genSize, uint32_t window, double overhead){
+	NS_ASSERT(genSize > 0 && genSize <= RdmaCoding::maxK && window > 0);
+	m_size = size;
+	m_mtu = mtu;
+	m_genSize = genSize;
+	m_window = window;
+	m_overhead = overhead;
+	uint64_t symbols = (size + mtu - 1) / mtu;
+	m_nGen = (symbols + genSize - 1) / genSize;
+	NS_ABORT_MSG_IF(m_nGen >= 1U << (31 - RdmaCoding::kBits), "Too many coding generations for the seq of an ACK, raise CodingGenerationSize");
+	m_base = m_next = m_repair = 0;
+	m_gens.resize(window);
+	m_sent = m_repairs = 0;
+	m_acked = 0;
+	m_ackedLow = 0;
+}
+
+uint32_t RdmaCodingTx::GetK(uint32_t g){
+	if (g + 1 < m_nGen)
+		return m_genSize;
+	return (m_size + m_mtu - 1) / m_mtu - (uint64_t)(m_nGen - 1) * m_genSize;
+}
+
+uint32_t RdmaCodingTx::NextSymbol(){
+	NS_ASSERT(!IsDone());
+	uint32_t g = m_next;
+	bool found = false;
+	// an open generation still short of the symbols it needs
+	for (uint32_t i = m_base; i < m_next && !found; i++){
+		Generation &gen = m_gens[i % m_window];
+		if (!gen.decoded && gen.sent < RdmaCoding::GetNeeded(GetK(i), m_overhead)){
+			g = i;
+			found = true;
+		}
+	}
+	// or a new one, if the window has room
+	if (!found && m_next < m_nGen && m_next - m_base < m_window){
+		m_gens[m_next % m_window] = Generation{0, false};
+		g = m_next++;
+		found = true;
+	}
+	// or a repair symbol of the undecoded ones in turn, m_base is one of them
+	if (!found){
+		if (m_repair < m_base || m_repair >= m_next)
+			m_repair = m_base;
+		while (m_gens[m_repair % m_window].decoded)
+			m_repair = m_repair + 1 < m_next ? m_repair + 1 : m_base;
+		g = m_repair++;
+		m_repairs++;
+	}
+	m_gens[g % m_window].sent++;
+	m_sent++;
+	return RdmaCoding::GetSymbolSeq(g, GetK(g));
+}
+
+bool RdmaCodingTx::OnAck(uint32_t seq){
+	// acks arrive in order, and fewer than maxK symbols apart
+	uint32_t received = RdmaCoding::GetAckReceived(seq);
+	uint32_t delta = (received - m_ackedLow) & (RdmaCoding::maxK - 1);
+	NS_ASSERT_MSG(m_acked + delta <= m_sent, "coding ack counts more symbols than were sent, acks out of order");
+	m_acked += delta;
+	m_ackedLow = received;
+	uint32_t g = RdmaCoding::GetAckGeneration(seq);
+	if (g < m_base || g >= m_next)
+		return false;
+	Generation &gen = m_gens[g % m_window];
+	if (gen.decoded || !RdmaCoding::IsAckDecoded(seq))
+		return false;
+	gen.decoded = true;
+	while (m_base < m_next && m_gens[m_base % m_window].decoded)
+		m_base++;
+	return true;
+}
+
+uint64_t RdmaCodingTx::GetDecodedBytes(){
+	return std::min(m_size, (uint64_t)m_base * m_genSize * m_mtu);
+}
+
+bool RdmaCodingTx::IsDone(){
+	return m_base == m_nGen;
+}
+
+/**************************
+ * RdmaCodingRx
+ *************************/
+RdmaCodingRx::RdmaCodingRx(){
+	m_base = 0;
+	m_received = 0;
+}
+
+RdmaCodingRx::Result RdmaCodingRx::OnSymbol(uint32_t seq, double overhead){
+	uint32_t g = RdmaCoding::GetGeneration(seq);
+	m_received++;
+	if (g < m_base)
+		return RX_REDUNDANT;
+	while (m_gens.size() <= g - m_base)
+		m_gens.push_back(Generation{0, COLLECTING});
+	Generation &gen = m_gens[g - m_base];
+	if (gen.state != COLLECTING)
+		return RX_REDUNDANT;
+	if (++gen.rank < RdmaCoding::GetNeeded(RdmaCoding::GetK(seq), overhead))
+		return RX_RANK;
+	gen.state = DECODING;
+	return RX_DECODABLE;
+}
+
+void RdmaCodingRx::SetDecoded(uint32_t g){
+	if (g < m_base || g - m_base >= m_gens.size())
+		return;
+	m_gens[g - m_base].state = DECODED;
+	while (!m_gens.empty() && m_gens.front().state == DECODED){
+		m_gens.pop_front();
+		m_base++;
+	}
+}
+
+bool RdmaCodingRx::IsDecoded(uint32_t g){
+	return g < m_base || (g - m_base < m_gens.size() && m_gens[g - m_base].state == DECODED);
+}
+
+uint32_t RdmaCodingRx::GetAckSeq(uint32_t g){
+	return RdmaCoding::GetAckSeq(g, IsDecoded(g), m_received);
+}
+
+/**************************
+ * RdmaQueuePair
+ *************************/
 RdmaQueuePair::RdmaQueuePair(uint16_t pg, Ipv4Address _sip, Ipv4Address _dip, uint16_t _sport, uint16_t _dport){
 	startTime = Simulator::Now();
 	sip = _sip;
@@ -28,7 +200,7 @@ RdmaQueuePair::RdmaQueuePair(uint16_t pg, Ipv4Address _sip, Ipv4Address _dip, ui
 	dport = _dport;
 	m_size = 0;
 	snd_nxt = snd_una = 0;
-	coding_snd_nxt = 0;
+	coding_snd_nxt = coding_snd_una = 0;
 	m_pg = pg;
 	m_ipid = 0;
 	m_win = 0;
@@ -37,36 +209,14 @@ RdmaQueuePair::RdmaQueuePair(uint16_t pg, Ipv4Address _sip, Ipv4Address _dip, ui
 	m_var_win = false;
 	m_rate = 0;
 	m_nextAvail = Time(0);
-	mlx.m_alpha = 1;
-	mlx.m_alpha_cnp_arrived = false;
-	mlx.m_first_cnp = true;
-	mlx.m_decrease_cnp_arrived = false;
-	mlx.m_rpTimeStage = 0;
-	hp.m_lastUpdateSeq = 0;
-	for (uint32_t i = 0; i < sizeof(hp.keep) / sizeof(hp.keep[0]); i++)
-		hp.keep[i] = 0;
-	hp.m_incStage = 0;
-	hp.m_lastGap = 0;
-	hp.u = 1;
-	for (uint32_t i = 0; i < IntHeader::maxHop; i++){
-		hp.hopState[i].u = 1;
-		hp.hopState[i].incStage = 0;
-	}
-
-	tmly.m_lastUpdateSeq = 0;
-	tmly.m_incStage = 0;
-	tmly.lastRtt = 0;
-	tmly.rttDiff = 0;
-
-	dctcp.m_lastUpdateSeq = 0;
-	dctcp.m_caState = 0;
-	dctcp.m_highSeq = 0;
-	dctcp.m_alpha = 1;
-	dctcp.m_ecnCnt = 0;
-	dctcp.m_batchSizeOfAlpha = 0;
+	lastPktSize = 0;
+	m_egressIdx = 0;
+	m_cc = NULL;
+}
 
-	hpccPint.m_lastUpdateSeq = 0;
-	hpccPint.m_incStage = 0;
+RdmaQueuePair::~RdmaQueuePair(){
+	if (m_cc != NULL)
+		m_ccSlab->Delete(m_cc);
 }
 
 void RdmaQueuePair::SetSize(uint64_t size){
@@ -115,7 +265,8 @@ void RdmaQueuePair::Acknowledge(uint64_t ack){
 }
 
 uint64_t RdmaQueuePair::GetOnTheFly(){
-	return snd_nxt - snd_una;
+	// a coding qp keeps snd_nxt at snd_una, a go-back-N one never sends a symbol
+	return snd_nxt - snd_una + coding_snd_nxt - coding_snd_una;
 }
 
 bool RdmaQueuePair::IsWinBound(){
@@ -137,20 +288,6 @@ uint64_t RdmaQueuePair::GetWin(){
 	return w;
 }
 
-uint64_t RdmaQueuePair::HpGetCurWin(){
-	if (m_win == 0)
-		return 0;
-	uint64_t w;
-	if (m_var_win){
-		w = m_win * hp.m_curRate.GetBitRate() / m_max_rate.GetBitRate();
-		if (w == 0)
-			w = 1; // must > 0
-	}else{
-		w = m_win;
-	}
-	return w;
-}
-
 bool RdmaQueuePair::IsFinished(){
 	return snd_una >= m_size;
 }
@@ -158,19 +295,12 @@ bool RdmaQueuePair::IsFinished(){
 /*********************
  * RdmaRxQueuePair
  ********************/
-TypeId RdmaRxQueuePair::GetTypeId (void)
-{
-	static TypeId tid = TypeId ("ns3::RdmaRxQueuePair")
-		.SetParent<Object> ()
-		;
-	return tid;
-}
-
 RdmaRxQueuePair::RdmaRxQueuePair(){
+	key = 0;
 	sip = dip = sport = dport = 0;
 	m_ipid = 0;
+	used = 0;
 	ReceiverNextExpectedSeq = 0;
-	m_nackTimer = Time(0);
 	m_milestone_rx = 0;
 	m_lastNACK = 0;
 }
@@ -190,6 +320,114 @@ uint32_t RdmaRxQueuePair::GetHash(void){
 	return Hash32(buf.c, 12);
 }
 
+/*********************
+ * RdmaRxQpTable
+ ********************/
+RdmaRxQpTable::RdmaRxQpTable(){
+	m_slots.assign(minCapacity, RdmaRxQueuePair());
+	m_mask = minCapacity - 1;
+	m_size = 0;
+}
+
+uint64_t RdmaRxQpTable::GetKey(uint32_t dip, uint16_t pg, uint16_t dport){
+	return ((uint64_t)dip << 32) | ((uint64_t)pg << 16) | (uint64_t)dport;
+}
+
+uint64_t RdmaRxQpTable::Hash(uint64_t key){
+	// murmur3 finalizer, the low bits of the key alone are the ports of one sender
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	key ^= key >> 33;
+	return key;
+}
+
+uint32_t RdmaRxQpTable::FindSlot(uint64_t key){
+	uint32_t i = Hash(key) & m_mask;
+	while (m_slots[i].used && m_slots[i].key != key)
+		i = (i + 1) & m_mask;
+	return i;
+}
+
+RdmaRxQueuePair *RdmaRxQpTable::Find(uint64_t key){
+	uint32_t i = FindSlot(key);
+	return m_slots[i].used ? &m_slots[i] : NULL;
+}
+
+RdmaRxQueuePair *RdmaRxQpTable::Insert(uint64_t key, bool &inserted){
+	uint32_t i = FindSlot(key);
+	if (m_slots[i].used){
+		inserted = false;
+		return &m_slots[i];
+	}
+	// keep the load factor at most 1/2 so probe sequences stay short
+	if ((m_size + 1) * 2 > m_slots.size()){
+		Resize(m_slots.size() * 2);
+		i = FindSlot(key);
+	}
+	RdmaRxQueuePair &q = m_slots[i];
+	q = RdmaRxQueuePair();
+	q.key = key;
+	q.used = 1;
+	m_size++;
+	inserted = true;
+	return &q;
+}
+
+bool RdmaRxQpTable::Erase(uint64_t key){
+	uint32_t i = FindSlot(key);
+	if (!m_slots[i].used)
+		return false;
+	// backward-shift deletion: pull up every following record whose home slot
+	// is not in (i, j], so no probe sequence is broken by the hole at i
+	uint32_t j = i;
+	while (true){
+		j = (j + 1) & m_mask;
+		if (!m_slots[j].used)
+			break;
+		uint32_t k = Hash(m_slots[j].key) & m_mask;
+		bool stays = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);
+		if (!stays){
+			m_slots[i] = m_slots[j];
+			i = j;
+		}
+	}
+	m_slots[i].used = 0;
+	m_size--;
+	if (m_slots.size() > minCapacity && m_size * 8 < m_slots.size())
+		Resize(m_slots.size() / 2);
+	return true;
+}
+
+void RdmaRxQpTable::Clear(){
+	std::vector<RdmaRxQueuePair>(minCapacity).swap(m_slots);
+	m_mask = minCapacity - 1;
+	m_size = 0;
+}
+
+uint32_t RdmaRxQpTable::GetN(){
+	return m_size;
+}
+
+uint32_t RdmaRxQpTable::GetCapacity(){
+	return m_slots.size();
+}
+
+RdmaRxQueuePair &RdmaRxQpTable::GetSlot(uint32_t i){
+	NS_ASSERT(i < m_slots.size());
+	return m_slots[i];
+}
+
+void RdmaRxQpTable::Resize(uint32_t capacity){
+	std::vector<RdmaRxQueuePair> old(capacity);
+	old.swap(m_slots);
+	m_mask = capacity - 1;
+	for (auto &q : old)
+		if (q.used)
+			m_slots[FindSlot(q.key)] = q;
+}
+
 /*********************
  * RdmaQueuePairGroup
  ********************/
@@ -202,6 +440,7 @@ TypeId RdmaQueuePairGroup::GetTypeId (void)
 }
 
 RdmaQueuePairGroup::RdmaQueuePairGroup(void){
+	m_generation = 0;
 }
 
 uint32_t RdmaQueuePairGroup::GetN(void){
@@ -228,6 +467,7 @@ void RdmaQueuePairGroup::AddRxQp(Ptr<RdmaRxQueuePair> rxQp){
 
 void RdmaQueuePairGroup::Clear(void){
 	m_qps.clear();
+	m_generation++;
 }
 
 }
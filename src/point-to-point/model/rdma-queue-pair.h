@@ -2,90 +2,212 @@
 #define RDMA_QUEUE_PAIR_H
 
 #include <ns3/object.h>
+#include <ns3/simple-ref-count.h>
 #include <ns3/packet.h>
 #include <ns3/ipv4-address.h>
 #include <ns3/data-rate.h>
 #include <ns3/event-id.h>
+#include <ns3/assert.h>
+#include <ns3/nstime.h>
 #include <ns3/custom-header.h>
 #include <ns3/int-header.h>
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <memory>
+#include <new>
 #include <vector>
 
 namespace ns3 {
 
-class RdmaQueuePair : public Object {
+/**
+ * Fixed-size blocks for the CC state of the qps of one RdmaCongestionOps,
+ * carved from chunks and recycled through a free list. Each qp holds a
+ * reference, so the slab outlives the ops as long as a qp does.
+ */
+class RdmaCcSlab : public SimpleRefCount<RdmaCcSlab> {
 public:
-	Time startTime;
-	Ipv4Address sip, dip;
-	uint16_t sport, dport;
+	RdmaCcSlab(uint32_t blockSize);
+	~RdmaCcSlab();
+	void *Alloc();
+	void Free(void *p);
+	// a T in a new block, the slab holds blocks of one type
+	template <typename T>
+	T *New(){
+		NS_ASSERT_MSG(m_blockSize >= sizeof(T), "the slab is sized for another type");
+		NS_ASSERT_MSG(m_destroy == NULL || m_destroy == &Destroy<T>, "the slab holds another type");
+		m_destroy = &Destroy<T>;
+		return new (Alloc()) T();
+	}
+	void Delete(void *p); // destroy the object in p and free its block
+	uint32_t GetBlockSize();
+	uint64_t GetBytes(); // memory held by the chunks
+
+private:
+	static const uint32_t blocksPerChunk = 256;
+	uint32_t m_blockSize;
+	uint32_t m_nextInChunk; // first never used block of the last chunk
+	std::vector<char*> m_chunks;
+	void *m_free; // freed blocks, each starting with the next
+	void (*m_destroy)(void *); // destructor of the type of the blocks
+
+	template <typename T>
+	static void Destroy(void *p){
+		static_cast<T *>(p)->~T();
+	}
+};
+
+/**
+ * Generations of the rateless coding transport. A flow is cut into
+ * generations of up to maxK source symbols of one MTU each, the last one
+ * shorter; generation g can be decoded from any GetNeeded(k) of its symbols,
+ * source or repair, the reception overhead of a RaptorQ-like code. A data
+ * symbol carries g and k - 1 in its seq, an ACK carries g, whether g is
+ * decoded and the count of symbols the receiver got, modulo maxK.
+ */
+struct RdmaCoding {
+	static const uint32_t kBits = 12;
+	static const uint32_t maxK = 1 << kBits;
+
+	static uint32_t GetNeeded(uint32_t k, double overhead){ // ceil(k * (1 + overhead))
+		return (uint32_t)std::ceil(k * (1 + overhead) - 1e-9);
+	}
+	static uint32_t GetSymbolSeq(uint32_t g, uint32_t k){
+		return g << kBits | (k - 1);
+	}
+	static uint32_t GetGeneration(uint32_t seq){
+		return seq >> kBits;
+	}
+	static uint32_t GetK(uint32_t seq){
+		return (seq & (maxK - 1)) + 1;
+	}
+	static uint32_t GetAckSeq(uint32_t g, bool decoded, uint32_t received){
+		return g << (kBits + 1) | (uint32_t)decoded << kBits | (received & (maxK - 1));
+	}
+	static uint32_t GetAckGeneration(uint32_t seq){
+		return seq >> (kBits + 1);
+	}
+	static bool IsAckDecoded(uint32_t seq){
+		return (seq >> kBits) & 1;
+	}
+	static uint32_t GetAckReceived(uint32_t seq){
+		return seq & (maxK - 1);
+	}
+};
+
+/**
+ * Sender side of a coding qp. Up to 'window' generations are open at a time:
+ * each first gets the symbols it needs to be decoded, then, while no new one
+ * may open, the undecoded ones get repair symbols in turn until the receiver
+ * acks them decoded, which is what stops the sender.
+ */
+class RdmaCodingTx {
+public:
+	struct Generation {
+		uint32_t sent; // symbols sent
+		bool decoded;
+	};
+
+	RdmaCodingTx(uint64_t size, uint32_t mtu, uint32_t genSize, uint32_t window, double overhead);
+	uint32_t GetK(uint32_t g); // source symbols of generation g
+	uint32_t NextSymbol(); // the seq of the next symbol to send, counted as sent
+	bool OnAck(uint32_t seq); // true if the ack newly decoded a generation
+	uint64_t GetDecodedBytes(); // of the generations decoded in order from the first
+	bool IsDone();
+
 	uint64_t m_size;
-	uint64_t coding_snd_nxt;
-	uint64_t snd_nxt, snd_una; // next seq to send, the highest unacked seq
+	uint32_t m_mtu, m_genSize, m_window;
+	double m_overhead;
+	uint32_t m_nGen; // generations of the flow
+	uint32_t m_base; // generations below are decoded
+	uint32_t m_next; // generations below are open
+	uint32_t m_repair; // next generation to get a repair symbol
+	std::vector<Generation> m_gens; // the open ones, by g % window
+	uint64_t m_sent; // symbols sent
+	uint64_t m_repairs; // of which beyond what the generation needs
+	uint64_t m_acked; // symbols the receiver got, as its acks count them
+	uint32_t m_ackedLow; // the count of the latest ack, modulo maxK
+};
+
+/**
+ * Receiver side of a coding rx qp: the rank of each generation, until it
+ * reaches GetNeeded and the generation becomes decodable, then decoded once
+ * RdmaHw has spent the decoding time on it.
+ */
+class RdmaCodingRx {
+public:
+	enum Result {
+		RX_RANK, // the symbol raised the rank of its generation
+		RX_DECODABLE, // and made it decodable
+		RX_REDUNDANT, // its generation was decodable already
+	};
+
+	RdmaCodingRx();
+	Result OnSymbol(uint32_t seq, double overhead);
+	void SetDecoded(uint32_t g);
+	bool IsDecoded(uint32_t g);
+	uint32_t GetAckSeq(uint32_t g);
+
+private:
+	enum { COLLECTING, DECODING, DECODED };
+	struct Generation {
+		uint32_t rank;
+		uint8_t state;
+	};
+	uint32_t m_base; // generations below are decoded
+	std::deque<Generation> m_gens; // of generations m_base..
+	uint32_t m_received; // symbols received
+};
+
+class RdmaQueuePair : public SimpleRefCount<RdmaQueuePair> {
+public:
+	/******************************
+	 * hot, read by the NIC scheduler for each qp it classifies
+	 *****************************/
+	uint32_t m_egressIdx; // slot in the NIC's RdmaQueuePairGroup, kept by RdmaEgressQueue
 	uint16_t m_pg;
-	uint16_t m_ipid;
+	bool m_var_win; // variable window size
 	uint32_t m_win; // bound of on-the-fly packets
-	uint64_t m_baseRtt; // base RTT of this qp
+	uint32_t lastPktSize;
+	uint64_t snd_nxt, snd_una; // next seq to send, the highest unacked seq
+	uint64_t m_size;
+	DataRate m_rate;	//< Current rate
 	DataRate m_max_rate; // max rate
-	bool m_var_win; // variable window size
 	Time m_nextAvail;	//< Soonest time of next send
-	uint32_t wp; // current window of packets
-	uint32_t lastPktSize;
-	Callback<void> m_notifyAppFinish;
+	uint64_t coding_snd_nxt, coding_snd_una; // bytes of the coded symbols sent, and acked
+
+	void *m_cc; // state of the RdmaCongestionOps of its RdmaHw, from the slab of the ops
 
 	/******************************
-	 * runtime states
+	 * cold
 	 *****************************/
-	DataRate m_rate;	//< Current rate
-	struct {
-		DataRate m_targetRate;	//< Target rate
-		EventId m_eventUpdateAlpha;
-		double m_alpha;
-		bool m_alpha_cnp_arrived; // indicate if CNP arrived in the last slot
-		bool m_first_cnp; // indicate if the current CNP is the first CNP
-		EventId m_eventDecreaseRate;
-		bool m_decrease_cnp_arrived; // indicate if CNP arrived in the last slot
-		uint32_t m_rpTimeStage;
-		EventId m_rpTimer;
-	} mlx;
-	struct {
-		uint32_t m_lastUpdateSeq;
-		DataRate m_curRate;
-		IntHop hop[IntHeader::maxHop];
-		uint32_t keep[IntHeader::maxHop];
-		uint32_t m_incStage;
-		double m_lastGap;
-		double u;
-		struct {
-			double u;
-			DataRate Rc;
-			uint32_t incStage;
-		}hopState[IntHeader::maxHop];
-	} hp;
-	struct{
-		uint32_t m_lastUpdateSeq;
-		DataRate m_curRate;
-		uint32_t m_incStage;
-		uint64_t lastRtt;
-		double rttDiff;
-	} tmly;
-	struct{
-		uint32_t m_lastUpdateSeq;
-		uint32_t m_caState;
-		uint32_t m_highSeq; // when to exit cwr
-		double m_alpha;
-		uint32_t m_ecnCnt;
-		uint32_t m_batchSizeOfAlpha;
-	} dctcp;
-	struct{
-		uint32_t m_lastUpdateSeq;
-		DataRate m_curRate;
-		uint32_t m_incStage;
-	}hpccPint;
+	uint16_t m_ipid;
+	uint16_t sport, dport;
+	Ipv4Address sip, dip;
+	uint64_t m_baseRtt; // base RTT of this qp
+	Time startTime;
+	Ptr<RdmaCcSlab> m_ccSlab;
+	Callback<void> m_notifyAppFinish;
+	std::unique_ptr<RdmaCodingTx> m_codingTx; // generations of a coding qp, null in stream mode
 
 	/***********
 	 * methods
 	 **********/
-	static TypeId GetTypeId (void);
 	RdmaQueuePair(uint16_t pg, Ipv4Address _sip, Ipv4Address _dip, uint16_t _sport, uint16_t _dport);
+	~RdmaQueuePair();
+	// allocate and init the CC state, from a slab of T
+	template <typename T>
+	T *NewCcState(Ptr<RdmaCcSlab> slab){
+		NS_ASSERT_MSG(m_cc == NULL, "the CC state of a qp is set once");
+		m_ccSlab = slab;
+		T *state = slab->New<T>();
+		m_cc = state;
+		return state;
+	}
+	template <typename T>
+	T *GetCcState(){
+		return static_cast<T *>(m_cc);
+	}
 	void SetSize(uint64_t size);
 	void SetWin(uint32_t win);
 	void SetBaseRtt(uint64_t baseRtt);
@@ -99,11 +221,14 @@ public:
 	bool IsWinBound();
 	uint64_t GetWin(); // window size calculated from m_rate
 	bool IsFinished();
-	uint64_t HpGetCurWin(); // window size calculated from hp.m_curRate, used by HPCC
 };
 
-class RdmaRxQueuePair : public Object { // Rx side queue pair
-public:
+/**
+ * Rx side queue pair, a fixed-size record of RdmaRxQpTable. The ACK headers
+ * are patched per ACK from the one template of RdmaHw, and the coding state
+ * of an rx qp, its coalesced ack and its generations, lives in RdmaHw.
+ */
+struct alignas(64) RdmaRxQueuePair {
 	struct ECNAccount{
 		uint16_t qIndex;
 		uint8_t ecnbits;
@@ -112,24 +237,61 @@ public:
 
 		ECNAccount() { memset(this, 0, sizeof(ECNAccount));}
 	};
-	ECNAccount m_ecn_source;
+	uint64_t key; // RdmaRxQpTable::GetKey of the remote dip, pg and dport
 	uint32_t sip, dip;
 	uint16_t sport, dport;
 	uint16_t m_ipid;
+	uint8_t used; // slot is occupied
+	ECNAccount m_ecn_source;
 	uint32_t ReceiverNextExpectedSeq;
-	Time m_nackTimer;
 	int32_t m_milestone_rx;
 	uint32_t m_lastNACK;
-	EventId QcnTimerEvent; // if destroy this rxQp, remember to cancel this timer
+	Time m_nackTimer;
+	Time m_lastActive; // last data packet, for the idle timeout of RdmaHw
 
-	static TypeId GetTypeId (void);
 	RdmaRxQueuePair();
 	uint32_t GetHash(void);
 };
 
+static_assert(sizeof(RdmaRxQueuePair) == 64, "RdmaRxQueuePair should fit in one cache line");
+
+/**
+ * Open-addressing hash table of the rx qps of an RdmaHw, by GetKey. Linear
+ * probing over a power-of-two array with backward-shift deletion, as
+ * CncpFlowTable; it halves when it gets 1/8 full, so the memory follows the
+ * rx qps alive. Record pointers stay valid until the next Insert or Erase.
+ */
+class RdmaRxQpTable {
+public:
+	static const uint32_t minCapacity = 64;
+
+	RdmaRxQpTable();
+	static uint64_t GetKey(uint32_t dip, uint16_t pg, uint16_t dport);
+
+	RdmaRxQueuePair *Find(uint64_t key); // NULL if absent
+	RdmaRxQueuePair *Insert(uint64_t key, bool &inserted); // a new record if absent
+	bool Erase(uint64_t key);
+	void Clear();
+	uint32_t GetN();
+
+	// raw slot access for walking all rx qps, skip slots with used == 0
+	uint32_t GetCapacity();
+	RdmaRxQueuePair &GetSlot(uint32_t i);
+
+private:
+	static uint64_t Hash(uint64_t key);
+	uint32_t FindSlot(uint64_t key);
+	void Resize(uint32_t capacity);
+
+	std::vector<RdmaRxQueuePair> m_slots;
+	uint32_t m_mask;
+	uint32_t m_size;
+};
+
 class RdmaQueuePairGroup : public Object {
 public:
 	std::vector<Ptr<RdmaQueuePair> > m_qps;
+	uint32_t m_generation; // bumped by Clear, so the NIC scheduler knows its slots are stale
 	//std::vector<Ptr<RdmaRxQueuePair> > m_rxQps;
 
 	static TypeId GetTypeId (void);
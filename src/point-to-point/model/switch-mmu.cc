@@ -32,10 +32,8 @@ SwitchMmu::SwitchMmu(void)
 
     // headroom
     shared_used_bytes = 0;
-    memset(hdrm_bytes, 0, sizeof(hdrm_bytes));
-    memset(ingress_bytes, 0, sizeof(ingress_bytes));
-    memset(paused, 0, sizeof(paused));
-    memset(egress_bytes, 0, sizeof(egress_bytes));
+    total_hdrm = 0;
+    total_rsrv = 0;
     m_uv = CreateObject<UniformRandomVariable>();
     m_uv->SetAttribute("Min", DoubleValue(0.0));
     m_uv->SetAttribute("Max", DoubleValue(1.0));
@@ -48,7 +46,7 @@ SwitchMmu::CheckIngressAdmission(uint32_t port, uint32_t qIndex, uint32_t psize)
         psize + GetSharedUsed(port, qIndex) > GetPfcThreshold(port))
     {
         NS_LOG_DEBUG(Simulator::Now().GetTimeStep() << " " << node_id << " Drop: queue:" << port << "," << qIndex << ": Headroom full");
-        for (uint32_t i = 1; i < 64; i++)
+        for (uint32_t i = 1; i < hdrm_bytes.size(); i++)
         {
             NS_LOG_DEBUG("(" << hdrm_bytes[i][3] << "," << ingress_bytes[i][3] << ")");
         }
@@ -90,6 +88,10 @@ void
 SwitchMmu::UpdateEgressAdmission(uint32_t port, uint32_t qIndex, uint32_t psize)
 {
     egress_bytes[port][qIndex] += psize;
+    if (!egress_monitor.empty() && egress_monitor[port] != nullptr)
+    {
+        egress_monitor[port]->Change(psize);
+    }
 }
 
 void
@@ -108,6 +110,10 @@ void
 SwitchMmu::RemoveFromEgressAdmission(uint32_t port, uint32_t qIndex, uint32_t psize)
 {
     egress_bytes[port][qIndex] -= psize;
+    if (!egress_monitor.empty() && egress_monitor[port] != nullptr)
+    {
+        egress_monitor[port]->Change(-(int64_t)psize);
+    }
 }
 
 bool
@@ -177,9 +183,33 @@ SwitchMmu::ShouldSendCN(uint32_t ifindex, uint32_t qIndex)
     return false;
 }
 
+void
+SwitchMmu::ConfigNDevices(uint32_t n_dev)
+{
+    if (n_dev <= headroom.size())
+    {
+        return;
+    }
+    pfc_a_shift.resize(n_dev, 0);
+    headroom.resize(n_dev, 0);
+    kmin.resize(n_dev, 0);
+    kmax.resize(n_dev, 0);
+    pmax.resize(n_dev, 0);
+    std::array<uint32_t, qCnt> zero{};
+    hdrm_bytes.resize(n_dev, zero);
+    ingress_bytes.resize(n_dev, zero);
+    paused.resize(n_dev, zero);
+    egress_bytes.resize(n_dev, zero);
+    if (!egress_monitor.empty())
+    {
+        egress_monitor.resize(n_dev, nullptr);
+    }
+}
+
 void
 SwitchMmu::ConfigEcn(uint32_t port, uint32_t _kmin, uint32_t _kmax, double _pmax)
 {
+    ConfigNDevices(port + 1);
     kmin[port] = _kmin * 1000;
     kmax[port] = _kmax * 1000;
     pmax[port] = _pmax;
@@ -188,12 +218,14 @@ SwitchMmu::ConfigEcn(uint32_t port, uint32_t _kmin, uint32_t _kmax, double _pmax
 void
 SwitchMmu::ConfigHdrm(uint32_t port, uint32_t size)
 {
+    ConfigNDevices(port + 1);
     headroom[port] = size;
 }
 
 void
 SwitchMmu::ConfigNPort(uint32_t n_port)
 {
+    ConfigNDevices(n_port + 1); // device 0 is the loopback
     total_hdrm = 0;
     total_rsrv = 0;
     for (uint32_t i = 1; i <= n_port; i++)
@@ -1,9 +1,13 @@
 #ifndef SWITCH_MMU_H
 #define SWITCH_MMU_H
 
+#include "queue-monitor.h"
+
 #include <ns3/node.h>
 
+#include <array>
 #include <unordered_map>
+#include <vector>
 #include "ns3/random-variable-stream.h"
 
 namespace ns3
@@ -14,8 +18,7 @@ class Packet;
 class SwitchMmu : public Object
 {
   public:
-    static const uint32_t pCnt = 257; // Number of ports used
-    static const uint32_t qCnt = 8;   // Number of queues/priorities used
+    static const uint32_t qCnt = 8; // Number of queues/priorities used
                                       // Uniform random variable
     Ptr<UniformRandomVariable> m_uv;
 
@@ -47,24 +50,29 @@ class SwitchMmu : public Object
     void ConfigNPort(uint32_t n_port);
     void ConfigBufferSize(uint32_t size);
 
-    // config
+    // config, per-port vectors are indexed by device and grow to cover every
+    // port passed to ConfigEcn, ConfigHdrm and ConfigNPort
     uint32_t node_id;
     uint32_t buffer_size;
-    uint32_t pfc_a_shift[pCnt];
+    std::vector<uint32_t> pfc_a_shift;
     uint32_t reserve;
-    uint32_t headroom[pCnt];
+    std::vector<uint32_t> headroom;
     uint32_t resume_offset;
-    uint32_t kmin[pCnt], kmax[pCnt];
-    double pmax[pCnt];
+    std::vector<uint32_t> kmin, kmax;
+    std::vector<double> pmax;
     uint32_t total_hdrm;
     uint32_t total_rsrv;
 
     // runtime
     uint32_t shared_used_bytes;
-    uint32_t hdrm_bytes[pCnt][qCnt];
-    uint32_t ingress_bytes[pCnt][qCnt];
-    uint32_t paused[pCnt][qCnt];
-    uint32_t egress_bytes[pCnt][qCnt];
+    std::vector<std::array<uint32_t, qCnt>> hdrm_bytes;
+    std::vector<std::array<uint32_t, qCnt>> ingress_bytes;
+    std::vector<std::array<uint32_t, qCnt>> paused;
+    std::vector<std::array<uint32_t, qCnt>> egress_bytes;
+    std::vector<QueueMonitor::Port*> egress_monitor; // by port, sized as egress_bytes, empty when none is monitored
+
+  private:
+    void ConfigNDevices(uint32_t n_dev); // make room for devices 0 .. n_dev - 1
 };
 
 } /* namespace ns3 */
@@ -5,15 +5,18 @@
 
 #include "ns3/boolean.h"
 #include "ns3/double.h"
+#include "ns3/enum.h"
 #include "ns3/flow-id-tag.h"
 #include "ns3/int-header.h"
 #include "ns3/ipv4-header.h"
 #include "ns3/ipv4.h"
 #include "ns3/packet.h"
 #include "ns3/pause-header.h"
+#include "ns3/rng-seed-manager.h"
 #include "ns3/simulator.h"
 #include "ns3/uinteger.h"
 
+#include <algorithm>
 #include <cmath>
 #include <iomanip>
 
@@ -61,7 +64,69 @@ SwitchNode::GetTypeId(void)
                                           "CNCP Iterative Update Parameter Lambda",
                                           UintegerValue(100000000000),
                                           MakeUintegerAccessor(&SwitchNode::m_lambda),
-                                          MakeUintegerChecker<uint64_t>());
+                                          MakeUintegerChecker<uint64_t>())
+                            .AddAttribute("CNCPReportInterval",
+                                          "Interval between two CNCP reports of a flow (ns)",
+                                          UintegerValue(1000),
+                                          MakeUintegerAccessor(&SwitchNode::m_cncp_report_interval),
+                                          MakeUintegerChecker<uint64_t>(1))
+                            .AddAttribute("CNCPUpdateInterval",
+                                          "Interval between two CNCP rate updates of a flow (ns)",
+                                          UintegerValue(1000),
+                                          MakeUintegerAccessor(&SwitchNode::m_cncp_update_interval),
+                                          MakeUintegerChecker<uint64_t>(1))
+                            .AddAttribute(
+                                "CNCPFlowExpiredInterval",
+                                "Time without packets after which a CNCP flow expires (ns)",
+                                UintegerValue(4000),
+                                MakeUintegerAccessor(&SwitchNode::m_cncp_flow_expired_interval),
+                                MakeUintegerChecker<uint64_t>(1))
+                            .AddAttribute("CNCPQueueWeight",
+                                          "Weight of the egress queue in the CNCP rate update",
+                                          DoubleValue(1.1),
+                                          MakeDoubleAccessor(&SwitchNode::m_cncpQueueWeight),
+                                          MakeDoubleChecker<double>(0))
+                            .AddAttribute(
+                                "CNCPUtility",
+                                "Utility function of the CNCP flows",
+                                EnumValue(CncpUpdateKernel::Log),
+                                MakeEnumAccessor<CncpUpdateKernel::Utility>(
+                                    &SwitchNode::m_cncpUtility),
+                                MakeEnumChecker(CncpUpdateKernel::Log,
+                                                "Log",
+                                                CncpUpdateKernel::AlphaFair,
+                                                "AlphaFair"))
+                            .AddAttribute("CNCPAlpha",
+                                          "Alpha of the AlphaFair CNCP utility",
+                                          DoubleValue(1),
+                                          MakeDoubleAccessor(&SwitchNode::m_cncpAlpha),
+                                          MakeDoubleChecker<double>(0.0625, 16))
+                            .AddAttribute("CNCPUtilityRefRate",
+                                          "Reference rate of the AlphaFair CNCP utility (bps)",
+                                          UintegerValue(1000000000),
+                                          MakeUintegerAccessor(&SwitchNode::m_cncpUtilityRefRate),
+                                          MakeUintegerChecker<uint64_t>(1))
+                            .AddAttribute("CNCPFixedPoint",
+                                          "Update the CNCP rates in fixed point, all the flows of "
+                                          "a tick in one batch with CNCPBatchedTimers",
+                                          BooleanValue(false),
+                                          MakeBooleanAccessor(&SwitchNode::m_cncpFixedPoint),
+                                          MakeBooleanChecker())
+                            .AddAttribute("CNCPBatchedTimers",
+                                          "Drive CNCP update/report/expiry of all flows from one "
+                                          "per-switch tick instead of per-flow events",
+                                          BooleanValue(false),
+                                          MakeBooleanAccessor(&SwitchNode::m_cncpBatchedTimers),
+                                          MakeBooleanChecker())
+                            .AddAttribute("CNCPReportBatchSize",
+                                          "Max flows reported per CNCP control packet, 1 sends "
+                                          "one report packet per flow, at most as many as fit "
+                                          "a 1500-byte packet",
+                                          UintegerValue(1),
+                                          MakeUintegerAccessor(&SwitchNode::m_cncpReportBatchSize),
+                                          MakeUintegerChecker<uint32_t>(
+                                              1,
+                                              CncpBatchReportHeader::maxReports));
     return tid;
 }
 
@@ -70,45 +135,69 @@ SwitchNode::SwitchNode()
     m_ecmpSeed = m_id;
     m_node_type = 1;
     m_mmu = CreateObject<SwitchMmu>();
-    for (uint32_t i = 0; i < pCnt; i++)
+    m_cncpPgWeights.fill(1);
+}
+
+void
+SwitchNode::SetCNCPPriorityWeight(uint32_t pg, double weight)
+{
+    NS_ASSERT(pg < qCnt && weight >= 0);
+    m_cncpPgWeights[pg] = weight;
+    m_cncpKernel.Configure(m_gamma,
+                           m_lambda,
+                           m_cncp_report_interval,
+                           m_cncpQueueWeight,
+                           m_cncpUtility,
+                           m_cncpAlpha,
+                           m_cncpUtilityRefRate,
+                           m_cncpPgWeights);
+}
+
+void
+SwitchNode::DoInitialize()
+{
+    uint32_t nDevices = GetNDevices();
+    m_bytes.assign((size_t)nDevices * nDevices * qCnt, 0);
+    m_txBytes.assign(nDevices, 0);
+    m_lastPktSize.assign(nDevices, 0);
+    m_lastPktTs.assign(nDevices, 0);
+    m_u.assign(nDevices, 0);
+    // the constants of the PINT estimate of each port, and a random stream of this switch
+    m_pint.assign(nDevices, PintEstimator());
+    for (uint32_t i = 0; i < nDevices; i++)
     {
-        for (uint32_t j = 0; j < pCnt; j++)
+        Ptr<QbbNetDevice> dev = DynamicCast<QbbNetDevice>(m_devices[i]);
+        if (dev)
         {
-            for (uint32_t k = 0; k < qCnt; k++)
-            {
-                m_bytes[i][j][k] = 0;
-            }
+            m_pint[i].Configure(m_maxRtt, dev->GetDataRate().GetBitRate() / 8);
         }
     }
-    for (uint32_t i = 0; i < pCnt; i++)
-    {
-        m_txBytes[i] = 0;
-    }
-    for (uint32_t i = 0; i < pCnt; i++)
-    {
-        m_lastPktSize[i] = m_lastPktTs[i] = 0;
-    }
-    for (uint32_t i = 0; i < pCnt; i++)
-    {
-        m_u[i] = 0;
-    }
+    m_pintRng.Seed((RngSeedManager::GetSeed() * 1000003ULL + RngSeedManager::GetRun()) << 20 |
+                   m_id);
+    m_cncpKernel.Configure(m_gamma,
+                           m_lambda,
+                           m_cncp_report_interval,
+                           m_cncpQueueWeight,
+                           m_cncpUtility,
+                           m_cncpAlpha,
+                           m_cncpUtilityRefRate,
+                           m_cncpPgWeights);
+    Node::DoInitialize();
 }
 
 int
 SwitchNode::GetOutDev(Ptr<const Packet> p, CustomHeader& ch)
 {
     // look up entries
-    auto entry = m_rtTable.find(ch.dip);
+    uint32_t nNexthops;
+    const uint32_t* nexthops = m_rtTable.Lookup(ch.dip, nNexthops);
 
     // no matching entry
-    if (entry == m_rtTable.end())
+    if (nNexthops == 0)
     {
         return -1;
     }
 
-    // entry found
-    auto& nexthops = entry->second;
-
     // pick one next hop based on hash
     union {
         uint8_t u8[4 + 4 + 2 + 2];
@@ -130,7 +219,7 @@ SwitchNode::GetOutDev(Ptr<const Packet> p, CustomHeader& ch)
         buf.u32[2] = ch.ack.sport | ((uint32_t)ch.ack.dport << 16);
     }
 
-    uint32_t idx = EcmpHash(buf.u8, 12, m_ecmpSeed) % nexthops.size();
+    uint32_t idx = EcmpHash(buf.u8, 12, m_ecmpSeed) % nNexthops;
     return nexthops[idx];
 }
 
@@ -184,25 +273,27 @@ SwitchNode::SendToDev(Ptr<NetDevice> input_device, Ptr<Packet> p, CustomHeader&
         if (qIndex != 0)
         {
             // notify CNCP flow control before drop, ignore ack/nack and background flow (pg=2)
+            CncpFlowEntry* flow = nullptr;
             if (m_ccMode == 11 && ch.l3Prot != 0xFC && ch.l3Prot != 0xFD && ch.udp.pg != 2)
             {
-                CNCPNotifyIngress(p, ch, idx, input_device);
+                flow = CNCPNotifyIngress(p, ch, idx, input_device);
             }
             // not highest priority
             if ((m_mmu->CheckIngressAdmission(inDev, qIndex, p->GetSize()) || !m_pfcEnabled) &&
                 m_mmu->CheckEgressAdmission(idx, qIndex, p->GetSize()) &&
-                CNCPAdmitIngress(p, ch))
+                CNCPAdmitIngress(p, ch, flow))
             { // Admission control
                 m_mmu->UpdateIngressAdmission(inDev, qIndex, p->GetSize());
                 m_mmu->UpdateEgressAdmission(idx, qIndex, p->GetSize());
             }
             else
             {
+                DynamicCast<QbbNetDevice>(m_devices[idx])->SwitchDrop(qIndex, p, ch);
                 return; // Drop
             }
             CheckAndSendPfc(inDev, qIndex);
         }
-        m_bytes[inDev][idx][qIndex] += p->GetSize();
+        m_bytes[((size_t)idx * m_txBytes.size() + inDev) * qCnt + qIndex] += p->GetSize();
         m_devices[idx]->SwitchSend(qIndex, p, ch);
     }
     else
@@ -264,14 +355,19 @@ SwitchNode::SetEcmpSeed(uint32_t seed)
 void
 SwitchNode::AddTableEntry(Ipv4Address& dstAddr, uint32_t intf_idx)
 {
-    uint32_t dip = dstAddr.Get();
-    m_rtTable[dip].push_back(intf_idx);
+    m_rtTable.Add(dstAddr.Get(), intf_idx);
 }
 
 void
 SwitchNode::ClearTable()
 {
-    m_rtTable.clear();
+    m_rtTable.Clear();
+}
+
+void
+SwitchNode::SetTable(const EcmpTable& table)
+{
+    m_rtTable = table;
 }
 
 // This function can only be called in switch mode
@@ -296,6 +392,18 @@ SwitchNode::SwitchReceiveFromDevice(Ptr<NetDevice> device, Ptr<Packet> packet, C
         key.priority_group = ch.cncp.priority_group;
         CNCPUpdateFromReport(key, ch.cncp.flowInfo);
     }
+    else if (ch.l3Prot == 0xFA)
+    { // batched CNCP report, the entries follow the IPv4 header
+        Ptr<Packet> p = packet->Copy();
+        CustomHeader l3(CustomHeader::L2_Header | CustomHeader::L3_Header);
+        p->RemoveHeader(l3);
+        CncpBatchReportHeader reports;
+        p->RemoveHeader(reports);
+        for (uint32_t i = 0; i < reports.GetNReports(); i++)
+        {
+            CNCPUpdateFromReport(reports.GetFlowKey(i), reports.GetFlowInfo(i));
+        }
+    }
     else
     {
         SendToDev(device, packet, ch);
@@ -304,39 +412,64 @@ SwitchNode::SwitchReceiveFromDevice(Ptr<NetDevice> device, Ptr<Packet> packet, C
 }
 
 void
-SwitchNode::SwitchNotifyDequeue(uint32_t ifIndex, uint32_t qIndex, Ptr<Packet> p)
+SwitchNode::SetEcnCe(Ptr<Packet> p)
+{
+    // mark CE in the IPv4 TOS byte right after the ppp header, in place
+    uint8_t* ip = p->GetBuffer() + PppHeader::GetStaticSize();
+    uint8_t oldTos = ip[1];
+    uint8_t newTos = oldTos | Ipv4Header::ECN_CE;
+    if (oldTos == newTos)
+    {
+        return;
+    }
+    ip[1] = newTos;
+    // a zero checksum means checksums are disabled, otherwise patch it (RFC 1624)
+    uint16_t checksum = (ip[10] << 8) | ip[11];
+    if (checksum != 0)
+    {
+        uint32_t sum = (uint16_t)~checksum + (uint16_t) ~((ip[0] << 8) | oldTos) +
+                       ((ip[0] << 8) | newTos);
+        sum = (sum & 0xffff) + (sum >> 16);
+        sum = (sum & 0xffff) + (sum >> 16);
+        checksum = ~sum;
+        ip[10] = checksum >> 8;
+        ip[11] = checksum & 0xff;
+    }
+}
+
+uint32_t
+SwitchNode::GetBytes(uint32_t inDev, uint32_t outDev, uint32_t qIndex) const
+{
+    return m_bytes[((size_t)outDev * m_txBytes.size() + inDev) * qCnt + qIndex];
+}
+
+void
+SwitchNode::SwitchNotifyDequeue(uint32_t ifIndex, uint32_t qIndex, Ptr<Packet> p, CustomHeader& ch)
 {
     FlowIdTag t;
     p->PeekPacketTag(t);
-    CustomHeader ch;
-    p->RemoveHeader(ch);
     if (qIndex != 0)
     {
         uint32_t inDev = t.GetFlowId();
         m_mmu->RemoveFromIngressAdmission(inDev, qIndex, p->GetSize());
         m_mmu->RemoveFromEgressAdmission(ifIndex, qIndex, p->GetSize());
-        m_bytes[inDev][ifIndex][qIndex] -= p->GetSize();
+        m_bytes[((size_t)ifIndex * m_txBytes.size() + inDev) * qCnt + qIndex] -= p->GetSize();
         if (m_ecnEnabled)
         {
             bool egressCongested = m_mmu->ShouldSendCN(ifIndex, qIndex);
             if (egressCongested)
             {
-                PppHeader ppp;
-                Ipv4Header h;
-                p->RemoveHeader(ppp);
-                p->RemoveHeader(h);
-                h.SetEcn((Ipv4Header::EcnType)0x03);
-                p->AddHeader(h);
-                p->AddHeader(ppp);
+                SetEcnCe(p);
+                ch.m_tos |= Ipv4Header::ECN_CE;
             }
         }
         CheckAndSendResume(inDev, qIndex);
     }
     if (1)
     {
-        uint8_t* buf = p->GetBuffer();
-        if (buf[PppHeader::GetStaticSize() + 9] == 0x11)
+        if (ch.l3Prot == 0x11)
         { // udp packet
+            uint8_t* buf = p->GetBuffer();
             IntHeader* ih = (IntHeader*)&buf[PppHeader::GetStaticSize() + 20 + 8 +
                                              6]; // ppp, ip, udp, SeqTs, INT
             Ptr<QbbNetDevice> dev = DynamicCast<QbbNetDevice>(m_devices[ifIndex]);
@@ -346,6 +479,10 @@ SwitchNode::SwitchNotifyDequeue(uint32_t ifIndex, uint32_t qIndex, Ptr<Packet> p
                             m_txBytes[ifIndex],
                             dev->GetQueue()->GetNBytesTotal(),
                             dev->GetDataRate().GetBitRate());
+                ch.udp.ih.PushHop(Simulator::Now().GetTimeStep(),
+                                  m_txBytes[ifIndex],
+                                  dev->GetQueue()->GetNBytesTotal(),
+                                  dev->GetDataRate().GetBitRate());
             }
             else if (m_ccMode == 10)
             { // HPCC-PINT
@@ -355,71 +492,21 @@ SwitchNode::SwitchNotifyDequeue(uint32_t ifIndex, uint32_t qIndex, Ptr<Packet> p
                 {
                     dt = m_maxRtt;
                 }
-                uint64_t B = dev->GetDataRate().GetBitRate() / 8; // Bps
                 uint64_t qlen = dev->GetQueue()->GetNBytesTotal();
-                double newU;
-
-                /**************************
-                 * approximate calc
-                 *************************/
-                int b = 20, m = 16, l = 20; // see log2apprx's paremeters
-                int sft = logres_shift(b, l);
-                double fct = 1 << sft;               // (multiplication factor corresponding to sft)
-                double log_T = log2(m_maxRtt) * fct; // log2(T)*fct
-                double log_B = log2(B) * fct;        // log2(B)*fct
-                double log_1e9 = log2(1e9) * fct;    // log2(1e9)*fct
-                double qterm = 0;
-                double byteTerm = 0;
-                double uTerm = 0;
-                if ((qlen >> 8) > 0)
-                {
-                    int log_dt = log2apprx(dt, b, m, l);          // ~log2(dt)*fct
-                    int log_qlen = log2apprx(qlen >> 8, b, m, l); // ~log2(qlen / 256)*fct
-                    qterm = pow(2, (log_dt + log_qlen + log_1e9 - log_B - 2 * log_T) / fct) * 256;
-                    // 2^((log2(dt)*fct+log2(qlen/256)*fct+log2(1e9)*fct-log2(B)*fct-2*log2(T)*fct)/fct)*256
-                    // ~= dt*qlen*1e9/(B*T^2)
-                }
-                if (m_lastPktSize[ifIndex] > 0)
-                {
-                    int byte = m_lastPktSize[ifIndex];
-                    int log_byte = log2apprx(byte, b, m, l);
-                    byteTerm = pow(2, (log_byte + log_1e9 - log_B - log_T) / fct);
-                    // 2^((log2(byte)*fct+log2(1e9)*fct-log2(B)*fct-log2(T)*fct)/fct) ~= byte*1e9 /
-                    // (B*T)
-                }
-                if (m_maxRtt > dt && m_u[ifIndex] > 0)
-                {
-                    int log_T_dt = log2apprx(m_maxRtt - dt, b, m, l); // ~log2(T-dt)*fct
-                    int log_u =
-                        log2apprx(int(round(m_u[ifIndex] * 8192)), b, m, l); // ~log2(u*512)*fct
-                    uTerm = pow(2, (log_T_dt + log_u - log_T) / fct) / 8192;
-                    // 2^((log2(T-dt)*fct+log2(u*512)*fct-log2(T)*fct)/fct)/512 = (T-dt)*u/T
-                }
-                newU = qterm + byteTerm + uTerm;
-
-#if 0
-				/**************************
-				 * accurate calc
-				 *************************/
-				double weight_ewma = double(dt) / m_maxRtt;
-				double u;
-				if (m_lastPktSize[ifIndex] == 0)
-					u = 0;
-				else{
-					double txRate = m_lastPktSize[ifIndex] / double(dt); // B/ns
-					u = (qlen / m_maxRtt + txRate) * 1e9 / B;
-				}
-				newU = m_u[ifIndex] * (1 - weight_ewma) + u * weight_ewma;
-				printf(" %lf\n", newU);
-#endif
+                double newU = m_pint[ifIndex].Estimate(dt,
+                                                       qlen,
+                                                       m_lastPktSize[ifIndex],
+                                                       m_u[ifIndex],
+                                                       m_pintRng);
 
                 /************************
                  * update PINT header
                  ***********************/
-                uint16_t power = Pint::encode_u(newU);
+                uint16_t power = Pint::encode_u(newU, m_pintRng.Next() & 0xffff);
                 if (power > ih->GetPower())
                 {
                     ih->SetPower(power);
+                    ch.udp.ih.SetPower(power);
                 }
 
                 m_u[ifIndex] = newU;
@@ -431,407 +518,432 @@ SwitchNode::SwitchNotifyDequeue(uint32_t ifIndex, uint32_t qIndex, Ptr<Packet> p
     m_lastPktTs[ifIndex] = Simulator::Now().GetTimeStep();
 }
 
-int
-SwitchNode::logres_shift(int b, int l)
+FlowKey
+SwitchNode::CNCPGetFlowKey(CustomHeader& ch)
 {
-    static int data[] = {0, 0, 1, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4,
-                         5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5};
-    return l - data[b];
-}
-
-int
-SwitchNode::log2apprx(int x, int b, int m, int l)
-{
-    int x0 = x;
-    int msb = int(log2(x)) + 1;
-    if (msb > m)
-    {
-        x = (x >> (msb - m) << (msb - m));
-#if 0
-		x += + (1 << (msb - m - 1));
-#else
-        int mask = (1 << (msb - m)) - 1;
-        if ((x0 & mask) > (rand() & mask))
-        {
-            x += 1 << (msb - m);
-        }
-#endif
+    FlowKey key;
+    key.sip = ch.sip;
+    key.dip = ch.dip;
+    key.sport = 0;
+    key.dport = 0;
+    key.protocol = ch.l3Prot;
+    key.priority_group = ch.udp.pg;
+    if (ch.l3Prot == 0x6)
+    { // TCP
+        key.sport = ch.tcp.sport;
+        key.dport = ch.tcp.dport;
+    }
+    else if (ch.l3Prot == 0x11)
+    { // UDP
+        key.sport = ch.udp.sport;
+        key.dport = ch.udp.dport;
     }
-    return int(log2(x) * (1 << logres_shift(b, l)));
+    else if (ch.l3Prot == 0xFC || ch.l3Prot == 0xFD)
+    { // ACK/NACK
+        key.sport = ch.ack.sport;
+        key.dport = ch.ack.dport;
+    }
+    return key;
 }
 
 bool
-SwitchNode::CNCPAdmitIngress(Ptr<Packet> packet, CustomHeader& ch)
+SwitchNode::CNCPAdmitIngress(Ptr<Packet> packet, CustomHeader& ch, CncpFlowEntry* flow)
 {
-    // If CNCP is not enabled, or it is ack or nack packet, or it is background flow (pg=2), always admit
-    if (m_ccMode != 11 || ch.l3Prot == 0xFC || ch.l3Prot == 0xFD || ch.udp.pg == 2)
+    // If CNCP is not enabled, or it is ack or nack packet, or it is background flow (pg=2), always
+    // admit. CNCPNotifyIngress has already inserted every other flow, so flow is only null here.
+    if (m_ccMode != 11 || ch.l3Prot == 0xFC || ch.l3Prot == 0xFD || ch.udp.pg == 2 ||
+        flow == nullptr)
     {
         return true;
     }
-    // obtain flow key from custom header
-    uint32_t sip = ch.sip;
-    uint32_t dip = ch.dip;
-    uint16_t sport = 0, dport = 0;
-    uint8_t protocol = ch.l3Prot;
-    if (ch.l3Prot == 0x6)
-    { // TCP
-        sport = ch.tcp.sport;
-        dport = ch.tcp.dport;
-    }
-    else if (ch.l3Prot == 0x11)
-    { // UDP
-        sport = ch.udp.sport;
-        dport = ch.udp.dport;
-    }
-
-    FlowKey key;
-    key.sip = sip;
-    key.dip = dip;
-    key.sport = sport;
-    key.dport = dport;
-    key.protocol = protocol;
-    key.priority_group = ch.udp.pg;
-    // check if flow is already in the table
-    auto it = m_flowControlRateTable.find(key);
     // admission control to simulate flow control
-    if (it != m_flowControlRateTable.end())
-    { // flow is already in the table
-        uint64_t flowRate = it->second;
-        uint64_t packetSize = packet->GetSize();
-        // get timestamp of the last packet
-        uint64_t lastPktTs = m_flowLastIngressPktTsTable[key];
-        uint64_t currentTs = Simulator::Now().GetTimeStep();
-        uint64_t dt = currentTs - lastPktTs;
-        uint64_t bytesWindow =
-            m_flowIngressWindowTable[key] + (flowRate * dt) / (8ULL * 1000000000ULL);
-        // NS_LOG_DEBUG("Node " << this->GetId() << " check packet:" << "port: " << key.dport
-        //                      << ", seq: " << ch.udp.seq << ", bytesWindow: " << bytesWindow
-        //                      << ", packetSize: " << packetSize << " with dt: " << dt);
-        if (bytesWindow < packetSize)
-        {
-            return false;
-        }
-        else
-        { // packets comming, update flow control information
-            // update ingress bytes window
-            m_flowIngressWindowTable[key] = bytesWindow - packetSize;
-            // update last packet timestamp
-            m_flowLastIngressPktTsTable[key] = currentTs;
-            return true;
-        }
-    }
-    else
-    { // flow is not in the table, means it is a new flow, always admit
-        // NS_LOG_DEBUG("Node " << this->GetId() << "admit new flow:" << "protocol: "
-        //                      << (int)key.protocol << ", sip: " << key.sip << ", dip: " << key.dip
-        //                      << ", sport: " << key.sport << ", dport: " << key.dport
-        //                      << ", pg: " << (int)key.priority_group);
-        m_flowLastIngressPktTsTable[key] = Simulator::Now().GetTimeStep();
-        return true;
+    uint64_t packetSize = packet->GetSize();
+    uint64_t currentTs = Simulator::Now().GetTimeStep();
+    uint64_t dt = currentTs - flow->lastIngressPktTs;
+    uint64_t flowRate = m_cncpPorts[flow->egressDevIdx].GetRate(*flow);
+    uint64_t bytesWindow = flow->ingressWindow + (flowRate * dt) / (8ULL * 1000000000ULL);
+    if (bytesWindow < packetSize)
+    {
+        return false;
     }
+    // packets comming, update ingress bytes window and last packet timestamp
+    flow->ingressWindow = bytesWindow - packetSize;
+    flow->lastIngressPktTs = currentTs;
+    return true;
 }
 
-void
+CncpFlowEntry*
 SwitchNode::CNCPNotifyIngress(Ptr<Packet> packet,
                               CustomHeader& ch,
                               uint32_t output_dev_idx,
                               Ptr<NetDevice> input_device)
 {
-    // obtain flow key from custom header
-    uint32_t sip = ch.sip;
-    uint32_t dip = ch.dip;
-    uint16_t sport = 0, dport = 0;
-    uint8_t protocol = ch.l3Prot;
-    if (ch.l3Prot == 0x6)
-    { // TCP
-        sport = ch.tcp.sport;
-        dport = ch.tcp.dport;
-    }
-    else if (ch.l3Prot == 0x11)
-    { // UDP
-        sport = ch.udp.sport;
-        dport = ch.udp.dport;
-    }
-    else if (ch.l3Prot == 0xFC || ch.l3Prot == 0xFD)
-    { // ACK/NACK
-        sport = ch.ack.sport;
-        dport = ch.ack.dport;
-    }
-    FlowKey key;
-    key.sip = sip;
-    key.dip = dip;
-    key.sport = sport;
-    key.dport = dport;
-    key.protocol = protocol;
-    key.priority_group = ch.udp.pg;
-    uint64_t flowRate = 0;
-    // check if flow is already in the table
-    auto it = m_flowControlRateTable.find(key);
-    // admission control to simulate flow control
-    if (it != m_flowControlRateTable.end())
-    { // flow is already in the table, do nothing here. Because we don't know if it should be admitted or not here.
-        flowRate = it->second;
-    }
-    else
-    { // flow is not in the table, means new flow arrives, reallocate flow rate
-        uint64_t currentTs = Simulator::Now().GetTimeStep();
-        m_flowIngressWindowTable[key] = packet->GetSize(); // saved for the first packet
-        m_flowEgressDevIdxTable[key] = output_dev_idx;
+    FlowKey key = CNCPGetFlowKey(ch);
+    uint64_t currentTs = Simulator::Now().GetTimeStep();
+    bool inserted;
+    CncpFlowEntry* flow = m_cncpFlowTable.Insert(key, inserted);
+    if (inserted)
+    { // new flow arrives, reallocate flow rate
+        flow->ingressWindow = packet->GetSize(); // saved for the first packet
+        flow->egressDevIdx = output_dev_idx;
         // get device rate
         Ptr<QbbNetDevice> device = DynamicCast<QbbNetDevice>(m_devices[output_dev_idx]);
         uint64_t totalRate = device->GetDataRate().GetBitRate();
-        // count flows on the same egress device
-        size_t activeFlowCount = 0;
-        for (const auto& kv : m_flowEgressDevIdxTable) {
-            if (kv.second == output_dev_idx) {
-                ++activeFlowCount;
-            }
-        }
-        // reallocate flow rate
-        flowRate = totalRate / (activeFlowCount);
-        for (auto& it : m_flowControlRateTable)
+        // reallocate flow rate among the flows on the same egress device
+        if (m_cncpPorts.size() < m_devices.size())
         {
-            // Use find to avoid inserting a default value if the key does not exist in m_flowEgressDevIdxTable
-            auto egressIt = m_flowEgressDevIdxTable.find(it.first);
-            if (egressIt != m_flowEgressDevIdxTable.end() && egressIt->second == output_dev_idx) {
-                it.second = flowRate;
+            m_cncpPorts.resize(m_devices.size());
+        }
+        if (m_cncpPorts[output_dev_idx].Join(*flow, totalRate))
+        { // the epoch wrapped, a flow not read for 65536 joins holds the current one
+            for (uint32_t i = 0; i < m_cncpFlowTable.GetCapacity(); i++)
+            {
+                CncpFlowEntry& e = m_cncpFlowTable.GetSlot(i);
+                if (e.used && e.egressDevIdx == output_dev_idx)
+                {
+                    m_cncpPorts[output_dev_idx].Resync(e);
+                }
             }
         }
-        m_flowControlRateTable[key] = flowRate;
-        m_flowBytesOnNodeTable[key] = m_default_flow_capacity_on_node;
-        m_flowPrevHopDevTable[key] = input_device;
-        m_flowQvTable[key] = m_default_flow_capacity_on_node;
-        m_flowLastIngressPktTsTable[key] = currentTs;
-        // Schedule a check event, if the flow is expired, remove it from the table
-        Simulator::Schedule(NanoSeconds(m_cncp_flow_expired_interval),
-                            &SwitchNode::CNCPCheckFlowExpired,
-                            this,
-                            key);
-        // Schedule a update event, if the flow is not updated for a while, update the flow rate
-        Simulator::Schedule(NanoSeconds(m_cncp_update_interval),
-                            &SwitchNode::CNCPUpdate,
-                            this,
-                            key);
-        // Schedule a report event, if the flow is not reported for a while, report the flow rate
-        Simulator::Schedule(NanoSeconds(m_cncp_report_interval),
-                            &SwitchNode::ReportCNCPStatus,
-                            this,
-                            key);
+        flow->bytesOnNode = m_default_flow_capacity_on_node;
+        flow->prevHopDevIdx = input_device->GetIfIndex();
+        flow->qv = m_default_flow_capacity_on_node;
+        flow->lastIngressPktTs = currentTs;
+        CNCPScheduleTimers(key);
     }
 
-    // m_flowBytesOnNodeTable[key] += packet->GetSize();
-
     // update Q_u for CNCP flow control
-    uint64_t lastPktTs = m_flowLastArrivalPktTsTable[key];
-    uint64_t currentTs = Simulator::Now().GetTimeStep();
-    uint64_t dt = currentTs - lastPktTs;
+    uint64_t dt = currentTs - flow->lastArrivalPktTs;
+    uint64_t flowRate = m_cncpPorts[flow->egressDevIdx].GetRate(*flow);
     int32_t deltaQ = flowRate * dt / (8ULL * 1000000000ULL) - packet->GetSize();
-    m_flowBytesOnNodeTable[key] += deltaQ;
-    // NS_LOG_DEBUG("Node " << GetId() << " CNCPNotifyIngress: key=(" << key.dport << "), update Qu as " << m_flowBytesOnNodeTable[key] << " with flow rate " << flowRate << " and dt " << dt);
-    if (m_flowBytesOnNodeTable[key] < 0)
+    int64_t q_u = (int64_t)flow->bytesOnNode + deltaQ;
+    if (q_u < 0)
     {
-        m_flowBytesOnNodeTable[key] = 0;
+        q_u = 0;
     }
-    if (m_flowBytesOnNodeTable[key] > m_default_flow_capacity_on_node)
+    if (q_u > (int64_t)m_default_flow_capacity_on_node)
     {
-        m_flowBytesOnNodeTable[key] = m_default_flow_capacity_on_node;
+        q_u = m_default_flow_capacity_on_node;
     }
-    m_flowLastArrivalPktTsTable[key] = currentTs;
-    return;
+    flow->bytesOnNode = q_u;
+    flow->lastArrivalPktTs = currentTs;
+    return flow;
 }
 
 void
-SwitchNode::CNCPCheckFlowExpired(FlowKey key)
+SwitchNode::CNCPScheduleTimers(const FlowKey& key)
 {
-    // check if the flow is expired
-    uint64_t currentTs = Simulator::Now().GetTimeStep();
-    uint64_t lastPktTs = m_flowLastArrivalPktTsTable[key];
-    uint64_t dt = currentTs - lastPktTs;
-    if (dt > m_cncp_flow_expired_interval)
-    {
-        m_flowIngressWindowTable.erase(key);
-        m_flowLastIngressPktTsTable.erase(key);
-        m_flowLastArrivalPktTsTable.erase(key);
-        m_flowBytesOnNodeTable.erase(key);
-        // share this flow's rate with other flows
-        uint64_t rate = m_flowControlRateTable.erase(key);
-        size_t activeFlowCount = m_flowControlRateTable.size();
-        if (activeFlowCount > 1)
-        { // there are other flows on the node
-            uint64_t sharedRate = rate / (activeFlowCount - 1);
-            for (auto& it : m_flowControlRateTable)
-            {
-                it.second += sharedRate;
-            }
+    if (m_cncpBatchedTimers)
+    {
+        // ticks are m_cncp_update_interval apart, round the expiry check up to whole ticks
+        uint64_t expiryTicks =
+            (m_cncp_flow_expired_interval + m_cncp_update_interval - 1) / m_cncp_update_interval;
+        m_cncpExpiryWheel.Schedule(key, m_cncpExpiryWheel.GetNow() + expiryTicks);
+        if (!m_cncpTickEvent.IsPending())
+        {
+            m_cncpTickEvent = Simulator::Schedule(NanoSeconds(m_cncp_update_interval),
+                                                  &SwitchNode::CNCPTick,
+                                                  this);
+            m_cncpScheduledEvents++;
         }
-        m_flowControlRateTable.erase(key);
-        m_flowPrevHopDevTable.erase(key);
-        m_flowEgressDevIdxTable.erase(key);
-        m_flowQvTable.erase(key);
-    }else{
-        Simulator::Schedule(NanoSeconds(m_cncp_flow_expired_interval),
-                            &SwitchNode::CNCPCheckFlowExpired,
-                            this,
-                            key);
+        return;
     }
+    // Schedule a check event, if the flow is expired, remove it from the table
+    Simulator::Schedule(NanoSeconds(m_cncp_flow_expired_interval),
+                        &SwitchNode::CNCPCheckFlowExpired,
+                        this,
+                        key);
+    // Schedule a update event, if the flow is not updated for a while, update the flow rate
+    Simulator::Schedule(NanoSeconds(m_cncp_update_interval), &SwitchNode::CNCPUpdate, this, key);
+    // Schedule a report event, if the flow is not reported for a while, report the flow rate
+    Simulator::Schedule(NanoSeconds(m_cncp_report_interval),
+                        &SwitchNode::ReportCNCPStatus,
+                        this,
+                        key);
+    m_cncpScheduledEvents += 3;
 }
 
 void
-SwitchNode::ReportCNCPStatus(FlowKey key)
+SwitchNode::CNCPTick()
 {
-    // find the flow in the control rate table, if not found, do not schedule a report event
-    auto flow = m_flowControlRateTable.find(key);
-    if (flow == m_flowControlRateTable.end())
+    // expiry checks first, matching the event order of per-flow timers
+    m_cncpExpiredKeys.clear();
+    m_cncpExpiryWheel.Advance(m_cncpExpiryWheel.GetNow() + 1, m_cncpExpiredKeys);
+    uint64_t expiryTicks =
+        (m_cncp_flow_expired_interval + m_cncp_update_interval - 1) / m_cncp_update_interval;
+    for (const FlowKey& key : m_cncpExpiredKeys)
     {
-        return;
-    }else{
-        // Get the bytes for this flow from m_flowBytesOnNodeTable
-        auto bytesIt = m_flowBytesOnNodeTable.find(key);
-        if (bytesIt == m_flowBytesOnNodeTable.end())
+        if (!CNCPExpireFlow(key))
         {
-            return;
+            m_cncpExpiryWheel.Schedule(key, m_cncpExpiryWheel.GetNow() + expiryTicks);
         }
-        Ptr<NetDevice> device = m_flowPrevHopDevTable[key];
-        if (device)
+    }
+
+    uint64_t reportTicks = std::max<uint64_t>(1, m_cncp_report_interval / m_cncp_update_interval);
+    bool report = m_cncpExpiryWheel.GetNow() % reportTicks == 0;
+    if (m_cncpFixedPoint)
+    {
+        CNCPUpdateAllFlows();
+    }
+    for (uint32_t i = 0; i < m_cncpFlowTable.GetCapacity(); i++)
+    {
+        CncpFlowEntry& e = m_cncpFlowTable.GetSlot(i);
+        if (!e.used)
         {
-            Ptr<QbbNetDevice> qbbDevice = DynamicCast<QbbNetDevice>(device);
-            if (qbbDevice)
-            {
-                qbbDevice->SendCNCPReport(key, bytesIt->second);
-            }
+            continue;
         }
+        if (!m_cncpFixedPoint)
+        {
+            CNCPUpdateFlow(e);
+        }
+        if (report)
+        {
+            CNCPReportFlow(e);
+        }
+    }
+    if (report)
+    {
+        CNCPFlushReports();
+    }
 
-        // Schedule a report event, if the flow is not reported for a while, report the flow rate
-        Simulator::Schedule(NanoSeconds(m_cncp_report_interval),
-                            &SwitchNode::ReportCNCPStatus,
+    // stop ticking once the switch has no CNCP flow, the next new flow restarts it
+    if (m_cncpFlowTable.GetN() > 0)
+    {
+        m_cncpTickEvent =
+            Simulator::Schedule(NanoSeconds(m_cncp_update_interval), &SwitchNode::CNCPTick, this);
+        m_cncpScheduledEvents++;
+    }
+}
+
+bool
+SwitchNode::CNCPExpireFlow(const FlowKey& key)
+{
+    CncpFlowEntry* flow = m_cncpFlowTable.Find(key);
+    if (flow == nullptr)
+    {
+        return true;
+    }
+    // check if the flow is expired
+    uint64_t currentTs = Simulator::Now().GetTimeStep();
+    uint64_t dt = currentTs - flow->lastArrivalPktTs;
+    if (dt <= m_cncp_flow_expired_interval)
+    {
+        return false;
+    }
+    // share this flow's rate with the remaining flows on its egress device
+    m_cncpPorts[flow->egressDevIdx].Leave(*flow);
+    m_cncpFlowTable.Erase(key);
+    return true;
+}
+
+void
+SwitchNode::CNCPCheckFlowExpired(FlowKey key)
+{
+    if (!CNCPExpireFlow(key))
+    {
+        Simulator::Schedule(NanoSeconds(m_cncp_flow_expired_interval),
+                            &SwitchNode::CNCPCheckFlowExpired,
                             this,
                             key);
+        m_cncpScheduledEvents++;
     }
 }
 
 void
-SwitchNode::CNCPUpdate(FlowKey key)
+SwitchNode::CNCPReportFlow(const CncpFlowEntry& flow)
 {
-    // find the flow in the control rate table
-    auto flow = m_flowControlRateTable.find(key);
-    if (flow == m_flowControlRateTable.end())
+    Ptr<QbbNetDevice> qbbDevice = DynamicCast<QbbNetDevice>(m_devices[flow.prevHopDevIdx]);
+    if (!qbbDevice)
     {
         return;
-    }else{
-    
-        FlowKey key = flow->first;
-        uint64_t f_e = flow->second;
-
-        // Get q_v from flowQvTable
-        int64_t q_v = m_flowQvTable[key];
-        if (q_v < 0)
-        {
-            q_v = 0;
-        }
+    }
+    if (m_cncpReportBatchSize <= 1)
+    {
+        qbbDevice->SendCNCPReport(flow.key, flow.bytesOnNode);
+        return;
+    }
+    if (m_cncpPendingReports.size() < m_devices.size())
+    {
+        m_cncpPendingReports.resize(m_devices.size());
+    }
+    CncpBatchReportHeader& pending = m_cncpPendingReports[flow.prevHopDevIdx];
+    pending.AddReport(flow.key, flow.bytesOnNode);
+    if (pending.GetNReports() >= m_cncpReportBatchSize || pending.IsFull())
+    {
+        qbbDevice->SendCNCPBatchReport(pending);
+        pending.Clear();
+    }
+    else if (!m_cncpBatchedTimers && !m_cncpReportFlushScheduled)
+    {
+        // per-flow timers report one flow at a time, flush whatever is pending at this time step
+        Simulator::ScheduleNow(&SwitchNode::CNCPFlushReports, this);
+        m_cncpReportFlushScheduled = true;
+        m_cncpScheduledEvents++;
+    }
+}
 
-        // Get q_u from m_flowBytesOnNodeTable
-        int64_t q_u = m_flowBytesOnNodeTable[key];
-        if (q_u < 0)
+void
+SwitchNode::CNCPFlushReports()
+{
+    m_cncpReportFlushScheduled = false;
+    for (uint32_t i = 0; i < m_cncpPendingReports.size(); i++)
+    {
+        CncpBatchReportHeader& pending = m_cncpPendingReports[i];
+        if (pending.GetNReports() == 0)
         {
-            q_u = 0;
+            continue;
         }
+        DynamicCast<QbbNetDevice>(m_devices[i])->SendCNCPBatchReport(pending);
+        pending.Clear();
+    }
+}
 
-        // p_e(t) and q_u^i(t) are set to 0 for now (can be extended later)
-        // look up entries
-        uint64_t p_e = 0;
-        auto entry = m_rtTable.find(key.dip);
-        if (entry != m_rtTable.end())
-        {
-            // Create a dummy packet for GetOutDev
-            Ptr<Packet> dummyPacket = Create<Packet>();
-
-            // Create and setup CustomHeader
-            CustomHeader ch;
-            ch.sip = key.sip;
-            ch.dip = key.dip;
-            ch.l3Prot = key.protocol;
-
-            // Set protocol specific fields
-            if (key.protocol == 0x6)
-            { // TCP
-                ch.tcp.sport = key.sport;
-                ch.tcp.dport = key.dport;
-            }
-            else if (key.protocol == 0x11)
-            { // UDP
-                ch.udp.sport = key.sport;
-                ch.udp.dport = key.dport;
-                ch.udp.pg = key.priority_group;
-            }
-            else if (key.protocol == 0xFC || key.protocol == 0xFD)
-            { // ACK/NACK
-                ch.ack.sport = key.sport;
-                ch.ack.dport = key.dport;
-            }
-            // Get the output device index
-            int dev_idx = GetOutDev(dummyPacket, ch);
-            if (dev_idx >= 0)
-            {
-                Ptr<QbbNetDevice> device = DynamicCast<QbbNetDevice>(m_devices[dev_idx]);
-                p_e = device->GetQueueLength(key.priority_group);
-            }
-        }
+void
+SwitchNode::ReportCNCPStatus(FlowKey key)
+{
+    // find the flow in the table, if not found, do not schedule a report event
+    CncpFlowEntry* flow = m_cncpFlowTable.Find(key);
+    if (flow == nullptr)
+    {
+        return;
+    }
+    CNCPReportFlow(*flow);
+
+    // Schedule a report event, if the flow is not reported for a while, report the flow rate
+    Simulator::Schedule(NanoSeconds(m_cncp_report_interval),
+                        &SwitchNode::ReportCNCPStatus,
+                        this,
+                        key);
+    m_cncpScheduledEvents++;
+}
 
-        // Get the flow rate for the next iteration
-        uint64_t f_e_new = CNCPGetNextIteration(f_e, q_v, p_e, q_u);
+void
+SwitchNode::CNCPUpdateFlow(CncpFlowEntry& flow)
+{
+    CncpPortShare& port = m_cncpPorts[flow.egressDevIdx];
+    uint64_t f_e = port.GetRate(flow);
+    uint64_t q_v = flow.qv;
+    // q_u is clamped to [0, m_default_flow_capacity_on_node] on every arrival
+    uint64_t q_u = flow.bytesOnNode;
+
+    // p_e is the queue length of the flow's priority group at its egress device
+    Ptr<QbbNetDevice> device = DynamicCast<QbbNetDevice>(m_devices[flow.egressDevIdx]);
+    uint64_t p_e = device->GetQueueLength(flow.key.priority_group);
+
+    // Get the flow rate for the next iteration
+    uint64_t f_e_new = CNCPGetNextIteration(f_e, q_v, p_e, q_u, flow.key.priority_group);
+
+    // check if the flow rate is larger than egress device's rate
+    uint64_t egress_rate = device->GetDataRate().GetBitRate();
+    if (f_e_new > egress_rate)
+    {
+        f_e_new = egress_rate;
+    }
+
+    // Update the flow rate in the table
+    port.SetRate(flow, f_e_new);
+
+    // Print flow rate before and after update
+    // double trans_gamma = 8 * m_gamma / m_cncp_report_interval;
+    // NS_LOG_DEBUG(std::setw(4) << GetId() << " "
+    //             << std::setw(6) << flow.key.dport << " "
+    //             << std::setw(10) << std::left << "oldRate=" << std::setw(12) << f_e << ", "
+    //             << std::setw(10) << std::left << "newRate=" << std::setw(12) << f_e_new << ", "
+    //             << std::setw(6) << std::left << "q_v=" << std::setw(12) << q_v * trans_gamma << ", "
+    //             << std::setw(6) << std::left << "p_e=" << std::setw(12) << p_e * trans_gamma << ", "
+    //             << std::setw(6) << std::left << "q_u=" << std::setw(12) << q_u * trans_gamma << ", "
+    //             << std::setw(10) << std::left << "U_prime=" << std::setw(12) << m_lambda / (f_e > 0 ? f_e : 1) << " "
+    //             << Simulator::Now().GetTimeStep());
+}
 
-        // check if the flow rate is larger than egress device's rate
-        int dev_idx = m_flowEgressDevIdxTable[key];
-        Ptr<QbbNetDevice> device = DynamicCast<QbbNetDevice>(m_devices[dev_idx]);
-        uint64_t egress_rate = device->GetDataRate().GetBitRate();
-        // print egress rate
-        if (f_e_new > egress_rate)
+void
+SwitchNode::CNCPUpdateAllFlows()
+{
+    // the rates do not depend on each other, so gather every flow, update them all, scatter back
+    CncpUpdateBatch& b = m_cncpBatch;
+    b.flows.clear();
+    b.rate.clear();
+    b.qv.clear();
+    b.pe.clear();
+    b.qu.clear();
+    b.pg.clear();
+    b.cap.clear();
+    for (uint32_t i = 0; i < m_cncpFlowTable.GetCapacity(); i++)
+    {
+        CncpFlowEntry& e = m_cncpFlowTable.GetSlot(i);
+        if (!e.used)
         {
-            f_e_new = egress_rate;
+            continue;
         }
+        QbbNetDevice* device = static_cast<QbbNetDevice*>(PeekPointer(m_devices[e.egressDevIdx]));
+        b.flows.push_back(&e);
+        b.rate.push_back(m_cncpPorts[e.egressDevIdx].GetRate(e));
+        b.qv.push_back(e.qv);
+        b.pe.push_back(device->GetQueueLength(e.key.priority_group));
+        b.qu.push_back(e.bytesOnNode);
+        b.pg.push_back(e.key.priority_group);
+        b.cap.push_back(device->GetDataRate().GetBitRate());
+    }
+    m_cncpKernel.NextRates(b.flows.size(),
+                           b.rate.data(),
+                           b.qv.data(),
+                           b.pe.data(),
+                           b.qu.data(),
+                           b.pg.data(),
+                           b.cap.data());
+    for (uint32_t i = 0; i < b.flows.size(); i++)
+    {
+        m_cncpPorts[b.flows[i]->egressDevIdx].SetRate(*b.flows[i], b.rate[i]);
+    }
+}
 
-        // Update the flow rate in the table
-        flow->second = f_e_new;
-
-        // Schedule a update event, if the flow is not updated for a while, update the flow rate
-        Simulator::Schedule(NanoSeconds(m_cncp_update_interval),
-                            &SwitchNode::CNCPUpdate,
-                            this,
-                            key);
-
-        // Print flow rate before and after update
-        // double trans_gamma = 8 * m_gamma / m_cncp_report_interval;
-        // NS_LOG_DEBUG(std::setw(4) << GetId() << " " 
-        //             << std::setw(6) << key.dport << " "
-        //             << std::setw(10) << std::left << "oldRate=" << std::setw(12) << f_e << ", "
-        //             << std::setw(10) << std::left << "newRate=" << std::setw(12) << f_e_new << ", "
-        //             << std::setw(6) << std::left << "q_v=" << std::setw(12) << q_v * trans_gamma << ", "
-        //             << std::setw(6) << std::left << "p_e=" << std::setw(12) << p_e * trans_gamma << ", "
-        //             << std::setw(6) << std::left << "q_u=" << std::setw(12) << q_u * trans_gamma << ", "
-        //             << std::setw(10) << std::left << "U_prime=" << std::setw(12) << m_lambda / (f_e > 0 ? f_e : 1) << " "
-        //             << Simulator::Now().GetTimeStep());
-        // NS_LOG_DEBUG(GetId() << " " << key.dport << " " << f_e << " " << f_e_new << " " << Simulator::Now().GetTimeStep());
+void
+SwitchNode::CNCPUpdate(FlowKey key)
+{
+    // find the flow in the table
+    CncpFlowEntry* flow = m_cncpFlowTable.Find(key);
+    if (flow == nullptr)
+    {
+        return;
     }
+    CNCPUpdateFlow(*flow);
+
+    // Schedule a update event, if the flow is not updated for a while, update the flow rate
+    Simulator::Schedule(NanoSeconds(m_cncp_update_interval), &SwitchNode::CNCPUpdate, this, key);
+    m_cncpScheduledEvents++;
 }
 
 uint64_t
-SwitchNode::CNCPGetNextIteration(uint64_t f_e, uint64_t q_v, uint64_t p_e, uint64_t q_u)
+SwitchNode::GetCncpScheduledEvents() const
 {
-    // Compute the derivative of the utility function U'(f_e^i(t))
-    // Here we use U'(x) = 1/x
-    double U_prime = m_lambda / (f_e > 0 ? f_e : 1); // avoid division by zero
+    return m_cncpScheduledEvents;
+}
 
-    double trans_gamma = 8 * m_gamma / m_cncp_report_interval;
-    double result = f_e + m_gamma * (q_v * trans_gamma + U_prime - 1.1 * p_e * trans_gamma - q_u * trans_gamma);
-    // NS_LOG_DEBUG("U_prime=" << U_prime << ", f_e=" << f_e << ", q_v=" << q_v << ", p_e=" << p_e
-    // << ", q_u=" << q_u << ", result=" << result);
-    return result > 0 ? static_cast<uint64_t>(result) : 0;
+uint64_t
+SwitchNode::CNCPGetNextIteration(uint64_t f_e,
+                                 uint64_t q_v,
+                                 uint64_t p_e,
+                                 uint64_t q_u,
+                                 uint32_t pg)
+{
+    // f_e + gamma * (q_v * tg + U'(f_e) - w * p_e * tg - q_u * tg), see CncpUpdateKernel
+    if (m_cncpFixedPoint)
+    {
+        return m_cncpKernel.NextRate(f_e, q_v, p_e, q_u, pg);
+    }
+    return m_cncpKernel.NextRateDouble(f_e, q_v, p_e, q_u, pg);
 }
 
 void
 SwitchNode::CNCPUpdateFromReport(FlowKey key, uint64_t flowInfo)
 {
-    m_flowQvTable[key] = flowInfo;
+    CncpFlowEntry* flow = m_cncpFlowTable.Find(key);
+    if (flow == nullptr)
+    {
+        return;
+    }
+    // reports carry the downstream Q_u, which never exceeds the flow capacity on node
+    flow->qv = std::min<uint64_t>(flowInfo, UINT32_MAX);
 }
 
 } /* namespace ns3 */
@@ -1,13 +1,18 @@
 #ifndef SWITCH_NODE_H
 #define SWITCH_NODE_H
 
+#include "cncp-flow-table.h"
+#include "cncp-timer-wheel.h"
+#include "cncp-update.h"
+#include "ecmp-table.h"
 #include "pint.h"
 #include "qbb-net-device.h"
 #include "switch-mmu.h"
 
+#include <ns3/event-id.h>
 #include <ns3/node.h>
 
-#include <unordered_map>
+#include <array>
 
 namespace ns3
 {
@@ -16,43 +21,71 @@ class Packet;
 
 class SwitchNode : public Node
 {
-    static const uint32_t pCnt = 257; // Number of ports used
-    static const uint32_t qCnt = 8;   // Number of queues/priorities used
+    static const uint32_t qCnt = 8; // Number of queues/priorities used
     uint32_t m_ecmpSeed;
-    std::unordered_map<uint32_t, std::vector<int>>
-        m_rtTable; // map from ip address (u32) to possible ECMP port (index of dev)
-
-    // monitor of PFC
-    uint32_t m_bytes[pCnt][pCnt][qCnt]; // m_bytes[inDev][outDev][qidx] is the bytes from inDev
-                                        // enqueued for outDev at qidx
-
-    uint64_t m_txBytes[pCnt]; // counter of tx bytes
-
-    uint32_t m_lastPktSize[pCnt];
-    uint64_t m_lastPktTs[pCnt]; // ns
-    double m_u[pCnt];
-
-    // Flow control table for CNCP, key is flow id and value is target flow rate
-    // for iterative update
-    uint64_t m_cncp_report_interval = 1000;       // 1000 ns
-    uint64_t m_cncp_update_interval = 1000;       // 1000 ns
-    uint64_t m_cncp_flow_expired_interval = 4000; // 2000 ns
-    std::unordered_map<FlowKey, uint32_t, FlowKeyHash> m_flowEgressDevIdxTable; // used for initializing flow rate
-    std::unordered_map<FlowKey, Ptr<NetDevice>, FlowKeyHash>
-        m_flowPrevHopDevTable; // used for sending CNCP report to previous hop device
-    std::unordered_map<FlowKey, uint64_t, FlowKeyHash>
-        m_flowQvTable; // used for CNCP update
-    std::unordered_map<FlowKey, int64_t, FlowKeyHash> m_flowBytesOnNodeTable;
+    EcmpTable m_rtTable; // map from ip address (u32) to possible ECMP port (index of dev)
+
+    // monitor of PFC, sized from GetNDevices() in DoInitialize
+    std::vector<uint32_t>
+        m_bytes; // m_bytes[(outDev * nDevices + inDev) * qCnt + qidx] is the bytes from inDev
+                 // enqueued for outDev at qidx
+
+    // per-device state, sized from GetNDevices() in DoInitialize
+    std::vector<uint64_t> m_txBytes; // counter of tx bytes
+
+    std::vector<uint32_t> m_lastPktSize;
+    std::vector<uint64_t> m_lastPktTs; // ns
+    std::vector<double> m_u;
+    std::vector<PintEstimator> m_pint; // HPCC-PINT estimate of the utilization of each device
+    PintRng m_pintRng;
+
+    // Flow control table for CNCP, key is flow id and value is the per-flow
+    // CNCP state (target rate for iterative update, Q_u, Q_v, ...)
+    uint64_t m_cncp_report_interval;       // ns
+    uint64_t m_cncp_update_interval;       // ns
+    uint64_t m_cncp_flow_expired_interval; // ns
+    CncpFlowTable m_cncpFlowTable;
+    std::vector<CncpPortShare> m_cncpPorts; // fair share of the flows on each egress device
     const uint64_t m_default_flow_capacity_on_node =
         10000; // default flow capacity on node, also called user queue capacity in the CNCP paper.
     uint64_t m_gamma = 3000;
     uint64_t m_lambda = 5e15;
-    // for flow rate control
-    std::unordered_map<FlowKey, uint64_t, FlowKeyHash>
-        m_flowControlRateTable; // flow rate, in bits per second
-    std::unordered_map<FlowKey, uint64_t, FlowKeyHash> m_flowIngressWindowTable;
-    std::unordered_map<FlowKey, uint64_t, FlowKeyHash> m_flowLastIngressPktTsTable;
-    std::unordered_map<FlowKey, uint64_t, FlowKeyHash> m_flowLastArrivalPktTsTable;
+
+    // the rate update, configured from the attributes below in DoInitialize
+    CncpUpdateKernel m_cncpKernel;
+    double m_cncpQueueWeight;
+    CncpUpdateKernel::Utility m_cncpUtility;
+    double m_cncpAlpha;
+    uint64_t m_cncpUtilityRefRate; // bps
+    std::array<double, qCnt> m_cncpPgWeights;
+    bool m_cncpFixedPoint;
+
+    // Fixed-point batched update: a tick gathers the inputs of every flow in these arrays,
+    // updates all the rates in one CncpUpdateKernel::NextRates and writes them back
+    struct CncpUpdateBatch
+    {
+        std::vector<CncpFlowEntry*> flows;
+        std::vector<uint64_t> rate;
+        std::vector<uint32_t> qv;
+        std::vector<uint32_t> pe;
+        std::vector<uint32_t> qu;
+        std::vector<uint8_t> pg;
+        std::vector<uint64_t> cap;
+    } m_cncpBatch;
+
+    // Batched CNCP timers: one tick per m_cncp_update_interval walks every flow in
+    // m_cncpFlowTable, and expiry checks are filed in a timing wheel counted in ticks
+    bool m_cncpBatchedTimers;
+    EventId m_cncpTickEvent;
+    CncpTimerWheel m_cncpExpiryWheel;
+    std::vector<FlowKey> m_cncpExpiredKeys; // scratch buffer for the wheel
+    uint64_t m_cncpScheduledEvents = 0;     // CNCP timer events scheduled on this switch
+
+    // Batched CNCP reports: flows sharing a previous hop device are reported in one
+    // CncpBatchReportHeader of up to m_cncpReportBatchSize entries, 1 sends one packet per flow
+    uint32_t m_cncpReportBatchSize;
+    std::vector<CncpBatchReportHeader> m_cncpPendingReports; // indexed by previous hop device
+    bool m_cncpReportFlushScheduled = false;
 
   protected:
     bool m_ecnEnabled;
@@ -62,6 +95,8 @@ class SwitchNode : public Node
 
     uint32_t m_ackHighPrio; // set high priority for ACK/NACK
 
+    void DoInitialize() override;
+
   private:
     int GetOutDev(Ptr<const Packet>, CustomHeader& ch);
     void SendToDev(Ptr<NetDevice> input_device, Ptr<Packet> p, CustomHeader& ch);
@@ -77,28 +112,45 @@ class SwitchNode : public Node
     void SetEcmpSeed(uint32_t seed);
     void AddTableEntry(Ipv4Address& dstAddr, uint32_t intf_idx);
     void ClearTable();
+    void SetTable(const EcmpTable& table); // replace the table, e.g. by an empty one of RouteCalculator
     bool SwitchReceiveFromDevice(Ptr<NetDevice> device, Ptr<Packet> packet, CustomHeader& ch);
-    void SwitchNotifyDequeue(uint32_t ifIndex, uint32_t qIndex, Ptr<Packet> p);
-
-    // for approximate calc in PINT
-    int logres_shift(int b, int l);
-    int log2apprx(int x, int b, int m, int l); // given x of at most b bits, use most significant m
-                                               // bits of x, calc the result in l bits
+    // ch is the header parsed on receive, kept in sync with the in-place updates
+    void SwitchNotifyDequeue(uint32_t ifIndex, uint32_t qIndex, Ptr<Packet> p, CustomHeader& ch);
+    uint32_t GetBytes(uint32_t inDev, uint32_t outDev, uint32_t qIndex) const;
+    static void SetEcnCe(Ptr<Packet> p); // mark CE on a ppp+IPv4 packet without re-serializing
 
     // CNCP Flow Control
-    bool CNCPAdmitIngress(Ptr<Packet> packet, CustomHeader& ch);
-    void CNCPNotifyIngress(
+    static FlowKey CNCPGetFlowKey(CustomHeader& ch);
+    bool CNCPAdmitIngress(Ptr<Packet> packet, CustomHeader& ch, CncpFlowEntry* flow);
+    CncpFlowEntry* CNCPNotifyIngress(
         Ptr<Packet> packet,
         CustomHeader& ch,
         uint32_t output_dev_idx,
         Ptr<NetDevice> device); // notify ingress and update flow control table. Packets are dropped
                                 // also are also recorded here, such that this function should be
-                                // called after CNCPAdmitIngress ACLs.
+                                // called after CNCPAdmitIngress ACLs. Returns the flow's entry,
+                                // which stays valid until the next insert or erase.
     void ReportCNCPStatus(FlowKey key);
     void CNCPUpdateFromReport(FlowKey key, uint64_t flowInfo);
     void CNCPUpdate(FlowKey key);
-    uint64_t CNCPGetNextIteration(uint64_t f_e, uint64_t q_v, uint64_t p_e, uint64_t q_u);
+    uint64_t CNCPGetNextIteration(uint64_t f_e,
+                                  uint64_t q_v,
+                                  uint64_t p_e,
+                                  uint64_t q_u,
+                                  uint32_t pg);
+    // weight of the utility of the flows of priority group pg, 1 by default
+    void SetCNCPPriorityWeight(uint32_t pg, double weight);
     void CNCPCheckFlowExpired(FlowKey key);
+    uint64_t GetCncpScheduledEvents() const;
+
+  private:
+    void CNCPScheduleTimers(const FlowKey& key);
+    bool CNCPExpireFlow(const FlowKey& key); // returns true if the flow is no longer tracked
+    void CNCPUpdateFlow(CncpFlowEntry& flow);
+    void CNCPUpdateAllFlows(); // fixed-point update of every flow in one batch
+    void CNCPReportFlow(const CncpFlowEntry& flow);
+    void CNCPFlushReports();
+    void CNCPTick();
 };
 
 } /* namespace ns3 */
@@ -6,14 +6,32 @@
  * Author: Mathieu Lacage <mathieu.lacage@sophia.inria.fr>
  */
 
+#include "ns3/cncp-flow-table.h"
+#include "ns3/cncp-timer-wheel.h"
+#include "ns3/cncp-update.h"
 #include "ns3/drop-tail-queue.h"
+#include "ns3/ecmp-table.h"
+#include "ns3/flow-trace.h"
 #include "ns3/net-device-queue-interface.h"
 #include "ns3/point-to-point-channel.h"
 #include "ns3/point-to-point-net-device.h"
+#include "ns3/qbb-net-device.h"
+#include "ns3/rdma-queue-pair.h"
 #include "ns3/simulator.h"
 #include "ns3/test.h"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <map>
+#include <numeric>
+#include <random>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 using namespace ns3;
 
@@ -128,6 +146,209 @@ PointToPointTest::DoRun()
     Simulator::Destroy();
 }
 
+/**
+ * @brief Test that the CNCP rate update in fixed point converges like the one in double
+ *
+ * The flows, of priority groups 0 to 3 weighted 1 to 4, share one egress port
+ * of 100 Gbps. At each update the queue of the port grows or drains by the
+ * bytes sent over or under its rate, and each flow holds its share of it. The
+ * port runs once with CncpUpdateKernel::NextRateDouble flow by flow, as
+ * SwitchNode without CNCPFixedPoint, and once with CncpUpdateKernel::NextRates
+ * of the whole port, 200000 times; the rates they converge to must agree
+ * within 0.1%.
+ *
+ * Both must also reach the fixed point of the update: the rates sum to the
+ * rate of the port, and the queue Q of the port prices every flow so that
+ * U'(f) = tg * Q * (w + f / rate of the port), which gives the flows of a
+ * larger weight a larger share, in proportion to weight^(1 / alpha) as the
+ * queue goes to 0.
+ */
+class CncpUpdateTest : public TestCase
+{
+  public:
+    /**
+     * @brief Create the test
+     *
+     * @param utility The utility of the flows.
+     * @param alpha Alpha of the AlphaFair utility.
+     * @param flows Number of flows on the port.
+     */
+    CncpUpdateTest(CncpUpdateKernel::Utility utility, double alpha, uint32_t flows);
+
+    /**
+     * @brief Run the test
+     */
+    void DoRun() override;
+
+  private:
+    /**
+     * @brief Update the rates of the port until they converge
+     *
+     * @param kernel The update.
+     * @param fixedPoint Whether to use the fixed-point update.
+     *
+     * @return The rates of the flows.
+     */
+    std::vector<uint64_t> Converge(const CncpUpdateKernel& kernel, bool fixedPoint);
+    /**
+     * @brief Solve the fixed point of the update, in double
+     *
+     * @param weights The weight of lambda of each priority group.
+     *
+     * @return The rates of the flows.
+     */
+    std::vector<double> FixedPoint(const std::array<double, CncpUpdateKernel::pgCnt>& weights);
+
+    CncpUpdateKernel::Utility m_utility; //!< utility of the flows
+    double m_alpha;                      //!< alpha of AlphaFair
+    uint32_t m_flows;                    //!< flows on the port
+};
+
+CncpUpdateTest::CncpUpdateTest(CncpUpdateKernel::Utility utility, double alpha, uint32_t flows)
+    : TestCase("CNCP update in fixed point, " +
+               std::string(utility == CncpUpdateKernel::Log ? "Log" : "AlphaFair") + ", " +
+               std::to_string(flows) + " flows"),
+      m_utility(utility),
+      m_alpha(alpha),
+      m_flows(flows)
+{
+}
+
+// the port and parameters of the update, a smaller step and larger utility than the
+// default, and the reference rate of AlphaFair at the rate of the port, for the port
+// to converge quickly
+static const uint64_t cncpPortRate = 100000000000ULL;
+static const uint64_t cncpGamma = 150;
+static const uint64_t cncpLambda = 1000000000000000ULL;
+static const uint64_t cncpInterval = 1000;
+static const double cncpQueueWeight = 1.1;
+static const uint64_t cncpRefRate = 100000000000ULL;
+
+std::vector<uint64_t>
+CncpUpdateTest::Converge(const CncpUpdateKernel& kernel, bool fixedPoint)
+{
+    const uint64_t portRate = cncpPortRate;
+    std::vector<uint64_t> rate(m_flows, portRate / m_flows);
+    std::vector<uint32_t> qv(m_flows, 0);
+    std::vector<uint32_t> pe(m_flows, 0);
+    std::vector<uint32_t> qu(m_flows, 0);
+    std::vector<uint8_t> pg(m_flows);
+    std::vector<uint64_t> cap(m_flows, portRate);
+    for (uint32_t i = 0; i < m_flows; i++)
+    {
+        pg[i] = i % 4;
+    }
+    int64_t queue = 0;
+    for (uint32_t t = 0; t < 200000; t++)
+    {
+        // the queue after one more interval of 1 us at the current rates
+        uint64_t sum = std::accumulate(rate.begin(), rate.end(), 0ULL);
+        queue = std::max<int64_t>(0, queue + ((int64_t)sum - (int64_t)portRate) / 8000000);
+        for (uint32_t i = 0; i < m_flows; i++)
+        {
+            pe[i] = queue;
+            qu[i] = sum > 0 ? (double)queue * rate[i] / sum : 0;
+        }
+        if (fixedPoint)
+        {
+            kernel.NextRates(m_flows,
+                             rate.data(),
+                             qv.data(),
+                             pe.data(),
+                             qu.data(),
+                             pg.data(),
+                             cap.data());
+            continue;
+        }
+        for (uint32_t i = 0; i < m_flows; i++)
+        {
+            rate[i] = std::min(kernel.NextRateDouble(rate[i], qv[i], pe[i], qu[i], pg[i]), cap[i]);
+        }
+    }
+    return rate;
+}
+
+std::vector<double>
+CncpUpdateTest::FixedPoint(const std::array<double, CncpUpdateKernel::pgCnt>& weights)
+{
+    const double s = cncpPortRate;
+    const double tg = 8 * cncpGamma / cncpInterval;
+    // the rate of flow i at which U' meets the price of a queue q, decreasing in q
+    auto rateAt = [&](uint32_t i, double q) {
+        double lambda = cncpLambda * weights[i % 4];
+        double lo = 0;
+        double hi = s;
+        for (uint32_t k = 0; k < 200; k++)
+        {
+            double f = (lo + hi) / 2;
+            double uPrime = m_utility == CncpUpdateKernel::Log
+                                ? lambda / f
+                                : lambda / cncpRefRate * std::pow(cncpRefRate / f, m_alpha);
+            (uPrime > tg * q * (cncpQueueWeight + f / s) ? lo : hi) = f;
+        }
+        return lo;
+    };
+    // the queue at which the rates fill the port
+    double lo = 0;
+    double hi = 1e12;
+    std::vector<double> rate(m_flows);
+    for (uint32_t k = 0; k < 200; k++)
+    {
+        double q = (lo + hi) / 2;
+        double sum = 0;
+        for (uint32_t i = 0; i < m_flows; i++)
+        {
+            rate[i] = rateAt(i, q);
+            sum += rate[i];
+        }
+        (sum > s ? lo : hi) = q;
+    }
+    return rate;
+}
+
+void
+CncpUpdateTest::DoRun()
+{
+    std::array<double, CncpUpdateKernel::pgCnt> weights = {1, 2, 3, 4, 1, 1, 1, 1};
+    CncpUpdateKernel kernel;
+    kernel.Configure(cncpGamma,
+                     cncpLambda,
+                     cncpInterval,
+                     cncpQueueWeight,
+                     m_utility,
+                     m_alpha,
+                     cncpRefRate,
+                     weights);
+
+    std::vector<uint64_t> ref = Converge(kernel, false);
+    std::vector<uint64_t> fixed = Converge(kernel, true);
+    std::vector<double> expected = FixedPoint(weights);
+    for (uint32_t i = 0; i < m_flows; i++)
+    {
+        NS_TEST_EXPECT_MSG_EQ_TOL((double)fixed[i],
+                                  (double)ref[i],
+                                  ref[i] * 0.001,
+                                  "rate of flow " << i << " in fixed point");
+        NS_TEST_EXPECT_MSG_EQ_TOL((double)ref[i],
+                                  expected[i],
+                                  expected[i] * 0.005,
+                                  "rate of flow " << i << " away from the fixed point");
+    }
+    NS_TEST_EXPECT_MSG_EQ_TOL((double)std::accumulate(ref.begin(), ref.end(), 0ULL),
+                              (double)cncpPortRate,
+                              cncpPortRate * 0.001,
+                              "the rates do not fill the port");
+    NS_TEST_EXPECT_MSG_EQ_TOL((double)std::accumulate(fixed.begin(), fixed.end(), 0ULL),
+                              (double)cncpPortRate,
+                              cncpPortRate * 0.001,
+                              "the rates in fixed point do not fill the port");
+    // flows of a larger weight get a larger share
+    for (uint32_t i = 0; i + 1 < std::min(m_flows, 4U); i++)
+    {
+        NS_TEST_EXPECT_MSG_LT(ref[i], ref[i + 1], "flow " << i << " of a lower weight");
+    }
+}
+
 /**
  * @brief TestSuite for PointToPoint module
  */
@@ -144,6 +365,1169 @@ PointToPointTestSuite::PointToPointTestSuite()
     : TestSuite("devices-point-to-point", Type::UNIT)
 {
     AddTestCase(new PointToPointTest, TestCase::Duration::QUICK);
+    for (uint32_t flows : {2, 4, 16})
+    {
+        AddTestCase(new CncpUpdateTest(CncpUpdateKernel::Log, 1, flows),
+                    TestCase::Duration::QUICK);
+        AddTestCase(new CncpUpdateTest(CncpUpdateKernel::AlphaFair, 2, flows),
+                    TestCase::Duration::QUICK);
+    }
 }
 
 static PointToPointTestSuite g_pointToPointTestSuite; //!< The testsuite
+
+/**
+ * @brief Test CncpFlowTable against an unordered_map
+ *
+ * Keys sharing a home slot, also across the end of the array, are erased
+ * from the middle of their probe sequence, then random inserts and erases
+ * grow the table from its smallest size; after each every flow must still be
+ * found with its fields, the erased ones not at all, and no slot may be left
+ * used without a flow.
+ */
+class CncpFlowTableTest : public TestCase
+{
+  public:
+    /**
+     * @brief Create the test
+     */
+    CncpFlowTableTest();
+
+    /**
+     * @brief Run the test
+     */
+    void DoRun() override;
+
+  private:
+    /**
+     * @brief Make the key of flow i
+     *
+     * @param i The flow.
+     *
+     * @return The key.
+     */
+    static FlowKey MakeKey(uint32_t i);
+    /**
+     * @brief Check the table holds exactly the flows of ref
+     *
+     * @param t The table.
+     * @param ref The qv of each flow in the table.
+     * @param n The flows ever inserted.
+     */
+    void Check(CncpFlowTable& t, const std::unordered_map<uint32_t, uint32_t>& ref, uint32_t n);
+};
+
+CncpFlowTableTest::CncpFlowTableTest()
+    : TestCase("CNCP flow table insert, erase and backward shift")
+{
+}
+
+FlowKey
+CncpFlowTableTest::MakeKey(uint32_t i)
+{
+    FlowKey key;
+    key.sip = 0x0b000001 + (i >> 8);
+    key.dip = 0x0b000001 + (i & 0xff);
+    key.sport = 10000 + (i & 0xfff);
+    key.dport = 100;
+    key.protocol = 0x11;
+    key.priority_group = i % 8;
+    return key;
+}
+
+void
+CncpFlowTableTest::Check(CncpFlowTable& t,
+                         const std::unordered_map<uint32_t, uint32_t>& ref,
+                         uint32_t n)
+{
+    NS_TEST_ASSERT_MSG_EQ(t.GetN(), ref.size(), "flows in the table");
+    for (uint32_t i = 0; i < n; i++)
+    {
+        CncpFlowEntry* e = t.Find(MakeKey(i));
+        auto it = ref.find(i);
+        if (it == ref.end())
+        {
+            NS_TEST_ASSERT_MSG_EQ(e, nullptr, "erased flow " << i << " found");
+            continue;
+        }
+        NS_TEST_ASSERT_MSG_NE(e, nullptr, "flow " << i << " lost");
+        NS_TEST_ASSERT_MSG_EQ(e->qv, it->second, "fields of flow " << i);
+    }
+    uint32_t used = 0;
+    for (uint32_t i = 0; i < t.GetCapacity(); i++)
+    {
+        used += t.GetSlot(i).used;
+    }
+    NS_TEST_ASSERT_MSG_EQ(used, ref.size(), "slots used");
+}
+
+void
+CncpFlowTableTest::DoRun()
+{
+    // five keys of each of two home slots, the second at the end of the array so that its
+    // probe sequence wraps to the start
+    CncpFlowTable t(64);
+    const uint32_t mask = t.GetCapacity() - 1;
+    std::unordered_map<uint32_t, uint32_t> ref;
+    uint32_t n = 0;
+    for (uint32_t home : {7U, mask})
+    {
+        uint32_t found = 0;
+        for (uint32_t i = 0; found < 5; i++)
+        {
+            if ((CncpFlowTable::Hash(MakeKey(i)) & mask) != home || ref.count(i))
+            {
+                continue;
+            }
+            bool inserted;
+            t.Insert(MakeKey(i), inserted)->qv = i;
+            NS_TEST_ASSERT_MSG_EQ(inserted, true, "new flow " << i);
+            ref[i] = i;
+            n = std::max(n, i + 1);
+            found++;
+        }
+    }
+    NS_TEST_ASSERT_MSG_EQ(t.GetCapacity(), mask + 1, "the table grew");
+    Check(t, ref, n);
+    // erase from the middle and the head of each probe sequence
+    std::vector<uint32_t> keys;
+    for (auto& kv : ref)
+    {
+        keys.push_back(kv.first);
+    }
+    std::sort(keys.begin(), keys.end());
+    for (uint32_t i : {2U, 0U, 7U, 5U})
+    {
+        NS_TEST_ASSERT_MSG_EQ(t.Erase(MakeKey(keys[i])), true, "erase flow " << keys[i]);
+        ref.erase(keys[i]);
+        Check(t, ref, n);
+    }
+    NS_TEST_ASSERT_MSG_EQ(t.Erase(MakeKey(keys[0])), false, "erase an erased flow");
+
+    // random inserts and erases, growing the table
+    CncpFlowTable r(1);
+    ref.clear();
+    std::mt19937 rng(1);
+    n = 4096;
+    for (uint32_t step = 0; step < 20000; step++)
+    {
+        uint32_t i = rng() % n;
+        bool inserted;
+        if (rng() % 3 != 0)
+        {
+            CncpFlowEntry* e = r.Insert(MakeKey(i), inserted);
+            NS_TEST_ASSERT_MSG_EQ(inserted, (ref.count(i) == 0), "insert flow " << i);
+            if (inserted)
+            {
+                e->qv = step;
+                ref[i] = step;
+            }
+        }
+        else
+        {
+            NS_TEST_ASSERT_MSG_EQ(r.Erase(MakeKey(i)), (ref.erase(i) == 1), "erase flow " << i);
+        }
+        if (step % 1000 == 0)
+        {
+            Check(r, ref, n);
+        }
+    }
+    Check(r, ref, n);
+    NS_TEST_ASSERT_MSG_LT_OR_EQ(r.GetN() * 2, r.GetCapacity(), "load factor above 1/2");
+    r.Clear();
+    ref.clear();
+    Check(r, ref, n);
+}
+
+/**
+ * @brief TestSuite for CncpFlowTable
+ */
+class CncpFlowTableTestSuite : public TestSuite
+{
+  public:
+    /**
+     * @brief Constructor
+     */
+    CncpFlowTableTestSuite();
+};
+
+CncpFlowTableTestSuite::CncpFlowTableTestSuite()
+    : TestSuite("cncp-flow-table", Type::UNIT)
+{
+    AddTestCase(new CncpFlowTableTest, TestCase::Duration::QUICK);
+}
+
+static CncpFlowTableTestSuite g_cncpFlowTableTestSuite; //!< The testsuite
+
+/**
+ * @brief Test that CncpTimerWheel fires every timer at its deadline, in order
+ *
+ * Timers are scheduled at every level of the wheel, beyond the top level
+ * and already due, also while the wheel turns. The wheel is advanced by steps
+ * of random length; each step must fire exactly the timers due in it, in
+ * order of deadline, a timer already due at the next tick.
+ */
+class CncpTimerWheelTest : public TestCase
+{
+  public:
+    /**
+     * @brief Create the test
+     */
+    CncpTimerWheelTest();
+
+    /**
+     * @brief Run the test
+     */
+    void DoRun() override;
+};
+
+CncpTimerWheelTest::CncpTimerWheelTest()
+    : TestCase("CNCP timer wheel expiry order")
+{
+}
+
+void
+CncpTimerWheelTest::DoRun()
+{
+    CncpTimerWheel w;
+    std::mt19937_64 rng(1);
+    std::vector<uint64_t> deadline; // of timer i, the sip of its key
+    auto schedule = [&](uint64_t d) {
+        FlowKey key = {};
+        key.sip = deadline.size();
+        // a timer already due fires on the next tick
+        deadline.push_back(std::max(d, w.GetNow() + 1));
+        w.Schedule(key, d);
+    };
+    const uint64_t end = 20000000; // beyond the 64^4 ticks of the top level
+    for (uint32_t i = 0; i < 5000; i++)
+    {
+        // spread over the levels: up to 64, 64^2, 64^3 and past the top
+        uint64_t span = 1ULL << (6 * (1 + i % 4));
+        schedule(rng() % std::min(span, end));
+    }
+    schedule(0);
+    std::vector<bool> fired(deadline.size(), false);
+    uint32_t nFired = 0;
+    while (w.GetNow() < end)
+    {
+        uint64_t from = w.GetNow();
+        uint64_t to = std::min(end, from + 1 + rng() % 100000);
+        if (rng() % 2)
+        {
+            schedule(from + rng() % 300000);
+            fired.push_back(false);
+        }
+        std::vector<FlowKey> expired;
+        w.Advance(to, expired);
+        NS_TEST_ASSERT_MSG_EQ(w.GetNow(), to, "wheel turned to");
+        uint64_t last = from;
+        for (const FlowKey& key : expired)
+        {
+            uint64_t d = deadline[key.sip];
+            NS_TEST_ASSERT_MSG_EQ(fired[key.sip], false, "timer " << key.sip << " fired twice");
+            NS_TEST_ASSERT_MSG_GT(d, from, "timer " << key.sip << " fired late");
+            NS_TEST_ASSERT_MSG_LT_OR_EQ(d, to, "timer " << key.sip << " fired early");
+            NS_TEST_ASSERT_MSG_LT_OR_EQ(last, d, "timer " << key.sip << " fired out of order");
+            last = d;
+            fired[key.sip] = true;
+            nFired++;
+        }
+        // every timer due by now has fired
+        NS_TEST_ASSERT_MSG_EQ(w.GetN(),
+                              (uint32_t)std::count_if(deadline.begin(),
+                                                      deadline.end(),
+                                                      [to](uint64_t d) { return d > to; }),
+                              "timers pending at " << to);
+    }
+    NS_TEST_ASSERT_MSG_EQ(nFired + w.GetN(), deadline.size(), "timers lost");
+}
+
+/**
+ * @brief TestSuite for CncpTimerWheel
+ */
+class CncpTimerWheelTestSuite : public TestSuite
+{
+  public:
+    /**
+     * @brief Constructor
+     */
+    CncpTimerWheelTestSuite();
+};
+
+CncpTimerWheelTestSuite::CncpTimerWheelTestSuite()
+    : TestSuite("cncp-timer-wheel", Type::UNIT)
+{
+    AddTestCase(new CncpTimerWheelTest, TestCase::Duration::QUICK);
+}
+
+static CncpTimerWheelTestSuite g_cncpTimerWheelTestSuite; //!< The testsuite
+
+/**
+ * @brief Test that RdmaEgressQueue picks the qp the former round-robin scan picked
+ *
+ * Rate-limited qps of random priority groups, sizes and windows send over a
+ * 100 Gbps NIC while priority groups are paused and resumed, qps are acked,
+ * finish and are added. Before each pick the qp is computed with the former
+ * linear scan from m_rrlast; the ready sets and waiting heap must pick the
+ * same one, and when none is ready GetNextAvail must be the earliest
+ * m_nextAvail of a qp that only waits for its rate limiter.
+ */
+class RdmaEgressQueueTest : public TestCase
+{
+  public:
+    /**
+     * @brief Create the test
+     */
+    RdmaEgressQueueTest();
+
+    /**
+     * @brief Run the test
+     */
+    void DoRun() override;
+
+  private:
+    /**
+     * @brief Add a qp of random parameters to the NIC
+     */
+    void AddQp();
+    /**
+     * @brief Change the NIC at random, then send the next packet if any
+     */
+    void Step();
+    /**
+     * @brief The packet of qp, as RdmaHw::GetNxtPacket advances it
+     *
+     * @param qp The qp.
+     *
+     * @return The packet.
+     */
+    Ptr<Packet> NextPkt(Ptr<RdmaQueuePair> qp);
+
+    Ptr<RdmaEgressQueue> m_eq;            //!< the scheduler
+    Ptr<RdmaQueuePairGroup> m_grp;        //!< its qps
+    bool m_paused[RdmaEgressQueue::qCnt]; //!< paused priority groups
+    std::mt19937 m_rng;                   //!< random changes
+    uint32_t m_steps;                     //!< steps left
+    uint32_t m_nQps;                      //!< qps added
+    uint32_t m_sent;                      //!< packets sent
+};
+
+RdmaEgressQueueTest::RdmaEgressQueueTest()
+    : TestCase("RDMA egress queue ready set and waiting heap"),
+      m_rng(1),
+      m_steps(0),
+      m_nQps(0),
+      m_sent(0)
+{
+}
+
+Ptr<Packet>
+RdmaEgressQueueTest::NextPkt(Ptr<RdmaQueuePair> qp)
+{
+    qp->snd_nxt += 1000;
+    return Create<Packet>(1000);
+}
+
+void
+RdmaEgressQueueTest::AddQp()
+{
+    Ptr<RdmaQueuePair> qp = Create<RdmaQueuePair>(m_rng() % 4,
+                                                  Ipv4Address(0x0b000001),
+                                                  Ipv4Address(0x0b000101 + m_nQps),
+                                                  10000 + m_nQps,
+                                                  100);
+    m_nQps++;
+    qp->SetSize(1000 * (1 + m_rng() % 40));
+    qp->SetWin(m_rng() % 2 ? 0 : 1000 * (1 + m_rng() % 8));
+    qp->m_max_rate = DataRate("100Gb/s");
+    qp->m_rate = DataRate(1000000000ULL * (1 + m_rng() % 50));
+    qp->m_nextAvail = Simulator::Now() + NanoSeconds(m_rng() % 2000);
+    m_grp->AddQp(qp);
+}
+
+void
+RdmaEgressQueueTest::Step()
+{
+    if (m_steps-- == 0)
+    {
+        return;
+    }
+    int64_t now = Simulator::Now().GetTimeStep();
+    if (m_rng() % 50 == 0)
+    {
+        m_paused[m_rng() % 4] ^= true;
+    }
+    if (m_rng() % 100 == 0 || m_grp->GetN() == 0)
+    {
+        AddQp();
+    }
+    if (m_grp->GetN() > 0)
+    {
+        // an ACK for some of the bytes in flight, the qp is re-filed as RdmaHw does
+        Ptr<RdmaQueuePair> qp = m_grp->Get(m_rng() % m_grp->GetN());
+        qp->Acknowledge(qp->snd_una + (qp->snd_nxt - qp->snd_una) * (m_rng() % 3) / 2);
+        m_eq->UpdateQp(qp);
+    }
+
+    // the former scan
+    Ptr<RdmaQueuePair> expected;
+    uint32_t fcount = m_grp->GetN();
+    for (uint32_t qIndex = 1; qIndex <= fcount && !expected; qIndex++)
+    {
+        Ptr<RdmaQueuePair> qp = m_grp->Get((qIndex + m_eq->m_rrlast) % fcount);
+        if (!m_paused[qp->m_pg] && qp->GetBytesLeft() > 0 && !qp->IsWinBound() &&
+            qp->m_nextAvail.GetTimeStep() <= now)
+        {
+            expected = qp;
+        }
+    }
+
+    int idx = m_eq->GetNextQindex(m_paused);
+    if (idx < 0)
+    {
+        NS_TEST_ASSERT_MSG_EQ(expected, nullptr, "a ready qp was not picked");
+        Time t = Simulator::GetMaximumSimulationTime();
+        for (uint32_t i = 0; i < m_grp->GetN(); i++)
+        {
+            Ptr<RdmaQueuePair> qp = m_grp->Get(i);
+            if (qp->GetBytesLeft() > 0 && !qp->IsWinBound() && qp->m_nextAvail.GetTimeStep() > now)
+            {
+                t = Min(t, qp->m_nextAvail);
+            }
+        }
+        NS_TEST_ASSERT_MSG_EQ(m_eq->GetNextAvail(), t, "next wake-up");
+        Simulator::Schedule(Min(t - Simulator::Now(), MicroSeconds(1)),
+                            &RdmaEgressQueueTest::Step,
+                            this);
+        return;
+    }
+    Ptr<RdmaQueuePair> qp = m_grp->Get(idx);
+    NS_TEST_ASSERT_MSG_EQ(qp, expected, "qp picked at slot " << idx);
+    m_eq->DequeueQindex(idx);
+    qp->m_nextAvail = Simulator::Now() + qp->m_rate.CalculateBytesTxTime(1000);
+    m_eq->UpdateQp(qp);
+    m_sent++;
+    Simulator::Schedule(NanoSeconds(80), &RdmaEgressQueueTest::Step, this);
+}
+
+void
+RdmaEgressQueueTest::DoRun()
+{
+    m_grp = CreateObject<RdmaQueuePairGroup>();
+    m_eq = CreateObject<RdmaEgressQueue>();
+    m_eq->m_qpGrp = m_grp;
+    m_eq->m_rdmaGetNxtPkt = MakeCallback(&RdmaEgressQueueTest::NextPkt, this);
+    std::fill(m_paused, m_paused + RdmaEgressQueue::qCnt, false);
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        AddQp();
+    }
+    m_steps = 50000;
+    Simulator::ScheduleNow(&RdmaEgressQueueTest::Step, this);
+    Simulator::Run();
+    Simulator::Destroy();
+    NS_TEST_ASSERT_MSG_GT(m_sent, 10000U, "packets sent");
+    NS_TEST_ASSERT_MSG_LT(m_grp->GetN(), m_nQps, "finished qps were not compacted");
+}
+
+/**
+ * @brief TestSuite for RdmaEgressQueue
+ */
+class RdmaEgressQueueTestSuite : public TestSuite
+{
+  public:
+    /**
+     * @brief Constructor
+     */
+    RdmaEgressQueueTestSuite();
+};
+
+RdmaEgressQueueTestSuite::RdmaEgressQueueTestSuite()
+    : TestSuite("rdma-egress-queue", Type::UNIT)
+{
+    AddTestCase(new RdmaEgressQueueTest, TestCase::Duration::QUICK);
+}
+
+static RdmaEgressQueueTestSuite g_rdmaEgressQueueTestSuite; //!< The testsuite
+
+/**
+ * @brief Test that FlowTraceReader reads text and binary traces alike
+ *
+ * A text trace of random flows, longer than the reader's buffer and with start
+ * times in plain and exponent notation, is read back and compared with what
+ * was written, then converted to the binary format and read back again. A
+ * missing file cannot be opened and a malformed flow ends the trace.
+ */
+class FlowTraceTest : public TestCase
+{
+  public:
+    /**
+     * @brief Create the test
+     */
+    FlowTraceTest();
+
+    /**
+     * @brief Run the test
+     */
+    void DoRun() override;
+
+  private:
+    /**
+     * @brief Read a trace and compare it with the flows written
+     *
+     * @param path The trace.
+     * @param binary Whether it is expected in the binary format.
+     */
+    void Check(const std::string& path, bool binary);
+
+    std::vector<FlowTraceRecord> m_flows; //!< the flows written
+};
+
+FlowTraceTest::FlowTraceTest()
+    : TestCase("Flow trace reader and binary conversion")
+{
+}
+
+void
+FlowTraceTest::Check(const std::string& path, bool binary)
+{
+    FlowTraceReader reader;
+    NS_TEST_ASSERT_MSG_EQ(reader.Open(path), true, "cannot open " << path);
+    NS_TEST_ASSERT_MSG_EQ(reader.IsBinary(), binary, "format of " << path);
+    NS_TEST_ASSERT_MSG_EQ(reader.GetNFlows(), m_flows.size(), "flows announced by " << path);
+    FlowTraceRecord r;
+    for (uint32_t i = 0; i < m_flows.size(); i++)
+    {
+        const FlowTraceRecord& f = m_flows[i];
+        NS_TEST_ASSERT_MSG_EQ(reader.Read(r), true, "flow #" << i << " of " << path);
+        NS_TEST_ASSERT_MSG_EQ(r.src, f.src, "src of flow #" << i << " of " << path);
+        NS_TEST_ASSERT_MSG_EQ(r.dst, f.dst, "dst of flow #" << i << " of " << path);
+        NS_TEST_ASSERT_MSG_EQ(r.pg, f.pg, "pg of flow #" << i << " of " << path);
+        NS_TEST_ASSERT_MSG_EQ(r.dport, f.dport, "dport of flow #" << i << " of " << path);
+        NS_TEST_ASSERT_MSG_EQ(r.size, f.size, "size of flow #" << i << " of " << path);
+        NS_TEST_ASSERT_MSG_EQ(r.start, f.start, "start of flow #" << i << " of " << path);
+    }
+    NS_TEST_ASSERT_MSG_EQ(reader.Read(r), false, "read past the end of " << path);
+}
+
+void
+FlowTraceTest::DoRun()
+{
+    std::mt19937_64 rng(1);
+    std::string textPath = CreateTempDirFilename("flow.txt");
+    std::string binPath = CreateTempDirFilename("flow.bin");
+    FILE* f = fopen(textPath.c_str(), "w");
+    NS_TEST_ASSERT_MSG_NE(f, nullptr, "cannot write " << textPath);
+    const uint32_t n = 60000; // about 2 MB, more than a chunk of the reader
+    fprintf(f, "%u\n", n);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        FlowTraceRecord r;
+        r.src = rng() % 1024;
+        r.dst = rng() % 1024;
+        r.pg = rng() % 8;
+        r.dport = 100 + rng() % 60000;
+        r.size = rng() % 2 ? rng() % 100000 : rng() % (1ULL << 40);
+        char start[64];
+        double t = 2 + (rng() % 1000000000) * 1e-9;
+        // the plain decimals of the generators, or what strtod parses
+        snprintf(start, sizeof(start), rng() % 4 ? "%.9f" : "%.17e", t);
+        r.start = Seconds(strtod(start, nullptr));
+        fprintf(f,
+                "%u %u %u %u %llu %s\n",
+                r.src,
+                r.dst,
+                r.pg,
+                r.dport,
+                (unsigned long long)r.size,
+                start);
+        m_flows.push_back(r);
+    }
+    fclose(f);
+
+    Check(textPath, false);
+    NS_TEST_ASSERT_MSG_EQ(FlowTraceReader::ConvertToBinary(textPath, binPath),
+                          true,
+                          "conversion of " << textPath);
+    Check(binPath, true);
+    NS_TEST_ASSERT_MSG_EQ(FlowTraceReader::ConvertToBinary(binPath, textPath),
+                          false,
+                          "a binary trace was converted");
+
+    FlowTraceReader reader;
+    NS_TEST_ASSERT_MSG_EQ(reader.Open(CreateTempDirFilename("missing")),
+                          false,
+                          "opened a missing trace");
+
+    f = fopen(textPath.c_str(), "w");
+    fprintf(f, "3\n1 2 3 100 1000 2.0\n1 2 x 100 1000 2.0\n1 2 3 100 1000 2.0\n");
+    fclose(f);
+    FlowTraceRecord r;
+    NS_TEST_ASSERT_MSG_EQ(reader.Open(textPath), true, "cannot open " << textPath);
+    NS_TEST_ASSERT_MSG_EQ(reader.Read(r), true, "flow before the malformed one");
+    NS_TEST_ASSERT_MSG_EQ(reader.Read(r), false, "malformed flow was read");
+    NS_TEST_ASSERT_MSG_EQ(FlowTraceReader::ConvertToBinary(textPath, binPath),
+                          false,
+                          "a malformed trace was converted");
+    remove(textPath.c_str());
+    remove(binPath.c_str());
+}
+
+/**
+ * @brief TestSuite for FlowTraceReader
+ */
+class FlowTraceTestSuite : public TestSuite
+{
+  public:
+    /**
+     * @brief Constructor
+     */
+    FlowTraceTestSuite();
+};
+
+FlowTraceTestSuite::FlowTraceTestSuite()
+    : TestSuite("flow-trace", Type::UNIT)
+{
+    AddTestCase(new FlowTraceTest, TestCase::Duration::QUICK);
+}
+
+static FlowTraceTestSuite g_flowTraceTestSuite; //!< The testsuite
+
+/**
+ * @brief Test that EcmpTable finds the next hops added, as runs or hashed
+ *
+ * Two tables share a pool, one with a next hop per rack of hosts and one with
+ * the uplinks for all but its own rack, added in host id order as
+ * RouteCalculator does: they must be a few runs and share their groups. Then
+ * random entries, in order and out of it, towards hosts and other addresses,
+ * are compared with a map of the next hops added, also after Clear.
+ */
+class EcmpTableTest : public TestCase
+{
+  public:
+    /**
+     * @brief Create the test
+     */
+    EcmpTableTest();
+
+    /**
+     * @brief Run the test
+     */
+    void DoRun() override;
+
+  private:
+    /// Destination to its next hops, in the order added
+    using Routes = std::map<uint32_t, std::vector<uint32_t>>;
+
+    /**
+     * @brief Compare the lookups of a table with the next hops added
+     *
+     * @param table The table.
+     * @param ref The next hops added.
+     * @param dips More destinations to look up, with no route unless in ref.
+     */
+    void Check(const EcmpTable& table, const Routes& ref, const std::vector<uint32_t>& dips);
+};
+
+EcmpTableTest::EcmpTableTest()
+    : TestCase("ECMP table runs and shared groups")
+{
+}
+
+void
+EcmpTableTest::Check(const EcmpTable& table,
+                     const Routes& ref,
+                     const std::vector<uint32_t>& dips)
+{
+    for (const auto& r : ref)
+    {
+        uint32_t n;
+        const uint32_t* ports = table.Lookup(r.first, n);
+        NS_TEST_ASSERT_MSG_EQ(n, r.second.size(), "next hops to " << r.first);
+        NS_TEST_ASSERT_MSG_EQ(std::equal(ports, ports + n, r.second.begin()),
+                              true,
+                              "next hops to " << r.first);
+    }
+    for (uint32_t dip : dips)
+    {
+        uint32_t n;
+        table.Lookup(dip, n);
+        NS_TEST_ASSERT_MSG_EQ(n, (ref.count(dip) ? ref.at(dip).size() : 0), "next hops to " << dip);
+    }
+}
+
+void
+EcmpTableTest::DoRun()
+{
+    const uint32_t hostBase = 0x0b000001;
+    const uint32_t hostShift = 8;
+    const uint32_t nHosts = 256;
+    auto host = [&](uint32_t id) { return hostBase + (id << hostShift); };
+
+    Ptr<EcmpGroupPool> groups = Create<EcmpGroupPool>();
+    EcmpTable core(groups, hostBase, hostShift);
+    EcmpTable tor(groups, hostBase, hostShift);
+    Routes coreRef;
+    Routes torRef;
+    std::vector<uint32_t> unrouted;
+    for (uint32_t id = 0; id < nHosts; id++)
+    {
+        if (id % 16 == 15)
+        {
+            unrouted.push_back(host(id)); // a host with no route, inside a run
+            continue;
+        }
+        core.Add(host(id), id / 16);
+        coreRef[host(id)].push_back(id / 16);
+        std::vector<uint32_t>& ports = torRef[host(id)];
+        ports = id < 16 ? std::vector<uint32_t>{id} : std::vector<uint32_t>{16, 17, 18, 19};
+        for (uint32_t port : ports)
+        {
+            tor.Add(host(id), port);
+        }
+    }
+    for (uint32_t id = nHosts; id < nHosts + 4; id++)
+    {
+        unrouted.push_back(host(id));
+    }
+    unrouted.push_back(host(3) + 1); // not a host address
+    Check(core, coreRef, unrouted);
+    Check(tor, torRef, unrouted);
+    // a run per rack and a gap after all but the last; a run per host of its own rack, then
+    // the uplinks, split by the same gaps
+    NS_TEST_ASSERT_MSG_EQ(core.GetNRuns(), 16 + 15, "runs of the core table");
+    NS_TEST_ASSERT_MSG_EQ(tor.GetNRuns(), 15 + 1 + 15 + 14, "runs of the ToR table");
+    // the empty list, {0}..{15}, and {16}, {16, 17}, {16, 17, 18}, {16, 17, 18, 19}
+    NS_TEST_ASSERT_MSG_EQ(tor.GetNGroups(), 1 + 16 + 4, "groups of the pool");
+    NS_TEST_ASSERT_MSG_EQ(core.GetNGroups(), tor.GetNGroups(), "the pool is shared");
+    uint32_t n1;
+    uint32_t n2;
+    NS_TEST_ASSERT_MSG_EQ(core.Lookup(host(20), n1),
+                          tor.Lookup(host(1), n2),
+                          "equal next hop lists are one group");
+
+    // random entries, mostly in host id order, into tables with and without a layout
+    std::mt19937 rng(1);
+    EcmpTable hosts(groups, hostBase, hostShift);
+    EcmpTable plain;
+    for (uint32_t round = 0; round < 4; round++)
+    {
+        Routes ref;
+        std::vector<uint32_t> dips;
+        uint32_t id = 0;
+        for (uint32_t i = 0; i < 5000; i++)
+        {
+            uint32_t r = rng() % 100;
+            uint32_t dip;
+            if (r < (round % 2 ? 1U : 0U))
+            {
+                dip = host(rng() % (id + 1)); // out of order, from the second round on
+            }
+            else if (r < 5)
+            {
+                dip = rng(); // most likely not a host address
+            }
+            else
+            {
+                id += rng() % 3; // the same host, the next or one after a gap
+                dip = host(id);
+            }
+            uint32_t port = rng() % 8;
+            hosts.Add(dip, port);
+            plain.Add(dip, port);
+            ref[dip].push_back(port);
+            dips.push_back(dip + 1);
+            dips.push_back(host(id + 1 + rng() % 4));
+        }
+        Check(hosts, ref, dips);
+        Check(plain, ref, dips);
+        hosts.Clear();
+        plain.Clear();
+        Check(hosts, Routes(), dips);
+        Check(plain, Routes(), dips);
+        NS_TEST_ASSERT_MSG_EQ(hosts.GetNRuns(), 0, "runs after Clear");
+    }
+}
+
+/**
+ * @brief TestSuite for EcmpTable
+ */
+class EcmpTableTestSuite : public TestSuite
+{
+  public:
+    /**
+     * @brief Constructor
+     */
+    EcmpTableTestSuite();
+};
+
+EcmpTableTestSuite::EcmpTableTestSuite()
+    : TestSuite("ecmp-table", Type::UNIT)
+{
+    AddTestCase(new EcmpTableTest, TestCase::Duration::QUICK);
+}
+
+static EcmpTableTestSuite g_ecmpTableTestSuite; //!< The testsuite
+
+/**
+ * @brief Test that RdmaRxQpTable keeps the rx qps inserted, and grows and shrinks with them
+ *
+ * Rx qps of a few senders with many ports each, and of random senders, are
+ * inserted and erased at random while the table grows to thousands of records
+ * and shrinks back to none. Lookups are compared with an unordered_map, and
+ * walking the slots must find exactly the records alive at a load factor
+ * between 1/8 and 1/2, down to the minimum capacity.
+ */
+class RdmaRxQpTableTest : public TestCase
+{
+  public:
+    /**
+     * @brief Create the test
+     */
+    RdmaRxQpTableTest();
+
+    /**
+     * @brief Run the test
+     */
+    void DoRun() override;
+
+  private:
+    /**
+     * @brief Compare the whole table with the rx qps inserted
+     *
+     * @param table The table.
+     * @param ref The key of each rx qp alive to its ReceiverNextExpectedSeq.
+     */
+    void Check(RdmaRxQpTable& table, const std::unordered_map<uint64_t, uint32_t>& ref);
+};
+
+RdmaRxQpTableTest::RdmaRxQpTableTest()
+    : TestCase("RDMA rx qp table insert, erase and shrink")
+{
+}
+
+void
+RdmaRxQpTableTest::Check(RdmaRxQpTable& table, const std::unordered_map<uint64_t, uint32_t>& ref)
+{
+    NS_TEST_ASSERT_MSG_EQ(table.GetN(), ref.size(), "rx qps in the table");
+    uint32_t used = 0;
+    for (uint32_t i = 0; i < table.GetCapacity(); i++)
+    {
+        RdmaRxQueuePair& q = table.GetSlot(i);
+        if (!q.used)
+        {
+            continue;
+        }
+        used++;
+        auto it = ref.find(q.key);
+        NS_TEST_ASSERT_MSG_EQ((it != ref.end()), true, "rx qp " << q.key << " was erased");
+        NS_TEST_ASSERT_MSG_EQ(q.ReceiverNextExpectedSeq, it->second, "rx qp " << q.key);
+    }
+    NS_TEST_ASSERT_MSG_EQ(used, ref.size(), "used slots");
+    uint32_t capacity = table.GetCapacity();
+    NS_TEST_ASSERT_MSG_LT_OR_EQ(table.GetN() * 2, capacity, "load factor above 1/2");
+    if (capacity > RdmaRxQpTable::minCapacity)
+    {
+        NS_TEST_ASSERT_MSG_GT_OR_EQ(table.GetN() * 8, capacity / 2, "table did not shrink");
+    }
+}
+
+void
+RdmaRxQpTableTest::DoRun()
+{
+    RdmaRxQpTable table;
+    std::unordered_map<uint64_t, uint32_t> ref;
+    std::vector<uint64_t> keys; // of the rx qps alive, but the few erased by newKey
+    std::mt19937_64 rng(1);
+    auto newKey = [&]() {
+        // most from a few senders, which only differ in the low bits of the key
+        uint32_t dip = rng() % 4 ? 0x0b000001 + ((rng() % 4) << 8) : rng();
+        return RdmaRxQpTable::GetKey(dip, rng() % 4, rng() % 65536);
+    };
+    uint32_t maxCapacity = 0;
+    for (uint32_t phase = 0; phase < 4; phase++)
+    {
+        // growing, then shrinking to nothing
+        bool grow = phase % 2 == 0;
+        for (uint32_t i = 0; (grow && ref.size() < 20000) || (!grow && !ref.empty()); i++)
+        {
+            bool insert = ref.empty() || rng() % 10 < (grow ? 7U : 3U);
+            // erase an rx qp alive, or now and then one that may not be
+            bool alive = !insert && rng() % 8 != 0;
+            size_t idx = alive ? rng() % keys.size() : 0;
+            uint64_t key = alive ? keys[idx] : newKey();
+            if (alive)
+            {
+                keys[idx] = keys.back();
+                keys.pop_back();
+            }
+            if (insert)
+            {
+                bool inserted;
+                RdmaRxQueuePair* q = table.Insert(key, inserted);
+                NS_TEST_ASSERT_MSG_EQ(inserted, (ref.count(key) == 0), "insert of " << key);
+                NS_TEST_ASSERT_MSG_EQ(q->key, key, "record of " << key);
+                if (inserted)
+                {
+                    q->ReceiverNextExpectedSeq = rng();
+                    ref[key] = q->ReceiverNextExpectedSeq;
+                    keys.push_back(key);
+                }
+                NS_TEST_ASSERT_MSG_EQ(q->ReceiverNextExpectedSeq, ref[key], "record of " << key);
+            }
+            else
+            {
+                NS_TEST_ASSERT_MSG_EQ(table.Erase(key), (ref.erase(key) == 1), "erase of " << key);
+            }
+            // a key just erased or never inserted is not found, the others keep their record
+            RdmaRxQueuePair* q = table.Find(key);
+            NS_TEST_ASSERT_MSG_EQ((q != nullptr), (ref.count(key) == 1), "find of " << key);
+            if (i % 1000 == 0)
+            {
+                Check(table, ref);
+            }
+            maxCapacity = std::max(maxCapacity, table.GetCapacity());
+        }
+        Check(table, ref);
+    }
+    NS_TEST_ASSERT_MSG_GT_OR_EQ(maxCapacity, 40000U, "table did not grow");
+    NS_TEST_ASSERT_MSG_EQ(table.GetCapacity(), RdmaRxQpTable::minCapacity, "capacity when empty");
+
+    bool inserted;
+    table.Insert(newKey(), inserted);
+    table.Clear();
+    ref.clear();
+    Check(table, ref);
+    NS_TEST_ASSERT_MSG_EQ(table.GetCapacity(), RdmaRxQpTable::minCapacity, "capacity after Clear");
+}
+
+/**
+ * @brief TestSuite for RdmaRxQpTable
+ */
+class RdmaRxQpTableTestSuite : public TestSuite
+{
+  public:
+    /**
+     * @brief Constructor
+     */
+    RdmaRxQpTableTestSuite();
+};
+
+RdmaRxQpTableTestSuite::RdmaRxQpTableTestSuite()
+    : TestSuite("rdma-rx-qp-table", Type::UNIT)
+{
+    AddTestCase(new RdmaRxQpTableTest, TestCase::Duration::QUICK);
+}
+
+static RdmaRxQpTableTestSuite g_rdmaRxQpTableTestSuite; //!< The testsuite
+
+/**
+ * @brief Test the generation and ack accounting of RdmaCodingTx and RdmaCodingRx
+ *
+ * A sender sends one symbol per slot over a path that delays and loses
+ * symbols, to a receiver that acks every symbol and decodes a generation
+ * some slots after it becomes decodable, as bench-rdma-coding does. The
+ * sender must keep at most its window of generations open, send each the
+ * symbols it needs before any repair, and repair only undecoded ones; the
+ * receiver must find each generation decodable at exactly the symbols it
+ * needs; each ack must bring the sender's count of symbols received to the
+ * receiver's, and each generation must be acked decoded once, in any order,
+ * while the decoded bytes grow with the first undecoded generation.
+ */
+class RdmaCodingTest : public TestCase
+{
+  public:
+    /**
+     * @brief Create the test
+     */
+    RdmaCodingTest();
+
+    /**
+     * @brief Run the test
+     */
+    void DoRun() override;
+
+  private:
+    /**
+     * @brief Transfer a flow and check the accounting on the way
+     *
+     * @param window Generations open at a time.
+     * @param rtt Round trip in slots.
+     * @param decode Slots to decode a generation.
+     * @param loss Fraction of the symbols lost.
+     * @param repairs Set to the repair symbols sent.
+     */
+    void Run(uint32_t window, uint32_t rtt, uint32_t decode, double loss, uint64_t& repairs);
+
+    static const uint64_t size = 2000500;    //!< flow size, the last generation is short
+    static const uint32_t mtu = 1000;        //!< symbol size
+    static const uint32_t genSize = 32;      //!< source symbols per generation
+    static constexpr double overhead = 0.02; //!< reception overhead
+};
+
+RdmaCodingTest::RdmaCodingTest()
+    : TestCase("RDMA coding generations and acks")
+{
+}
+
+void
+RdmaCodingTest::Run(uint32_t window, uint32_t rtt, uint32_t decode, double loss, uint64_t& repairs)
+{
+    RdmaCodingTx tx(size, mtu, genSize, window, overhead);
+    RdmaCodingRx rx;
+    std::mt19937 rng(window * 1000 + rtt);
+    std::bernoulli_distribution lost(loss);
+    std::deque<std::pair<uint64_t, uint32_t>> data;    // arrival slot, seq
+    std::deque<std::pair<uint64_t, uint32_t>> acks;    // arrival slot, seq
+    std::deque<std::pair<uint64_t, uint32_t>> decodes; // end slot, generation
+    std::vector<uint32_t> rank(tx.m_nGen, 0);  // symbols received before decodable
+    std::vector<bool> acked(tx.m_nGen, false); // acked decoded
+    uint64_t received = 0;
+    uint64_t needed = 0;
+    for (uint32_t g = 0; g < tx.m_nGen; g++)
+    {
+        needed += RdmaCoding::GetNeeded(tx.GetK(g), overhead);
+    }
+
+    for (uint64_t t = 0; !tx.IsDone(); t++)
+    {
+        NS_TEST_ASSERT_MSG_LT(t, needed * 100, "flow not decoded with window " << window);
+        uint32_t base = tx.m_base;
+        uint32_t next = tx.m_next;
+        repairs = tx.m_repairs;
+        uint32_t seq = tx.NextSymbol();
+        uint32_t g = RdmaCoding::GetGeneration(seq);
+        NS_TEST_ASSERT_MSG_EQ(RdmaCoding::GetK(seq), tx.GetK(g), "k of generation " << g);
+        NS_TEST_ASSERT_MSG_GT_OR_EQ(g, base, "symbol of a decoded generation");
+        NS_TEST_ASSERT_MSG_LT_OR_EQ(g, next, "symbol of a generation not open");
+        NS_TEST_ASSERT_MSG_LT_OR_EQ(tx.m_next - tx.m_base, window, "generations open");
+        NS_TEST_ASSERT_MSG_EQ(tx.m_gens[g % window].decoded, false, "symbol of a decoded one");
+        if (tx.m_repairs > repairs)
+        {
+            // no generation is short of what it needs, and no new one may open
+            for (uint32_t i = tx.m_base; i < tx.m_next; i++)
+            {
+                NS_TEST_ASSERT_MSG_EQ(
+                    (tx.m_gens[i % window].decoded ||
+                     tx.m_gens[i % window].sent >=
+                         RdmaCoding::GetNeeded(tx.GetK(i), overhead)),
+                    true,
+                    "repair while generation " << i << " is short");
+            }
+            NS_TEST_ASSERT_MSG_EQ((tx.m_next == tx.m_nGen || tx.m_next - tx.m_base == window),
+                                  true,
+                                  "repair while the window has room");
+        }
+        if (!lost(rng))
+        {
+            data.emplace_back(t + rtt / 2, seq);
+        }
+
+        for (; !decodes.empty() && decodes.front().first <= t; decodes.pop_front())
+        {
+            rx.SetDecoded(decodes.front().second);
+            acks.emplace_back(t + rtt - rtt / 2, rx.GetAckSeq(decodes.front().second));
+        }
+        for (; !data.empty() && data.front().first <= t; data.pop_front())
+        {
+            seq = data.front().second;
+            g = RdmaCoding::GetGeneration(seq);
+            bool decodable = rank[g] == RdmaCoding::GetNeeded(tx.GetK(g), overhead);
+            RdmaCodingRx::Result res = rx.OnSymbol(seq, overhead);
+            received++;
+            if (decodable)
+            {
+                NS_TEST_ASSERT_MSG_EQ(res, RdmaCodingRx::RX_REDUNDANT, "symbol " << seq);
+            }
+            else if (++rank[g] < RdmaCoding::GetNeeded(tx.GetK(g), overhead))
+            {
+                NS_TEST_ASSERT_MSG_EQ(res, RdmaCodingRx::RX_RANK, "symbol " << seq);
+            }
+            else
+            {
+                NS_TEST_ASSERT_MSG_EQ(res, RdmaCodingRx::RX_DECODABLE, "symbol " << seq);
+                if (decode == 0)
+                {
+                    rx.SetDecoded(g);
+                }
+                else
+                {
+                    decodes.emplace_back(t + decode, g);
+                }
+            }
+            uint32_t ack = rx.GetAckSeq(g);
+            NS_TEST_ASSERT_MSG_EQ(RdmaCoding::GetAckGeneration(ack), g, "ack of " << seq);
+            NS_TEST_ASSERT_MSG_EQ(RdmaCoding::IsAckDecoded(ack), rx.IsDecoded(g), "ack of " << seq);
+            acks.emplace_back(t + rtt - rtt / 2, ack);
+        }
+        for (; !acks.empty() && acks.front().first <= t; acks.pop_front())
+        {
+            uint32_t ack = acks.front().second;
+            g = RdmaCoding::GetAckGeneration(ack);
+            uint64_t decodedBytes = tx.GetDecodedBytes();
+            bool newly = RdmaCoding::IsAckDecoded(ack) && !acked[g];
+            NS_TEST_ASSERT_MSG_EQ(tx.OnAck(ack), newly, "ack of generation " << g);
+            acked[g] = acked[g] || newly;
+            NS_TEST_ASSERT_MSG_EQ(tx.m_acked % RdmaCoding::maxK,
+                                  RdmaCoding::GetAckReceived(ack),
+                                  "symbols acked");
+            NS_TEST_ASSERT_MSG_LT_OR_EQ(tx.m_acked, received, "symbols acked");
+            NS_TEST_ASSERT_MSG_GT_OR_EQ(tx.GetDecodedBytes(), decodedBytes, "decoded bytes");
+            uint32_t first = std::find(acked.begin(), acked.end(), false) - acked.begin();
+            NS_TEST_ASSERT_MSG_EQ(tx.m_base, first, "first undecoded generation");
+        }
+    }
+    NS_TEST_ASSERT_MSG_EQ(tx.GetDecodedBytes(), size, "decoded bytes when done");
+    NS_TEST_ASSERT_MSG_EQ(tx.m_sent - tx.m_repairs, needed, "symbols sent but repairs");
+    NS_TEST_ASSERT_MSG_EQ((uint32_t)std::count(acked.begin(), acked.end(), true),
+                          tx.m_nGen,
+                          "generations acked decoded");
+    repairs = tx.m_repairs;
+}
+
+void
+RdmaCodingTest::DoRun()
+{
+    NS_TEST_ASSERT_MSG_EQ(RdmaCoding::GetNeeded(32, overhead), 33U, "needed of 32");
+    NS_TEST_ASSERT_MSG_EQ(RdmaCoding::GetNeeded(100, 0.01), 101U, "needed of 100");
+    uint32_t seq = RdmaCoding::GetSymbolSeq(12345, RdmaCoding::maxK);
+    NS_TEST_ASSERT_MSG_EQ(RdmaCoding::GetGeneration(seq), 12345U, "generation of a symbol");
+    NS_TEST_ASSERT_MSG_EQ(RdmaCoding::GetK(seq), RdmaCoding::maxK, "k of a symbol");
+    uint32_t ack = RdmaCoding::GetAckSeq(12345, true, RdmaCoding::maxK + 7);
+    NS_TEST_ASSERT_MSG_EQ(RdmaCoding::GetAckGeneration(ack), 12345U, "generation of an ack");
+    NS_TEST_ASSERT_MSG_EQ(RdmaCoding::IsAckDecoded(ack), true, "decoded flag of an ack");
+    NS_TEST_ASSERT_MSG_EQ(RdmaCoding::GetAckReceived(ack), 7U, "symbols of an ack");
+
+    // without loss or delay the sender sends exactly what decoding needs
+    uint64_t repairs;
+    Run(4, 0, 0, 0, repairs);
+    NS_TEST_ASSERT_MSG_EQ(repairs, 0U, "repairs without loss or delay");
+    for (uint32_t window : {1, 4, 16})
+    {
+        Run(window, 50, 0, 0, repairs);
+        Run(window, 50, 20, 0.01, repairs);
+        Run(window, 20, 5, 0.1, repairs);
+        NS_TEST_ASSERT_MSG_GT(repairs, 0U, "repairs of lost symbols");
+    }
+}
+
+/**
+ * @brief TestSuite for RdmaCodingTx and RdmaCodingRx
+ */
+class RdmaCodingTestSuite : public TestSuite
+{
+  public:
+    /**
+     * @brief Constructor
+     */
+    RdmaCodingTestSuite();
+};
+
+RdmaCodingTestSuite::RdmaCodingTestSuite()
+    : TestSuite("rdma-coding", Type::UNIT)
+{
+    AddTestCase(new RdmaCodingTest, TestCase::Duration::QUICK);
+}
+
+static RdmaCodingTestSuite g_rdmaCodingTestSuite; //!< The testsuite
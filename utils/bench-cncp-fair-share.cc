@@ -0,0 +1,162 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+// This program benchmarks the CNCP fair-share reallocation done when a flow
+// arrives at or expires from an egress port. It compares rescanning the flow
+// table (what SwitchNode::CNCPNotifyIngress used to do) with CncpPortShare,
+// for 10 to 'max-flows' flows on the port. Each step is one arrival followed
+// by one expiry, so the port keeps the same number of flows.
+// Sample usage:  ./ns3 run 'bench-cncp-fair-share --n=100000'
+
+#include "ns3/cncp-flow-table.h"
+#include "ns3/command-line.h"
+#include "ns3/system-wall-clock-ms.h"
+
+#include <algorithm>
+#include <deque>
+#include <iostream>
+#include <stdlib.h> // for exit ()
+
+using namespace ns3;
+
+static const uint64_t portRate = 100000000000ULL;
+
+static FlowKey
+MakeKey(uint32_t i)
+{
+    FlowKey key;
+    key.sip = 0x0b000001 + (i >> 12);
+    key.dip = 0x0b000101;
+    key.sport = 10000 + (i & 0xfff);
+    key.dport = 100;
+    key.protocol = 0x11;
+    key.priority_group = 3;
+    return key;
+}
+
+/// rescan the table on every arrival and expiry, as CNCPNotifyIngress used to
+static uint64_t
+benchScan(uint32_t flows, uint32_t n)
+{
+    CncpFlowTable t;
+    std::deque<uint32_t> alive;
+    uint32_t next = 0;
+    SystemWallClockMs time;
+    time.Start();
+    for (uint32_t step = 0; step < flows + n; step++)
+    {
+        bool inserted;
+        CncpFlowEntry* flow = t.Insert(MakeKey(next), inserted);
+        flow->egressDevIdx = 1;
+        alive.push_back(next++);
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < t.GetCapacity(); i++)
+        {
+            CncpFlowEntry& e = t.GetSlot(i);
+            count += e.used && e.egressDevIdx == 1;
+        }
+        for (uint32_t i = 0; i < t.GetCapacity(); i++)
+        {
+            CncpFlowEntry& e = t.GetSlot(i);
+            if (e.used && e.egressDevIdx == 1)
+            {
+                e.rateBase = portRate / count;
+            }
+        }
+        if (alive.size() > flows)
+        {
+            FlowKey key = MakeKey(alive.front());
+            alive.pop_front();
+            uint64_t rate = t.Find(key)->rateBase;
+            t.Erase(key);
+            for (uint32_t i = 0; i < t.GetCapacity(); i++)
+            {
+                CncpFlowEntry& e = t.GetSlot(i);
+                if (e.used && e.egressDevIdx == 1)
+                {
+                    e.rateBase += rate / (count - 1);
+                }
+            }
+        }
+        if (step + 1 == flows)
+        {
+            time.Start(); // only time the steady state
+        }
+    }
+    return time.End();
+}
+
+/// lazy fair share through CncpPortShare
+static uint64_t
+benchLazy(uint32_t flows, uint32_t n)
+{
+    CncpFlowTable t;
+    CncpPortShare port;
+    std::deque<uint32_t> alive;
+    uint32_t next = 0;
+    SystemWallClockMs time;
+    time.Start();
+    for (uint32_t step = 0; step < flows + n; step++)
+    {
+        bool inserted;
+        CncpFlowEntry* flow = t.Insert(MakeKey(next), inserted);
+        flow->egressDevIdx = 1;
+        if (port.Join(*flow, portRate))
+        {
+            for (uint32_t i = 0; i < t.GetCapacity(); i++)
+            {
+                if (t.GetSlot(i).used)
+                {
+                    port.Resync(t.GetSlot(i));
+                }
+            }
+        }
+        alive.push_back(next++);
+        if (alive.size() > flows)
+        {
+            FlowKey key = MakeKey(alive.front());
+            alive.pop_front();
+            port.Leave(*t.Find(key));
+            t.Erase(key);
+        }
+        if (step + 1 == flows)
+        {
+            time.Start(); // only time the steady state
+        }
+    }
+    return time.End();
+}
+
+int
+main(int argc, char* argv[])
+{
+    uint32_t n = 0;
+    uint32_t maxFlows = 10000;
+
+    CommandLine cmd(__FILE__);
+    cmd.Usage("Benchmark CNCP fair-share reallocation on flow arrival and expiry");
+    cmd.AddValue("n", "number of arrivals to time for each port size", n);
+    cmd.AddValue("max-flows", "largest number of flows on the port", maxFlows);
+    cmd.Parse(argc, argv);
+
+    if (n == 0)
+    {
+        std::cerr << "Error-- number of arrivals must be specified "
+                  << "by command-line argument --n=(number of arrivals)" << std::endl;
+        exit(1);
+    }
+
+    std::cout << "Running bench-cncp-fair-share with n=" << n << std::endl;
+    std::cout << "flows\tscan ns/arrival\tlazy ns/arrival" << std::endl;
+    for (uint32_t flows = 10; flows <= maxFlows; flows *= 10)
+    {
+        // the scan grows linearly with the port, keep its run time bounded
+        uint32_t scanN = std::max<uint32_t>(1, std::min<uint64_t>(n, 100000000ULL / flows));
+        double scan = benchScan(flows, scanN) * 1e6 / scanN;
+        double lazy = benchLazy(flows, n) * 1e6 / n;
+        std::cout << flows << "\t" << scan << "\t" << lazy << std::endl;
+    }
+
+    return 0;
+}
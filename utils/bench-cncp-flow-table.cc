@@ -0,0 +1,206 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+// This program benchmarks the per-packet CNCP flow state lookups done by
+// SwitchNode::CNCPNotifyIngress and SwitchNode::CNCPAdmitIngress. It compares
+// the former layout (one unordered_map per field) with CncpFlowTable (one
+// open-addressing table of cache-line sized entries), for 'flows' active flows
+// and 'n' packets spread uniformly over them.
+// Sample usage:  ./ns3 run 'bench-cncp-flow-table --flows=100000 --n=10000000'
+
+#include "ns3/cncp-flow-table.h"
+#include "ns3/command-line.h"
+#include "ns3/system-wall-clock-ms.h"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <stdlib.h> // for exit ()
+#include <unordered_map>
+#include <vector>
+
+using namespace ns3;
+
+static const uint64_t packetSize = 1000;
+static const uint64_t capacity = 10000;
+
+/// The eight per-flow tables SwitchNode used before CncpFlowTable
+struct LegacyTables
+{
+    std::unordered_map<FlowKey, uint64_t, FlowKeyHash> controlRate;
+    std::unordered_map<FlowKey, uint64_t, FlowKeyHash> ingressWindow;
+    std::unordered_map<FlowKey, uint64_t, FlowKeyHash> lastIngressPktTs;
+    std::unordered_map<FlowKey, uint64_t, FlowKeyHash> lastArrivalPktTs;
+    std::unordered_map<FlowKey, int64_t, FlowKeyHash> bytesOnNode;
+    std::unordered_map<FlowKey, uint64_t, FlowKeyHash> qv;
+    std::unordered_map<FlowKey, uint32_t, FlowKeyHash> egressDevIdx;
+    std::unordered_map<FlowKey, uint32_t, FlowKeyHash> prevHopDevIdx;
+};
+
+static std::vector<FlowKey> g_keys;
+static std::vector<uint32_t> g_trace;
+static uint64_t g_sink = 0;
+
+static FlowKey
+MakeKey(uint32_t i)
+{
+    FlowKey key;
+    key.sip = 0x0b000001 + (i >> 8);
+    key.dip = 0x0b000001 + (i & 0xff);
+    key.sport = 10000 + (i & 0xfff);
+    key.dport = 100 + (i >> 12);
+    key.protocol = 0x11;
+    key.priority_group = 3;
+    return key;
+}
+
+static void
+benchLegacy()
+{
+    LegacyTables t;
+    for (uint32_t i = 0; i < g_keys.size(); i++)
+    {
+        const FlowKey& key = g_keys[i];
+        t.controlRate[key] = 100000000000ULL / g_keys.size();
+        t.ingressWindow[key] = packetSize;
+        t.lastIngressPktTs[key] = 0;
+        t.lastArrivalPktTs[key] = 0;
+        t.bytesOnNode[key] = capacity;
+        t.qv[key] = capacity;
+        t.egressDevIdx[key] = i & 0xf;
+        t.prevHopDevIdx[key] = (i >> 4) & 0xf;
+    }
+    uint64_t now = 0;
+    for (uint32_t idx : g_trace)
+    {
+        const FlowKey& key = g_keys[idx];
+        now += 10;
+        // CNCPNotifyIngress: rate lookup and Q_u update
+        uint64_t rate = t.controlRate.find(key)->second;
+        uint64_t dt = now - t.lastArrivalPktTs[key];
+        int64_t& q_u = t.bytesOnNode[key];
+        q_u = std::min<int64_t>(std::max<int64_t>(q_u + (int64_t)(rate * dt / 8000000000ULL) -
+                                                      (int64_t)packetSize,
+                                                  0),
+                                capacity);
+        t.lastArrivalPktTs[key] = now;
+        // CNCPAdmitIngress: window refill and admission
+        rate = t.controlRate.find(key)->second;
+        dt = now - t.lastIngressPktTs[key];
+        uint64_t window = t.ingressWindow[key] + rate * dt / 8000000000ULL;
+        if (window >= packetSize)
+        {
+            t.ingressWindow[key] = window - packetSize;
+            t.lastIngressPktTs[key] = now;
+            g_sink++;
+        }
+    }
+}
+
+static void
+benchTable()
+{
+    CncpFlowTable t;
+    for (uint32_t i = 0; i < g_keys.size(); i++)
+    {
+        bool inserted;
+        CncpFlowEntry* e = t.Insert(g_keys[i], inserted);
+        e->rateBase = 100000000000ULL / g_keys.size();
+        e->ingressWindow = packetSize;
+        e->bytesOnNode = capacity;
+        e->qv = capacity;
+        e->egressDevIdx = i & 0xf;
+        e->prevHopDevIdx = (i >> 4) & 0xf;
+    }
+    uint64_t now = 0;
+    for (uint32_t idx : g_trace)
+    {
+        now += 10;
+        // CNCPNotifyIngress returns the entry that CNCPAdmitIngress then reuses
+        bool inserted;
+        CncpFlowEntry* e = t.Insert(g_keys[idx], inserted);
+        uint64_t dt = now - e->lastArrivalPktTs;
+        int64_t q_u = (int64_t)e->bytesOnNode +
+                      (int64_t)(e->rateBase * dt / 8000000000ULL) - (int64_t)packetSize;
+        e->bytesOnNode = std::min<int64_t>(std::max<int64_t>(q_u, 0), capacity);
+        e->lastArrivalPktTs = now;
+        dt = now - e->lastIngressPktTs;
+        uint64_t window = e->ingressWindow + e->rateBase * dt / 8000000000ULL;
+        if (window >= packetSize)
+        {
+            e->ingressWindow = window - packetSize;
+            e->lastIngressPktTs = now;
+            g_sink++;
+        }
+    }
+}
+
+static uint64_t
+runBenchOneIteration(void (*bench)())
+{
+    SystemWallClockMs time;
+    time.Start();
+    (*bench)();
+    uint64_t deltaMs = time.End();
+    return deltaMs;
+}
+
+static void
+runBench(void (*bench)(), uint32_t minIterations, const char* name)
+{
+    uint64_t minDelay = std::numeric_limits<uint64_t>::max();
+    for (uint32_t i = 0; i < minIterations; i++)
+    {
+        uint64_t delay = runBenchOneIteration(bench);
+        minDelay = std::min(minDelay, delay);
+    }
+    double nsPerPacket = minDelay * 1e6 / g_trace.size();
+    std::cout << nsPerPacket << " ns/packet"
+              << " (" << minDelay << " ms elapsed)\t" << name << std::endl;
+}
+
+int
+main(int argc, char* argv[])
+{
+    uint32_t flows = 100000;
+    uint32_t n = 0;
+    uint32_t minIterations = 1;
+
+    CommandLine cmd(__FILE__);
+    cmd.Usage("Benchmark CNCP per-flow state lookups");
+    cmd.AddValue("flows", "number of active flows on the switch", flows);
+    cmd.AddValue("n", "number of packets", n);
+    cmd.AddValue("min-iterations",
+                 "number of subiterations to minimize iteration time over",
+                 minIterations);
+    cmd.Parse(argc, argv);
+
+    if (n == 0 || flows == 0)
+    {
+        std::cerr << "Error-- number of packets and flows must be specified "
+                  << "by command-line arguments --n=(number of packets) --flows=(number of flows)"
+                  << std::endl;
+        exit(1);
+    }
+
+    for (uint32_t i = 0; i < flows; i++)
+    {
+        g_keys.push_back(MakeKey(i));
+    }
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<uint32_t> pick(0, flows - 1);
+    g_trace.resize(n);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        g_trace[i] = pick(rng);
+    }
+
+    std::cout << "Running bench-cncp-flow-table with flows=" << flows << " n=" << n << std::endl;
+    runBench(&benchLegacy, minIterations, "unordered_map per field");
+    runBench(&benchTable, minIterations, "CncpFlowTable");
+    std::cout << "admitted " << g_sink << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,216 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+// This program checks and benchmarks the CNCP rate update of SwitchNode.
+// First 'flows' flows of priority groups 0 to 3, of utility weights 1 to 4,
+// share one egress port of 100 Gbps for 'ticks' updates, the queue of the
+// port growing or draining by the bytes sent over or under its rate in each
+// update interval and each flow holding its share of the queue on the
+// switch, so the rates converge to the shares of their utilities, in
+// proportion to the weights for Log. This runs once with the
+// update in double, CncpUpdateKernel::NextRateDouble flow by flow, and once
+// in fixed point, CncpUpdateKernel::NextRates of the whole port, for the Log
+// utility and for AlphaFair: the rates both converge to must be the same.
+// Then the two are timed on 'n' updates of flows in random states.
+// Sample usage:  ./ns3 run 'bench-cncp-update --n=10000000'
+
+#include "ns3/cncp-update.h"
+#include "ns3/command-line.h"
+#include "ns3/system-wall-clock-ms.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+#include <stdlib.h> // for exit ()
+#include <vector>
+
+using namespace ns3;
+
+static const uint64_t portRate = 100000000000ULL;
+static const uint64_t interval = 1000; // ns
+
+struct Port
+{
+    std::vector<uint64_t> rate;
+    std::vector<uint32_t> qv;
+    std::vector<uint32_t> pe;
+    std::vector<uint32_t> qu;
+    std::vector<uint8_t> pg;
+    std::vector<uint64_t> cap;
+    int64_t queue; // bytes
+
+    Port(uint32_t flows)
+        : rate(flows, portRate / flows),
+          qv(flows, 0),
+          pe(flows, 0),
+          qu(flows, 0),
+          pg(flows),
+          cap(flows, portRate),
+          queue(0)
+    {
+        for (uint32_t i = 0; i < flows; i++)
+        {
+            pg[i] = i % 4;
+        }
+    }
+
+    /// the queue after one more interval at the current rates
+    void Account()
+    {
+        uint64_t sum = std::accumulate(rate.begin(), rate.end(), 0ULL);
+        queue = std::max<int64_t>(0, queue + ((int64_t)sum - (int64_t)portRate) / 8000000);
+        for (uint32_t i = 0; i < rate.size(); i++)
+        {
+            pe[i] = queue;
+            qu[i] = sum > 0 ? (double)queue * rate[i] / sum : 0;
+        }
+    }
+};
+
+/// \return the rates the port converges to, with the fixed-point kernel or not
+static std::vector<uint64_t>
+Converge(const CncpUpdateKernel& kernel, uint32_t flows, uint32_t ticks, bool fixedPoint)
+{
+    Port port(flows);
+    for (uint32_t t = 0; t < ticks; t++)
+    {
+        port.Account();
+        if (fixedPoint)
+        {
+            kernel.NextRates(flows,
+                             port.rate.data(),
+                             port.qv.data(),
+                             port.pe.data(),
+                             port.qu.data(),
+                             port.pg.data(),
+                             port.cap.data());
+            continue;
+        }
+        for (uint32_t i = 0; i < flows; i++)
+        {
+            uint64_t next =
+                kernel.NextRateDouble(port.rate[i], port.qv[i], port.pe[i], port.qu[i], port.pg[i]);
+            port.rate[i] = std::min(next, port.cap[i]);
+        }
+    }
+    return port.rate;
+}
+
+static void
+Check(const char* name, const CncpUpdateKernel& kernel, uint32_t flows, uint32_t ticks)
+{
+    std::vector<uint64_t> ref = Converge(kernel, flows, ticks, false);
+    std::vector<uint64_t> fixed = Converge(kernel, flows, ticks, true);
+    double maxDiff = 0;
+    for (uint32_t i = 0; i < flows; i++)
+    {
+        maxDiff = std::max(maxDiff, std::fabs((double)fixed[i] - ref[i]) / ref[i]);
+    }
+    std::cout << name << ":\tper group";
+    for (uint32_t g = 0; g < 4 && g < flows; g++)
+    {
+        std::cout << " " << ref[g] / 1e9;
+    }
+    std::cout << " Gbps, max difference " << maxDiff * 100 << " %" << std::endl;
+    if (maxDiff > 0.001)
+    {
+        std::cerr << "Error-- the rates in fixed point do not converge to those in double"
+                  << std::endl;
+        exit(1);
+    }
+}
+
+int
+main(int argc, char* argv[])
+{
+    uint32_t flows = 16;
+    uint32_t ticks = 20000;
+    uint32_t n = 10000000;
+
+    CommandLine cmd(__FILE__);
+    cmd.Usage("Check and benchmark the CNCP rate update in fixed point");
+    cmd.AddValue("flows", "number of flows on the port", flows);
+    cmd.AddValue("ticks", "number of updates to converge", ticks);
+    cmd.AddValue("n", "number of flow updates to time", n);
+    cmd.Parse(argc, argv);
+
+    std::cout << "Running bench-cncp-update with flows=" << flows << " ticks=" << ticks
+              << " n=" << n << std::endl;
+
+    // a smaller step and larger utility than the default, for the port to converge quickly
+    std::array<double, CncpUpdateKernel::pgCnt> weights = {1, 2, 3, 4, 1, 1, 1, 1};
+    CncpUpdateKernel log;
+    log.Configure(150, 1000000000000000, interval, 1.1, CncpUpdateKernel::Log, 1, 1000000000, weights);
+    Check("Log", log, flows, ticks);
+    CncpUpdateKernel alpha;
+    alpha.Configure(150,
+                    1000000000000000,
+                    interval,
+                    1.1,
+                    CncpUpdateKernel::AlphaFair,
+                    2,
+                    1000000000,
+                    weights);
+    Check("AlphaFair 2", alpha, flows, ticks);
+
+    // random states of 4096 flows, updated n / 4096 times
+    uint32_t batch = 4096;
+    Port port(batch);
+    uint32_t x = 12345;
+    for (uint32_t i = 0; i < batch; i++)
+    {
+        x = x * 1103515245 + 12345;
+        port.rate[i] = (uint64_t)(x >> 8) * 5000 + 1000000;
+        x = x * 1103515245 + 12345;
+        port.qv[i] = (x >> 8) % 10000;
+        port.pe[i] = (x >> 4) % 100000;
+        port.qu[i] = (x >> 16) % 10000;
+    }
+    std::vector<uint64_t> start = port.rate;
+    uint32_t rounds = std::max<uint32_t>(1, n / batch);
+    SystemWallClockMs time;
+    time.Start();
+    for (uint32_t r = 0; r < rounds; r++)
+    {
+        for (uint32_t i = 0; i < batch; i++)
+        {
+            uint64_t next =
+                log.NextRateDouble(start[i], port.qv[i], port.pe[i], port.qu[i], port.pg[i]);
+            port.rate[i] = std::min(next, port.cap[i]);
+        }
+    }
+    uint64_t doubleMs = time.End();
+    std::vector<uint64_t> ref = port.rate;
+    time.Start();
+    for (uint32_t r = 0; r < rounds; r++)
+    {
+        std::copy(start.begin(), start.end(), port.rate.begin());
+        log.NextRates(batch,
+                      port.rate.data(),
+                      port.qv.data(),
+                      port.pe.data(),
+                      port.qu.data(),
+                      port.pg.data(),
+                      port.cap.data());
+    }
+    uint64_t fixedMs = time.End();
+    for (uint32_t i = 0; i < batch; i++)
+    {
+        // the double may round the whole number it computes down by one
+        if (port.rate[i] > ref[i] + 1 || ref[i] > port.rate[i] + 1)
+        {
+            std::cerr << "Error-- the updates of flow " << i << " differ" << std::endl;
+            exit(1);
+        }
+    }
+
+    uint64_t updates = (uint64_t)rounds * batch;
+    std::cout << doubleMs << " ms, " << updates / 1e3 / std::max<uint64_t>(doubleMs, 1)
+              << " M updates/s\tNextRateDouble per flow" << std::endl;
+    std::cout << fixedMs << " ms, " << updates / 1e3 / std::max<uint64_t>(fixedMs, 1)
+              << " M updates/s\tNextRates in fixed point" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,214 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+// This program benchmarks the forwarding tables of a k-ary fat-tree, hosts
+// first and then the edge, aggregation and core switches, filled with the
+// routes of RouteCalculator. It compares the former
+// std::unordered_map<uint32_t, std::vector<int>> per node with EcmpTable:
+// memory (resident set growth while filling), then the next hops of every
+// node towards every host are checked to be the same, then the rate of
+// lookups of random (node, destination) pairs.
+// Sample usage:  ./ns3 run 'bench-ecmp-table --k=16 --n=10000000'
+
+#include "ns3/command-line.h"
+#include "ns3/ecmp-table.h"
+#include "ns3/route-calculator.h"
+#include "ns3/switch-node.h"
+#include "ns3/system-wall-clock-ms.h"
+
+#include <fstream>
+#include <iostream>
+#include <stdlib.h> // for exit ()
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+using namespace ns3;
+
+typedef std::unordered_map<uint32_t, std::vector<int>> LegacyTable;
+
+static std::vector<Ipv4Address> addresses;
+static std::vector<LegacyTable>* legacyTables;
+static std::vector<EcmpTable>* ecmpTables;
+
+static void
+AddLegacy(uint32_t node, uint32_t dst, uint32_t ifIndex)
+{
+    (*legacyTables)[node][addresses[dst].Get()].push_back(ifIndex);
+}
+
+static void
+AddEcmp(uint32_t node, uint32_t dst, uint32_t ifIndex)
+{
+    (*ecmpTables)[node].Add(addresses[dst].Get(), ifIndex);
+}
+
+static void
+Ignore(uint32_t node, uint32_t dst, uint32_t ifIndex)
+{
+}
+
+static uint64_t
+ResidentBytes()
+{
+    std::ifstream statm("/proc/self/statm");
+    uint64_t size = 0;
+    uint64_t resident = 0;
+    statm >> size >> resident;
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+int
+main(int argc, char* argv[])
+{
+    uint32_t k = 16;
+    uint32_t n = 10000000;
+
+    CommandLine cmd(__FILE__);
+    cmd.Usage("Benchmark ECMP forwarding tables of a fat-tree");
+    cmd.AddValue("k", "fat-tree arity", k);
+    cmd.AddValue("n", "number of lookups", n);
+    cmd.Parse(argc, argv);
+
+    uint32_t hosts = k * k * k / 4;
+    uint32_t switches = 5 * k * k / 4;
+    std::cout << "Running bench-ecmp-table with k=" << k << " (" << hosts << " hosts, "
+              << switches << " switches) n=" << n << std::endl;
+
+    NodeContainer nodes;
+    for (uint32_t i = 0; i < hosts; i++)
+    {
+        nodes.Add(CreateObject<Node>());
+        addresses.push_back(Ipv4Address(0x0b000001 + (i << 8)));
+    }
+    for (uint32_t i = 0; i < switches; i++)
+    {
+        nodes.Add(CreateObject<SwitchNode>());
+    }
+    RouteCalculator calc;
+    calc.SetNodes(nodes, addresses);
+    std::vector<uint32_t> nIf(nodes.GetN(), 1);
+    auto link = [&](uint32_t a, uint32_t b) {
+        calc.AddInterface(a, b, nIf[a]++, 1000, 100000000000);
+        calc.AddInterface(b, a, nIf[b]++, 1000, 100000000000);
+    };
+    uint32_t edge0 = hosts;
+    uint32_t agg0 = edge0 + k * k / 2;
+    uint32_t core0 = agg0 + k * k / 2;
+    for (uint32_t i = 0; i < hosts; i++)
+    {
+        link(i, edge0 + i / (k / 2));
+    }
+    for (uint32_t pod = 0; pod < k; pod++)
+    {
+        for (uint32_t e = 0; e < k / 2; e++)
+        {
+            for (uint32_t a = 0; a < k / 2; a++)
+            {
+                link(edge0 + pod * k / 2 + e, agg0 + pod * k / 2 + a);
+            }
+        }
+        for (uint32_t a = 0; a < k / 2; a++)
+        {
+            for (uint32_t c = 0; c < k / 2; c++)
+            {
+                link(agg0 + pod * k / 2 + a, core0 + a * k / 2 + c);
+            }
+        }
+    }
+
+    // allocate the host pair delays of RouteCalculator before measuring
+    calc.ComputeRoutes(MakeCallback(&Ignore));
+
+    Ptr<EcmpGroupPool> groups = Create<EcmpGroupPool>();
+    std::vector<EcmpTable> ecmp(nodes.GetN(), EcmpTable(groups, 0x0b000001, 8));
+    ecmpTables = &ecmp;
+    uint64_t rss = ResidentBytes();
+    SystemWallClockMs time;
+    time.Start();
+    calc.ComputeRoutes(MakeCallback(&AddEcmp));
+    uint64_t ecmpFill = time.End();
+    uint64_t ecmpBytes = ResidentBytes() - rss;
+
+    std::vector<LegacyTable> legacy(nodes.GetN());
+    legacyTables = &legacy;
+    rss = ResidentBytes();
+    time.Start();
+    calc.ComputeRoutes(MakeCallback(&AddLegacy));
+    uint64_t legacyFill = time.End();
+    uint64_t legacyBytes = ResidentBytes() - rss;
+
+    uint64_t runs = 0;
+    for (uint32_t i = 0; i < nodes.GetN(); i++)
+    {
+        runs += ecmp[i].GetNRuns();
+        for (uint32_t j = 0; j < hosts; j++)
+        {
+            uint32_t dip = addresses[j].Get();
+            auto it = legacy[i].find(dip);
+            uint32_t nHops;
+            const uint32_t* hops = ecmp[i].Lookup(dip, nHops);
+            if (it == legacy[i].end() ? nHops != 0
+                                      : !std::equal(it->second.begin(),
+                                                    it->second.end(),
+                                                    hops,
+                                                    hops + nHops))
+            {
+                std::cerr << "Error-- next hops of node " << i << " towards host " << j
+                          << " differ" << std::endl;
+                exit(1);
+            }
+        }
+    }
+
+    // the same pseudo-random pairs for both
+    std::vector<std::pair<uint32_t, uint32_t>> pairs(1 << 16);
+    uint32_t x = 12345;
+    for (auto& p : pairs)
+    {
+        x = x * 1103515245 + 12345;
+        p.first = (x >> 8) % nodes.GetN();
+        x = x * 1103515245 + 12345;
+        p.second = addresses[(x >> 8) % hosts].Get();
+    }
+    uint64_t sum = 0;
+    time.Start();
+    for (uint32_t i = 0; i < n; i++)
+    {
+        auto& p = pairs[i & (pairs.size() - 1)];
+        auto it = legacy[p.first].find(p.second);
+        if (it != legacy[p.first].end())
+        {
+            sum += it->second[i % it->second.size()];
+        }
+    }
+    uint64_t legacyLookup = time.End();
+    time.Start();
+    for (uint32_t i = 0; i < n; i++)
+    {
+        auto& p = pairs[i & (pairs.size() - 1)];
+        uint32_t nHops;
+        const uint32_t* hops = ecmp[p.first].Lookup(p.second, nHops);
+        if (nHops > 0)
+        {
+            sum -= hops[i % nHops];
+        }
+    }
+    uint64_t ecmpLookup = time.End();
+    if (sum != 0)
+    {
+        std::cerr << "Error-- lookups differ" << std::endl;
+        exit(1);
+    }
+
+    std::cout << legacyBytes / 1048576.0 << " MB, filled in " << legacyFill << " ms, "
+              << n / 1e3 / std::max<uint64_t>(legacyLookup, 1) << " M lookups/s"
+              << "\tstd::unordered_map<uint32_t, std::vector<int>>" << std::endl;
+    std::cout << ecmpBytes / 1048576.0 << " MB, filled in " << ecmpFill << " ms, "
+              << n / 1e3 / std::max<uint64_t>(ecmpLookup, 1) << " M lookups/s"
+              << "\tEcmpTable (" << groups->GetNGroups() << " groups, " << runs << " runs)"
+              << std::endl;
+
+    return 0;
+}
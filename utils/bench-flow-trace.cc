@@ -0,0 +1,119 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+// This program benchmarks loading a flow trace of n random flows. It compares
+// the former iostream parsing of the text trace with FlowTraceReader on the
+// same text trace and on its binary conversion. The trace files are written to
+// the current directory and removed afterwards.
+// Sample usage:  ./ns3 run 'bench-flow-trace --n=10000000'
+
+#include "ns3/command-line.h"
+#include "ns3/flow-trace.h"
+#include "ns3/system-wall-clock-ms.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdlib.h> // for exit ()
+
+using namespace ns3;
+
+static const char* textPath = "bench-flow-trace.txt";
+static const char* binPath = "bench-flow-trace.bin";
+
+static void
+WriteText(uint32_t n)
+{
+    FILE* f = fopen(textPath, "w");
+    fprintf(f, "%u\n", n);
+    double t = 2.0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        t += 1e-9 * (rand() % 1000);
+        uint32_t src = rand() % 1024;
+        uint32_t dst = (src + 1 + rand() % 1023) % 1024;
+        fprintf(f, "%u %u 3 100 %u %.9f\n", src, dst, 1000 + rand() % 1000000, t);
+    }
+    fclose(f);
+}
+
+// the former ReadFlowInput of third.cc
+static uint64_t
+LoadIostream()
+{
+    std::ifstream flowf(textPath);
+    uint32_t n;
+    flowf >> n;
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint32_t src, dst, pg, dport, size;
+        double start;
+        flowf >> src >> dst >> pg >> dport >> size >> start;
+        sum += size + Seconds(start).GetTimeStep();
+    }
+    return sum;
+}
+
+static uint64_t
+LoadReader(const char* path)
+{
+    FlowTraceReader reader;
+    reader.Open(path);
+    FlowTraceRecord r;
+    uint64_t sum = 0;
+    while (reader.Read(r))
+    {
+        sum += r.size + r.start.GetTimeStep();
+    }
+    return sum;
+}
+
+int
+main(int argc, char* argv[])
+{
+    uint32_t n = 0;
+
+    CommandLine cmd(__FILE__);
+    cmd.Usage("Benchmark loading of text and binary flow traces");
+    cmd.AddValue("n", "number of flows", n);
+    cmd.Parse(argc, argv);
+
+    if (n == 0)
+    {
+        std::cerr << "Error-- number of flows must be specified "
+                  << "by command-line argument --n=(number of flows)" << std::endl;
+        exit(1);
+    }
+
+    std::cout << "Running bench-flow-trace with n=" << n << std::endl;
+    WriteText(n);
+    SystemWallClockMs time;
+    time.Start();
+    uint64_t a = LoadIostream();
+    uint64_t iostream = time.End();
+    time.Start();
+    uint64_t b = LoadReader(textPath);
+    uint64_t text = time.End();
+    time.Start();
+    FlowTraceReader::ConvertToBinary(textPath, binPath);
+    uint64_t convert = time.End();
+    time.Start();
+    uint64_t c = LoadReader(binPath);
+    uint64_t bin = time.End();
+    remove(textPath);
+    remove(binPath);
+    if (a != b || a != c)
+    {
+        std::cerr << "Error-- the readers disagree" << std::endl;
+        exit(1);
+    }
+
+    std::cout << iostream << " ms\tiostream text" << std::endl;
+    std::cout << text << " ms\tFlowTraceReader text" << std::endl;
+    std::cout << convert << " ms\tconversion to binary" << std::endl;
+    std::cout << bin << " ms\tFlowTraceReader binary" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,143 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+// This program benchmarks the packet trace of QbbHelper, n records after a
+// SimSetting. It compares the former TraceFormat::Serialize of every event
+// with PacketTraceWriter, then TraceFormat::Deserialize of every record with
+// PacketTraceReader. The trace files are written to the current directory and
+// removed afterwards.
+// Sample usage:  ./ns3 run 'bench-packet-trace --n=10000000'
+
+#include "ns3/command-line.h"
+#include "ns3/packet-trace.h"
+#include "ns3/sim-setting.h"
+#include "ns3/system-wall-clock-ms.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdlib.h> // for exit ()
+
+using namespace ns3;
+
+static const char* legacyPath = "bench-packet-trace-legacy.tr";
+static const char* writerPath = "bench-packet-trace.tr";
+
+static void
+MakeRecord(TraceFormat& tr, uint32_t i)
+{
+    memset(&tr, 0, sizeof(tr));
+    tr.time = 2000000000 + i * 80;
+    tr.node = i % 320;
+    tr.intf = i % 16;
+    tr.qidx = 3;
+    tr.qlen = i % 100000;
+    tr.sip = 0x0b000001 + ((i % 1024) << 8);
+    tr.dip = 0x0b000001 + (((i + 1) % 1024) << 8);
+    tr.size = 1048;
+    tr.l3Prot = 0x11;
+    tr.event = i % 4;
+    tr.data.sport = 10000 + i % 1000;
+    tr.data.dport = 100;
+    tr.data.seq = i * 1000;
+    tr.data.payload = 1000;
+}
+
+static void
+WriteSetting(FILE* f)
+{
+    SimSetting setting;
+    setting.port_speed[0][1] = 100000000000;
+    setting.win = 100000;
+    setting.Serialize(f);
+}
+
+static uint64_t
+Sum(const TraceFormat& tr)
+{
+    return tr.time + tr.node + tr.qlen + tr.data.seq;
+}
+
+int
+main(int argc, char* argv[])
+{
+    uint32_t n = 10000000;
+
+    CommandLine cmd(__FILE__);
+    cmd.Usage("Benchmark writing and reading the packet trace");
+    cmd.AddValue("n", "number of records", n);
+    cmd.Parse(argc, argv);
+
+    std::cout << "Running bench-packet-trace with n=" << n << " (" << sizeof(TraceFormat)
+              << " bytes per record)" << std::endl;
+    SystemWallClockMs time;
+
+    FILE* f = fopen(legacyPath, "w");
+    WriteSetting(f);
+    time.Start();
+    for (uint32_t i = 0; i < n; i++)
+    {
+        TraceFormat tr;
+        MakeRecord(tr, i);
+        tr.Serialize(f);
+    }
+    fclose(f);
+    uint64_t legacyWrite = time.End();
+
+    f = fopen(writerPath, "w");
+    WriteSetting(f);
+    time.Start();
+    {
+        PacketTraceWriter writer(f);
+        for (uint32_t i = 0; i < n; i++)
+        {
+            MakeRecord(writer.Append(), i);
+        }
+    }
+    fclose(f);
+    uint64_t writerWrite = time.End();
+
+    time.Start();
+    f = fopen(legacyPath, "r");
+    SimSetting setting;
+    setting.Deserialize(f);
+    uint64_t a = 0;
+    uint32_t na = 0;
+    TraceFormat tr;
+    while (tr.Deserialize(f) > 0)
+    {
+        a += Sum(tr);
+        na++;
+    }
+    fclose(f);
+    uint64_t legacyRead = time.End();
+
+    time.Start();
+    PacketTraceReader reader;
+    reader.Open(writerPath, setting);
+    uint64_t b = 0;
+    uint32_t nb = 0;
+    while (reader.Read(tr))
+    {
+        b += Sum(tr);
+        nb++;
+    }
+    reader.Close();
+    uint64_t readerRead = time.End();
+
+    remove(legacyPath);
+    remove(writerPath);
+    if (a != b || na != n || nb != n || setting.win != 100000)
+    {
+        std::cerr << "Error-- the traces differ" << std::endl;
+        exit(1);
+    }
+
+    std::cout << legacyWrite << " ms\tTraceFormat::Serialize per record" << std::endl;
+    std::cout << writerWrite << " ms\tPacketTraceWriter" << std::endl;
+    std::cout << legacyRead << " ms\tTraceFormat::Deserialize per record" << std::endl;
+    std::cout << readerRead << " ms\tPacketTraceReader" << std::endl;
+
+    return 0;
+}
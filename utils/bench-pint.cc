@@ -0,0 +1,201 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+// This program benchmarks the HPCC-PINT work of SwitchNode::SwitchNotifyDequeue,
+// the estimate of the utilization of the port and its encoding, on 'n'
+// dequeues from random port states. It compares the former path (log2() in
+// log2apprx, pow() for each term, log2() of the constants on every packet,
+// rand(), and log() and pow() in Pint::encode_u) with PintEstimator and the
+// table-driven Pint::encode_u. The estimates must agree within 'tolerance'
+// and, for the same random draw, the encodings must agree on all but a
+// fraction 'tolerance' of the dequeues.
+// Sample usage:  ./ns3 run 'bench-pint --n=10000000'
+
+#include "ns3/command-line.h"
+#include "ns3/pint.h"
+#include "ns3/system-wall-clock-ms.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdlib.h> // for exit ()
+#include <vector>
+
+using namespace ns3;
+
+static const uint64_t maxRtt = 9000;
+
+struct State
+{
+    uint32_t port;
+    uint64_t dt;
+    uint64_t qlen;
+    uint32_t lastPktSize;
+    double u;
+    uint16_t rnd;
+};
+
+static const uint64_t portBytesPerSecond[3] = {3125000000, 12500000000, 50000000000};
+
+/// the former SwitchNode::logres_shift(20, 20)
+static const int legacySft = 15;
+
+/// the former SwitchNode::log2apprx(x, 20, 16, 20)
+static int
+LegacyLog2Apprx(int x)
+{
+    int x0 = x;
+    int msb = int(log2(x)) + 1;
+    if (msb > 16)
+    {
+        x = (x >> (msb - 16) << (msb - 16));
+        int mask = (1 << (msb - 16)) - 1;
+        if ((x0 & mask) > (rand() & mask))
+        {
+            x += 1 << (msb - 16);
+        }
+    }
+    return int(log2(x) * (1 << legacySft));
+}
+
+/// the former estimate of SwitchNode::SwitchNotifyDequeue
+static double
+LegacyEstimate(const State& s)
+{
+    uint64_t B = portBytesPerSecond[s.port];
+    double fct = 1 << legacySft;
+    double log_T = log2(maxRtt) * fct;
+    double log_B = log2(B) * fct;
+    double log_1e9 = log2(1e9) * fct;
+    double qterm = 0;
+    double byteTerm = 0;
+    double uTerm = 0;
+    if ((s.qlen >> 8) > 0)
+    {
+        int log_dt = LegacyLog2Apprx(s.dt);
+        int log_qlen = LegacyLog2Apprx(s.qlen >> 8);
+        qterm = pow(2, (log_dt + log_qlen + log_1e9 - log_B - 2 * log_T) / fct) * 256;
+    }
+    if (s.lastPktSize > 0)
+    {
+        int log_byte = LegacyLog2Apprx(s.lastPktSize);
+        byteTerm = pow(2, (log_byte + log_1e9 - log_B - log_T) / fct);
+    }
+    if (maxRtt > s.dt && s.u > 0)
+    {
+        int log_T_dt = LegacyLog2Apprx(maxRtt - s.dt);
+        int log_u = LegacyLog2Apprx(int(round(s.u * 8192)));
+        uTerm = pow(2, (log_T_dt + log_u - log_T) / fct) / 8192;
+    }
+    return qterm + byteTerm + uTerm;
+}
+
+/// the former Pint::encode_u, with the draw of rand() % 65536 given
+static uint16_t
+LegacyEncode(double u, uint16_t rnd)
+{
+    uint32_t u_toInt = ceil(u * Pint::max_concurrent);
+    if (u_toInt == 0)
+    {
+        u_toInt = 1;
+    }
+    double power = log(u_toInt) * Pint::log_factor;
+    uint16_t p_upper = ceil(power);
+    uint16_t p_lower = floor(power);
+    double upper = pow(Pint::log_base, p_upper);
+    double lower = pow(Pint::log_base, p_lower);
+    if (p_upper == p_lower)
+    {
+        upper *= Pint::log_base;
+    }
+    return (rnd < (u_toInt - lower) / (upper - lower) * 65536) ? p_upper : p_lower;
+}
+
+int
+main(int argc, char* argv[])
+{
+    uint32_t n = 10000000;
+    double tolerance = 0.001;
+
+    CommandLine cmd(__FILE__);
+    cmd.Usage("Benchmark the HPCC-PINT estimate and encoding of a switch dequeue");
+    cmd.AddValue("n", "number of dequeues", n);
+    cmd.AddValue("tolerance",
+                 "max relative error of the estimates, and fraction of mismatched encodings",
+                 tolerance);
+    cmd.Parse(argc, argv);
+
+    std::cout << "Running bench-pint with n=" << n << std::endl;
+
+    // the same pseudo-random port states for both
+    std::vector<State> states(1 << 16);
+    uint32_t x = 12345;
+    for (auto& s : states)
+    {
+        x = x * 1103515245 + 12345;
+        s.port = (x >> 8) % 3;
+        x = x * 1103515245 + 12345;
+        s.dt = 1 + (x >> 8) % (maxRtt + 1000);
+        s.dt = std::min(s.dt, maxRtt);
+        x = x * 1103515245 + 12345;
+        s.qlen = (x >> 8) % 10 < 3 ? 0 : (x >> 4) % 2000000;
+        x = x * 1103515245 + 12345;
+        s.lastPktSize = (x >> 8) % 4 == 0 ? 0 : 64 + (x >> 12) % 1000;
+        x = x * 1103515245 + 12345;
+        s.u = (x >> 8) % 8 == 0 ? 0 : (x >> 12) % 1500 / 1000.0;
+        x = x * 1103515245 + 12345;
+        s.rnd = x >> 16;
+    }
+    std::vector<PintEstimator> ports(3);
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        ports[i].Configure(maxRtt, portBytesPerSecond[i]);
+    }
+    PintRng rng(1);
+
+    double maxError = 0;
+    uint32_t mismatches = 0;
+    for (auto& s : states)
+    {
+        double legacy = LegacyEstimate(s);
+        double u = ports[s.port].Estimate(s.dt, s.qlen, s.lastPktSize, s.u, rng);
+        maxError = std::max(maxError, std::fabs(u - legacy) / std::max(legacy, 1e-9));
+        mismatches += LegacyEncode(legacy, s.rnd) != Pint::encode_u(legacy, s.rnd);
+    }
+    double mismatchRate = (double)mismatches / states.size();
+    if (maxError > tolerance || mismatchRate > tolerance)
+    {
+        std::cerr << "Error-- max relative error " << maxError << ", encodings mismatched "
+                  << mismatchRate << std::endl;
+        exit(1);
+    }
+
+    SystemWallClockMs time;
+    uint64_t legacySum = 0;
+    time.Start();
+    for (uint32_t i = 0; i < n; i++)
+    {
+        State& s = states[i & (states.size() - 1)];
+        legacySum += LegacyEncode(LegacyEstimate(s), rand() % 65536);
+    }
+    uint64_t legacyMs = time.End();
+    uint64_t newSum = 0;
+    time.Start();
+    for (uint32_t i = 0; i < n; i++)
+    {
+        State& s = states[i & (states.size() - 1)];
+        double u = ports[s.port].Estimate(s.dt, s.qlen, s.lastPktSize, s.u, rng);
+        newSum += Pint::encode_u(u, rng.Next() & 0xffff);
+    }
+    uint64_t newMs = time.End();
+
+    std::cout << "max relative error " << maxError << ", encodings mismatched " << mismatchRate
+              << std::endl;
+    std::cout << legacyMs * 1e6 / n << " ns/dequeue, mean power " << (double)legacySum / n
+              << "\tlog2(), pow(), rand()" << std::endl;
+    std::cout << newMs * 1e6 / n << " ns/dequeue, mean power " << (double)newSum / n
+              << "\tPintEstimator and tables" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,157 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+// This program measures the redundant traffic of the generation mode of the
+// coding transport: a sender drives RdmaCodingTx at one symbol per slot over
+// a path of 'rtt' slots that loses a fraction 'loss' of the symbols, and a
+// receiver feeds RdmaCodingRx and acks every symbol, 'decode' slots after a
+// generation becomes decodable for the one that decodes it. For each window
+// of open generations it reports the symbols sent against those decoding
+// needs, the symbols received once their generation was decodable already,
+// and the goodput in source symbols per slot. Without loss or delay the
+// sender must send exactly what decoding needs.
+// Sample usage:  ./ns3 run 'bench-rdma-coding --size=10000000 --loss=0.01'
+
+#include "ns3/command-line.h"
+#include "ns3/pint.h"
+#include "ns3/rdma-queue-pair.h"
+
+#include <deque>
+#include <iostream>
+#include <stdlib.h> // for exit ()
+#include <utility>
+
+using namespace ns3;
+
+struct Result
+{
+    uint64_t sent;
+    uint64_t needed;
+    uint64_t received;
+    uint64_t redundant;
+    uint64_t slots;
+    uint64_t source;
+};
+
+static Result
+Run(uint64_t size,
+    uint32_t mtu,
+    uint32_t genSize,
+    uint32_t window,
+    double overhead,
+    uint32_t rtt,
+    uint32_t decode,
+    double loss)
+{
+    RdmaCodingTx tx(size, mtu, genSize, window, overhead);
+    RdmaCodingRx rx;
+    PintRng rng(1);
+    uint32_t lossThresh = loss * 4294967296.0 < 4294967295.0 ? loss * 4294967296.0 : 4294967295U;
+    uint32_t toRx = rtt / 2;
+    uint32_t toTx = rtt - toRx;
+    std::deque<std::pair<uint64_t, uint32_t>> data; // arrival slot, seq
+    std::deque<std::pair<uint64_t, uint32_t>> acks;
+    std::deque<std::pair<uint64_t, uint32_t>> decodes; // end slot, generation
+
+    Result r = {0, 0, 0, 0, 0, 0};
+    for (uint32_t g = 0; g < tx.m_nGen; g++)
+    {
+        r.needed += RdmaCoding::GetNeeded(tx.GetK(g), overhead);
+        r.source += tx.GetK(g);
+    }
+    uint64_t t = 0;
+    for (; !tx.IsDone(); t++)
+    {
+        if (t > r.needed * 1000 + 1000000)
+        {
+            std::cerr << "Error-- window " << window << ": " << tx.m_base << " of " << tx.m_nGen
+                      << " generations decoded after " << t << " slots" << std::endl;
+            exit(1);
+        }
+        // one symbol per slot, then what arrives within the slot
+        uint32_t sent = tx.NextSymbol();
+        if (rng.Next() >= lossThresh)
+        {
+            data.emplace_back(t + toRx, sent);
+        }
+        for (; !decodes.empty() && decodes.front().first <= t; decodes.pop_front())
+        {
+            rx.SetDecoded(decodes.front().second);
+            acks.emplace_back(t + toTx, rx.GetAckSeq(decodes.front().second));
+        }
+        for (; !data.empty() && data.front().first <= t; data.pop_front())
+        {
+            uint32_t seq = data.front().second;
+            uint32_t g = RdmaCoding::GetGeneration(seq);
+            RdmaCodingRx::Result res = rx.OnSymbol(seq, overhead);
+            r.received++;
+            if (res == RdmaCodingRx::RX_DECODABLE && decode == 0)
+            {
+                rx.SetDecoded(g);
+            }
+            else if (res == RdmaCodingRx::RX_DECODABLE)
+            {
+                decodes.emplace_back(t + decode, g);
+            }
+            else if (res == RdmaCodingRx::RX_REDUNDANT)
+            {
+                r.redundant++;
+            }
+            acks.emplace_back(t + toTx, rx.GetAckSeq(g));
+        }
+        for (; !acks.empty() && acks.front().first <= t; acks.pop_front())
+        {
+            tx.OnAck(acks.front().second);
+        }
+    }
+    r.sent = tx.m_sent;
+    r.slots = t;
+    return r;
+}
+
+int
+main(int argc, char* argv[])
+{
+    uint64_t size = 10000000;
+    uint32_t mtu = 1000;
+    uint32_t genSize = 32;
+    double overhead = 0.02;
+    uint32_t rtt = 50;
+    uint32_t decode = 0;
+    double loss = 0.001;
+
+    CommandLine cmd(__FILE__);
+    cmd.Usage("Measure the redundant symbols of the generation mode of the coding transport");
+    cmd.AddValue("size", "flow size in bytes", size);
+    cmd.AddValue("mtu", "symbol size in bytes", mtu);
+    cmd.AddValue("gen", "source symbols per generation", genSize);
+    cmd.AddValue("overhead", "reception overhead of the code", overhead);
+    cmd.AddValue("rtt", "round trip in symbol slots", rtt);
+    cmd.AddValue("decode", "slots to decode a generation", decode);
+    cmd.AddValue("loss", "fraction of the symbols lost", loss);
+    cmd.Parse(argc, argv);
+
+    std::cout << "Running bench-rdma-coding with size=" << size << " gen=" << genSize
+              << " overhead=" << overhead << " rtt=" << rtt << " decode=" << decode
+              << " loss=" << loss << std::endl;
+
+    Result ideal = Run(size, mtu, genSize, 4, overhead, 0, 0, 0);
+    if (ideal.sent != ideal.needed || ideal.redundant != 0)
+    {
+        std::cerr << "Error-- without loss or delay " << ideal.sent << " symbols sent, "
+                  << ideal.needed << " needed, " << ideal.redundant << " redundant" << std::endl;
+        exit(1);
+    }
+
+    std::cout << "window\tsent/needed\tredundant\tgoodput" << std::endl;
+    for (uint32_t window = 1; window <= 64; window *= 2)
+    {
+        Result r = Run(size, mtu, genSize, window, overhead, rtt, decode, loss);
+        std::cout << window << "\t" << (double)r.sent / r.needed << "\t\t"
+                  << 100.0 * r.redundant / r.received << "%\t\t" << (double)r.source / r.slots
+                  << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,177 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+// This program benchmarks QP selection in a host NIC's RdmaEgressQueue with
+// many concurrent QPs, as in all-to-all, where congestion control has
+// throttled every QP so that together they use half of the NIC and the NIC
+// mostly waits for the next m_nextAvail. It compares the former linear
+// round-robin scan over every QP (and the second scan for the next wake-up)
+// with the ready-set/heap scheduler now used by RdmaEgressQueue.
+// Sample usage:  ./ns3 run 'bench-rdma-egress --n=1000000 --qps=10000'
+
+#include "ns3/command-line.h"
+#include "ns3/qbb-net-device.h"
+#include "ns3/simulator.h"
+#include "ns3/system-wall-clock-ms.h"
+
+#include <iostream>
+#include <stdlib.h> // for exit ()
+
+using namespace ns3;
+
+static const uint32_t pktSize = 1000;
+static const DataRate lineRate("100Gb/s");
+
+static Ptr<Packet> g_pkt;
+
+static Ptr<Packet>
+NextPkt(Ptr<RdmaQueuePair> qp)
+{
+    qp->snd_nxt += pktSize;
+    return g_pkt;
+}
+
+// the former RdmaEgressQueue::GetNextQindex, without the ACK queue and finished qps
+static int
+ScanNextQindex(Ptr<RdmaQueuePairGroup> grp, uint32_t rrlast, bool paused[])
+{
+    uint32_t fcount = grp->GetN();
+    for (uint32_t qIndex = 1; qIndex <= fcount; qIndex++)
+    {
+        uint32_t idx = (qIndex + rrlast) % fcount;
+        Ptr<RdmaQueuePair> qp = grp->Get(idx);
+        if (!paused[qp->m_pg] && qp->GetBytesLeft() > 0 && !qp->IsWinBound())
+        {
+            if (qp->m_nextAvail.GetTimeStep() > Simulator::Now().GetTimeStep())
+            {
+                continue;
+            }
+            return idx;
+        }
+    }
+    return -1024;
+}
+
+// the former wake-up computation of QbbNetDevice::DequeueAndTransmit
+static Time
+ScanNextAvail(Ptr<RdmaQueuePairGroup> grp)
+{
+    Time t = Simulator::GetMaximumSimulationTime();
+    for (uint32_t i = 0; i < grp->GetN(); i++)
+    {
+        Ptr<RdmaQueuePair> qp = grp->Get(i);
+        if (qp->GetBytesLeft() == 0)
+        {
+            continue;
+        }
+        t = Min(qp->m_nextAvail, t);
+    }
+    return t;
+}
+
+struct Nic
+{
+    Ptr<RdmaEgressQueue> eq;
+    Ptr<RdmaQueuePairGroup> grp;
+    bool scan;
+    uint32_t left;
+    bool paused[RdmaEgressQueue::qCnt];
+};
+
+// QbbNetDevice::DequeueAndTransmit and RdmaHw::PktSent, without the packet transmission
+static void
+Transmit(Nic* nic)
+{
+    if (nic->left == 0)
+    {
+        return;
+    }
+    int idx = nic->scan ? ScanNextQindex(nic->grp, nic->eq->m_rrlast, nic->paused)
+                        : nic->eq->GetNextQindex(nic->paused);
+    if (idx < 0)
+    {
+        Time t = nic->scan ? ScanNextAvail(nic->grp) : nic->eq->GetNextAvail();
+        Simulator::Schedule(t - Simulator::Now(), &Transmit, nic);
+        return;
+    }
+    Ptr<RdmaQueuePair> qp = nic->grp->Get(idx);
+    nic->eq->DequeueQindex(idx);
+    qp->m_nextAvail = Simulator::Now() + qp->m_rate.CalculateBytesTxTime(pktSize);
+    if (!nic->scan)
+    {
+        nic->eq->UpdateQp(qp);
+    }
+    nic->left--;
+    Simulator::Schedule(lineRate.CalculateBytesTxTime(pktSize), &Transmit, nic);
+}
+
+// sends n packets from nQps qps, each throttled to half of its fair share of the line
+static void
+Run(uint32_t n, uint32_t nQps, bool scan)
+{
+    Nic nic = {};
+    nic.grp = CreateObject<RdmaQueuePairGroup>();
+    for (uint32_t i = 0; i < nQps; i++)
+    {
+        Ptr<RdmaQueuePair> qp = Create<RdmaQueuePair>(3,
+                                                      Ipv4Address(0x0b000001),
+                                                      Ipv4Address(0x0b000101 + i),
+                                                      10000 + i,
+                                                      100);
+        qp->SetSize(1ULL << 40);
+        qp->m_max_rate = lineRate;
+        qp->m_rate = DataRate(lineRate.GetBitRate() / nQps / 2);
+        // staggered starts, so that the qps do not send in bursts of nQps packets
+        qp->m_nextAvail = qp->m_rate.CalculateBytesTxTime(pktSize) * i / nQps;
+        nic.grp->AddQp(qp);
+    }
+    nic.eq = CreateObject<RdmaEgressQueue>();
+    nic.eq->m_qpGrp = nic.grp;
+    nic.eq->m_rdmaGetNxtPkt = MakeCallback(&NextPkt);
+    nic.scan = scan;
+    nic.left = n;
+    Simulator::ScheduleNow(&Transmit, &nic);
+    Simulator::Run();
+    Simulator::Destroy();
+}
+
+static uint64_t
+runBench(uint32_t n, uint32_t nQps, bool scan)
+{
+    SystemWallClockMs time;
+    time.Start();
+    Run(n, nQps, scan);
+    return time.End();
+}
+
+int
+main(int argc, char* argv[])
+{
+    uint32_t n = 0;
+    uint32_t nQps = 1000;
+
+    CommandLine cmd(__FILE__);
+    cmd.Usage("Benchmark QP selection in RdmaEgressQueue with many rate-limited QPs");
+    cmd.AddValue("n", "number of packets", n);
+    cmd.AddValue("qps", "number of concurrent qps", nQps);
+    cmd.Parse(argc, argv);
+
+    if (n == 0)
+    {
+        std::cerr << "Error-- number of packets must be specified "
+                  << "by command-line argument --n=(number of packets)" << std::endl;
+        exit(1);
+    }
+    g_pkt = Create<Packet>(pktSize);
+
+    std::cout << "Running bench-rdma-egress with n=" << n << " qps=" << nQps << std::endl;
+    uint64_t scan = runBench(n, nQps, true);
+    uint64_t sched = runBench(n, nQps, false);
+    std::cout << scan * 1e6 / n << " ns/pkt"
+              << " (" << scan << " ms elapsed)\tlinear scan" << std::endl;
+    std::cout << sched * 1e6 / n << " ns/pkt"
+              << " (" << sched << " ms elapsed)\tready set and heap" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,199 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+// This program measures the memory of the RdmaQueuePairs of 'qps' concurrent
+// flows, and the time the NIC scheduler takes to check them all for a packet
+// to send, 'rounds' times. It compares the former layout, an Object holding
+// the states of every congestion control, with the hot/cold RdmaQueuePair
+// and the state of the RdmaCongestionOps of one cc_mode, from the slab of
+// the ops. Freed CC states must be reused by the slab.
+// Sample usage:  ./ns3 run 'bench-rdma-qp --qps=1000000'
+
+#include "ns3/command-line.h"
+#include "ns3/object-factory.h"
+#include "ns3/rdma-congestion-ops.h"
+#include "ns3/rdma-header-template.h"
+#include "ns3/rdma-queue-pair.h"
+#include "ns3/system-wall-clock-ms.h"
+
+#include <iostream>
+#include <stdlib.h> // for exit ()
+#include <vector>
+
+using namespace ns3;
+
+/// the former RdmaQueuePair
+class LegacyQueuePair : public Object
+{
+  public:
+    Time startTime;
+    Ipv4Address sip, dip;
+    uint16_t sport, dport;
+    uint64_t m_size;
+    uint64_t coding_snd_nxt;
+    uint64_t snd_nxt, snd_una;
+    uint16_t m_pg;
+    uint16_t m_ipid;
+    uint32_t m_win;
+    uint64_t m_baseRtt;
+    DataRate m_max_rate;
+    bool m_var_win;
+    Time m_nextAvail;
+    uint32_t wp;
+    uint32_t lastPktSize;
+    uint32_t m_egressIdx;
+    RdmaHeaderTemplate m_dataHdr;
+    Callback<void> m_notifyAppFinish;
+    DataRate m_rate;
+    RdmaQpMlx mlx;
+    RdmaQpHp hp;
+    RdmaQpTimely tmly;
+    RdmaQpDctcp dctcp;
+    RdmaQpHpPint hpccPint;
+
+    LegacyQueuePair()
+        : m_size(0),
+          snd_nxt(0),
+          snd_una(0),
+          m_win(0),
+          m_var_win(false)
+    {
+    }
+};
+
+/// the checks of RdmaEgressQueue::GetNextQindex before it sends a qp
+template <typename Qp>
+static bool
+Ready(Qp* qp, int64_t now)
+{
+    uint64_t left = qp->m_size >= qp->snd_nxt ? qp->m_size - qp->snd_nxt : 0;
+    uint64_t w = qp->m_win;
+    if (w != 0 && qp->m_var_win)
+    {
+        w = std::max<uint64_t>(1, w * qp->m_rate.GetBitRate() / qp->m_max_rate.GetBitRate());
+    }
+    bool winBound = w != 0 && qp->snd_nxt - qp->snd_una >= w;
+    return left > 0 && !winBound && qp->m_nextAvail.GetTimeStep() <= now;
+}
+
+/// the same pseudo-random send state for qp i of both layouts
+template <typename Qp>
+static void
+InitQp(Qp* qp, uint32_t i)
+{
+    uint32_t x = i * 2654435761U;
+    qp->m_size = 1000000;
+    qp->snd_una = x % 1000 * 1000;
+    qp->snd_nxt = qp->snd_una + (x >> 10) % 64 * 1000;
+    qp->m_win = 40000;
+    qp->m_var_win = true;
+    qp->m_max_rate = DataRate(100000000000ULL);
+    qp->m_rate = DataRate(1000000000ULL + (x >> 16) % 99 * 1000000000ULL);
+    qp->m_nextAvail = TimeStep((x >> 20) % 1000);
+}
+
+template <typename Qp>
+static uint64_t
+Scan(const std::vector<Ptr<Qp>>& qps, uint32_t rounds)
+{
+    uint64_t ready = 0;
+    for (uint32_t r = 0; r < rounds; r++)
+    {
+        for (const auto& qp : qps)
+        {
+            ready += Ready(PeekPointer(qp), 500 + r);
+        }
+    }
+    return ready;
+}
+
+int
+main(int argc, char* argv[])
+{
+    uint32_t qps = 1000000;
+    uint32_t rounds = 20;
+
+    CommandLine cmd(__FILE__);
+    cmd.Usage("Measure the memory and scan time of RdmaQueuePairs");
+    cmd.AddValue("qps", "number of queue pairs", qps);
+    cmd.AddValue("rounds", "number of scans over all of them", rounds);
+    cmd.Parse(argc, argv);
+
+    std::cout << "Running bench-rdma-qp with qps=" << qps << " rounds=" << rounds << std::endl;
+
+    uint32_t ccModes[] = {1, 3, 7, 8, 10};
+    std::cout << "bytes per qp\tformer " << sizeof(LegacyQueuePair) << ", now "
+              << sizeof(RdmaQueuePair) << " +" << std::endl;
+    for (uint32_t mode : ccModes)
+    {
+        ObjectFactory factory;
+        factory.SetTypeId(RdmaCongestionOps::GetTypeIdOfCcMode(mode));
+        Ptr<RdmaCongestionOps> ops = factory.Create<RdmaCongestionOps>();
+        std::vector<Ptr<RdmaQueuePair>> v;
+        for (uint32_t i = 0; i < 1024; i++)
+        {
+            v.push_back(Create<RdmaQueuePair>(3, Ipv4Address(i), Ipv4Address(1), i, 100));
+            ops->InitQp(v.back());
+        }
+        Ptr<RdmaCcSlab> slab = ops->GetSlab();
+        uint64_t bytes = slab->GetBytes();
+        // the qps of the second round reuse the CC states the first one freed
+        v.clear();
+        for (uint32_t i = 0; i < 1024; i++)
+        {
+            v.push_back(Create<RdmaQueuePair>(3, Ipv4Address(i), Ipv4Address(1), i, 100));
+            ops->InitQp(v.back());
+        }
+        if (slab->GetBytes() != bytes)
+        {
+            std::cerr << "Error-- the slab of cc_mode " << mode << " did not reuse freed blocks"
+                      << std::endl;
+            exit(1);
+        }
+        std::cout << "\tcc_mode " << mode << ": " << slab->GetBlockSize() << " CC state, "
+                  << sizeof(LegacyQueuePair) /
+                         (double)(sizeof(RdmaQueuePair) + slab->GetBlockSize())
+                  << "x smaller" << std::endl;
+    }
+
+    SystemWallClockMs time;
+    time.Start();
+    std::vector<Ptr<LegacyQueuePair>> legacy(qps);
+    for (uint32_t i = 0; i < qps; i++)
+    {
+        legacy[i] = CreateObject<LegacyQueuePair>();
+        InitQp(PeekPointer(legacy[i]), i);
+    }
+    uint64_t legacyCreateMs = time.End();
+    time.Start();
+    uint64_t legacyReady = Scan(legacy, rounds);
+    uint64_t legacyMs = time.End();
+    legacy.clear();
+
+    time.Start();
+    Ptr<RdmaCongestionOps> ops = CreateObject<RdmaHpcc>();
+    std::vector<Ptr<RdmaQueuePair>> now(qps);
+    for (uint32_t i = 0; i < qps; i++)
+    {
+        now[i] = Create<RdmaQueuePair>(3, Ipv4Address(i), Ipv4Address(1), i, 100);
+        ops->InitQp(now[i]);
+        InitQp(PeekPointer(now[i]), i);
+    }
+    uint64_t createMs = time.End();
+    time.Start();
+    uint64_t ready = Scan(now, rounds);
+    uint64_t scanMs = time.End();
+    if (ready != legacyReady)
+    {
+        std::cerr << "Error-- " << ready << " ready qps, formerly " << legacyReady << std::endl;
+        exit(1);
+    }
+
+    std::cout << legacyCreateMs << " ms to create, " << legacyMs << " ms to scan\tformer layout"
+              << std::endl;
+    std::cout << createMs << " ms to create, " << scanMs
+              << " ms to scan\thot/cold layout and HPCC state from the slab" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,152 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+// This program benchmarks the rx qp lookup of RdmaHw::ReceiveUdp on a host
+// receiving 'flows' short flows of 'pkts' packets each, 'concurrent' of them
+// at a time, each rx qp deleted when its flow completes. It compares the
+// former unordered_map of Ptr to an Object per rx qp with RdmaRxQpTable of
+// 64-byte records, in time per packet and in memory at the peak.
+// Sample usage:  ./ns3 run 'bench-rdma-rx-qp --flows=1000000'
+
+#include "ns3/command-line.h"
+#include "ns3/rdma-header-template.h"
+#include "ns3/rdma-queue-pair.h"
+#include "ns3/simulator.h"
+#include "ns3/system-wall-clock-ms.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdlib.h> // for exit ()
+#include <unordered_map>
+#include <vector>
+
+using namespace ns3;
+
+/// the former RdmaRxQueuePair
+class LegacyRxQueuePair : public Object
+{
+  public:
+    RdmaRxQueuePair::ECNAccount m_ecn_source;
+    uint32_t sip, dip;
+    uint16_t sport, dport;
+    uint16_t m_ipid;
+    uint32_t ReceiverNextExpectedSeq;
+    Time m_nackTimer;
+    int32_t m_milestone_rx;
+    uint32_t m_lastNACK;
+    EventId QcnTimerEvent;
+    RdmaHeaderTemplate m_ackHdr;
+    uint32_t m_codingAckPending;
+    IntHeader m_codingAckIh;
+    EventId m_codingAckEvent;
+
+    LegacyRxQueuePair()
+        : ReceiverNextExpectedSeq(0)
+    {
+    }
+};
+
+/// the flow of the i-th packet: 'concurrent' flows interleave, each sends 'pkts' packets
+static uint32_t
+FlowOf(uint64_t i, uint32_t concurrent, uint32_t pkts)
+{
+    return i / ((uint64_t)concurrent * pkts) * concurrent + i % concurrent;
+}
+
+static uint64_t
+KeyOf(uint32_t flow)
+{
+    return RdmaRxQpTable::GetKey(0x0b000001 + flow / 60000, 3, 10000 + flow % 60000);
+}
+
+int
+main(int argc, char* argv[])
+{
+    uint32_t flows = 1000000;
+    uint32_t pkts = 10;
+    uint32_t concurrent = 1000;
+
+    CommandLine cmd(__FILE__);
+    cmd.Usage("Benchmark the rx qp table of RdmaHw");
+    cmd.AddValue("flows", "number of flows", flows);
+    cmd.AddValue("pkts", "packets per flow", pkts);
+    cmd.AddValue("concurrent", "flows received at a time", concurrent);
+    cmd.Parse(argc, argv);
+
+    std::cout << "Running bench-rdma-rx-qp with flows=" << flows << " pkts=" << pkts
+              << " concurrent=" << concurrent << std::endl;
+
+    // Time objects are tracked for a change of resolution until a simulation runs
+    Simulator::Run();
+
+    flows = std::max(flows / concurrent, 1U) * concurrent;
+    uint64_t n = (uint64_t)flows * pkts;
+    SystemWallClockMs time;
+
+    std::unordered_map<uint64_t, Ptr<LegacyRxQueuePair>> legacy;
+    uint64_t legacySum = 0;
+    size_t legacyPeak = 0;
+    time.Start();
+    for (uint64_t i = 0; i < n; i++)
+    {
+        uint64_t key = KeyOf(FlowOf(i, concurrent, pkts));
+        Ptr<LegacyRxQueuePair>& q = legacy[key];
+        if (q == nullptr)
+        {
+            q = CreateObject<LegacyRxQueuePair>();
+        }
+        q->ReceiverNextExpectedSeq += 1000;
+        legacyPeak = std::max(legacyPeak, legacy.size());
+        if (q->ReceiverNextExpectedSeq == pkts * 1000)
+        {
+            legacySum += q->ReceiverNextExpectedSeq;
+            legacy.erase(key);
+        }
+    }
+    uint64_t legacyMs = time.End();
+
+    RdmaRxQpTable table;
+    uint64_t sum = 0;
+    uint32_t peakCapacity = 0;
+    time.Start();
+    for (uint64_t i = 0; i < n; i++)
+    {
+        uint64_t key = KeyOf(FlowOf(i, concurrent, pkts));
+        bool inserted;
+        RdmaRxQueuePair* q = table.Insert(key, inserted);
+        q->ReceiverNextExpectedSeq += 1000;
+        peakCapacity = std::max(peakCapacity, table.GetCapacity());
+        if (q->ReceiverNextExpectedSeq == pkts * 1000)
+        {
+            sum += q->ReceiverNextExpectedSeq;
+            table.Erase(key);
+        }
+    }
+    uint64_t ms = time.End();
+
+    if (sum != legacySum || table.GetN() != 0 || !legacy.empty())
+    {
+        std::cerr << "Error-- " << sum << " bytes received, formerly " << legacySum << ", "
+                  << table.GetN() << " rx qps left" << std::endl;
+        exit(1);
+    }
+    if (table.GetCapacity() != RdmaRxQpTable::minCapacity)
+    {
+        std::cerr << "Error-- the empty table kept " << table.GetCapacity() << " slots"
+                  << std::endl;
+        exit(1);
+    }
+
+    // an unordered_map node holds the key, the Ptr and the next pointer, plus a bucket
+    uint64_t legacyBytes =
+        legacyPeak * (sizeof(LegacyRxQueuePair) + sizeof(uint64_t) * 3 + sizeof(void*) * 2);
+    uint64_t bytes = (uint64_t)peakCapacity * sizeof(RdmaRxQueuePair);
+    std::cout << legacyMs * 1e6 / n << " ns/pkt, " << legacyBytes / 1024
+              << " KiB at the peak\tunordered_map of Object" << std::endl;
+    std::cout << ms * 1e6 / n << " ns/pkt, " << bytes / 1024
+              << " KiB at the peak\tRdmaRxQpTable" << std::endl;
+
+    Simulator::Destroy();
+    return 0;
+}
@@ -0,0 +1,389 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+// This program benchmarks the routing setup of k-ary fat-trees, k = 4, 8, ...
+// up to maxK, hosts first and then the edge, aggregation and core switches.
+// It compares the former per-host BFS of the scratch programs, over
+// std::map<Ptr<Node>, ...>, with RouteCalculator on 1 and on all hardware
+// threads; every variant fills the SwitchNode and RdmaHw tables. Up to
+// legacyMaxK, the routes and host pair delays of both are checked to be the
+// same first, the ECMP order too when the nodes happen to be allocated in
+// increasing addresses.
+// Sample usage:  ./ns3 run 'bench-route-calculator --maxK=16'
+
+#include "ns3/command-line.h"
+#include "ns3/rdma-driver.h"
+#include "ns3/rdma-hw.h"
+#include "ns3/route-calculator.h"
+#include "ns3/simulator.h"
+#include "ns3/switch-node.h"
+#include "ns3/system-wall-clock-ms.h"
+
+#include <iostream>
+#include <algorithm>
+#include <map>
+#include <stdlib.h> // for exit ()
+#include <thread>
+#include <vector>
+
+using namespace ns3;
+
+static const uint64_t linkDelay = 1000;
+static const uint64_t linkRate = 100000000000;
+static const uint32_t payloadSize = 1000;
+
+struct Interface
+{
+    uint32_t idx;
+    bool up;
+    uint64_t delay;
+    uint64_t bw;
+
+    Interface()
+        : idx(0),
+          up(false)
+    {
+    }
+};
+
+struct Topology
+{
+    NodeContainer n;
+    std::vector<Ipv4Address> addresses;
+    std::vector<std::pair<uint32_t, uint32_t>> links;
+};
+
+static void
+Link(Topology& t, uint32_t a, uint32_t b)
+{
+    t.links.emplace_back(a, b);
+}
+
+static Topology
+FatTree(uint32_t k)
+{
+    Topology t;
+    uint32_t hosts = k * k * k / 4;
+    uint32_t edges = k * k / 2;
+    uint32_t aggs = k * k / 2;
+    uint32_t cores = k * k / 4;
+    for (uint32_t i = 0; i < hosts; i++)
+    {
+        Ptr<Node> node = CreateObject<Node>();
+        Ptr<RdmaDriver> driver = CreateObject<RdmaDriver>();
+        driver->m_rdma = CreateObject<RdmaHw>();
+        node->AggregateObject(driver);
+        t.n.Add(node);
+        t.addresses.push_back(Ipv4Address(0x0b000001 + (i << 8)));
+    }
+    for (uint32_t i = 0; i < edges + aggs + cores; i++)
+    {
+        t.n.Add(CreateObject<SwitchNode>());
+    }
+    uint32_t edge0 = hosts;
+    uint32_t agg0 = edge0 + edges;
+    uint32_t core0 = agg0 + aggs;
+    for (uint32_t i = 0; i < hosts; i++)
+    {
+        Link(t, i, edge0 + i / (k / 2));
+    }
+    for (uint32_t pod = 0; pod < k; pod++)
+    {
+        for (uint32_t e = 0; e < k / 2; e++)
+        {
+            for (uint32_t a = 0; a < k / 2; a++)
+            {
+                Link(t, edge0 + pod * k / 2 + e, agg0 + pod * k / 2 + a);
+            }
+        }
+        for (uint32_t a = 0; a < k / 2; a++)
+        {
+            for (uint32_t c = 0; c < k / 2; c++)
+            {
+                Link(t, agg0 + pod * k / 2 + a, core0 + a * k / 2 + c);
+            }
+        }
+    }
+    return t;
+}
+
+// the former routing setup of third.cc
+struct Legacy
+{
+    std::map<Ptr<Node>, std::map<Ptr<Node>, Interface>> nbr2if;
+    std::map<Ptr<Node>, std::map<Ptr<Node>, std::vector<Ptr<Node>>>> nextHop;
+    std::map<Ptr<Node>, std::map<Ptr<Node>, uint64_t>> pairDelay;
+    std::map<Ptr<Node>, std::map<Ptr<Node>, uint64_t>> pairTxDelay;
+    std::map<uint32_t, std::map<uint32_t, uint64_t>> pairBw;
+
+    void CalculateRoute(Ptr<Node> host)
+    {
+        std::vector<Ptr<Node>> q;
+        std::map<Ptr<Node>, int> dis;
+        std::map<Ptr<Node>, uint64_t> delay;
+        std::map<Ptr<Node>, uint64_t> txDelay;
+        std::map<Ptr<Node>, uint64_t> bw;
+        q.push_back(host);
+        dis[host] = 0;
+        delay[host] = 0;
+        txDelay[host] = 0;
+        bw[host] = 0xfffffffffffffffflu;
+        for (int i = 0; i < (int)q.size(); i++)
+        {
+            Ptr<Node> now = q[i];
+            int d = dis[now];
+            for (auto it = nbr2if[now].begin(); it != nbr2if[now].end(); it++)
+            {
+                if (!it->second.up)
+                {
+                    continue;
+                }
+                Ptr<Node> next = it->first;
+                if (dis.find(next) == dis.end())
+                {
+                    dis[next] = d + 1;
+                    delay[next] = delay[now] + it->second.delay;
+                    txDelay[next] = txDelay[now] + payloadSize * 1000000000lu * 8 / it->second.bw;
+                    bw[next] = std::min(bw[now], it->second.bw);
+                    if (next->GetNodeType() == 1)
+                    {
+                        q.push_back(next);
+                    }
+                }
+                if (d + 1 == dis[next])
+                {
+                    nextHop[next][host].push_back(now);
+                }
+            }
+        }
+        for (auto it : delay)
+        {
+            pairDelay[it.first][host] = it.second;
+        }
+        for (auto it : txDelay)
+        {
+            pairTxDelay[it.first][host] = it.second;
+        }
+        for (auto it : bw)
+        {
+            pairBw[it.first->GetId()][host->GetId()] = it.second;
+        }
+    }
+
+    void Run(Topology& t, bool install)
+    {
+        for (uint32_t i = 0; i < t.n.GetN(); i++)
+        {
+            if (t.n.Get(i)->GetNodeType() == 0)
+            {
+                CalculateRoute(t.n.Get(i));
+            }
+        }
+        if (!install)
+        {
+            return;
+        }
+        for (auto i = nextHop.begin(); i != nextHop.end(); i++)
+        {
+            Ptr<Node> node = i->first;
+            for (auto j = i->second.begin(); j != i->second.end(); j++)
+            {
+                Ipv4Address dstAddr = t.addresses[j->first->GetId() - t.n.Get(0)->GetId()];
+                for (auto next : j->second)
+                {
+                    uint32_t interface = nbr2if[node][next].idx;
+                    if (node->GetNodeType() == 1)
+                    {
+                        DynamicCast<SwitchNode>(node)->AddTableEntry(dstAddr, interface);
+                    }
+                    else
+                    {
+                        node->GetObject<RdmaDriver>()->m_rdma->AddTableEntry(dstAddr, interface);
+                    }
+                }
+            }
+        }
+    }
+};
+
+static void
+AddLinks(Topology& t, Legacy* legacy, RouteCalculator* calc)
+{
+    std::vector<uint32_t> nIf(t.n.GetN(), 1);
+    for (auto [a, b] : t.links)
+    {
+        uint32_t ia = nIf[a]++;
+        uint32_t ib = nIf[b]++;
+        if (legacy)
+        {
+            Interface& x = legacy->nbr2if[t.n.Get(a)][t.n.Get(b)];
+            x.idx = ia;
+            x.up = true;
+            x.delay = linkDelay;
+            x.bw = linkRate;
+            Interface& y = legacy->nbr2if[t.n.Get(b)][t.n.Get(a)];
+            y.idx = ib;
+            y.up = true;
+            y.delay = linkDelay;
+            y.bw = linkRate;
+        }
+        if (calc)
+        {
+            calc->AddInterface(a, b, ia, linkDelay, linkRate);
+            calc->AddInterface(b, a, ib, linkDelay, linkRate);
+        }
+    }
+}
+
+typedef std::map<std::pair<uint32_t, uint32_t>, std::vector<uint32_t>> RouteList;
+
+static RouteList* collected;
+
+static void
+Collect(uint32_t node, uint32_t dst, uint32_t ifIndex)
+{
+    (*collected)[{node, dst}].push_back(ifIndex);
+}
+
+static bool
+CheckSame(uint32_t k)
+{
+    Topology t = FatTree(k);
+    Legacy legacy;
+    AddLinks(t, &legacy, nullptr);
+    legacy.Run(t, false);
+    RouteList expected;
+    uint32_t id0 = t.n.Get(0)->GetId();
+    for (auto& i : legacy.nextHop)
+    {
+        for (auto& j : i.second)
+        {
+            for (auto next : j.second)
+            {
+                expected[{i.first->GetId() - id0, j.first->GetId() - id0}].push_back(
+                    legacy.nbr2if[i.first][next].idx);
+            }
+        }
+    }
+
+    RouteCalculator calc;
+    calc.SetNodes(t.n, t.addresses);
+    calc.SetPayloadSize(payloadSize);
+    AddLinks(t, nullptr, &calc);
+    RouteList got;
+    collected = &got;
+    calc.ComputeRoutes(MakeCallback(&Collect));
+    // the legacy ECMP order follows the addresses of the nodes, which is the node
+    // order only if they were allocated in increasing addresses
+    bool ordered = true;
+    for (uint32_t i = 1; i < t.n.GetN(); i++)
+    {
+        ordered = ordered && PeekPointer(t.n.Get(i - 1)) < PeekPointer(t.n.Get(i));
+    }
+    if (!ordered)
+    {
+        for (auto& r : expected)
+        {
+            std::sort(r.second.begin(), r.second.end());
+        }
+        for (auto& r : got)
+        {
+            std::sort(r.second.begin(), r.second.end());
+        }
+    }
+    if (got != expected)
+    {
+        return false;
+    }
+    uint32_t hosts = k * k * k / 4;
+    for (uint32_t i = 0; i < hosts; i++)
+    {
+        for (uint32_t j = 0; j < hosts; j++)
+        {
+            if (calc.GetDelay(i, j) != legacy.pairDelay[t.n.Get(i)][t.n.Get(j)] ||
+                calc.GetTxDelay(i, j) != legacy.pairTxDelay[t.n.Get(i)][t.n.Get(j)] ||
+                calc.GetBw(i, j) != legacy.pairBw[i + id0][j + id0])
+            {
+                return false;
+            }
+        }
+    }
+    Simulator::Destroy();
+    return true;
+}
+
+static uint64_t
+RunLegacy(uint32_t k)
+{
+    Topology t = FatTree(k);
+    SystemWallClockMs time;
+    time.Start();
+    {
+        Legacy legacy;
+        AddLinks(t, &legacy, nullptr);
+        legacy.Run(t, true);
+    }
+    uint64_t ms = time.End();
+    Simulator::Destroy();
+    return ms;
+}
+
+static uint64_t
+RunCalculator(uint32_t k, uint32_t threads)
+{
+    Topology t = FatTree(k);
+    SystemWallClockMs time;
+    time.Start();
+    {
+        RouteCalculator calc;
+        calc.SetNodes(t.n, t.addresses);
+        calc.SetHostAddressing(0x0b000001, 8);
+        calc.SetPayloadSize(payloadSize);
+        calc.SetThreads(threads);
+        AddLinks(t, nullptr, &calc);
+        calc.InstallRoutes();
+    }
+    uint64_t ms = time.End();
+    Simulator::Destroy();
+    return ms;
+}
+
+int
+main(int argc, char* argv[])
+{
+    uint32_t maxK = 16;
+    uint32_t legacyMaxK = 16;
+
+    CommandLine cmd(__FILE__);
+    cmd.Usage("Benchmark routing setup of fat-trees");
+    cmd.AddValue("maxK", "largest fat-tree arity", maxK);
+    cmd.AddValue("legacyMaxK", "largest fat-tree arity to run the legacy setup on", legacyMaxK);
+    cmd.Parse(argc, argv);
+
+    uint32_t threads = std::max(1U, std::thread::hardware_concurrency());
+    std::cout << "Running bench-route-calculator with maxK=" << maxK << ", " << threads
+              << " hardware threads" << std::endl;
+    for (uint32_t k = 4; k <= maxK; k += 4)
+    {
+        std::cout << "k=" << k << " (" << k * k * k / 4 << " hosts, " << 5 * k * k / 4
+                  << " switches):" << std::endl;
+        if (k <= legacyMaxK)
+        {
+            if (!CheckSame(k))
+            {
+                std::cerr << "Error-- routes or delays differ from the legacy setup" << std::endl;
+                exit(1);
+            }
+            std::cout << RunLegacy(k) << " ms\tper-host BFS over std::map" << std::endl;
+        }
+        std::cout << RunCalculator(k, 1) << " ms\tRouteCalculator, 1 thread" << std::endl;
+        if (threads > 1)
+        {
+            std::cout << RunCalculator(k, threads) << " ms\tRouteCalculator, " << threads
+                      << " threads" << std::endl;
+        }
+    }
+
+    return 0;
+}
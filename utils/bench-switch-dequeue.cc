@@ -0,0 +1,158 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+// This program benchmarks the header work a switch does when it dequeues a
+// data packet, for a packet crossing a line of 'hops' switches that all mark
+// ECN and push an INT hop. It compares the former path (packet copy, ppp and
+// IPv4 header removal on the copy, CustomHeader removal and ECN marking by
+// re-serializing the ppp and IPv4 headers) with the in-place path now used by
+// QbbNetDevice::DequeueAndTransmit and SwitchNode::SwitchNotifyDequeue.
+// Sample usage:  ./ns3 run 'bench-switch-dequeue --n=1000000'
+
+#include "ns3/command-line.h"
+#include "ns3/custom-header.h"
+#include "ns3/int-header.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/ppp-header.h"
+#include "ns3/rdma-seq-ts-header.h"
+#include "ns3/switch-node.h"
+#include "ns3/system-wall-clock-ms.h"
+#include "ns3/udp-header.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdlib.h> // for exit ()
+
+using namespace ns3;
+
+static const uint32_t hops = 5;
+
+static Ptr<Packet>
+MakeDataPacket(uint32_t seq)
+{
+    // same layout as RdmaHw::GetNxtPacket
+    Ptr<Packet> p = Create<Packet>(1000);
+    RDMASeqTsHeader seqTs;
+    seqTs.SetSeq(seq);
+    seqTs.SetPG(3);
+    p->AddHeader(seqTs);
+    UdpHeader udpHeader;
+    udpHeader.SetDestinationPort(100);
+    udpHeader.SetSourcePort(10000);
+    p->AddHeader(udpHeader);
+    Ipv4Header ipHeader;
+    ipHeader.SetSource(Ipv4Address(0x0b000001));
+    ipHeader.SetDestination(Ipv4Address(0x0b000101));
+    ipHeader.SetProtocol(0x11);
+    ipHeader.SetPayloadSize(p->GetSize());
+    ipHeader.SetTtl(64);
+    ipHeader.SetTos(0);
+    ipHeader.SetIdentification(seq);
+    p->AddHeader(ipHeader);
+    PppHeader ppp;
+    ppp.SetProtocol(0x0021);
+    p->AddHeader(ppp);
+    return p;
+}
+
+static void
+PushIntHop(Ptr<Packet> p, uint32_t hop)
+{
+    uint8_t* buf = p->GetBuffer();
+    IntHeader* ih = (IntHeader*)&buf[PppHeader::GetStaticSize() + 20 + 8 + 6];
+    ih->PushHop(hop, hop * 1000, hop * 100, 100000000000ULL);
+}
+
+static void
+benchCopy(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        Ptr<Packet> p = MakeDataPacket(i);
+        for (uint32_t h = 0; h < hops; h++)
+        {
+            // QbbNetDevice::DequeueAndTransmit
+            Ipv4Header h4;
+            Ptr<Packet> packet = p->Copy();
+            PppHeader ppp;
+            packet->RemoveHeader(ppp);
+            packet->RemoveHeader(h4);
+            // SwitchNode::SwitchNotifyDequeue
+            CustomHeader ch;
+            p->RemoveHeader(ch);
+            PppHeader ppp2;
+            Ipv4Header ip;
+            p->RemoveHeader(ppp2);
+            p->RemoveHeader(ip);
+            ip.SetEcn(Ipv4Header::ECN_CE);
+            p->AddHeader(ip);
+            p->AddHeader(ppp2);
+            PushIntHop(p, h);
+        }
+    }
+}
+
+static void
+benchInPlace(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        Ptr<Packet> p = MakeDataPacket(i);
+        for (uint32_t h = 0; h < hops; h++)
+        {
+            SwitchNode::SetEcnCe(p);
+            PushIntHop(p, h);
+        }
+    }
+}
+
+static void
+benchBuildOnly(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        Ptr<Packet> p = MakeDataPacket(i);
+    }
+}
+
+static uint64_t
+runBench(void (*bench)(uint32_t), uint32_t n)
+{
+    SystemWallClockMs time;
+    time.Start();
+    (*bench)(n);
+    return time.End();
+}
+
+int
+main(int argc, char* argv[])
+{
+    uint32_t n = 0;
+
+    CommandLine cmd(__FILE__);
+    cmd.Usage("Benchmark per-hop header processing on the switch dequeue path");
+    cmd.AddValue("n", "number of packets", n);
+    cmd.Parse(argc, argv);
+
+    if (n == 0)
+    {
+        std::cerr << "Error-- number of packets must be specified "
+                  << "by command-line argument --n=(number of packets)" << std::endl;
+        exit(1);
+    }
+    IntHeader::mode = IntHeader::NORMAL;
+
+    std::cout << "Running bench-switch-dequeue with n=" << n << " hops=" << hops << std::endl;
+    // packet construction is common to both paths, subtract it from the per-hop cost
+    uint64_t build = runBench(&benchBuildOnly, n);
+    uint64_t copy = runBench(&benchCopy, n);
+    uint64_t inPlace = runBench(&benchInPlace, n);
+    double perHop = 1e6 / n / hops;
+    std::cout << (copy - std::min(copy, build)) * perHop << " ns/hop"
+              << " (" << copy << " ms elapsed)\tcopy and re-serialize" << std::endl;
+    std::cout << (inPlace - std::min(inPlace, build)) * perHop << " ns/hop"
+              << " (" << inPlace << " ms elapsed)\tin place" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,52 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+// This program converts a text flow trace (flow count, then one
+// "src dst pg dport size start_seconds" line per flow) to the binary format
+// of FlowTraceReader, which third and test-coding-transport read as well
+// through FLOW_FILE.
+// Sample usage:  ./ns3 run 'convert-flow-trace --in=mix/flow.txt --out=mix/flow.bin'
+
+#include "ns3/command-line.h"
+#include "ns3/flow-trace.h"
+#include "ns3/system-wall-clock-ms.h"
+
+#include <iostream>
+#include <stdlib.h> // for exit ()
+
+using namespace ns3;
+
+int
+main(int argc, char* argv[])
+{
+    std::string in;
+    std::string out;
+
+    CommandLine cmd(__FILE__);
+    cmd.Usage("Convert a text flow trace to the binary flow trace format");
+    cmd.AddValue("in", "text flow trace", in);
+    cmd.AddValue("out", "binary flow trace to write", out);
+    cmd.Parse(argc, argv);
+
+    if (in.empty() || out.empty())
+    {
+        std::cerr << "Error-- input and output must be specified "
+                  << "by command-line arguments --in=(text trace) --out=(binary trace)" << std::endl;
+        exit(1);
+    }
+
+    SystemWallClockMs time;
+    time.Start();
+    if (!FlowTraceReader::ConvertToBinary(in, out))
+    {
+        std::cerr << "Error-- cannot convert " << in << " to " << out << std::endl;
+        exit(1);
+    }
+    FlowTraceReader reader;
+    reader.Open(out);
+    std::cout << "Converted " << reader.GetNFlows() << " flows in " << time.End() << " ms"
+              << std::endl;
+
+    return 0;
+}